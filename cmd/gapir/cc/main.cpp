@@ -14,6 +14,7 @@
  * limitations under the License.
  */
 
+#include "gapir/cc/checkpoint.h"
 #include "gapir/cc/context.h"
 #include "gapir/cc/crash_uploader.h"
 #include "gapir/cc/memory_manager.h"
@@ -30,6 +31,7 @@
 #include "core/cc/socket_connection.h"
 #include "core/cc/supported_abis.h"
 #include "core/cc/target.h"
+#include "core/cc/timer.h"
 
 #include <signal.h>
 #include <stdio.h>
@@ -50,19 +52,26 @@ using namespace gapir;
 
 namespace {
 
-std::vector<uint32_t> memorySizes {
+std::vector<uint64_t> memorySizes {
 // If we are on desktop, we can try more memory
 #if TARGET_OS != GAPID_OS_ANDROID
-  3 * 1024 * 1024 * 1024U,  // 3GB
+  3 * 1024 * 1024 * 1024ULL,  // 3GB
 #endif
-      2 * 1024 * 1024 * 1024U,  // 2GB
-      1 * 1024 * 1024 * 1024U,  // 1GB
-      512 * 1024 * 1024U,       // 512MB
-      256 * 1024 * 1024U,       // 256MB
-      128 * 1024 * 1024U,       // 128MB
+      2 * 1024 * 1024 * 1024ULL,  // 2GB
+      1 * 1024 * 1024 * 1024ULL,  // 1GB
+      512 * 1024 * 1024ULL,       // 512MB
+      256 * 1024 * 1024ULL,       // 256MB
+      128 * 1024 * 1024ULL,       // 128MB
 };
 
-// createResourceProvider constructs and returns a ResourceInMemoryCache.
+// The address space reserved for the memory to grow into, for replays that
+// need more memory than the initial size. Only 64-bit processes have the
+// address space to spare.
+const uint64_t maxMemorySize =
+    sizeof(void*) == 8 ? 64 * 1024 * 1024 * 1024ULL : 0;  // 64GB
+
+// createResourceProvider constructs and returns a ResourceInMemoryCache, which
+// evicts the resources loaded furthest in the future first.
 // If cachePath is non-null then the ResourceInMemoryCache will be backed by a
 // disk-cache.
 std::unique_ptr<ResourceInMemoryCache> createResourceProvider(
@@ -71,10 +80,12 @@ std::unique_ptr<ResourceInMemoryCache> createResourceProvider(
     GAPID_FATAL("Disk cache is currently out of service. Got %s", cachePath);
     return std::unique_ptr<ResourceInMemoryCache>(ResourceInMemoryCache::create(
         ResourceDiskCache::create(ResourceRequester::create(), cachePath),
-        memoryManager->getBaseAddress()));
+        memoryManager->getBaseAddress(),
+        ResourceInMemoryCache::EvictionPolicy::BELADY));
   } else {
     return std::unique_ptr<ResourceInMemoryCache>(ResourceInMemoryCache::create(
-        ResourceRequester::create(), memoryManager->getBaseAddress()));
+        ResourceRequester::create(), memoryManager->getBaseAddress(),
+        ResourceInMemoryCache::EvictionPolicy::BELADY));
   }
 }
 
@@ -84,16 +95,19 @@ std::unique_ptr<ResourceInMemoryCache> createResourceProvider(
 // multiple connections, so a mutex lock is passed in to make the accesses to
 // to them exclusive to one connected client. All other replay requests from
 // other clients will be blocked, until the current replay finishes.
+// The checkpoint store is shared the same way, and may be nullptr to disable
+// the checkpoints.
 std::unique_ptr<Server> Setup(const char* uri, const char* authToken,
                               const char* cachePath, int idleTimeoutSec,
                               core::CrashHandler* crashHandler,
-                              MemoryManager* memMgr, std::mutex* lock) {
+                              MemoryManager* memMgr,
+                              CheckpointStore* checkpoints, std::mutex* lock) {
   // Return a replay server with the following replay ID handler. The first
   // package for a replay must be the ID of the replay.
   return Server::createAndStart(
       uri, authToken, idleTimeoutSec,
-      [cachePath, memMgr, crashHandler, lock](ReplayConnection* replayConn,
-                                              const std::string& replayId) {
+      [cachePath, memMgr, crashHandler, checkpoints, lock](
+          ReplayConnection* replayConn, const std::string& replayId) {
         std::lock_guard<std::mutex> mem_mgr_crash_hdl_lock_guard(*lock);
         std::unique_ptr<ResourceInMemoryCache> resourceProvider(
             createResourceProvider(cachePath, memMgr));
@@ -102,18 +116,34 @@ std::unique_ptr<Server> Setup(const char* uri, const char* authToken,
             std::unique_ptr<CrashUploader>(
                 new CrashUploader(*crashHandler, replayConn));
 
-        std::unique_ptr<Context> context = Context::create(
-            replayConn, *crashHandler, resourceProvider.get(), memMgr);
+        auto& stats = replayConn->stats();
+        core::Timer timer;
+        timer.Start();
+        std::unique_ptr<Context> context =
+            Context::create(replayConn, *crashHandler, resourceProvider.get(),
+                            memMgr, checkpoints);
+        stats.contextNs = timer.Stop();
 
         if (context == nullptr) {
           GAPID_WARNING("Loading Context failed!");
           return;
         }
+        timer.Start();
         context->prefetch(resourceProvider.get());
+        stats.prefetchNs = timer.Stop();
 
         GAPID_INFO("Replay started");
+        timer.Start();
         bool ok = context->interpret();
+        stats.interpretNs = timer.Stop();
         GAPID_INFO("Replay %s", ok ? "finished successfully" : "failed");
+        GAPID_INFO(
+            "Replay took %.3fms: payload %.3fms, context %.3fms, prefetch "
+            "%.3fms, interpret %.3fms, resource fetch %.3fms",
+            (stats.contextNs + stats.prefetchNs + stats.interpretNs) / 1e6,
+            stats.payloadNs / 1e6, stats.contextNs / 1e6,
+            stats.prefetchNs / 1e6, stats.interpretNs / 1e6,
+            stats.resourceFetchNs / 1e6);
       });
 }
 
@@ -148,7 +178,7 @@ void android_process(struct android_app* app, int32_t cmd) {
 
 // Main function for android
 void android_main(struct android_app* app) {
-  MemoryManager memoryManager(memorySizes);
+  MemoryManager memoryManager(memorySizes, maxMemorySize);
   CrashHandler crashHandler;
 
   // Get the path of the file system socket.
@@ -167,7 +197,7 @@ void android_main(struct android_app* app) {
   std::mutex lock;
   std::unique_ptr<Server> server =
       Setup(uri.c_str(), nullptr, nullptr, idleTimeoutSec, &crashHandler,
-            &memoryManager, &lock);
+            &memoryManager, nullptr, &lock);
   std::thread waiting_thread([&]() { server.get()->wait(); });
   if (chmod(socket_file_path.c_str(), S_IRUSR | S_IWUSR | S_IROTH | S_IWOTH)) {
     GAPID_ERROR("Chmod failed!");
@@ -210,6 +240,7 @@ int main(int argc, const char* argv[]) {
   const char* portArgStr = "0";
   const char* authTokenFile = nullptr;
   int idleTimeoutSec = 0;
+  uint64_t checkpointMemory = 0;
 
   for (int i = 1; i < argc; i++) {
     if (strcmp(argv[i], "--auth-token-file") == 0) {
@@ -263,6 +294,11 @@ int main(int argc, const char* argv[]) {
         GAPID_FATAL("Usage: --idle-timeout-sec <timeout in seconds>");
       }
       idleTimeoutSec = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--checkpoint-memory") == 0) {
+      if (i + 1 >= argc) {
+        GAPID_FATAL("Usage: --checkpoint-memory <size in MiB>");
+      }
+      checkpointMemory = strtoull(argv[++i], nullptr, 10) * 1024 * 1024;
     } else if (strcmp(argv[i], "--wait-for-debugger") == 0) {
       wait_for_debugger = true;
     } else if (strcmp(argv[i], "--version") == 0) {
@@ -308,7 +344,7 @@ int main(int argc, const char* argv[]) {
     fclose(file);
   }
 
-  MemoryManager memoryManager(memorySizes);
+  MemoryManager memoryManager(memorySizes, maxMemorySize);
 
   // If the user does not assign a port to use, get a free TCP port from OS.
   const char local_host_name[] = "127.0.0.1";
@@ -324,10 +360,18 @@ int main(int argc, const char* argv[]) {
   std::string uri =
       std::string(local_host_name) + std::string(":") + std::string(portStr);
 
+  // Replays resume from the checkpoint of the previous replay if they are
+  // given the memory to keep a copy of its volatile memory.
+  std::unique_ptr<CheckpointStore> checkpoints;
+  if (checkpointMemory > 0) {
+    checkpoints.reset(new CheckpointStore(checkpointMemory));
+  }
+
   std::mutex lock;
   std::unique_ptr<Server> server =
       Setup(uri.c_str(), (authToken.size() > 0) ? authToken.data() : nullptr,
-            cachePath, idleTimeoutSec, &crashHandler, &memoryManager, &lock);
+            cachePath, idleTimeoutSec, &crashHandler, &memoryManager,
+            checkpoints.get(), &lock);
   // The following message is parsed by launchers to detect the selected port.
   // DO NOT CHANGE!
   printf("Bound on port '%s'\n", portStr.c_str());
@@ -42,6 +42,7 @@ import (
 	"github.com/google/gapid/gapis/server"
 	"github.com/google/gapid/gapis/service"
 	"github.com/google/gapid/gapis/service/path"
+	"github.com/google/gapid/gapis/shadertools"
 	"github.com/google/gapid/gapis/stringtable"
 	"github.com/google/gapid/gapis/trace"
 
@@ -62,6 +63,7 @@ var (
 	adbPath          = flag.String("adb", "", "Path to the adb executable; leave empty to search the environment")
 	enableLocalFiles = flag.Bool("enable-local-files", false, "Allow clients to access local .gfxtrace files by path")
 	remoteSSHConfig  = flag.String("ssh-config", "", "_Path to an ssh config file for remote devices")
+	shaderCache      = flag.String("shader-cache", "", "Directory in which converted and compiled shaders are cached between runs")
 )
 
 func main() {
@@ -103,6 +105,13 @@ func run(ctx context.Context) error {
 
 	grpclog.SetLogger(log.From(ctx))
 
+	if *shaderCache != "" {
+		if err := shadertools.SetCacheDir(*shaderCache); err != nil {
+			log.W(ctx, "Could not use the shader cache directory. Error: %v", err)
+		}
+	}
+	defer func() { log.I(ctx, "Shader cache %v", shadertools.GetCacheStats()) }()
+
 	var hostDevice *path.Device
 
 	if *addLocalDevice {
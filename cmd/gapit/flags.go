@@ -187,6 +187,7 @@ type (
 		Observe        struct {
 			Frames uint `help:"capture the framebuffer every n frames (0 to disable)"`
 			Draws  uint `help:"capture the framebuffer every n draws (0 to disable)"`
+			Async  bool `help:"downsample the framebuffer observations on a background thread in the application"`
 		}
 		Disable struct {
 			PCS     bool `help:"disable pre-compiled shaders"`
@@ -212,6 +213,25 @@ type (
 		No struct {
 			Buffer bool `help:"Do not buffer the output, this helps if the application crashes"`
 		}
+		Compress struct {
+			Stream bool `help:"compress the capture stream on a background thread in the application"`
+		}
+		Per struct {
+			Thread struct {
+				Capture bool `help:"capture vkCmd* commands on different threads concurrently. Only valid for Vulkan."`
+			}
+		}
+		Shared struct {
+			Memory struct {
+				Stream bool `help:"stream the capture through shared memory instead of a socket. Only valid for applications on the Linux host."`
+			}
+		}
+		Flight struct {
+			Recorder struct {
+				Frames int `help:"only keep the given number of most recent frames until <enter> is pressed. 0 to disable"`
+				Size   int `help:"_the maximum number of megabytes kept by the flight recorder. 0 for the default"`
+			}
+		}
 		API   string `help:"only capture the given API valid options are gles and vulkan"`
 		Local struct {
 			Port int `help:"connect to an application already running on the server using this port"`
@@ -156,8 +156,16 @@ func (verb *traceVerb) Run(ctx context.Context, flags flag.FlagSet) error {
 		DeferStart:            verb.Start.Defer,
 		NoBuffer:              verb.No.Buffer,
 		HideUnknownExtensions: verb.Disable.Unknown.Extensions,
+		CompressStream:        verb.Compress.Stream,
+		PerThreadCapture:      verb.Per.Thread.Capture,
+		SharedMemoryStream:    verb.Shared.Memory.Stream,
 		ClearCache:            verb.Clear.Cache,
 		ServerLocalSavePath:   out,
+
+		FlightRecorderFrames:     uint32(verb.Flight.Recorder.Frames),
+		FlightRecorderBufferSize: uint64(verb.Flight.Recorder.Size) * 1024 * 1024,
+
+		AsyncFramebufferObservations: verb.Observe.Async,
 	}
 
 	if uri != "" {
@@ -213,6 +221,16 @@ func (verb *traceVerb) Run(ctx context.Context, flags flag.FlagSet) error {
 			return true, nil
 		}
 
+		if options.FlightRecorderFrames != 0 && !handlerInstalled {
+			// The flight recorder sends nothing until it is flushed.
+			crash.Go(func() {
+				reader := bufio.NewReader(os.Stdin)
+				println("Press enter to save the most recent frames...")
+				_, _ = reader.ReadString('\n')
+				handler.Event(service.TraceEvent_Flush)
+			})
+			handlerInstalled = true
+		}
 		if status.BytesCaptured > 0 {
 			if !handlerInstalled {
 				crash.Go(func() {
@@ -60,7 +60,11 @@ bool EnsureInitialized() {
 
 }  // namespace
 
-TraceScope::TraceScope(const char* name) {
+TraceScope::TraceScope(const char* name) { TraceBegin(name); }
+
+TraceScope::~TraceScope() { TraceEnd(); }
+
+void TraceBegin(const char* name) {
   if (EnsureInitialized()) {
     char buffer[kBufferSize];
     size_t length = snprintf(buffer, kBufferSize, "B|%d|%s", getpid(), name);
@@ -68,7 +72,7 @@ TraceScope::TraceScope(const char* name) {
   }
 }
 
-TraceScope::~TraceScope() {
+void TraceEnd() {
   if (EnsureInitialized()) {
     char value = 'E';
     write(sTraceFD, &value, sizeof(value));
@@ -28,6 +28,10 @@ class TraceScope {
   ~TraceScope();
 };
 
+void TraceBegin(const char* name);
+
+void TraceEnd();
+
 void TraceInt(const char* name, std::int32_t value);
 
 }  // namespace core
@@ -36,6 +40,12 @@ void TraceInt(const char* name, std::int32_t value);
 
 #define GAPID_TRACE_NAME(name) core::TraceScope __gapidtrace(name)
 
+#define GAPID_TRACE_BEGIN(name) core::TraceBegin(name)
+
+#define GAPID_TRACE_END() core::TraceEnd()
+
 #define GAPID_TRACE_INT(name, value) core::TraceInt(name, value)
 
+#define GAPID_TRACE_ENABLED() true
+
 #endif  // CORE_ANDROID_TRACE_H
@@ -59,10 +59,20 @@ Archive::Archive(const std::string& archiveName) {
     uint32_t idSize;
     if (!fread(&idSize, sizeof(idSize), 1, mIndexFile)) break;
 
-    std::string id(idSize, 0);
+    // Records written with ids of another size (such as the hex string ids of
+    // older versions) can never be looked up, so skip over them.
+    if (idSize != sizeof(Id::data)) {
+      if (fseek(mIndexFile, idSize + sizeof(uint64_t) + sizeof(uint32_t),
+                SEEK_CUR)) {
+        break;
+      }
+      continue;
+    }
+
+    Id id;
     uint64_t offset;
     uint32_t size;
-    if (!fread(&id.front(), idSize, 1, mIndexFile) ||
+    if (!fread(id.data, idSize, 1, mIndexFile) ||
         !fread(&offset, sizeof(offset), 1, mIndexFile) ||
         !fread(&size, sizeof(size), 1, mIndexFile)) {
       break;
@@ -80,11 +90,11 @@ Archive::~Archive() {
   if (mIndexFile) fclose(mIndexFile);
 }
 
-bool Archive::contains(const std::string& id) const {
+bool Archive::contains(const Id& id) const {
   return mRecords.find(id) != mRecords.end();
 }
 
-bool Archive::read(const std::string& id, void* buffer, uint32_t size) {
+bool Archive::read(const Id& id, void* buffer, uint32_t size) {
   const auto r = mRecords.find(id);
   if (r == mRecords.end() || r->second.size != size) return false;
 
@@ -92,7 +102,7 @@ bool Archive::read(const std::string& id, void* buffer, uint32_t size) {
   return fread(buffer, size, 1, mDataFile) == 1;
 }
 
-bool Archive::write(const std::string& id, const void* buffer, uint32_t size) {
+bool Archive::write(const Id& id, const void* buffer, uint32_t size) {
   // Skip if we already have a record by this id.
   if (mRecords.find(id) != mRecords.end()) {
     return true;
@@ -103,20 +113,20 @@ bool Archive::write(const std::string& id, const void* buffer, uint32_t size) {
   const uint64_t dataOffset = ftell(mDataFile);
   if (!fwrite(buffer, size, 1, mDataFile)) {
     GAPID_WARNING("Couldn't write '%s' to the archive data file, dropping it.",
-                  id.c_str());
+                  id.string().c_str());
     must_truncate(fileno(mDataFile), dataOffset);
     return false;
   }
 
   // Update the archive index file.
-  const uint32_t idSize = id.size();
+  const uint32_t idSize = sizeof(id.data);
   const uint64_t indexOffset = ftell(mIndexFile);
   if (!fwrite(&idSize, sizeof(idSize), 1, mIndexFile) ||
-      !fwrite(&id.front(), id.size(), 1, mIndexFile) ||
+      !fwrite(id.data, idSize, 1, mIndexFile) ||
       !fwrite(&dataOffset, sizeof(dataOffset), 1, mIndexFile) ||
       !fwrite(&size, sizeof(size), 1, mIndexFile)) {
     GAPID_WARNING("Couldn't write '%s' to the archive index file, dropping it.",
-                  id.c_str());
+                  id.string().c_str());
     must_truncate(fileno(mDataFile), dataOffset);
     must_truncate(fileno(mIndexFile), indexOffset);
     fseek(mIndexFile, 0, SEEK_END);
@@ -35,14 +35,14 @@ class Archive {
   ~Archive();
 
   // Checks if the archive contains a record for the given id.
-  bool contains(const std::string& id) const;
+  bool contains(const Id& id) const;
 
   // Reads the resource keyed by id into buffer if it exists and if its size
   // matches.
-  bool read(const std::string& id, void* buffer, uint32_t size);
+  bool read(const Id& id, void* buffer, uint32_t size);
 
   // Write a resource of size size keyed by id from buffer into the archive.
-  bool write(const std::string& id, const void* buffer, uint32_t size);
+  bool write(const Id& id, const void* buffer, uint32_t size);
 
  protected:
   struct ArchiveRecord {
@@ -52,7 +52,7 @@ class Archive {
 
   FILE* mDataFile;
   FILE* mIndexFile;
-  std::unordered_map<std::string, ArchiveRecord> mRecords;
+  std::unordered_map<Id, ArchiveRecord> mRecords;
 };
 
 }  // namespace core
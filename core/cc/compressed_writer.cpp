@@ -0,0 +1,176 @@
+/*
+ * Copyright (C) 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "compressed_writer.h"
+
+#include "core/cc/log.h"
+
+#include <string.h>
+#include <zlib.h>
+
+#include <algorithm>
+
+namespace {
+
+const size_t kFrameHeaderSize = 8;
+
+inline void putUint32(char* out, uint32_t v) {
+  out[0] = static_cast<char>(v);
+  out[1] = static_cast<char>(v >> 8);
+  out[2] = static_cast<char>(v >> 16);
+  out[3] = static_cast<char>(v >> 24);
+}
+
+}  // anonymous namespace
+
+namespace core {
+
+CompressedWriter::CompressedWriter(const std::shared_ptr<StreamWriter>& out,
+                                   bool async, uint32_t blockSize, int level)
+    : mOut(out),
+      mBlockSize(blockSize),
+      mStream(new z_stream()),
+      mGood(true),
+      mBusy(false),
+      mStop(false) {
+  if (deflateInit(mStream.get(), level) != Z_OK) {
+    GAPID_ERROR("Failed to initialize stream compression");
+  }
+  mFrame.resize(kFrameHeaderSize + deflateBound(mStream.get(), mBlockSize));
+  mBlock.reserve(mBlockSize);
+  if (async) {
+    mThread.reset(new std::thread(&CompressedWriter::worker, this));
+  }
+}
+
+CompressedWriter::~CompressedWriter() {
+  flush();
+  if (mThread) {
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mStop = true;
+    }
+    mSignal.notify_one();
+    mThread->join();
+  }
+  deflateEnd(mStream.get());
+}
+
+uint64_t CompressedWriter::write(const void* data, uint64_t size) {
+  auto bytes = static_cast<const char*>(data);
+  for (uint64_t remaining = size; remaining > 0 && mGood;) {
+    size_t n = static_cast<size_t>(
+        std::min<uint64_t>(remaining, mBlockSize - mBlock.size()));
+    mBlock.append(bytes, n);
+    bytes += n;
+    remaining -= n;
+    if (mBlock.size() == mBlockSize) {
+      submit();
+    }
+  }
+  return mGood ? size : 0;
+}
+
+bool CompressedWriter::flush() {
+  if (!mBlock.empty()) {
+    submit();
+  }
+  if (mThread) {
+    std::unique_lock<std::mutex> lock(mMutex);
+    mDone.wait(lock, [this] { return mQueue.empty() && !mBusy; });
+  }
+  return mGood;
+}
+
+void CompressedWriter::submit() {
+  if (!mThread) {
+    compress(mBlock);
+    mBlock.clear();
+    return;
+  }
+
+  {
+    std::unique_lock<std::mutex> lock(mMutex);
+    mDone.wait(lock, [this] { return mQueue.size() < kMaxPendingBlocks; });
+    mQueue.push_back(std::move(mBlock));
+    if (!mFree.empty()) {
+      mBlock = std::move(mFree.front());
+      mFree.pop_front();
+    } else {
+      mBlock = std::string();
+    }
+  }
+  mSignal.notify_one();
+  mBlock.clear();
+  mBlock.reserve(mBlockSize);
+}
+
+void CompressedWriter::compress(const std::string& block) {
+  if (!mGood) {
+    return;
+  }
+
+  auto size = static_cast<uint32_t>(block.size());
+  char* frame = &mFrame[0];
+  z_stream* stream = mStream.get();
+  deflateReset(stream);
+  stream->next_in =
+      reinterpret_cast<Bytef*>(const_cast<char*>(block.data()));
+  stream->avail_in = size;
+  stream->next_out = reinterpret_cast<Bytef*>(frame + kFrameHeaderSize);
+  stream->avail_out = static_cast<uInt>(mFrame.size() - kFrameHeaderSize);
+  int err = deflate(stream, Z_FINISH);
+
+  uint32_t compressedSize = static_cast<uint32_t>(stream->total_out);
+  if (err != Z_STREAM_END || compressedSize >= size) {
+    // Store incompressible blocks as they are.
+    memcpy(frame + kFrameHeaderSize, block.data(), size);
+    compressedSize = size;
+  }
+  putUint32(frame, compressedSize);
+  putUint32(frame + 4, size);
+
+  uint64_t frameSize = kFrameHeaderSize + compressedSize;
+  if (mOut->write(frame, frameSize) != frameSize) {
+    mGood = false;
+  }
+}
+
+void CompressedWriter::worker(CompressedWriter* writer) {
+  while (true) {
+    std::unique_lock<std::mutex> lock(writer->mMutex);
+    writer->mSignal.wait(lock, [writer] {
+      return writer->mStop || !writer->mQueue.empty();
+    });
+    if (writer->mQueue.empty()) {
+      return;  // Stop signalled with no work left.
+    }
+    auto block = std::move(writer->mQueue.front());
+    writer->mQueue.pop_front();
+    writer->mBusy = true;
+    lock.unlock();
+
+    writer->compress(block);
+
+    lock.lock();
+    writer->mFree.push_back(std::move(block));
+    writer->mBusy = false;
+    lock.unlock();
+    writer->mDone.notify_one();
+  }
+}
+
+}  // namespace core
@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CORE_COMPRESSED_WRITER_H
+#define CORE_COMPRESSED_WRITER_H
+
+#include "core/cc/stream_writer.h"
+
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+typedef struct z_stream_s z_stream;
+
+namespace core {
+
+// CompressedWriter is a StreamWriter that splits the data written to it into
+// blocks, compresses each block independently with zlib and writes the
+// framed blocks to another StreamWriter. Each block is framed as:
+//
+//   uint32_t compressedSize;      // little-endian.
+//   uint32_t size;                // little-endian, uncompressed size.
+//   uint8_t  data[compressedSize];
+//
+// If compressedSize is equal to size then the block data is stored
+// uncompressed.
+//
+// Data is held back until a whole block has been written or flush() is
+// called. The compression and the writes to the output stream are either done
+// on the calling thread or on a dedicated background thread.
+// A CompressedWriter must only be written to by one thread at a time.
+class CompressedWriter : public StreamWriter {
+ public:
+  static const uint32_t kDefaultBlockSize = 64 * 1024;
+  static const int kDefaultLevel = 1;  // Z_BEST_SPEED
+
+  // The maximum number of full blocks waiting for the background thread
+  // before write() blocks.
+  static const size_t kMaxPendingBlocks = 4;
+
+  // If async is true then blocks are compressed and written on a background
+  // thread. level is the zlib compression level.
+  CompressedWriter(const std::shared_ptr<StreamWriter>& out, bool async,
+                   uint32_t blockSize = kDefaultBlockSize,
+                   int level = kDefaultLevel);
+
+  // Destructor. Flushes all the written data before returning.
+  ~CompressedWriter();
+
+  // core::StreamWriter compliance
+  virtual uint64_t write(const void* data, uint64_t size) override;
+
+  // flush compresses and writes any partially filled block, and waits for
+  // all pending blocks to be written to the output stream. Returns false if
+  // the output stream has failed.
+  bool flush();
+
+  inline bool is_async() const { return mThread != nullptr; }
+
+ private:
+  CompressedWriter(const CompressedWriter&) = delete;
+  CompressedWriter& operator=(const CompressedWriter&) = delete;
+
+  // submit hands the current block over for compression and starts a new
+  // one.
+  void submit();
+
+  // compress compresses and frames the block, and writes it to the output.
+  void compress(const std::string& block);
+
+  static void worker(CompressedWriter*);
+
+  std::shared_ptr<StreamWriter> mOut;
+  const uint32_t mBlockSize;
+
+  // The block currently being filled by write().
+  std::string mBlock;
+
+  // The zlib state and output buffer. Only used by the worker thread when
+  // asynchronous, otherwise by the writing thread.
+  std::unique_ptr<z_stream> mStream;
+  std::string mFrame;
+
+  // False once a write to the output stream has failed.
+  std::atomic<bool> mGood;
+
+  std::mutex mMutex;  // Guards the fields below.
+  std::condition_variable mSignal;  // Signals the worker.
+  std::condition_variable mDone;    // Signals the writing thread.
+  std::deque<std::string> mQueue;   // Full blocks waiting for the worker.
+  std::deque<std::string> mFree;    // Written blocks, for reuse.
+  bool mBusy;  // True while the worker is compressing a block.
+  bool mStop;
+  std::unique_ptr<std::thread> mThread;
+};
+
+}  // namespace core
+
+#endif  // CORE_COMPRESSED_WRITER_H
@@ -0,0 +1,228 @@
+/*
+ * Copyright (C) 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "compressed_writer.h"
+
+#include <gtest/gtest.h>
+#include <string.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+
+namespace core {
+namespace test {
+namespace {
+
+// BufferWriter is a StreamWriter that appends everything written to a string,
+// failing all writes once limit bytes have been written.
+class BufferWriter : public StreamWriter {
+ public:
+  BufferWriter(size_t limit = ~size_t(0)) : mLimit(limit) {}
+
+  virtual uint64_t write(const void* data, uint64_t size) override {
+    if (mData.size() + size > mLimit) {
+      return 0;
+    }
+    mData.append(static_cast<const char*>(data), size);
+    return size;
+  }
+
+  std::string mData;
+  size_t mLimit;
+};
+
+uint32_t getUint32(const std::string& s, size_t offset) {
+  auto p = reinterpret_cast<const uint8_t*>(s.data() + offset);
+  return p[0] | (p[1] << 8) | (p[2] << 16) | (uint32_t(p[3]) << 24);
+}
+
+// decode decodes the framed blocks in data, returning false on error.
+bool decode(const std::string& data, std::string* out, size_t* blocks) {
+  out->clear();
+  *blocks = 0;
+  for (size_t offset = 0; offset < data.size(); (*blocks)++) {
+    if (data.size() - offset < 8) {
+      return false;
+    }
+    uint32_t compressedSize = getUint32(data, offset);
+    uint32_t size = getUint32(data, offset + 4);
+    offset += 8;
+    if (data.size() - offset < compressedSize) {
+      return false;
+    }
+    if (compressedSize == size) {
+      out->append(data, offset, size);
+    } else {
+      size_t start = out->size();
+      out->resize(start + size);
+      uLongf got = size;
+      if (uncompress(reinterpret_cast<Bytef*>(&(*out)[start]), &got,
+                     reinterpret_cast<const Bytef*>(data.data() + offset),
+                     compressedSize) != Z_OK ||
+          got != size) {
+        return false;
+      }
+    }
+    offset += compressedSize;
+  }
+  return true;
+}
+
+// packStream returns size bytes that resemble a ProtoPack capture stream:
+// length-prefixed command messages of varint fields, pointers and repeated
+// names, interleaved with the occasional observation of vertex data.
+std::string packStream(size_t size) {
+  static const char* kNames[] = {
+      "glDrawElements", "glBindBuffer",          "glUniform4fv",
+      "glBindTexture",  "vkCmdDrawIndexed",      "vkQueueSubmit",
+      "glUseProgram",   "vkCmdBindDescriptorSets",
+  };
+  std::string out;
+  out.reserve(size + 1024);
+  uint32_t seed = 12345;
+  auto next = [&seed] {
+    seed = seed * 1103515245 + 12345;
+    return seed >> 8;
+  };
+  auto varint = [&out](uint64_t v) {
+    for (; v >= 0x80; v >>= 7) {
+      out.push_back(static_cast<char>(v | 0x80));
+    }
+    out.push_back(static_cast<char>(v));
+  };
+  uint64_t pointer = 0x7f0000100000ull;
+  while (out.size() < size) {
+    if (next() % 64 == 0) {
+      // Observed vertex data: a grid of float positions and UVs.
+      uint32_t n = 64 + next() % 512;
+      out.push_back(0x12);
+      varint(n * 5 * sizeof(float));
+      for (uint32_t i = 0; i < n; i++) {
+        float vertex[5] = {float(i % 16), float(i / 16), 0.0f, i % 16 / 15.0f,
+                           i / 16 / 31.0f};
+        out.append(reinterpret_cast<const char*>(vertex), sizeof(vertex));
+      }
+      continue;
+    }
+    const char* name = kNames[next() % 8];
+    out.push_back(0x0a);
+    varint(strlen(name));
+    out.append(name);
+    for (uint32_t i = 0, n = 1 + next() % 6; i < n; i++) {
+      out.push_back(static_cast<char>((i + 1) << 3));
+      varint(next() % 3 == 0 ? pointer + (next() % 256) * 16 : next() % 300);
+    }
+    pointer += 64;
+  }
+  out.resize(size);
+  return out;
+}
+
+}  // anonymous namespace
+
+TEST(CompressedWriterTest, RoundTrip) {
+  auto data = packStream(1000000);
+  for (bool async : {false, true}) {
+    auto out = std::make_shared<BufferWriter>();
+    {
+      CompressedWriter writer(out, async);
+      EXPECT_EQ(async, writer.is_async());
+      // Write in uneven pieces that straddle the block boundaries.
+      for (size_t i = 0, n = 1; i < data.size(); i += n, n = n * 3 % 70001) {
+        n = std::min(n, data.size() - i);
+        EXPECT_EQ(n, writer.write(data.data() + i, n));
+      }
+    }
+    std::string got;
+    size_t blocks;
+    ASSERT_TRUE(decode(out->mData, &got, &blocks));
+    EXPECT_EQ(data, got);
+    EXPECT_EQ((data.size() + CompressedWriter::kDefaultBlockSize - 1) /
+                  CompressedWriter::kDefaultBlockSize,
+              blocks);
+    EXPECT_LT(out->mData.size(), data.size());
+  }
+}
+
+TEST(CompressedWriterTest, FlushWritesPartialBlock) {
+  auto out = std::make_shared<BufferWriter>();
+  CompressedWriter writer(out, true);
+  std::string data(100, 'x');
+  EXPECT_EQ(100, writer.write(data.data(), data.size()));
+  EXPECT_TRUE(out->mData.empty());
+  EXPECT_TRUE(writer.flush());
+  std::string got;
+  size_t blocks;
+  ASSERT_TRUE(decode(out->mData, &got, &blocks));
+  EXPECT_EQ(data, got);
+  EXPECT_EQ(1, blocks);
+
+  EXPECT_TRUE(writer.flush());  // Nothing more to write.
+  EXPECT_EQ(1, (decode(out->mData, &got, &blocks), blocks));
+}
+
+TEST(CompressedWriterTest, IncompressibleBlocksAreStored) {
+  std::string data(3000, 0);
+  uint32_t seed = 1;
+  for (auto& c : data) {
+    seed = seed * 1103515245 + 12345;
+    c = static_cast<char>(seed >> 16);
+  }
+  auto out = std::make_shared<BufferWriter>();
+  CompressedWriter writer(out, false, 1024);
+  writer.write(data.data(), data.size());
+  writer.flush();
+  ASSERT_EQ(data.size() + 3 * 8, out->mData.size());
+  EXPECT_EQ(1024, getUint32(out->mData, 0));
+  EXPECT_EQ(1024, getUint32(out->mData, 4));
+  std::string got;
+  size_t blocks;
+  ASSERT_TRUE(decode(out->mData, &got, &blocks));
+  EXPECT_EQ(data, got);
+  EXPECT_EQ(3, blocks);
+}
+
+TEST(CompressedWriterTest, OutputFailure) {
+  std::string data(64 * 1024, 'x');
+  for (bool async : {false, true}) {
+    auto out = std::make_shared<BufferWriter>(0);
+    CompressedWriter writer(out, async, 1024);
+    writer.write(data.data(), data.size());
+    EXPECT_FALSE(writer.flush());
+    EXPECT_EQ(0, writer.write(data.data(), data.size()));
+  }
+}
+
+TEST(CompressedWriterTest, CompressesCaptureStream) {
+  const size_t kSize = 4 * 1024 * 1024;
+  const size_t kChunkSize = 32 * 1024;  // As written by the ChunkWriter.
+  auto data = packStream(kSize);
+  for (bool async : {false, true}) {
+    auto out = std::make_shared<BufferWriter>();
+    {
+      CompressedWriter writer(out, async);
+      for (size_t i = 0; i < kSize; i += kChunkSize) {
+        writer.write(data.data() + i, kChunkSize);
+      }
+    }
+    EXPECT_LT(out->mData.size(), kSize / 2);
+  }
+}
+
+}  // namespace test
+}  // namespace core
@@ -0,0 +1,298 @@
+/*
+ * Copyright (C) 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "direct_file_writer.h"
+
+#include "core/cc/log.h"
+#include "core/cc/target.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if TARGET_OS == GAPID_OS_WINDOWS
+#include <io.h>
+#include <malloc.h>
+#include <sys/stat.h>
+#else  // TARGET_OS == GAPID_OS_WINDOWS
+#include <unistd.h>
+#endif  // TARGET_OS == GAPID_OS_WINDOWS
+
+#include <algorithm>
+
+namespace {
+
+const uint32_t kAlignment = core::DirectFileWriter::kAlignment;
+
+inline uint64_t alignUp(uint64_t value) {
+  return (value + kAlignment - 1) & ~uint64_t(kAlignment - 1);
+}
+
+inline uint32_t alignDown(uint32_t value) {
+  return value & ~(kAlignment - 1);
+}
+
+#if TARGET_OS == GAPID_OS_WINDOWS
+
+int openFile(const char* path, bool* direct) {
+  *direct = false;
+  return _open(path, _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY,
+               _S_IREAD | _S_IWRITE);
+}
+
+bool writeFile(int fd, const char* data, uint64_t size, uint64_t offset) {
+  if (_lseeki64(fd, offset, SEEK_SET) < 0) {
+    return false;
+  }
+  while (size > 0) {
+    int n = _write(fd, data, static_cast<unsigned int>(
+                                 std::min<uint64_t>(size, 1 << 30)));
+    if (n <= 0) {
+      return false;
+    }
+    data += n;
+    size -= n;
+  }
+  return true;
+}
+
+bool truncateFile(int fd, uint64_t size) { return _chsize_s(fd, size) == 0; }
+bool syncFile(int fd) { return _commit(fd) == 0; }
+void closeFile(int fd) { _close(fd); }
+
+char* allocBuffer(size_t size) {
+  return static_cast<char*>(_aligned_malloc(size, kAlignment));
+}
+void freeBuffer(char* buffer) { _aligned_free(buffer); }
+
+#else  // TARGET_OS == GAPID_OS_WINDOWS
+
+int openFile(const char* path, bool* direct) {
+  const int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+  int fd = -1;
+#ifdef O_DIRECT
+  // Not all file systems support O_DIRECT (for example tmpfs).
+  fd = open(path, flags | O_DIRECT, 0644);
+  *direct = fd >= 0;
+#endif  // O_DIRECT
+  if (fd < 0) {
+    fd = open(path, flags, 0644);
+    *direct = false;
+  }
+#if TARGET_OS == GAPID_OS_OSX
+  if (fd >= 0) {
+    *direct = fcntl(fd, F_NOCACHE, 1) == 0;
+  }
+#endif  // TARGET_OS == GAPID_OS_OSX
+  return fd;
+}
+
+bool writeFile(int fd, const char* data, uint64_t size, uint64_t offset) {
+  while (size > 0) {
+    ssize_t n = pwrite(fd, data, size, offset);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    data += n;
+    size -= n;
+    offset += n;
+  }
+  return true;
+}
+
+bool truncateFile(int fd, uint64_t size) { return ftruncate(fd, size) == 0; }
+bool syncFile(int fd) { return fsync(fd) == 0; }
+void closeFile(int fd) { close(fd); }
+
+char* allocBuffer(size_t size) {
+  void* buffer = nullptr;
+  if (posix_memalign(&buffer, kAlignment, size) != 0) {
+    return nullptr;
+  }
+  return static_cast<char*>(buffer);
+}
+void freeBuffer(char* buffer) { free(buffer); }
+
+#endif  // TARGET_OS == GAPID_OS_WINDOWS
+
+}  // anonymous namespace
+
+namespace core {
+
+std::shared_ptr<DirectFileWriter> DirectFileWriter::create(
+    const char* path, uint32_t bufferSize) {
+  bool direct = false;
+  int fd = openFile(path, &direct);
+  if (fd < 0) {
+    GAPID_WARNING("Failed to open '%s' for writing: %s", path,
+                  strerror(errno));
+    return nullptr;
+  }
+  bufferSize = static_cast<uint32_t>(alignUp(std::max(bufferSize, 1u)));
+  return std::shared_ptr<DirectFileWriter>(
+      new DirectFileWriter(fd, direct, bufferSize));
+}
+
+DirectFileWriter::DirectFileWriter(int fd, bool direct, uint32_t bufferSize)
+    : mFd(fd),
+      mDirect(direct),
+      mBufferSize(bufferSize),
+      mBuffers(kBufferCount),
+      mWritten(0),
+      mGood(true),
+      mBusy(false),
+      mStop(false),
+      mClosed(false) {
+  for (auto& buffer : mBuffers) {
+    buffer.data = allocBuffer(mBufferSize);
+    buffer.size = 0;
+    buffer.offset = 0;
+    if (buffer.data == nullptr) {
+      GAPID_FATAL("Failed to allocate %d byte file buffer", mBufferSize);
+    }
+  }
+  mBuffer = &mBuffers[0];
+  for (size_t i = 1; i < kBufferCount; i++) {
+    mFree.push_back(&mBuffers[i]);
+  }
+  mThread.reset(new std::thread(&DirectFileWriter::worker, this));
+}
+
+DirectFileWriter::~DirectFileWriter() {
+  close();
+  for (auto& buffer : mBuffers) {
+    freeBuffer(buffer.data);
+  }
+}
+
+bool DirectFileWriter::close() {
+  if (mClosed) {
+    return false;
+  }
+  bool good = flush();
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mStop = true;
+  }
+  mSignal.notify_one();
+  mThread->join();
+  closeFile(mFd);
+  mClosed = true;
+  mGood = false;  // Drop any later writes.
+  return good;
+}
+
+uint64_t DirectFileWriter::write(const void* data, uint64_t size) {
+  auto bytes = static_cast<const char*>(data);
+  for (uint64_t remaining = size; remaining > 0 && mGood;) {
+    uint32_t n = static_cast<uint32_t>(
+        std::min<uint64_t>(remaining, mBufferSize - mBuffer->size));
+    memcpy(mBuffer->data + mBuffer->size, bytes, n);
+    mBuffer->size += n;
+    bytes += n;
+    remaining -= n;
+    if (mBuffer->size == mBufferSize) {
+      submit();
+    }
+  }
+  return mGood ? size : 0;
+}
+
+bool DirectFileWriter::flush() {
+  if (mClosed) {
+    return false;
+  }
+  if (mBuffer->size > mWritten) {
+    submit();
+  }
+  std::unique_lock<std::mutex> lock(mMutex);
+  mDone.wait(lock, [this] { return mQueue.empty() && !mBusy; });
+  return mGood;
+}
+
+bool DirectFileWriter::sync() {
+  if (!flush()) {
+    return false;
+  }
+  if (!syncFile(mFd)) {
+    GAPID_WARNING("Failed to sync file: %s", strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+void DirectFileWriter::submit() {
+  Buffer* full = mBuffer;
+  {
+    std::unique_lock<std::mutex> lock(mMutex);
+    mDone.wait(lock, [this] { return !mFree.empty(); });
+    mBuffer = mFree.front();
+    mFree.pop_front();
+    mQueue.push_back(full);
+  }
+  mSignal.notify_one();
+
+  // The worker only reads the submitted buffer, and never past its size.
+  uint32_t aligned = alignDown(full->size);
+  mWritten = full->size - aligned;
+  memcpy(mBuffer->data, full->data + aligned, mWritten);
+  mBuffer->size = mWritten;
+  mBuffer->offset = full->offset + aligned;
+}
+
+void DirectFileWriter::writeBuffer(Buffer* buffer) {
+  if (!mGood) {
+    return;
+  }
+  uint64_t size = alignUp(buffer->size);
+  memset(buffer->data + buffer->size, 0, size - buffer->size);
+  if (!writeFile(mFd, buffer->data, size, buffer->offset) ||
+      (size != buffer->size &&
+       !truncateFile(mFd, buffer->offset + buffer->size))) {
+    GAPID_WARNING("Failed to write file: %s", strerror(errno));
+    mGood = false;
+  }
+}
+
+void DirectFileWriter::worker(DirectFileWriter* writer) {
+  while (true) {
+    std::unique_lock<std::mutex> lock(writer->mMutex);
+    writer->mSignal.wait(lock, [writer] {
+      return writer->mStop || !writer->mQueue.empty();
+    });
+    if (writer->mQueue.empty()) {
+      return;  // Stop signalled with no work left.
+    }
+    Buffer* buffer = writer->mQueue.front();
+    writer->mQueue.pop_front();
+    writer->mBusy = true;
+    lock.unlock();
+
+    writer->writeBuffer(buffer);
+
+    lock.lock();
+    writer->mFree.push_back(buffer);
+    writer->mBusy = false;
+    lock.unlock();
+    writer->mDone.notify_one();
+  }
+}
+
+}  // namespace core
@@ -0,0 +1,131 @@
+/*
+ * Copyright (C) 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CORE_DIRECT_FILE_WRITER_H
+#define CORE_DIRECT_FILE_WRITER_H
+
+#include "core/cc/stream_writer.h"
+
+#include <stdint.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace core {
+
+// DirectFileWriter is a StreamWriter that writes to a file through a set of
+// large, aligned write-behind buffers. Full buffers are written to the file
+// by a background thread, so write() only blocks when all the buffers are
+// waiting to be written.
+//
+// Where supported, the file is opened for direct I/O (O_DIRECT on Linux and
+// Android, F_NOCACHE on macOS), bypassing the page cache. Direct I/O requires
+// aligned file offsets and sizes, so partially filled buffers are written
+// padded to the alignment and the file is then truncated to the written size.
+// The unaligned tail of such a buffer is rewritten with the next buffer.
+//
+// A DirectFileWriter must only be written to by one thread at a time.
+class DirectFileWriter : public StreamWriter {
+ public:
+  // The alignment of the buffers, and of the file offsets and sizes written.
+  static const uint32_t kAlignment = 4096;
+  static const uint32_t kDefaultBufferSize = 2 * 1024 * 1024;
+  // The number of buffers. write() blocks if all of them are being written.
+  static const size_t kBufferCount = 4;
+
+  // create opens the file at path for writing, truncating any existing file.
+  // Returns nullptr if the file could not be opened.
+  static std::shared_ptr<DirectFileWriter> create(
+      const char* path, uint32_t bufferSize = kDefaultBufferSize);
+
+  // Destructor. Closes the file if it is still open.
+  ~DirectFileWriter();
+
+  // core::StreamWriter compliance
+  virtual uint64_t write(const void* data, uint64_t size) override;
+
+  // flush writes any partially filled buffer and waits for all pending
+  // buffers to be written to the file. Returns false if a write has failed.
+  bool flush();
+
+  // sync flushes the written data, and waits for the file to be committed to
+  // storage. Returns false on error.
+  bool sync();
+
+  // close writes all the data to the file and closes it. Writes after close
+  // are dropped. Returns false if a write has failed, or if the file was
+  // already closed.
+  bool close();
+
+  // is_direct returns true if the file bypasses the page cache.
+  inline bool is_direct() const { return mDirect; }
+
+ private:
+  struct Buffer {
+    char* data;
+    uint32_t size;    // Number of bytes filled.
+    uint64_t offset;  // File offset of data, a multiple of kAlignment.
+  };
+
+  DirectFileWriter(int fd, bool direct, uint32_t bufferSize);
+  DirectFileWriter(const DirectFileWriter&) = delete;
+  DirectFileWriter& operator=(const DirectFileWriter&) = delete;
+
+  // submit hands the current buffer over to the worker, and continues with
+  // a free buffer that starts with the current buffer's unaligned tail.
+  void submit();
+
+  // writeBuffer writes the buffer to the file.
+  void writeBuffer(Buffer* buffer);
+
+  static void worker(DirectFileWriter*);
+
+  const int mFd;
+  const bool mDirect;
+  const uint32_t mBufferSize;
+
+  std::vector<Buffer> mBuffers;
+
+  // The buffer currently being filled by write().
+  Buffer* mBuffer;
+  // The number of bytes at the start of mBuffer that have already been
+  // written as part of the previous buffer.
+  uint32_t mWritten;
+
+  // False once a write to the file has failed.
+  std::atomic<bool> mGood;
+
+  std::mutex mMutex;                // Guards the fields below.
+  std::condition_variable mSignal;  // Signals the worker.
+  std::condition_variable mDone;    // Signals the writing thread.
+  std::deque<Buffer*> mQueue;       // Buffers waiting to be written.
+  std::deque<Buffer*> mFree;        // Buffers that can be filled.
+  bool mBusy;  // True while the worker is writing a buffer.
+  bool mStop;
+  std::unique_ptr<std::thread> mThread;
+
+  // True once close() was called. Only accessed by the writing thread.
+  bool mClosed;
+};
+
+}  // namespace core
+
+#endif  // CORE_DIRECT_FILE_WRITER_H
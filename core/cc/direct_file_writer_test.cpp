@@ -0,0 +1,121 @@
+/*
+ * Copyright (C) 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "direct_file_writer.h"
+
+#include <gtest/gtest.h>
+#include <stdio.h>
+
+#include <algorithm>
+#include <string>
+
+namespace core {
+namespace test {
+namespace {
+
+std::string tempPath(const char* name) { return ::testing::TempDir() + name; }
+
+std::string readFile(const std::string& path) {
+  std::string data;
+  FILE* file = fopen(path.c_str(), "rb");
+  if (file == nullptr) {
+    return data;
+  }
+  char buffer[4096];
+  for (size_t n; (n = fread(buffer, 1, sizeof(buffer), file)) > 0;) {
+    data.append(buffer, n);
+  }
+  fclose(file);
+  return data;
+}
+
+std::string testData(size_t size) {
+  std::string data(size, 0);
+  uint32_t seed = 1;
+  for (auto& c : data) {
+    seed = seed * 1103515245 + 12345;
+    c = static_cast<char>(seed >> 16);
+  }
+  return data;
+}
+
+}  // anonymous namespace
+
+TEST(DirectFileWriterTest, RoundTrip) {
+  auto path = tempPath("direct_file_writer_round_trip");
+  auto data = testData(3 * 1000 * 1000 + 17);
+  {
+    auto writer = DirectFileWriter::create(path.c_str(), 64 * 1024);
+    ASSERT_NE(nullptr, writer);
+    // Write in uneven pieces that straddle the buffer boundaries.
+    for (size_t i = 0, n = 1; i < data.size(); i += n, n = n * 3 % 70001) {
+      n = std::min(n, data.size() - i);
+      EXPECT_EQ(n, writer->write(data.data() + i, n));
+    }
+  }
+  EXPECT_EQ(data, readFile(path));
+  remove(path.c_str());
+}
+
+TEST(DirectFileWriterTest, FlushWritesUnalignedData) {
+  auto path = tempPath("direct_file_writer_flush");
+  auto data = testData(100000);
+  auto writer = DirectFileWriter::create(path.c_str(), 64 * 1024);
+  ASSERT_NE(nullptr, writer);
+  size_t written = 0;
+  for (size_t n : {100, 5000, 1, 60000, 4096, 30803}) {
+    writer->write(data.data() + written, n);
+    written += n;
+    EXPECT_TRUE(writer->flush());
+    EXPECT_EQ(data.substr(0, written), readFile(path));
+  }
+  EXPECT_TRUE(writer->sync());
+  EXPECT_TRUE(writer->flush());  // Nothing more to write.
+  writer.reset();
+  EXPECT_EQ(data, readFile(path));
+  remove(path.c_str());
+}
+
+TEST(DirectFileWriterTest, OpenFailure) {
+  EXPECT_EQ(nullptr, DirectFileWriter::create(
+                         tempPath("missing_directory/file").c_str()));
+}
+
+TEST(DirectFileWriterTest, Close) {
+  auto path = tempPath("direct_file_writer_close");
+  const size_t kChunkSize = 32 * 1024;  // As written by the ChunkWriter.
+  // Several default sized buffers, and an unaligned tail.
+  auto data = testData(4 * DirectFileWriter::kDefaultBufferSize + 1234);
+  auto writer = DirectFileWriter::create(path.c_str());
+  ASSERT_NE(nullptr, writer);
+  for (size_t i = 0; i < data.size(); i += kChunkSize) {
+    size_t n = std::min(kChunkSize, data.size() - i);
+    EXPECT_EQ(n, writer->write(data.data() + i, n));
+  }
+  EXPECT_TRUE(writer->close());
+  EXPECT_EQ(data, readFile(path));
+
+  // Writes after close are dropped.
+  EXPECT_EQ(0, writer->write(data.data(), kChunkSize));
+  EXPECT_FALSE(writer->flush());
+  EXPECT_FALSE(writer->close());
+  writer.reset();
+  EXPECT_EQ(data, readFile(path));
+  remove(path.c_str());
+}
+
+}  // namespace test
+}  // namespace core
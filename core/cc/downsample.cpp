@@ -0,0 +1,220 @@
+/*
+ * Copyright (C) 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "downsample.h"
+
+#include <string.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define CORE_DOWNSAMPLE_NEON 1
+#endif
+
+namespace {
+
+// The column sums are accumulated as 16-bit values, which can hold the sum of
+// at most 257 rows of 8-bit values.
+const uint32_t kMaxBoxHeight = 0xffff / 0xff;
+
+// The fixed-point reciprocal division is exact for every sum of a box when
+// 255 * area * area < 2^32.
+const uint32_t kMaxBoxArea = 4103;
+
+// end returns the exclusive end of the source range covered by the destination
+// index i, when src source elements are mapped onto dst destination elements.
+inline uint32_t end(uint32_t i, uint32_t src, uint32_t dst) {
+  // Smallest e where e * dst >= (i + 1) * src.
+  return static_cast<uint32_t>(
+      (static_cast<uint64_t>(i + 1) * src + dst - 1) / dst);
+}
+
+// accumulateRow adds the count bytes at row to the count 16-bit sums.
+inline void accumulateRow(const uint8_t* row, uint16_t* sums, size_t count) {
+  size_t i = 0;
+#if defined(__AVX2__)
+  for (; i + 16 <= count; i += 16) {
+    __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+    __m256i* s = reinterpret_cast<__m256i*>(sums + i);
+    __m256i sum = _mm256_loadu_si256(s);
+    _mm256_storeu_si256(s, _mm256_add_epi16(sum, _mm256_cvtepu8_epi16(px)));
+  }
+#elif defined(__SSE2__)
+  const __m128i zero = _mm_setzero_si128();
+  for (; i + 16 <= count; i += 16) {
+    __m128i px = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + i));
+    __m128i* lo = reinterpret_cast<__m128i*>(sums + i);
+    __m128i* hi = reinterpret_cast<__m128i*>(sums + i + 8);
+    _mm_storeu_si128(
+        lo, _mm_add_epi16(_mm_loadu_si128(lo), _mm_unpacklo_epi8(px, zero)));
+    _mm_storeu_si128(
+        hi, _mm_add_epi16(_mm_loadu_si128(hi), _mm_unpackhi_epi8(px, zero)));
+  }
+#elif defined(CORE_DOWNSAMPLE_NEON)
+  for (; i + 16 <= count; i += 16) {
+    uint8x16_t px = vld1q_u8(row + i);
+    vst1q_u16(sums + i, vaddw_u8(vld1q_u16(sums + i), vget_low_u8(px)));
+    vst1q_u16(sums + i + 8,
+              vaddw_u8(vld1q_u16(sums + i + 8), vget_high_u8(px)));
+  }
+#endif
+  for (; i < count; i++) {
+    sums[i] += row[i];
+  }
+}
+
+// sumColumns returns the per-channel sums of the RGBA column sums in the
+// range [start, end).
+inline void sumColumns(const uint16_t* sums, uint32_t start, uint32_t end,
+                       uint32_t out[4]) {
+#if defined(__SSE2__)
+  const __m128i zero = _mm_setzero_si128();
+  __m128i acc = zero;
+  for (uint32_t x = start; x < end; x++) {
+    auto p = reinterpret_cast<const __m128i*>(sums + x * 4);
+    __m128i v = _mm_loadl_epi64(p);
+    acc = _mm_add_epi32(acc, _mm_unpacklo_epi16(v, zero));
+  }
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(out), acc);
+#elif defined(CORE_DOWNSAMPLE_NEON)
+  uint32x4_t acc = vdupq_n_u32(0);
+  for (uint32_t x = start; x < end; x++) {
+    acc = vaddw_u16(acc, vld1_u16(sums + x * 4));
+  }
+  vst1q_u32(out, acc);
+#else
+  out[0] = out[1] = out[2] = out[3] = 0;
+  for (uint32_t x = start; x < end; x++) {
+    out[0] += sums[x * 4 + 0];
+    out[1] += sums[x * 4 + 1];
+    out[2] += sums[x * 4 + 2];
+    out[3] += sums[x * 4 + 3];
+  }
+#endif
+}
+
+}  // anonymous namespace
+
+namespace core {
+
+void Downsampler::dimensions(uint32_t srcW, uint32_t srcH, uint32_t maxW,
+                             uint32_t maxH, uint32_t* dstW, uint32_t* dstH) {
+  // Calculate the minimal scaling factor as integer fraction.
+  uint32_t mul = 1;
+  uint32_t div = 1;
+  if (mul * srcW > maxW * div) {  // if mul/div > maxW/srcW
+    mul = maxW;
+    div = srcW;
+  }
+  if (mul * srcH > maxH * div) {  // if mul/div > maxH/srcH
+    mul = maxH;
+    div = srcH;
+  }
+
+  // Calculate the final dimensions (round up).
+  *dstW = (srcW * mul + div - 1) / div;
+  *dstH = (srcH * mul + div - 1) / div;
+}
+
+void Downsampler::downsample(const uint8_t* src, uint32_t srcW, uint32_t srcH,
+                             uint8_t* dst, uint32_t dstW, uint32_t dstH) {
+  if (dstW == 0 || dstH == 0) {
+    return;
+  }
+
+  uint32_t maxBoxW = 0;
+  mColumnEnds.resize(dstW);
+  for (uint32_t dstX = 0, srcX = 0; dstX < dstW; dstX++) {
+    uint32_t x = end(dstX, srcW, dstW);
+    maxBoxW = (x - srcX > maxBoxW) ? x - srcX : maxBoxW;
+    mColumnEnds[dstX] = srcX = x;
+  }
+  uint32_t maxBoxH = (srcH + dstH - 1) / dstH + 1;
+  uint32_t maxBoxArea = maxBoxW * maxBoxH;
+  if (maxBoxH > kMaxBoxHeight || maxBoxArea > kMaxBoxArea) {
+    downsampleReference(src, srcW, srcH, dst, dstW, dstH);
+    return;
+  }
+
+  for (uint32_t n = static_cast<uint32_t>(mReciprocals.size());
+       n <= maxBoxArea; n++) {
+    mReciprocals.push_back(n == 0 ? 0 : (uint64_t(1) << 32) / n + 1);
+  }
+
+  // The filter is separable: first sum the rows covered by a destination row
+  // into per-column sums, then sum the columns of each destination pixel.
+  // All sums are exact, so the result is identical to downsampleReference().
+  const size_t rowSize = static_cast<size_t>(srcW) * 4;
+  mRowSums.resize(rowSize);
+  uint16_t* sums = mRowSums.data();
+  for (uint32_t dstY = 0, srcY = 0; dstY < dstH; dstY++) {
+    uint32_t y = end(dstY, srcH, dstH);
+    uint32_t boxH = y - srcY;
+    memset(sums, 0, rowSize * sizeof(uint16_t));
+    for (; srcY < y; srcY++) {
+      accumulateRow(src + srcY * rowSize, sums, rowSize);
+    }
+
+    uint32_t srcX = 0;
+    for (uint32_t dstX = 0; dstX < dstW; dstX++) {
+      uint32_t x = mColumnEnds[dstX];
+      uint32_t rgba[4];
+      sumColumns(sums, srcX, x, rgba);
+      uint64_t reciprocal = mReciprocals[(x - srcX) * boxH];
+      dst[0] = static_cast<uint8_t>((rgba[0] * reciprocal) >> 32);
+      dst[1] = static_cast<uint8_t>((rgba[1] * reciprocal) >> 32);
+      dst[2] = static_cast<uint8_t>((rgba[2] * reciprocal) >> 32);
+      dst[3] = static_cast<uint8_t>((rgba[3] * reciprocal) >> 32);
+      dst += 4;
+      srcX = x;
+    }
+  }
+}
+
+void Downsampler::downsampleReference(const uint8_t* src, uint32_t srcW,
+                                      uint32_t srcH, uint8_t* dst,
+                                      uint32_t dstW, uint32_t dstH) {
+  // Downsample the image by averaging the colours of neighbouring pixels.
+  for (uint32_t srcY = 0, y = 0, dstY = 0; dstY < dstH; srcY = y, dstY++) {
+    for (uint32_t srcX = 0, x = 0, dstX = 0; dstX < dstW; srcX = x, dstX++) {
+      uint32_t r = 0, g = 0, b = 0, a = 0, n = 0;
+      // We need to loop over srcX/srcY ranges several times, so we keep them in
+      // x/y, and we update srcX/srcY to the last x/y only once we are done with
+      // the pixel.
+      for (y = srcY; y * dstH < (dstY + 1) * srcH;
+           y++) {  // while y*yScale < dstY+1
+        const uint8_t* p = &src[(srcX + y * srcW) * 4];
+        for (x = srcX; x * dstW < (dstX + 1) * srcW;
+             x++) {  // while x*xScale < dstX+1
+          r += *(p++);
+          g += *(p++);
+          b += *(p++);
+          a += *(p++);
+          n += 1;
+        }
+      }
+      *(dst++) = r / n;
+      *(dst++) = g / n;
+      *(dst++) = b / n;
+      *(dst++) = a / n;
+    }
+  }
+}
+
+}  // namespace core
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CORE_DOWNSAMPLE_H
+#define CORE_DOWNSAMPLE_H
+
+#include <stdint.h>
+
+#include <vector>
+
+namespace core {
+
+// Downsampler shrinks RGBA8 images with a box filter, where each destination
+// pixel is the truncated average of the source pixels it covers.
+// The scratch buffers used by the filter are kept between calls, so a single
+// Downsampler should be reused for a stream of images of similar size.
+// A Downsampler is not thread-safe.
+class Downsampler {
+ public:
+  // dimensions calculates the dimensions of the downsampled image for a
+  // srcW x srcH image so that it fits in maxW x maxH while preserving the
+  // aspect ratio. Images that already fit are not scaled.
+  static void dimensions(uint32_t srcW, uint32_t srcH, uint32_t maxW,
+                         uint32_t maxH, uint32_t* dstW, uint32_t* dstH);
+
+  // downsample averages the srcW x srcH RGBA8 pixels at src into the
+  // dstW x dstH RGBA8 pixels at dst. dst must point to at least
+  // dstW * dstH * 4 bytes. dstW and dstH must not be greater than srcW and
+  // srcH respectively.
+  void downsample(const uint8_t* src, uint32_t srcW, uint32_t srcH,
+                  uint8_t* dst, uint32_t dstW, uint32_t dstH);
+
+  // downsampleReference is the plain, per-pixel implementation of
+  // downsample(). It is used for box sizes the vectorized path does not
+  // support, and as a reference for testing.
+  static void downsampleReference(const uint8_t* src, uint32_t srcW,
+                                  uint32_t srcH, uint8_t* dst, uint32_t dstW,
+                                  uint32_t dstH);
+
+ private:
+  // The exclusive end of the source column range of each destination column.
+  std::vector<uint32_t> mColumnEnds;
+  // The per-channel column sums of the source rows covered by the current
+  // destination row.
+  std::vector<uint16_t> mRowSums;
+  // 32.32 fixed-point reciprocals of the box areas, indexed by area.
+  std::vector<uint64_t> mReciprocals;
+};
+
+}  // namespace core
+
+#endif  // CORE_DOWNSAMPLE_H
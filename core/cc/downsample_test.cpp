@@ -0,0 +1,117 @@
+/*
+ * Copyright (C) 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "downsample.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <vector>
+
+using ::testing::ElementsAre;
+
+namespace core {
+namespace test {
+namespace {
+
+const uint32_t kMaxW = 1920 / 2;
+const uint32_t kMaxH = 1280 / 2;
+
+std::vector<uint8_t> image(uint32_t w, uint32_t h) {
+  std::vector<uint8_t> data(w * h * 4);
+  uint32_t seed = w * 31 + h;
+  for (auto& b : data) {
+    seed = seed * 1103515245 + 12345;
+    b = static_cast<uint8_t>(seed >> 16);
+  }
+  return data;
+}
+
+// expectMatchesReference checks that downsampling a w x h image produces the
+// same bytes as the reference implementation.
+void expectMatchesReference(Downsampler& downsampler, uint32_t w, uint32_t h,
+                            uint32_t maxW, uint32_t maxH) {
+  auto src = image(w, h);
+  uint32_t dstW, dstH;
+  Downsampler::dimensions(w, h, maxW, maxH, &dstW, &dstH);
+  std::vector<uint8_t> got(dstW * dstH * 4);
+  std::vector<uint8_t> want(dstW * dstH * 4);
+  downsampler.downsample(src.data(), w, h, got.data(), dstW, dstH);
+  Downsampler::downsampleReference(src.data(), w, h, want.data(), dstW, dstH);
+  EXPECT_EQ(want, got) << w << "x" << h << " -> " << dstW << "x" << dstH;
+}
+
+}  // anonymous namespace
+
+TEST(DownsampleTest, Dimensions) {
+  uint32_t w, h;
+  Downsampler::dimensions(640, 480, kMaxW, kMaxH, &w, &h);
+  EXPECT_EQ(640, w);
+  EXPECT_EQ(480, h);
+  Downsampler::dimensions(1920, 1080, kMaxW, kMaxH, &w, &h);
+  EXPECT_EQ(960, w);
+  EXPECT_EQ(540, h);
+  Downsampler::dimensions(1080, 1920, kMaxW, kMaxH, &w, &h);
+  EXPECT_EQ(360, w);
+  EXPECT_EQ(640, h);
+}
+
+TEST(DownsampleTest, Average) {
+  const uint8_t src[] = {
+      0,  10, 20, 30,  2,  12, 22, 32,  //
+      4,  14, 24, 34,  7,  17, 27, 37,  //
+  };
+  uint8_t dst[4];
+  Downsampler downsampler;
+  downsampler.downsample(src, 2, 2, dst, 1, 1);
+  EXPECT_THAT(dst, ElementsAre(3, 13, 23, 33));
+}
+
+TEST(DownsampleTest, Identity) {
+  auto src = image(17, 5);
+  std::vector<uint8_t> dst(src.size());
+  Downsampler downsampler;
+  downsampler.downsample(src.data(), 17, 5, dst.data(), 17, 5);
+  EXPECT_EQ(src, dst);
+}
+
+TEST(DownsampleTest, MatchesReference) {
+  Downsampler downsampler;
+  for (uint32_t w : {1u, 3u, 8u, 33u, 100u}) {
+    for (uint32_t h : {1u, 2u, 7u, 64u}) {
+      expectMatchesReference(downsampler, w, h, 5, 3);
+      expectMatchesReference(downsampler, w, h, 16, 16);
+    }
+  }
+}
+
+TEST(DownsampleTest, MatchesReferenceAtCommonResolutions) {
+  Downsampler downsampler;
+  expectMatchesReference(downsampler, 1280, 720, kMaxW, kMaxH);
+  expectMatchesReference(downsampler, 1920, 1080, kMaxW, kMaxH);
+  expectMatchesReference(downsampler, 2560, 1440, kMaxW, kMaxH);
+  expectMatchesReference(downsampler, 3840, 2160, kMaxW, kMaxH);
+  expectMatchesReference(downsampler, 1440, 2960, kMaxW, kMaxH);
+}
+
+TEST(DownsampleTest, LargeBoxesFallBackToReference) {
+  Downsampler downsampler;
+  expectMatchesReference(downsampler, 300, 600, 1, 1);
+  expectMatchesReference(downsampler, 4, 1000, 4, 2);
+}
+
+}  // namespace test
+}  // namespace core
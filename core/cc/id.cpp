@@ -44,10 +44,6 @@ Id Id::Hash(const void* ptr, uint64_t size) {
   return id;
 }
 
-bool Id::operator==(const Id& rhs) const {
-  return memcmp(data, rhs.data, sizeof(data)) == 0;
-}
-
 std::string Id::string() const {
   std::stringstream ss;
   ss << "0x";
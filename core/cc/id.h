@@ -20,6 +20,7 @@
 #include <stdint.h>
 #include <cstring>
 #include <functional>
+#include <string>
 
 namespace core {
 
@@ -28,7 +29,8 @@ struct Id {
   // Construct an Id with the hash of the given memory address.
   static Id Hash(const void* ptr, uint64_t size);
 
-  bool operator==(const Id& rhs) const;
+  inline bool operator==(const Id& rhs) const;
+  inline bool operator!=(const Id& rhs) const;
 
   inline operator uint8_t*();
   inline operator const uint8_t*() const;
@@ -38,6 +40,12 @@ struct Id {
   uint8_t data[20];
 };
 
+inline bool Id::operator==(const Id& rhs) const {
+  return memcmp(data, rhs.data, sizeof(data)) == 0;
+}
+
+inline bool Id::operator!=(const Id& rhs) const { return !(*this == rhs); }
+
 inline Id::operator uint8_t*() { return data; }
 
 inline Id::operator const uint8_t*() const { return data; }
@@ -46,6 +54,8 @@ inline Id::operator const uint8_t*() const { return data; }
 
 namespace std {
 
+// Ids are content hashes, so any 8 of their bytes are already uniformly
+// distributed and can be used as the hash directly.
 template <>
 struct hash<core::Id> {
   inline size_t operator()(const core::Id& id) const {
@@ -17,17 +17,37 @@
 #ifndef CORE_TRACE_H
 #define CORE_TRACE_H
 
+#include "target.h"
+
+// When GAPID_USE_TRACING is defined, the GAPID_TRACE_ macros emit trace events.
+// On Android the events go to systrace, unless GAPID_USE_TRACE_RECORDER is
+// also defined. On other platforms, and with GAPID_USE_TRACE_RECORDER, the
+// events are recorded in-process by core::TraceRecorder.
+// Without GAPID_USE_TRACING the macros compile to nothing.
+
 #ifdef GAPID_USE_TRACING
-#if TARGET_OS == GAPID_OS_ANDROID
+#if TARGET_OS == GAPID_OS_ANDROID && !defined(GAPID_USE_TRACE_RECORDER)
 #define GAPID_TRACE_MACROS_DEFINED
 #include "android/trace.h"
-#endif  // TARGET_OS == GAPID_OS_ANDROID
+#else  // TARGET_OS == GAPID_OS_ANDROID && !defined(GAPID_USE_TRACE_RECORDER)
+#define GAPID_TRACE_MACROS_DEFINED
+#include "trace_recorder.h"
+
+#define GAPID_TRACE_CALL() core::TraceRecorder::Scope __gapidtrace(__FUNCTION__)
+#define GAPID_TRACE_NAME(name) core::TraceRecorder::Scope __gapidtrace(name)
+#define GAPID_TRACE_BEGIN(name) core::TraceRecorder::begin(name)
+#define GAPID_TRACE_END() core::TraceRecorder::end()
+#define GAPID_TRACE_INT(name, value) core::TraceRecorder::counter(name, value)
+#define GAPID_TRACE_ENABLED() true
+#endif  // TARGET_OS == GAPID_OS_ANDROID && !defined(GAPID_USE_TRACE_RECORDER)
 #endif  // GAPID_USE_TRACING
 
 #ifndef GAPID_TRACE_MACROS_DEFINED
 #define GAPID_TRACE_CALL()
 #define GAPID_TRACE_NAME(name)
-#define GAPID_TRACE_INT(name)
+#define GAPID_TRACE_BEGIN(name)
+#define GAPID_TRACE_END()
+#define GAPID_TRACE_INT(name, value)
 #define GAPID_TRACE_ENABLED() false
 #endif  // GAPID_TRACE_MACROS_DEFINED
 
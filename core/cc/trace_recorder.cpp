@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "trace_recorder.h"
+
+#include "thread.h"
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// appendEscaped appends str to out as the contents of a JSON string.
+void appendEscaped(std::string* out, const char* str) {
+  for (const char* c = str; *c != '\0'; c++) {
+    if (*c == '"' || *c == '\\') {
+      out->push_back('\\');
+    }
+    out->push_back(*c);
+  }
+}
+
+}  // anonymous namespace
+
+namespace core {
+
+struct TraceRecorder::Registry {
+  std::mutex mutex;  // Guards buffers.
+  std::vector<Buffer*> buffers;
+  // The time at which the first buffer was registered, in ticks and as
+  // steady clock time. Used to measure the tick rate.
+  uint64_t baseTicks;
+  std::chrono::steady_clock::time_point baseTime;
+  // The path the events are dumped to at exit, if any.
+  const char* dumpPath;
+};
+
+thread_local TraceRecorder::Buffer* TraceRecorder::tBuffer = nullptr;
+
+TraceRecorder::Registry& TraceRecorder::registry() {
+  // Never destroyed, so that events can be recorded and dumped during static
+  // destruction.
+  static Registry* instance = [] {
+    auto r = new Registry();
+    r->baseTicks = now();
+    r->baseTime = std::chrono::steady_clock::now();
+    r->dumpPath = getenv("GAPID_TRACE_FILE");
+    if (r->dumpPath != nullptr) {
+      atexit([] { dump(registry().dumpPath); });
+    }
+    return r;
+  }();
+  return *instance;
+}
+
+TraceRecorder::Buffer* TraceRecorder::registerThread() {
+  auto buffer = new Buffer();
+  buffer->count = 0;
+  buffer->threadId = Thread::current().id();
+  // The buffer is kept after the thread exits, so its events can be dumped.
+  auto& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  r.buffers.push_back(buffer);
+  tBuffer = buffer;
+  return buffer;
+}
+
+std::string TraceRecorder::json() {
+  auto& r = registry();
+  std::vector<Buffer*> buffers;
+  {
+    std::lock_guard<std::mutex> lock(r.mutex);
+    buffers = r.buffers;
+  }
+
+  // Measure the tick rate against the steady clock, over at least 10ms.
+  auto minElapsed = std::chrono::milliseconds(10);
+  auto elapsed = std::chrono::steady_clock::now() - r.baseTime;
+  if (elapsed < minElapsed) {
+    std::this_thread::sleep_for(minElapsed - elapsed);
+  }
+  uint64_t ticks = now() - r.baseTicks;
+  elapsed = std::chrono::steady_clock::now() - r.baseTime;
+  double ticksPerMicrosecond =
+      ticks / std::chrono::duration<double, std::micro>(elapsed).count();
+
+  std::string out = "{\"traceEvents\":[";
+  const char* separator = "\n";
+  std::vector<Event> events;
+  for (auto buffer : buffers) {
+    uint64_t end = buffer->count.load(std::memory_order_acquire);
+    uint64_t start = end > kEventsPerThread ? end - kEventsPerThread : 0;
+    events.clear();
+    for (uint64_t i = start; i < end; i++) {
+      events.push_back(buffer->events[i % kEventsPerThread]);
+    }
+    // Drop the events that may have been overwritten while they were copied.
+    // The slot of the next event may be partially written too.
+    uint64_t after = buffer->count.load(std::memory_order_acquire);
+    uint64_t intact =
+        after >= kEventsPerThread ? after - kEventsPerThread + 1 : 0;
+    size_t first = intact > start ? static_cast<size_t>(intact - start) : 0;
+
+    int depth = 0;
+    for (size_t i = first; i < events.size(); i++) {
+      const Event& event = events[i];
+      if (event.type == END) {
+        if (depth == 0) {
+          continue;  // The begin event has been overwritten.
+        }
+        depth--;
+      } else if (event.type == BEGIN) {
+        depth++;
+      }
+
+      char buf[128];
+      double ts = static_cast<int64_t>(event.time - r.baseTicks) /
+                  ticksPerMicrosecond;
+      out += separator;
+      out += "{";
+      if (event.name != nullptr) {
+        out += "\"name\":\"";
+        appendEscaped(&out, event.name);
+        out += "\",";
+      }
+      snprintf(buf, sizeof(buf), "\"ph\":\"%c\",\"ts\":%.3f,\"pid\":0,",
+               event.type == BEGIN ? 'B' : event.type == END ? 'E' : 'C', ts);
+      out += buf;
+      snprintf(buf, sizeof(buf), "\"tid\":%" PRIu64, buffer->threadId);
+      out += buf;
+      if (event.type == COUNTER) {
+        snprintf(buf, sizeof(buf), ",\"args\":{\"value\":%" PRId64 "}",
+                 event.value);
+        out += buf;
+      }
+      out += "}";
+      separator = ",\n";
+    }
+  }
+  out += "\n],\"displayTimeUnit\":\"ns\"}\n";
+  return out;
+}
+
+bool TraceRecorder::dump(const char* path) {
+  FILE* file = fopen(path, "w");
+  if (file == nullptr) {
+    return false;
+  }
+  auto data = json();
+  bool ok = fwrite(data.data(), 1, data.size(), file) == data.size();
+  return fclose(file) == 0 && ok;
+}
+
+void TraceRecorder::clear() {
+  auto& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  for (auto buffer : r.buffers) {
+    buffer->count.store(0, std::memory_order_release);
+  }
+}
+
+}  // namespace core
@@ -0,0 +1,150 @@
+/*
+ * Copyright (C) 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef CORE_TRACE_RECORDER_H
+#define CORE_TRACE_RECORDER_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+#if defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+namespace core {
+
+// TraceRecorder records begin, end and counter trace events into per-thread
+// ring buffers, and writes them out in the Chrome trace event JSON format,
+// which can be loaded by chrome://tracing and the Perfetto UI.
+//
+// Recording an event does not take any locks: each thread writes to its own
+// buffer, which is registered on the thread's first event. When a buffer is
+// full, the oldest events of the thread are overwritten.
+//
+// Only the pointer of an event name is recorded, so names must outlive the
+// recorder, which is normally achieved by using string literals.
+//
+// If the GAPID_TRACE_FILE environment variable is set, the events are dumped
+// to that file when the process exits.
+class TraceRecorder {
+ public:
+  // The number of most recent events kept for each thread.
+  static const uint32_t kEventsPerThread = 1 << 14;
+
+  // Scope records a begin event on construction, and the matching end event
+  // on destruction.
+  class Scope {
+   public:
+    inline Scope(const char* name) { begin(name); }
+    inline ~Scope() { end(); }
+
+   private:
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+  };
+
+  // begin records the start of the named slice on the current thread.
+  static inline void begin(const char* name) { record(BEGIN, name, 0); }
+
+  // end records the end of the last begun slice on the current thread.
+  static inline void end() { record(END, nullptr, 0); }
+
+  // counter records the value of the named counter.
+  static inline void counter(const char* name, int64_t value) {
+    record(COUNTER, name, value);
+  }
+
+  // json returns all the recorded events as a Chrome trace event JSON
+  // document. End events without a recorded begin event are dropped.
+  // It is safe to call json() while other threads are recording events.
+  static std::string json();
+
+  // dump writes json() to the file at path. Returns true on success.
+  static bool dump(const char* path);
+
+  // clear discards all the recorded events. clear() must not be called while
+  // other threads are recording events.
+  static void clear();
+
+ private:
+  enum Type : uint32_t { BEGIN, END, COUNTER };
+
+  struct Event {
+    uint64_t time;  // In ticks.
+    const char* name;
+    int64_t value;
+    Type type;
+  };
+
+  struct Buffer {
+    // The total number of events recorded by the thread.
+    std::atomic<uint64_t> count;
+    uint64_t threadId;
+    Event events[kEventsPerThread];
+  };
+
+  // record appends an event to the current thread's buffer.
+  static inline void record(Type type, const char* name, int64_t value);
+
+  // now returns the current time in ticks. Ticks are converted to time using
+  // the tick rate measured when the events are written out.
+  static inline uint64_t now();
+
+  struct Registry;
+
+  // registry returns the list of all the thread buffers.
+  static Registry& registry();
+
+  // registerThread creates and registers the current thread's buffer.
+  static Buffer* registerThread();
+
+  static thread_local Buffer* tBuffer;
+};
+
+inline void TraceRecorder::record(Type type, const char* name, int64_t value) {
+  Buffer* buffer = tBuffer;
+  if (buffer == nullptr) {
+    buffer = registerThread();
+  }
+  uint64_t count = buffer->count.load(std::memory_order_relaxed);
+  Event& event = buffer->events[count % kEventsPerThread];
+  event.time = now();
+  event.name = name;
+  event.value = value;
+  event.type = type;
+  buffer->count.store(count + 1, std::memory_order_release);
+}
+
+inline uint64_t TraceRecorder::now() {
+#if defined(__i386__) || defined(__x86_64__)
+  return __rdtsc();
+#elif defined(__aarch64__)
+  uint64_t ticks;
+  asm volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+  return ticks;
+#else
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now().time_since_epoch())
+      .count();
+#endif
+}
+
+}  // namespace core
+
+#endif  // CORE_TRACE_RECORDER_H
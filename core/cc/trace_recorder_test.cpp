@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "trace_recorder.h"
+
+#include <gtest/gtest.h>
+
+#include <string>
+#include <thread>
+
+namespace core {
+namespace test {
+namespace {
+
+// count returns the number of times substr appears in str.
+size_t count(const std::string& str, const std::string& substr) {
+  size_t n = 0;
+  for (size_t i = str.find(substr); i != std::string::npos;
+       i = str.find(substr, i + 1)) {
+    n++;
+  }
+  return n;
+}
+
+class TraceRecorderTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() { TraceRecorder::clear(); }
+  virtual void TearDown() { TraceRecorder::clear(); }
+};
+
+}  // anonymous namespace
+
+TEST_F(TraceRecorderTest, Events) {
+  {
+    TraceRecorder::Scope outer("outer");
+    TraceRecorder::begin("inner \"quoted\"");
+    TraceRecorder::counter("counter", -42);
+    TraceRecorder::end();
+  }
+  auto json = TraceRecorder::json();
+  EXPECT_EQ(0, json.find("{\"traceEvents\":["));
+  EXPECT_NE(std::string::npos, json.find("{\"name\":\"outer\",\"ph\":\"B\","));
+  EXPECT_NE(std::string::npos,
+            json.find("{\"name\":\"inner \\\"quoted\\\"\",\"ph\":\"B\","));
+  EXPECT_NE(std::string::npos, json.find("\"args\":{\"value\":-42}"));
+  EXPECT_EQ(2, count(json, "\"ph\":\"B\""));
+  EXPECT_EQ(2, count(json, "\"ph\":\"E\""));
+  EXPECT_EQ(1, count(json, "\"ph\":\"C\""));
+}
+
+TEST_F(TraceRecorderTest, Threads) {
+  std::thread thread([] { TraceRecorder::Scope scope("thread"); });
+  thread.join();
+  TraceRecorder::Scope scope("main");
+  auto json = TraceRecorder::json();
+  EXPECT_EQ(1, count(json, "\"name\":\"thread\""));
+  EXPECT_EQ(1, count(json, "\"name\":\"main\""));
+}
+
+TEST_F(TraceRecorderTest, Wrap) {
+  TraceRecorder::begin("first");
+  for (uint32_t i = 0; i < TraceRecorder::kEventsPerThread; i++) {
+    TraceRecorder::Scope scope("repeated");
+  }
+  TraceRecorder::end();
+  auto json = TraceRecorder::json();
+  // The first begin event has been overwritten, so its end event is dropped,
+  // as is the end of the oldest repeated scope still in the buffer.
+  EXPECT_EQ(0, count(json, "\"name\":\"first\""));
+  EXPECT_EQ(count(json, "\"ph\":\"B\""), count(json, "\"ph\":\"E\""));
+  EXPECT_EQ(TraceRecorder::kEventsPerThread / 2 - 1,
+            count(json, "\"ph\":\"B\""));
+}
+
+}  // namespace test
+}  // namespace core
@@ -0,0 +1,472 @@
+/*
+ * Copyright (C) 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cache.h"
+#include "query.h"
+
+#include "core/cc/target.h"
+
+#include <city.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <set>
+#include <utility>
+#include <vector>
+
+#if TARGET_OS == GAPID_OS_ANDROID || TARGET_OS == GAPID_OS_LINUX
+#include <dirent.h>
+#include <sys/stat.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+#endif
+
+#if TARGET_OS == GAPID_OS_ANDROID
+#include <sys/system_properties.h>
+#endif
+
+namespace {
+
+// The cache file holds kMagic, the size of the key, the key, the hash of the
+// driver libraries and the serialized device::Instance. The last byte of
+// kMagic is the version of the format.
+const char kMagic[8] = {'G', 'A', 'P', 'I', 'D', 'D', 'I', 1};
+
+// kUnverified is the driver content hash of a cache that has not yet been
+// verified.
+const uint64_t kUnverified = 0;
+
+bool readFile(const std::string& path, std::string* out) {
+  FILE* f = fopen(path.c_str(), "rb");
+  if (f == nullptr) {
+    return false;
+  }
+  char buffer[4096];
+  while (size_t n = fread(buffer, 1, sizeof(buffer), f)) {
+    out->append(buffer, n);
+  }
+  fclose(f);
+  return true;
+}
+
+#if TARGET_OS == GAPID_OS_ANDROID || TARGET_OS == GAPID_OS_LINUX
+
+#if defined(__LP64__)
+#define LIB_DIR "lib64"
+#else
+#define LIB_DIR "lib"
+#endif
+
+#if TARGET_OS == GAPID_OS_ANDROID
+// The driver libraries, either loaded by the system libraries below or
+// selected by the properties in deviceProperties.
+const char* kDriverFiles[] = {
+    "/system/" LIB_DIR "/libEGL.so",
+    "/system/" LIB_DIR "/libGLESv2.so",
+    "/system/" LIB_DIR "/libvulkan.so",
+};
+// DriverDir is a directory whose files starting with prefix and ending with
+// suffix are drivers. If icd_manifests is set, the files are Vulkan ICD
+// manifests, and the libraries they name are drivers too.
+struct DriverDir {
+  const char* path;
+  const char* prefix;
+  const char* suffix;
+  bool icd_manifests;
+};
+const DriverDir kDriverDirs[] = {
+    {"/system/" LIB_DIR "/egl", "", "", false},
+    {"/vendor/" LIB_DIR "/egl", "", "", false},
+    {"/system/" LIB_DIR "/hw", "vulkan.", "", false},
+    {"/vendor/" LIB_DIR "/hw", "vulkan.", "", false},
+};
+// The directories searched for the libraries named without a path.
+const char* kLibDirs[] = {"/system/" LIB_DIR, "/vendor/" LIB_DIR};
+#else
+// The GL and Vulkan loaders, and the GLX and EGL vendor libraries they
+// dispatch to.
+const char* kDriverFiles[] = {
+    "/usr/lib/x86_64-linux-gnu/libGL.so.1",
+    "/usr/lib/x86_64-linux-gnu/libGLX.so.0",
+    "/usr/lib/x86_64-linux-gnu/libGLX_mesa.so.0",
+    "/usr/lib/x86_64-linux-gnu/libGLX_nvidia.so.0",
+    "/usr/lib/x86_64-linux-gnu/libEGL_mesa.so.0",
+    "/usr/lib/x86_64-linux-gnu/libEGL_nvidia.so.0",
+    "/usr/lib/x86_64-linux-gnu/libvulkan.so.1",
+    "/usr/" LIB_DIR "/libGL.so.1",
+    "/usr/" LIB_DIR "/libGLX.so.0",
+    "/usr/" LIB_DIR "/libGLX_mesa.so.0",
+    "/usr/" LIB_DIR "/libGLX_nvidia.so.0",
+    "/usr/" LIB_DIR "/libEGL_mesa.so.0",
+    "/usr/" LIB_DIR "/libEGL_nvidia.so.0",
+    "/usr/" LIB_DIR "/libvulkan.so.1",
+    "/proc/driver/nvidia/version",
+};
+// DriverDir is a directory whose files starting with prefix and ending with
+// suffix are drivers. If icd_manifests is set, the files are Vulkan ICD
+// manifests, and the libraries they name are drivers too.
+struct DriverDir {
+  const char* path;
+  const char* prefix;
+  const char* suffix;
+  bool icd_manifests;
+};
+// The Mesa DRI drivers, and the Vulkan drivers and layers, which are found
+// through the manifests in the Vulkan directories.
+const DriverDir kDriverDirs[] = {
+    {"/usr/lib/x86_64-linux-gnu/dri", "", "_dri.so", false},
+    {"/usr/" LIB_DIR "/dri", "", "_dri.so", false},
+    {"/etc/vulkan/icd.d", "", "", true},
+    {"/usr/share/vulkan/icd.d", "", "", true},
+    {"/etc/vulkan/implicit_layer.d", "", "", false},
+    {"/usr/share/vulkan/implicit_layer.d", "", "", false},
+    {"/etc/vulkan/explicit_layer.d", "", "", false},
+    {"/usr/share/vulkan/explicit_layer.d", "", "", false},
+};
+// The directories searched for the libraries named without a path.
+const char* kLibDirs[] = {"/usr/lib/x86_64-linux-gnu", "/usr/" LIB_DIR,
+                          "/usr/lib"};
+#endif
+
+#undef LIB_DIR
+
+bool hasSuffix(const std::string& str, const char* suffix) {
+  size_t n = strlen(suffix);
+  return str.size() >= n && str.compare(str.size() - n, n, suffix) == 0;
+}
+
+// icdLibrary returns the path of the library named by the library_path of the
+// Vulkan ICD manifest at path, resolved as the Vulkan loader does, or an empty
+// string if it does not exist.
+std::string icdLibrary(const std::string& path) {
+  std::string manifest;
+  if (!readFile(path, &manifest)) {
+    return "";
+  }
+  size_t start = manifest.find("\"library_path\"");
+  if (start == std::string::npos ||
+      (start = manifest.find(':', start)) == std::string::npos ||
+      (start = manifest.find('"', start)) == std::string::npos) {
+    return "";
+  }
+  size_t end = manifest.find('"', start + 1);
+  if (end == std::string::npos) {
+    return "";
+  }
+  std::string library = manifest.substr(start + 1, end - start - 1);
+  std::vector<std::string> candidates;
+  if (library.empty() || library[0] == '/') {
+    candidates.push_back(library);
+  } else if (library.find('/') != std::string::npos) {
+    // Relative to the manifest.
+    candidates.push_back(path.substr(0, path.rfind('/') + 1) + library);
+  } else {
+    for (auto dir : kLibDirs) {
+      candidates.push_back(std::string(dir) + "/" + library);
+    }
+  }
+  struct stat st;
+  for (const auto& candidate : candidates) {
+    if (!candidate.empty() && stat(candidate.c_str(), &st) == 0) {
+      return candidate;
+    }
+  }
+  return "";
+}
+
+// driverFiles returns the paths of the existing driver files. Files linked to
+// the same inode, such as the Mesa DRI drivers, are only returned once.
+std::vector<std::string> driverFiles() {
+  std::vector<std::string> files;
+  std::set<std::pair<dev_t, ino_t>> seen;
+  auto add = [&](const std::string& file) {
+    struct stat st;
+    if (stat(file.c_str(), &st) == 0 &&
+        seen.insert(std::make_pair(st.st_dev, st.st_ino)).second) {
+      files.push_back(file);
+    }
+  };
+  for (auto file : kDriverFiles) {
+    add(file);
+  }
+  for (const auto& dir : kDriverDirs) {
+    DIR* d = opendir(dir.path);
+    if (d == nullptr) {
+      continue;
+    }
+    std::vector<std::string> names;
+    while (auto entry = readdir(d)) {
+      std::string name = entry->d_name;
+      if (name[0] != '.' &&
+          name.compare(0, strlen(dir.prefix), dir.prefix) == 0 &&
+          hasSuffix(name, dir.suffix)) {
+        names.push_back(std::string(dir.path) + "/" + name);
+      }
+    }
+    closedir(d);
+    // readdir order is unspecified.
+    std::sort(names.begin(), names.end());
+    for (const auto& name : names) {
+      add(name);
+      if (dir.icd_manifests) {
+        auto library = icdLibrary(name);
+        if (!library.empty()) {
+          add(library);
+        }
+      }
+    }
+  }
+  return files;
+}
+
+// deviceProperties returns the system properties which identify the OS build,
+// the hardware and the drivers selected for it.
+std::string deviceProperties() {
+  std::string out;
+#if TARGET_OS == GAPID_OS_ANDROID
+  for (auto name : {"ro.build.fingerprint", "ro.hardware", "ro.hardware.egl",
+                    "ro.hardware.vulkan", "ro.board.platform"}) {
+    char value[PROP_VALUE_MAX] = {};
+    __system_property_get(name, value);
+    out = out + name + "=" + value + "\n";
+  }
+#else
+  utsname ubuf;
+  if (uname(&ubuf) == 0) {
+    out = out + ubuf.sysname + " " + ubuf.nodename + " " + ubuf.release + " " +
+          ubuf.version + " " + ubuf.machine + "\n";
+  }
+  // The GPUs present, as PCI vendor and device IDs.
+  for (int i = 0; i < 8; i++) {
+    for (auto field : {"vendor", "device"}) {
+      char path[64];
+      snprintf(path, sizeof(path), "/sys/class/drm/card%d/device/%s", i,
+               field);
+      if (FILE* f = fopen(path, "r")) {
+        char value[32] = {};
+        if (fgets(value, sizeof(value), f)) {
+          out = out + path + "=" + value;
+        }
+        fclose(f);
+      }
+    }
+  }
+  // The environment variables that change the drivers and layers loaded.
+  for (auto name : {"DISPLAY", "LD_LIBRARY_PATH", "VK_ICD_FILENAMES",
+                    "VK_LAYER_PATH", "VK_INSTANCE_LAYERS"}) {
+    const char* value = getenv(name);
+    out = out + name + "=" + (value ? value : "") + "\n";
+  }
+#endif
+  return out;
+}
+
+// driverContentHash returns the hash of the content of the driver files.
+uint64_t driverContentHash() {
+  uint64_t hash = 0;
+  std::vector<char> buffer(1 << 20);
+  for (const auto& file : driverFiles()) {
+    hash = CityHash64WithSeed(file.data(), file.size(), hash);
+    FILE* f = fopen(file.c_str(), "rb");
+    if (f == nullptr) {
+      continue;
+    }
+    while (size_t n = fread(buffer.data(), 1, buffer.size(), f)) {
+      hash = CityHash64WithSeed(buffer.data(), n, hash);
+    }
+    fclose(f);
+  }
+  return hash;
+}
+
+#endif  // TARGET_OS == GAPID_OS_ANDROID || TARGET_OS == GAPID_OS_LINUX
+
+// writeFile writes the data to a temporary file which is then renamed to path,
+// so that concurrent readers never see a partially written cache. Each writer
+// has its own temporary file, so concurrent writers do not interleave.
+void writeFile(const std::string& path, const std::string& data) {
+#if TARGET_OS == GAPID_OS_ANDROID || TARGET_OS == GAPID_OS_LINUX
+  std::string tmp = path + ".XXXXXX";
+  int fd = mkstemp(&tmp[0]);
+  if (fd < 0) {
+    return;
+  }
+  FILE* f = fdopen(fd, "wb");
+  if (f == nullptr) {
+    close(fd);
+    remove(tmp.c_str());
+    return;
+  }
+#else
+  std::string tmp = path + ".tmp";
+  FILE* f = fopen(tmp.c_str(), "wb");
+  if (f == nullptr) {
+    return;
+  }
+#endif
+  bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+  ok = fclose(f) == 0 && ok;
+  if (!ok || rename(tmp.c_str(), path.c_str()) != 0) {
+    remove(tmp.c_str());
+  }
+}
+
+// Cache is the content of a cache file.
+struct Cache {
+  std::string key;
+  uint64_t driver_hash;
+  std::string instance;  // The serialized device::Instance.
+
+  bool parse(const std::string& data) {
+    size_t offset = sizeof(kMagic);
+    uint32_t key_size;
+    if (data.size() < offset + sizeof(key_size) ||
+        memcmp(data.data(), kMagic, sizeof(kMagic)) != 0) {
+      return false;
+    }
+    memcpy(&key_size, &data[offset], sizeof(key_size));
+    offset += sizeof(key_size);
+    if (data.size() < offset + key_size + sizeof(driver_hash)) {
+      return false;
+    }
+    key = data.substr(offset, key_size);
+    offset += key_size;
+    memcpy(&driver_hash, &data[offset], sizeof(driver_hash));
+    offset += sizeof(driver_hash);
+    instance = data.substr(offset);
+    return true;
+  }
+
+  std::string serialize() const {
+    uint32_t key_size = key.size();
+    std::string out(kMagic, sizeof(kMagic));
+    out.append(reinterpret_cast<const char*>(&key_size), sizeof(key_size));
+    out.append(key);
+    out.append(reinterpret_cast<const char*>(&driver_hash),
+               sizeof(driver_hash));
+    out.append(instance);
+    return out;
+  }
+};
+
+}  // anonymous namespace
+
+namespace query {
+
+std::string deviceFingerprint() {
+#if TARGET_OS == GAPID_OS_ANDROID || TARGET_OS == GAPID_OS_LINUX
+  std::string out = deviceProperties();
+  struct stat st;
+  for (const auto& file : driverFiles()) {
+    if (stat(file.c_str(), &st) == 0) {
+      char line[64];
+      snprintf(line, sizeof(line), ":%lld:%lld\n",
+               static_cast<long long>(st.st_size),
+               static_cast<long long>(st.st_mtime));
+      out += file + line;
+    }
+  }
+  return out;
+#else
+  return "";
+#endif
+}
+
+std::string defaultCachePath() {
+#if TARGET_OS == GAPID_OS_ANDROID
+  // The process name starts with the package name, whose cache directory is
+  // writable by the app.
+  std::string cmdline;
+  if (!readFile("/proc/self/cmdline", &cmdline)) {
+    return "";
+  }
+  std::string package(cmdline.c_str());
+  package = package.substr(0, package.find(':'));
+  if (package.empty()) {
+    return "";
+  }
+  return "/data/data/" + package + "/cache/gapid_device_info";
+#elif TARGET_OS == GAPID_OS_LINUX
+  if (const char* dir = getenv("XDG_CACHE_HOME")) {
+    return std::string(dir) + "/gapid_device_info";
+  }
+  if (const char* home = getenv("HOME")) {
+    return std::string(home) + "/.cache/gapid_device_info";
+  }
+  return "";
+#else
+  return "";
+#endif
+}
+
+device::Instance* loadCachedInstance(const std::string& path,
+                                     const std::string& key) {
+  std::string data;
+  Cache cache;
+  if (key.empty() || !readFile(path, &data) || !cache.parse(data) ||
+      cache.key != key) {
+    return nullptr;
+  }
+  auto instance = new device::Instance();
+  if (!instance->ParseFromString(cache.instance)) {
+    delete instance;
+    return nullptr;
+  }
+  return instance;
+}
+
+void storeCachedInstance(const std::string& path, const std::string& key,
+                         const device::Instance& instance) {
+  if (key.empty()) {
+    return;
+  }
+  Cache cache;
+  cache.key = key;
+  cache.driver_hash = kUnverified;
+  if (!instance.SerializeToString(&cache.instance)) {
+    return;
+  }
+  writeFile(path, cache.serialize());
+}
+
+void verifyCachedInstance(const std::string& path) {
+#if TARGET_OS == GAPID_OS_ANDROID || TARGET_OS == GAPID_OS_LINUX
+  verifyCachedInstanceWithHash(path, driverContentHash());
+#endif
+}
+
+void verifyCachedInstanceWithHash(const std::string& path, uint64_t hash) {
+  std::string data;
+  Cache cache;
+  if (!readFile(path, &data) || !cache.parse(data)) {
+    return;
+  }
+  if (hash == kUnverified) {
+    hash = 1;
+  }
+  if (cache.driver_hash == kUnverified) {
+    // The first verification after the instance was queried records the
+    // hash of the drivers it was queried with.
+    cache.driver_hash = hash;
+    writeFile(path, cache.serialize());
+  } else if (cache.driver_hash != hash) {
+    remove(path.c_str());
+  }
+}
+
+}  // namespace query
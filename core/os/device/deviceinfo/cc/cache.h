@@ -0,0 +1,59 @@
+/*
+ * Copyright (C) 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef DEVICEINFO_CACHE_H
+#define DEVICEINFO_CACHE_H
+
+#include <stdint.h>
+
+#include <string>
+
+#include "core/os/device/device.pb.h"
+
+namespace query {
+
+// deviceFingerprint returns a string identifying the OS build and the graphics
+// drivers of the device, which changes whenever they are updated. It is built
+// from system properties and the paths, sizes and modification times of the
+// driver libraries, so it is cheap to compute and does not need a graphics
+// context. Returns an empty string if the platform is not supported.
+std::string deviceFingerprint();
+
+// loadCachedInstance returns the device::Instance stored at path if it was
+// stored with the given key, otherwise nullptr. It must be freed with delete.
+device::Instance* loadCachedInstance(const std::string& path,
+                                     const std::string& key);
+
+// storeCachedInstance stores the device::Instance at path with the given key.
+// Failures are ignored, as the instance is just queried again the next time.
+void storeCachedInstance(const std::string& path, const std::string& key,
+                         const device::Instance& instance);
+
+// verifyCachedInstance hashes the content of the driver libraries and removes
+// the cache at path if they changed since the instance was stored, which the
+// fingerprint could miss if a driver is replaced with one of the same size and
+// modification time. This reads every driver library, so it is meant to be
+// called on a background thread after a cache hit.
+void verifyCachedInstance(const std::string& path);
+
+// verifyCachedInstanceWithHash is verifyCachedInstance for the given hash of
+// the driver libraries. The first verification of a cache records the hash,
+// and the following ones remove the cache if the hash differs.
+void verifyCachedInstanceWithHash(const std::string& path, uint64_t hash);
+
+}  // namespace query
+
+#endif  // DEVICEINFO_CACHE_H
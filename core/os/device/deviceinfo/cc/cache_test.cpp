@@ -0,0 +1,98 @@
+/*
+ * Copyright (C) 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "cache.h"
+
+#include <gtest/gtest.h>
+
+#include <stdio.h>
+
+#include <memory>
+#include <string>
+
+namespace query {
+namespace test {
+namespace {
+
+class CacheTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    mPath = ::testing::TempDir() + "gapid_device_info_test";
+    remove(mPath.c_str());
+    mInstance.set_name("test device");
+    mInstance.mutable_configuration()->mutable_hardware()->set_name("gpu");
+  }
+
+  void TearDown() override { remove(mPath.c_str()); }
+
+  std::unique_ptr<device::Instance> load(const std::string& key) {
+    return std::unique_ptr<device::Instance>(loadCachedInstance(mPath, key));
+  }
+
+  std::string mPath;
+  device::Instance mInstance;
+};
+
+}  // anonymous namespace
+
+TEST_F(CacheTest, Hit) {
+  storeCachedInstance(mPath, "key", mInstance);
+  auto instance = load("key");
+  ASSERT_NE(nullptr, instance);
+  EXPECT_EQ(mInstance.SerializeAsString(), instance->SerializeAsString());
+}
+
+TEST_F(CacheTest, Miss) {
+  EXPECT_EQ(nullptr, load("key"));
+
+  // The fingerprint of the device changed.
+  storeCachedInstance(mPath, "key", mInstance);
+  EXPECT_EQ(nullptr, load("other key"));
+
+  // The platform has no fingerprint.
+  EXPECT_EQ(nullptr, load(""));
+  storeCachedInstance(mPath, "", mInstance);
+  EXPECT_NE(nullptr, load("key"));
+
+  // The file is not a cache.
+  FILE* f = fopen(mPath.c_str(), "wb");
+  ASSERT_NE(nullptr, f);
+  fputs("not a device info cache", f);
+  fclose(f);
+  EXPECT_EQ(nullptr, load("key"));
+}
+
+TEST_F(CacheTest, Invalidation) {
+  storeCachedInstance(mPath, "key", mInstance);
+
+  // The first verification records the hash of the drivers.
+  verifyCachedInstanceWithHash(mPath, 123);
+  EXPECT_NE(nullptr, load("key"));
+  verifyCachedInstanceWithHash(mPath, 123);
+  EXPECT_NE(nullptr, load("key"));
+
+  // The drivers changed without changing the fingerprint.
+  verifyCachedInstanceWithHash(mPath, 456);
+  EXPECT_EQ(nullptr, load("key"));
+
+  // A new cache is verified again.
+  storeCachedInstance(mPath, "key", mInstance);
+  verifyCachedInstanceWithHash(mPath, 456);
+  EXPECT_NE(nullptr, load("key"));
+}
+
+}  // namespace test
+}  // namespace query
@@ -15,6 +15,7 @@
  */
 
 #include "query.h"
+#include "cache.h"
 
 #include <city.h>
 
@@ -182,12 +183,31 @@ void buildDeviceInstance(const query::Option& opt, void* platform_data,
 namespace query {
 
 device::Instance* getDeviceInstance(const Option& opt, void* platform_data) {
+  std::string key;
+  if (!opt.cache_path.empty()) {
+    key = deviceFingerprint();
+    if (!key.empty()) {
+      key += opt.vulkan.query_layers_and_extensions() ? "vk-layers:1\n"
+                                                      : "vk-layers:0\n";
+      key += opt.vulkan.query_physical_devices() ? "vk-devices:1\n"
+                                                 : "vk-devices:0\n";
+    }
+    if (auto instance = loadCachedInstance(opt.cache_path, key)) {
+      std::thread(verifyCachedInstance, opt.cache_path).detach();
+      return instance;
+    }
+  }
+
   device::Instance* instance = nullptr;
 
   // buildDeviceInstance on a separate thread to avoid EGL screwing with the
   // currently bound context.
   std::thread thread(buildDeviceInstance, opt, platform_data, &instance);
   thread.join();
+
+  if (instance != nullptr) {
+    storeCachedInstance(opt.cache_path, key, *instance);
+  }
   return instance;
 }
 
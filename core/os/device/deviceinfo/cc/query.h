@@ -18,6 +18,7 @@
 #define DEVICEINFO_QUERY_H
 
 #include <functional>
+#include <string>
 
 #include "core/os/device/device.pb.h"
 
@@ -60,12 +61,22 @@ class VulkanOption {
 // query::getDeviceInstance().
 struct Option {
   VulkanOption vulkan;
+  // cache_path is the path of the file in which the device::Instance is cached
+  // between runs. If empty, the device::Instance is always queried.
+  std::string cache_path;
 };
 
 // getDeviceInstance returns the device::Instance proto message for the
-// current device. It must be freed with delete.
+// current device. It must be freed with delete. If opt.cache_path is set and
+// the cache was stored with the same options on the same OS build and drivers,
+// the cached device::Instance is returned without creating a context, and the
+// cache is verified on a background thread.
 device::Instance* getDeviceInstance(const Option& opt, void* platform_data);
 
+// defaultCachePath returns the path of the device::Instance cache for the
+// current process, or an empty string if there is no suitable location.
+std::string defaultCachePath();
+
 // updateVulkanPhysicalDevices modifies the given device::Instance by adding
 // device::VulkanPhysicalDevice to the device::Instance. If a
 // vkGetInstanceProcAddress function is given, that function will be used to
@@ -18,10 +18,13 @@
 #include "spy_base.h"
 
 #include "core/cc/thread.h"
+#include "core/cc/trace.h"
 
 #include "gapis/memory/memory_pb/memory.pb.h"
 
+#include <string>
 #include <tuple>
+#include <vector>
 
 using core::Interval;
 
@@ -30,21 +33,40 @@ namespace {
 // Minimum byte gap between memory observations before globbing together.
 const size_t MEMORY_MERGE_THRESHOLD = 256;
 
+// Observations of at most this many bytes are sent together as a single
+// resource when a command has more than one of them.
+const uint64_t MAX_BATCHED_OBSERVATION_SIZE = 4096;
+
+// The batch buffer is released after sending a batch larger than this, rather
+// than kept for the next command.
+const size_t MAX_RETAINED_BATCH_SIZE = 256 * 1024;
+
 }  // anonymous namespace
 
 namespace gapii {
 // Creates a CallObserver with a given spy and applies the memory space for
 // observation data from the spy instance.
 CallObserver::CallObserver(SpyBase* spy, CallObserver* parent, uint8_t api)
-    : mSpy(spy),
-      mParent(parent),
-      mSeenReferences{{nullptr, 0}},
-      mCurrentCommandName(nullptr),
-      mObserveApplicationPool(spy->shouldObserveApplicationPool()),
-      mError(0 /*GL_NO_ERROR*/),
-      mApi(api),
-      mShouldTrace(false),
+    : mBatch(new memory::Observations()),
       mCurrentThread(core::Thread::current().id()) {
+  mEncoderStack.reserve(4);
+  mSeenReferences.reserve(kMaxSeenReferences);
+  mPendingObservations.setMergeThreshold(MEMORY_MERGE_THRESHOLD);
+  reset(spy, parent, api);
+}
+
+// Releases the observation data memory at the end.
+CallObserver::~CallObserver() { release(); }
+
+void CallObserver::reset(SpyBase* spy, CallObserver* parent, uint8_t api) {
+  mSpy = spy;
+  mParent = parent;
+  mCurrentCommandName = nullptr;
+  mObserveApplicationPool = spy->shouldObserveApplicationPool();
+  mError = 0 /*GL_NO_ERROR*/;
+  mApi = api;
+  mThreadLocal = false;
+
   // context_t initialization.
   this->context_t::id = 0;
   this->context_t::location = 0;
@@ -54,16 +76,22 @@ CallObserver::CallObserver(SpyBase* spy, CallObserver* parent, uint8_t api)
   mShouldTrace = mSpy->should_trace(mApi);
 
   if (parent) {
-    mEncoderStack.push(mShouldTrace ? parent->encoder() : mSpy->nullEncoder());
+    mEncoderStack.push_back(mShouldTrace ? parent->encoder()
+                                         : mSpy->nullEncoder());
   } else {
-    mEncoderStack.push(mSpy->getEncoder(mApi));
+    mEncoderStack.push_back(mSpy->getEncoder(mApi));
   }
-
-  mPendingObservations.setMergeThreshold(MEMORY_MERGE_THRESHOLD);
 }
 
-// Releases the observation data memory at the end.
-CallObserver::~CallObserver() {}
+void CallObserver::release() {
+  runDeferred(0);
+  // The containers are cleared rather than destroyed to keep their capacity.
+  mEncoderStack.clear();
+  mSeenReferences.clear();
+  mSeenReferenceMap.clear();
+  mPendingObservations.clear();
+  mOnSliceEncoded = nullptr;
+}
 
 core::Arena* CallObserver::arena() const { return mSpy->arena(); }
 
@@ -89,9 +117,57 @@ void CallObserver::observePending() {
   if (!mShouldTrace) {
     return;
   }
+  GAPID_TRACE_NAME("CallObserver::observePending");
+
+  // Small observations are concatenated into a single resource, so that they
+  // are hashed and looked up once. Larger ones are sent individually, so that
+  // unchanged data can be shared between commands.
+  size_t batchCount = 0;
+  uint64_t batchSize = 0;
+  for (auto p : mPendingObservations) {
+    uint64_t size = p.end() - p.start();
+    if (size <= MAX_BATCHED_OBSERVATION_SIZE) {
+      batchCount++;
+      batchSize += size;
+    }
+  }
+  bool batch = batchCount > 1;
+  auto& observations = *mBatch;
+  observations.Clear();
+  mBatchData.clear();
+  if (batch) {
+    observations.mutable_gaps()->Reserve(batchCount);
+    observations.mutable_sizes()->Reserve(batchCount);
+    mBatchData.reserve(batchSize);
+  }
+
+  uintptr_t batchEnd = 0;
   for (auto p : mPendingObservations) {
     uint8_t* data = reinterpret_cast<uint8_t*>(p.start());
     uint64_t size = p.end() - p.start();
+    if (batch && size <= MAX_BATCHED_OBSERVATION_SIZE) {
+      observations.add_gaps(p.start() - batchEnd);
+      observations.add_sizes(size);
+      mBatchData.append(reinterpret_cast<const char*>(data), size);
+      batchEnd = p.end();
+      continue;
+    }
+    if (mSpy->sendResourcePages(mApi, data, size, &mPages)) {
+      // Large ranges observed repeatedly are sent as a resource per page.
+      // Only the pages that changed since the last observation are new.
+      memory::Observations paged;
+      paged.mutable_gaps()->Resize(mPages.size(), 0);
+      paged.mutable_sizes()->Resize(mPages.size(), ContentCache::kPageSize);
+      paged.set_gaps(0, p.start());
+      paged.set_sizes(mPages.size() - 1,
+                      size - (mPages.size() - 1) * ContentCache::kPageSize);
+      paged.mutable_res_indices()->Reserve(mPages.size());
+      for (auto index : mPages) {
+        paged.add_res_indices(index);
+      }
+      encode(&paged);
+      continue;
+    }
     auto resIndex = mSpy->sendResource(mApi, data, size);
     auto observation = new memory::Observation();
     observation->set_base(p.start());
@@ -99,14 +175,33 @@ void CallObserver::observePending() {
     observation->set_res_index(resIndex);
     encodeAndDelete(observation);
   }
+
+  if (batch) {
+    observations.set_res_index(
+        mSpy->sendResource(mApi, mBatchData.data(), mBatchData.size()));
+    encode(&observations);
+    if (mBatchData.capacity() > MAX_RETAINED_BATCH_SIZE) {
+      std::string().swap(mBatchData);
+    }
+  }
   mPendingObservations.clear();
 }
 
+void CallObserver::setThreadLocal() {
+  if (mParent != nullptr) {
+    return;
+  }
+  mThreadLocal = true;
+  if (mShouldTrace) {
+    mEncoderStack.back() = encoder()->block();
+  }
+}
+
 void CallObserver::enter(const ::google::protobuf::Message* cmd) {
   if (!mShouldTrace) {
     return;
   }
-  mEncoderStack.push(encoder()->group(cmd));
+  mEncoderStack.push_back(encoder()->group(cmd));
 }
 
 void CallObserver::encode(const ::google::protobuf::Message* cmd) {
@@ -118,9 +213,23 @@ void CallObserver::encode(const ::google::protobuf::Message* cmd) {
 
 void CallObserver::exit() {
   if (!mShouldTrace) {
+    runDeferred(0);
     return;
   }
-  mEncoderStack.pop();
+  runDeferred(mEncoderStack.size());
+  mEncoderStack.pop_back();
+}
+
+void CallObserver::defer(const std::function<void()>& f) {
+  mDeferred.push_back(std::make_pair(mEncoderStack.size(), f));
+}
+
+void CallObserver::runDeferred(size_t depth) {
+  while (!mDeferred.empty() && mDeferred.back().first >= depth) {
+    auto f = mDeferred.back().second;
+    mDeferred.pop_back();
+    f();
+  }
 }
 
 void CallObserver::encodeAndDelete(::google::protobuf::Message* cmd) {
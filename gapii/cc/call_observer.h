@@ -28,9 +28,17 @@
 #include "core/cc/vector.h"
 #include "core/memory/arena/cc/arena.h"
 
-#include <stack>
+#include <functional>
+#include <memory>
+#include <string>
 #include <type_traits>
 #include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace memory {
+class Observations;
+}  // namespace memory
 
 namespace gapii {
 
@@ -39,8 +47,10 @@ typedef uint32_t GLenum_Error;
 class SpyBase;
 
 // CallObserver collects observation data in API function calls. It is supposed
-// to be created at the beginning of each intercepted API function call and
-// deleted at the end.
+// to be created or reset at the beginning of each intercepted API function
+// call and released at the end. A released observer keeps the capacity of its
+// containers, so that reusing it for the next call on the same thread does not
+// allocate.
 class CallObserver : public context_t {
  public:
   template <class T>
@@ -53,8 +63,26 @@ class CallObserver : public context_t {
 
   ~CallObserver();
 
+  // reset prepares a released observer for a new intercepted call, as if it
+  // was constructed with the given arguments.
+  void reset(SpyBase* spy_p, CallObserver* parent, uint8_t api);
+
+  // release ends the intercepted call, calling the remaining deferred
+  // functions and dropping the encoders. It is called by the destructor.
+  void release();
+
   inline CallObserver* getParent() { return mParent; }
 
+  // setThreadLocal marks the observed command as only touching state owned
+  // by the calling thread. The command is encoded to a PackEncoder block
+  // instead of directly to the stream, and the spy releases its lock for the
+  // duration of the driver call. It must be called before the command is
+  // entered, and has no effect on nested observers.
+  void setThreadLocal();
+
+  // isThreadLocal returns true if setThreadLocal() marked this observer.
+  inline bool isThreadLocal() const { return mThreadLocal; }
+
   // setCurrentCommandName sets the name of the current command that is being
   // observed by this observer. The storage of cmd_name must remain valid for
   // the lifetime of this observer object, ideally it should be static
@@ -75,10 +103,7 @@ class CallObserver : public context_t {
   // Returns the unique reference identifier for the given object address,
   // and true when the address is seen for the first time.
   // Nullptr address is always mapped to identifier 0.
-  inline std::pair<uint64_t, bool> reference_id(const void* address) {
-    auto it = mSeenReferences.emplace(address, mSeenReferences.size());
-    return std::pair<uint64_t, bool>(it.first->second, it.second);
-  }
+  inline std::pair<uint64_t, bool> reference_id(const void* address);
 
   // on_slice_encoded sets the callback to be invoked when slice_encoded is
   // called.
@@ -174,6 +199,11 @@ class CallObserver : public context_t {
   // exit returns encoding to the group bound before calling enter().
   void exit();
 
+  // defer registers f to be called immediately before the current group is
+  // closed by exit(). This allows work started during the command to run
+  // concurrently with the driver call and still be encoded into the command.
+  void defer(const std::function<void()>& f);
+
   // observePending observes and encodes all the pending memory observations.
   // The list of pending memory observations is cleared on returning.
   void observePending();
@@ -196,11 +226,29 @@ class CallObserver : public context_t {
   // A pointer to the parent CallObserver.
   CallObserver* mParent;
 
+  // runDeferred calls and removes all the deferred functions registered at
+  // the given encoder stack depth or deeper.
+  void runDeferred(size_t depth);
+
   // The encoder stack.
-  std::stack<PackEncoder::SPtr> mEncoderStack;
+  std::vector<PackEncoder::SPtr> mEncoderStack;
+
+  // The functions registered with defer() and the encoder stack depth at
+  // which they were registered.
+  std::vector<std::pair<size_t, std::function<void()> > > mDeferred;
+
+  // The maximum number of references looked up in mSeenReferences before
+  // they are moved to mSeenReferenceMap.
+  static const size_t kMaxSeenReferences = 16;
+
+  // The non-null object pointers seen, the identifier of each being its index
+  // plus one. Most commands encode a few references, which are found faster
+  // by a linear search than by hashing.
+  std::vector<const void*> mSeenReferences;
 
-  // A map of object pointer to encoded reference identifier.
-  std::unordered_map<const void*, uint64_t> mSeenReferences;
+  // A map of object pointer to encoded reference identifier, used once more
+  // than kMaxSeenReferences references are seen.
+  std::unordered_map<const void*, uint64_t> mSeenReferenceMap;
 
   // A pointer to the static array that contains the current command name.
   const char* mCurrentCommandName;
@@ -211,6 +259,11 @@ class CallObserver : public context_t {
   // The list of pending reads or writes observations that are yet to be made.
   core::IntervalList<uintptr_t> mPendingObservations;
 
+  // Scratch buffers of observePending(), kept between calls.
+  std::unique_ptr<memory::Observations> mBatch;
+  std::vector<int64_t> mPages;
+  std::string mBatchData;
+
   // Record GL error which was raised during this call.
   GLenum_Error mError;
 
@@ -220,6 +273,9 @@ class CallObserver : public context_t {
   // Whether or not we should be tracing with this call observer
   bool mShouldTrace;
 
+  // True if the observed command only touches thread-local state.
+  bool mThreadLocal;
+
   // The current thread id.
   uint64_t mCurrentThread;
 
@@ -289,14 +345,39 @@ inline gapil::Slice<T> CallObserver::make(uint64_t count) {
   return gapil::Slice<T>::create(this, count);
 }
 
-inline PackEncoder::SPtr CallObserver::encoder() { return mEncoderStack.top(); }
+inline std::pair<uint64_t, bool> CallObserver::reference_id(
+    const void* address) {
+  if (address == nullptr) {
+    return std::pair<uint64_t, bool>(0, false);
+  }
+  if (mSeenReferenceMap.empty()) {
+    for (size_t i = 0; i < mSeenReferences.size(); i++) {
+      if (mSeenReferences[i] == address) {
+        return std::pair<uint64_t, bool>(i + 1, false);
+      }
+    }
+    if (mSeenReferences.size() < kMaxSeenReferences) {
+      mSeenReferences.push_back(address);
+      return std::pair<uint64_t, bool>(mSeenReferences.size(), true);
+    }
+    for (size_t i = 0; i < mSeenReferences.size(); i++) {
+      mSeenReferenceMap.emplace(mSeenReferences[i], i + 1);
+    }
+  }
+  auto it = mSeenReferenceMap.emplace(address, mSeenReferenceMap.size() + 1);
+  return std::pair<uint64_t, bool>(it.first->second, it.second);
+}
+
+inline PackEncoder::SPtr CallObserver::encoder() {
+  return mEncoderStack.back();
+}
 
 template <typename T, typename /* = enable_if_encodable<T> */>
 inline void CallObserver::enter(const T& obj) {
   auto group = reinterpret_cast<PackEncoder*>(obj.encode(this, true));
   GAPID_ASSERT_MSG(group != nullptr,
                    "encode() for group did not return sub-encoder");
-  mEncoderStack.push(PackEncoder::SPtr(group));
+  mEncoderStack.push_back(PackEncoder::SPtr(group));
 }
 
 template <typename T, typename /* = enable_if_encodable<T> */>
@@ -0,0 +1,357 @@
+/*
+ * Copyright (C) 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "call_observer.h"
+#include "pack_encoder.h"
+#include "spy_base.h"
+
+#include "core/cc/string_writer.h"
+
+#include "gapis/capture/capture.pb.h"
+#include "gapis/memory/memory_pb/memory.pb.h"
+
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <atomic>
+#include <memory>
+#include <new>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// The number of allocations made by the test binary, so that tests can measure
+// the allocations made by the code they run.
+static std::atomic<size_t> gAllocations(0);
+
+void* operator new(size_t size) {
+  gAllocations++;
+  if (void* p = malloc(size > 0 ? size : 1)) {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { free(p); }
+
+namespace gapii {
+namespace test {
+namespace {
+
+// Collector is a StringWriter that appends all written chunks.
+class Collector : public core::StringWriter {
+ public:
+  virtual bool write(std::string& data) override {
+    mData.append(data);
+    return true;
+  }
+  virtual void flush() override {}
+  std::string mData;
+};
+
+// TestSpy is a SpyBase that encodes to a Collector.
+class TestSpy : public SpyBase {
+ public:
+  TestSpy() : mCollector(new Collector()) {
+    mEncoder = PackEncoder::create(mCollector);
+    init(nullptr);
+  }
+  std::shared_ptr<Collector> mCollector;
+};
+
+uint64_t readVarint(const std::string& s, size_t* offset) {
+  uint64_t value = 0;
+  for (int shift = 0;; shift += 7) {
+    uint8_t b = static_cast<uint8_t>(s[(*offset)++]);
+    value |= static_cast<uint64_t>(b & 0x7f) << shift;
+    if ((b & 0x80) == 0) {
+      return value;
+    }
+  }
+}
+
+int64_t readZigzag(const std::string& s, size_t* offset) {
+  uint64_t n = readVarint(s, offset);
+  return static_cast<int64_t>(n >> 1) ^ -static_cast<int64_t>(n & 1);
+}
+
+// Stream holds the objects decoded from a pack stream of root objects.
+struct Stream {
+  std::vector<memory::Observation> observations;
+  std::vector<memory::Observations> batches;
+  std::unordered_map<int64_t, std::string> resources;
+};
+
+void decode(const std::string& data, Stream* stream) {
+  std::vector<std::string> types = {""};
+  size_t offset = 0;
+  while (offset < data.size()) {
+    int64_t size = readZigzag(data, &offset);
+    if (size < 0) {
+      size_t end = offset - size;
+      uint64_t length = readVarint(data, &offset);
+      types.push_back(data.substr(offset, length));
+      offset = end;
+      continue;
+    }
+    size_t end = offset + size;
+    ASSERT_EQ(0, readZigzag(data, &offset));  // Parent
+    int64_t type = readZigzag(data, &offset);
+    std::string payload = data.substr(offset, end - offset);
+    offset = end;
+    ASSERT_LT(type, static_cast<int64_t>(types.size()));
+    if (types[type] == "capture.Resource") {
+      capture::Resource resource;
+      ASSERT_TRUE(resource.ParseFromString(payload));
+      stream->resources[resource.index()] = resource.data();
+    } else if (types[type] == "memory.Observation") {
+      stream->observations.emplace_back();
+      ASSERT_TRUE(stream->observations.back().ParseFromString(payload));
+    } else if (types[type] == "memory.Observations") {
+      stream->batches.emplace_back();
+      ASSERT_TRUE(stream->batches.back().ParseFromString(payload));
+    }
+  }
+}
+
+// drawCall observes reads of count ranges of size bytes, stride bytes apart,
+// as made by a draw call reading vertex attributes and uniforms.
+void drawCall(SpyBase* spy, const uint8_t* memory, int count, uint64_t size,
+              uint64_t stride, bool batched) {
+  CallObserver observer(spy, nullptr, 0);
+  for (int i = 0; i < count; i++) {
+    observer.read(memory + i * stride, size);
+    if (!batched) {
+      // Observing each range on its own takes the unbatched path.
+      observer.observePending();
+    }
+  }
+  observer.observePending();
+}
+
+// command observes the reads made by a command with a few references encoded
+// in it, as intercepted by the spy.
+void command(CallObserver* observer, const uint8_t* memory) {
+  for (int i = 0; i < 4; i++) {
+    observer->reference_id(memory + i * 8);
+  }
+  observer->read(memory, 16);
+  observer->read(memory + 1024, 16);
+  observer->observePending();
+}
+
+}  // anonymous namespace
+
+TEST(CallObserverTest, ReferenceIds) {
+  std::vector<uint8_t> memory(64);
+  TestSpy spy;
+  CallObserver observer(&spy, nullptr, 0);
+  for (int pass = 0; pass < 2; pass++) {
+    EXPECT_EQ(std::make_pair(uint64_t(0), false),
+              observer.reference_id(nullptr));
+    // More references than are looked up linearly.
+    for (size_t i = 0; i < memory.size(); i++) {
+      EXPECT_EQ(std::make_pair(uint64_t(i + 1), true),
+                observer.reference_id(&memory[i]));
+    }
+    for (size_t i = 0; i < memory.size(); i++) {
+      EXPECT_EQ(std::make_pair(uint64_t(i + 1), false),
+                observer.reference_id(&memory[i]));
+    }
+    // A reset observer has seen no references.
+    observer.release();
+    observer.reset(&spy, nullptr, 0);
+  }
+}
+
+TEST(CallObserverTest, BatchesSmallObservations) {
+  std::vector<uint8_t> memory(1024 * 1024);
+  for (size_t i = 0; i < memory.size(); i++) {
+    memory[i] = static_cast<uint8_t>(i * 7);
+  }
+  TestSpy spy;
+  {
+    CallObserver observer(&spy, nullptr, 0);
+    observer.read(&memory[1000], 16);
+    observer.read(&memory[2000], 100);
+    observer.read(&memory[100000], 64 * 1024);  // Too large to batch.
+    observer.read(&memory[5000], 4096);
+    observer.observePending();
+  }
+
+  Stream stream;
+  decode(spy.mCollector->mData, &stream);
+  ASSERT_EQ(1, stream.observations.size());
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(&memory[100000]),
+            stream.observations[0].base());
+  EXPECT_EQ(64 * 1024, stream.observations[0].size());
+
+  ASSERT_EQ(1, stream.batches.size());
+  const auto& batch = stream.batches[0];
+  ASSERT_EQ(3, batch.gaps_size());
+  ASSERT_EQ(3, batch.sizes_size());
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(&memory[1000]), batch.gaps(0));
+  EXPECT_EQ(16, batch.sizes(0));
+  EXPECT_EQ(2000 - 1016, batch.gaps(1));
+  EXPECT_EQ(100, batch.sizes(1));
+  EXPECT_EQ(5000 - 2100, batch.gaps(2));
+  EXPECT_EQ(4096, batch.sizes(2));
+
+  std::string expected;
+  expected.append(reinterpret_cast<char*>(&memory[1000]), 16);
+  expected.append(reinterpret_cast<char*>(&memory[2000]), 100);
+  expected.append(reinterpret_cast<char*>(&memory[5000]), 4096);
+  EXPECT_EQ(expected, stream.resources[batch.res_index()]);
+}
+
+TEST(CallObserverTest, SingleSmallObservationIsNotBatched) {
+  std::vector<uint8_t> memory(1024);
+  TestSpy spy;
+  {
+    CallObserver observer(&spy, nullptr, 0);
+    observer.read(&memory[10], 16);
+    observer.observePending();
+  }
+
+  Stream stream;
+  decode(spy.mCollector->mData, &stream);
+  EXPECT_EQ(1, stream.observations.size());
+  EXPECT_EQ(0, stream.batches.size());
+}
+
+TEST(CallObserverTest, PagesRepeatedLargeObservations) {
+  const size_t kPage = ContentCache::kPageSize;
+  const size_t kSize = 16 * kPage + 10;
+  std::vector<uint8_t> memory(kSize);
+  for (size_t i = 0; i < memory.size(); i++) {
+    memory[i] = static_cast<uint8_t>(i * 7 + i / kPage);
+  }
+  TestSpy spy;
+  std::vector<size_t> resourceCounts;
+  for (int i = 0; i < 3; i++) {
+    if (i == 2) {
+      memory[5 * kPage + 1]++;
+    }
+    CallObserver observer(&spy, nullptr, 0);
+    observer.read(memory.data(), kSize);
+    observer.observePending();
+    Stream stream;
+    decode(spy.mCollector->mData, &stream);
+    resourceCounts.push_back(stream.resources.size());
+  }
+
+  Stream stream;
+  decode(spy.mCollector->mData, &stream);
+  // The first observation of the range is sent as a single resource.
+  ASSERT_EQ(1, stream.observations.size());
+  EXPECT_EQ(kSize, stream.observations[0].size());
+  // The second and third are sent as a resource per page. Only the changed
+  // page is sent again.
+  ASSERT_EQ(2, stream.batches.size());
+  EXPECT_EQ(resourceCounts[1] + 1, resourceCounts[2]);
+  for (int i = 0; i < 2; i++) {
+    const auto& batch = stream.batches[i];
+    ASSERT_EQ(17, batch.res_indices_size());
+    ASSERT_EQ(17, batch.gaps_size());
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(memory.data()), batch.gaps(0));
+    std::string data;
+    for (int page = 0; page < 17; page++) {
+      EXPECT_EQ(page > 0 ? 0 : batch.gaps(0), batch.gaps(page));
+      EXPECT_EQ(page < 16 ? kPage : 10, batch.sizes(page));
+      data.append(stream.resources[batch.res_indices(page)]);
+      if (i == 1 && page != 5) {
+        EXPECT_EQ(stream.batches[0].res_indices(page),
+                  batch.res_indices(page));
+      }
+    }
+    if (i == 1) {
+      EXPECT_EQ(std::string(memory.begin(), memory.end()), data);
+    }
+  }
+  EXPECT_NE(stream.batches[0].res_indices(5), stream.batches[1].res_indices(5));
+}
+
+// DrawCalls observes the reads of repeated draw calls with many small ranges,
+// with and without batching. Unchanged ranges are not sent again, and a
+// batch is encoded smaller than the observations of its ranges.
+TEST(CallObserverTest, DrawCalls) {
+  const int kDrawCalls = 10;
+  const int kRanges = 32;
+  const uint64_t kSize = 48;
+  const uint64_t kStride = 1024;
+  std::vector<uint8_t> memory(kRanges * kStride);
+  for (size_t i = 0; i < memory.size(); i++) {
+    memory[i] = static_cast<uint8_t>(i * 7 + i / kStride);
+  }
+  std::vector<Stream> streams(2);
+  std::vector<size_t> bytes(2);
+  for (int batched = 0; batched < 2; batched++) {
+    TestSpy spy;
+    for (int i = 0; i < kDrawCalls; i++) {
+      drawCall(&spy, memory.data(), kRanges, kSize, kStride, batched != 0);
+    }
+    decode(spy.mCollector->mData, &streams[batched]);
+    bytes[batched] = spy.mCollector->mData.size();
+  }
+  EXPECT_EQ(kDrawCalls * kRanges, streams[0].observations.size());
+  EXPECT_EQ(0, streams[0].batches.size());
+  EXPECT_EQ(kRanges, streams[0].resources.size());
+  EXPECT_EQ(0, streams[1].observations.size());
+  EXPECT_EQ(kDrawCalls, streams[1].batches.size());
+  EXPECT_EQ(1, streams[1].resources.size());
+  EXPECT_LT(bytes[1] * 2, bytes[0]);
+
+  // A batch with a changed range is sent again as a whole.
+  TestSpy spy;
+  for (int i = 0; i < kDrawCalls; i++) {
+    memcpy(&memory[kStride], &i, sizeof(i));
+    drawCall(&spy, memory.data(), kRanges, kSize, kStride, true);
+  }
+  Stream stream;
+  decode(spy.mCollector->mData, &stream);
+  EXPECT_EQ(kDrawCalls, stream.resources.size());
+}
+
+// CommandAllocations checks that resetting the same observer for each command,
+// as the spy does, makes far fewer allocations than creating a new observer.
+TEST(CallObserverTest, CommandAllocations) {
+  const int kCommands = 1000;
+  std::vector<uint8_t> memory(2048);
+  auto allocations = [&](bool reuse) {
+    TestSpy spy;
+    CallObserver reused(&spy, nullptr, 0);
+    command(&reused, memory.data());
+    reused.release();
+    size_t before = gAllocations;
+    for (int i = 0; i < kCommands; i++) {
+      if (reuse) {
+        reused.reset(&spy, nullptr, 0);
+        command(&reused, memory.data());
+        reused.release();
+      } else {
+        CallObserver observer(&spy, nullptr, 0);
+        command(&observer, memory.data());
+      }
+    }
+    return gAllocations - before;
+  };
+  // The observer's containers keep their capacity when it is reset.
+  EXPECT_LT(allocations(true) * 4, allocations(false));
+}
+
+}  // namespace test
+}  // namespace gapii
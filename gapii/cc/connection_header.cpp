@@ -29,7 +29,9 @@ ConnectionHeader::ConnectionHeader()
       mNumFrames(0),
       mAPIs(0xFFFFFFFF),
       mFlags(0),
-      mGvrHandle(0) {}
+      mGvrHandle(0),
+      mFlightRecorderFrames(0),
+      mFlightRecorderBufferSize(0) {}
 
 bool ConnectionHeader::read(core::StreamReader* reader) {
   if (!reader->read(mMagic)) {
@@ -49,7 +51,7 @@ bool ConnectionHeader::read(core::StreamReader* reader) {
   }
 
   const int kMinSupportedVersion = 1;
-  const int kMaxSupportedVersion = 1;
+  const int kMaxSupportedVersion = 2;
 
   if (mVersion < kMinSupportedVersion || mVersion > kMaxSupportedVersion) {
     GAPID_WARNING(
@@ -65,6 +67,13 @@ bool ConnectionHeader::read(core::StreamReader* reader) {
     return false;
   }
 
+  if (mVersion >= 2) {
+    if (!reader->read(mFlightRecorderFrames) ||
+        !reader->read(mFlightRecorderBufferSize)) {
+      return false;
+    }
+  }
+
   // Insert new version handling here. Don't forget to bump
   // kMaxSupportedVersion!
   return true;
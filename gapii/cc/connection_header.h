@@ -48,13 +48,24 @@ class ConnectionHeader {
   static const uint32_t FLAG_NO_BUFFER = 0x00000020;
   // Hides unknown extensions from applications
   static const uint32_t FLAG_HIDE_UNKNOWN_EXTENSIONS = 0x00000040;
+  // Downsamples framebuffer observations on a background thread
+  static const uint32_t FLAG_ASYNC_FRAMEBUFFER_OBSERVATIONS = 0x00000080;
+  // Compresses the capture stream on a background thread, unless
+  // FLAG_NO_BUFFER is set
+  static const uint32_t FLAG_COMPRESS_STREAM = 0x00000100;
+  // Encodes commands that only touch thread-local state without holding the
+  // stream lock, and releases the spy lock for their driver calls
+  static const uint32_t FLAG_PER_THREAD_CAPTURE = 0x00000200;
+  // Offers a shared memory ring to stream the capture through, answered by
+  // the receiver after the header
+  static const uint32_t FLAG_SHARED_MEMORY_STREAM = 0x00000400;
 
   // read reads the ConnectionHeader from the provided stream, returning true
   // on success or false on error.
   bool read(core::StreamReader* reader);
 
   uint8_t mMagic[4];                // 's', 'p', 'y', '0'
-  uint32_t mVersion;                // 1
+  uint32_t mVersion;                // 2
   uint32_t mObserveFrameFrequency;  // non-zero == enabled.
   uint32_t mObserveDrawFrequency;   // non-zero == enabled.
   uint32_t mStartFrame;             // non-zero == Frame to start at.
@@ -63,6 +74,9 @@ class ConnectionHeader {
   uint32_t mFlags;                  // Combination of FLAG_XX bits.
   uint64_t mGvrHandle;              // Handle of GVR library.
   char mLibInterceptorPath[MAX_PATH];  // Path of libinterceptor.so.
+  // Version 2:
+  uint32_t mFlightRecorderFrames;      // non-zero == Frames to retain.
+  uint64_t mFlightRecorderBufferSize;  // Retained bytes limit, 0 == default.
 };
 
 }  // namespace gapii
@@ -15,6 +15,7 @@
  */
 
 #include "connection_stream.h"
+#include "shared_memory_ring.h"
 
 #include "core/cc/log.h"
 #include "core/cc/socket_connection.h"
@@ -39,14 +40,44 @@ std::shared_ptr<ConnectionStream> ConnectionStream::listenPipe(
 ConnectionStream::ConnectionStream(std::unique_ptr<core::Connection> connection)
     : mConnection(std::move(connection)) {}
 
+ConnectionStream::~ConnectionStream() {}
+
+bool ConnectionStream::offerSharedMemory(uint64_t capacity) {
+  // The offer is the process id and the file descriptor of the ring, -1 if
+  // there is none, which the receiver answers with 1 if it opened the ring.
+  auto ring = SharedMemoryRing::create(capacity);
+  struct {
+    uint32_t pid;
+    int32_t fd;
+  } offer = {ring ? ring->writerPid() : 0, ring ? ring->fd() : -1};
+  if (!mConnection->send(offer) || !ring) {
+    return false;
+  }
+  uint32_t accepted = 0;
+  if (mConnection->recv(&accepted, sizeof(accepted)) != sizeof(accepted) ||
+      accepted != 1) {
+    return false;
+  }
+  mRing = std::move(ring);
+  return true;
+}
+
 uint64_t ConnectionStream::read(void* data, uint64_t max_size) {
   return mConnection->recv(data, max_size);
 }
 
 uint64_t ConnectionStream::write(const void* data, uint64_t size) {
+  if (mRing) {
+    return mRing->write(data, size);
+  }
   return mConnection->send(data, size);
 }
 
-void ConnectionStream::close() { mConnection->close(); }
+void ConnectionStream::close() {
+  if (mRing) {
+    mRing->close();
+  }
+  mConnection->close();
+}
 
 }  // namespace gapii
@@ -30,6 +30,8 @@ class Connection;
 
 namespace gapii {
 
+class SharedMemoryRing;
+
 // ConnectionStream is an implementation of the StreamReader and StreamWriter
 // interfaces that reads and writes to an incoming TCP connection.
 class ConnectionStream : public core::StreamWriter, public core::StreamReader {
@@ -46,6 +48,15 @@ class ConnectionStream : public core::StreamWriter, public core::StreamReader {
   static std::shared_ptr<ConnectionStream> listenPipe(const char* pipename,
                                                       bool abstract);
 
+  ~ConnectionStream();
+
+  // offerSharedMemory offers the receiver a shared memory ring of the given
+  // capacity to read the written data from, instead of the connection. It
+  // returns true if the receiver accepted, false if it falls back to the
+  // connection. Rings are only offered on Linux: on other platforms the offer
+  // tells the receiver that there is none.
+  bool offerSharedMemory(uint64_t capacity);
+
   // core::StreamReader compliance
   virtual uint64_t read(void* data, uint64_t max_size) override;
 
@@ -59,6 +70,7 @@ class ConnectionStream : public core::StreamWriter, public core::StreamReader {
   ConnectionStream(std::unique_ptr<core::Connection>);
 
   std::unique_ptr<core::Connection> mConnection;
+  std::unique_ptr<SharedMemoryRing> mRing;
 };
 
 }  // namespace gapii
@@ -0,0 +1,120 @@
+/*
+ * Copyright (C) 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "content_cache.h"
+
+#include <string.h>
+
+#include <algorithm>
+
+namespace {
+
+// The maximum number of ranges observed once that are remembered. The set is
+// cleared once it holds this many ranges.
+const size_t kMaxSeen = 4096;
+
+}  // anonymous namespace
+
+namespace gapii {
+
+const size_t ContentCache::kPageSize;
+
+ContentCache::ContentCache(size_t minSize, size_t maxSize)
+    : mMinSize(minSize),
+      mMaxSize(maxSize),
+      mUse(0),
+      mSize(0),
+      mBytesHashed(0) {}
+
+std::vector<ContentCache::Page>* ContentCache::update(const void* data,
+                                                      size_t size) {
+  if (size < mMinSize || size > mMaxSize) {
+    return nullptr;
+  }
+  mUse++;
+  auto src = reinterpret_cast<const char*>(data);
+  Key key(reinterpret_cast<uintptr_t>(data), size);
+
+  auto it = mRanges.find(key);
+  if (it == mRanges.end()) {
+    if (mSeen.erase(key) == 0) {
+      if (mSeen.size() >= kMaxSeen) {
+        mSeen.clear();
+      }
+      mSeen.insert(key);
+      return nullptr;
+    }
+    evict(size);
+    Range& range = mRanges[key];
+    range.data.assign(src, size);
+    range.pages.resize((size + kPageSize - 1) / kPageSize);
+    for (size_t i = 0; i < range.pages.size(); i++) {
+      hash(&range, i);
+    }
+    range.lastUse = mUse;
+    mSize += size;
+    return &range.pages;
+  }
+
+  Range& range = it->second;
+  char* copy = &range.data[0];
+  for (size_t i = 0, offset = 0; offset < size; i++, offset += kPageSize) {
+    size_t length = std::min(kPageSize, size - offset);
+    if (memcmp(copy + offset, src + offset, length) != 0) {
+      memcpy(copy + offset, src + offset, length);
+      hash(&range, i);
+    }
+  }
+  range.lastUse = mUse;
+  return &range.pages;
+}
+
+void ContentCache::resetIndices() {
+  for (auto& it : mRanges) {
+    for (auto& page : it.second.pages) {
+      page.index = -1;
+    }
+  }
+}
+
+void ContentCache::clear() {
+  mRanges.clear();
+  mSeen.clear();
+  mSize = 0;
+}
+
+void ContentCache::hash(Range* range, size_t i) {
+  size_t offset = i * kPageSize;
+  size_t length = std::min(kPageSize, range->data.size() - offset);
+  range->pages[i].id = core::Id::Hash(range->data.data() + offset, length);
+  range->pages[i].index = -1;
+  mBytesHashed += length;
+}
+
+void ContentCache::evict(size_t size) {
+  while (!mRanges.empty() && mSize + size > mMaxSize) {
+    auto oldest = mRanges.begin();
+    for (auto it = mRanges.begin(); it != mRanges.end(); ++it) {
+      if (it->second.lastUse < oldest->second.lastUse) {
+        oldest = it;
+      }
+    }
+    mSize -= oldest->second.data.size();
+    mRanges.erase(oldest);
+  }
+}
+
+}  // namespace gapii
@@ -0,0 +1,113 @@
+/*
+ * Copyright (C) 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GAPII_CONTENT_CACHE_H
+#define GAPII_CONTENT_CACHE_H
+
+#include "core/cc/id.h"
+
+#include <stdint.h>
+
+#include <map>
+#include <set>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace gapii {
+
+// ContentCache remembers the content of large memory ranges that are observed
+// more than once, such as buffers that are re-uploaded every frame, so that
+// only the pages that changed since the last observation of a range need to
+// be hashed again.
+//
+// Ranges are identified by their exact base address and size. The first
+// observation of a range is only noted; the range is cached from its second
+// observation on, so that data observed once is not copied. For each cached
+// range the cache keeps a copy of its content and the identifier and resource
+// index of each of its pages. Changed pages are found by comparing the range
+// with the copy, which is cheaper than hashing it and cannot miss a change.
+//
+// The copies are limited to maxSize bytes in total, by discarding the least
+// recently observed ranges.
+//
+// A ContentCache is not thread-safe.
+class ContentCache {
+ public:
+  // The size of the pages that cached ranges are split into. The last page of
+  // a range may be smaller.
+  static const size_t kPageSize = 4096;
+
+  // Page describes a single page of a cached range.
+  struct Page {
+    core::Id id;    // The hash of the content of the page.
+    int64_t index;  // The index of the page's resource, or -1 if unsent.
+  };
+
+  // minSize is the size in bytes of the smallest range that is cached.
+  // maxSize is the limit in bytes for the content of all cached ranges.
+  ContentCache(size_t minSize, size_t maxSize);
+
+  // update brings the cached content of the range [data, data + size) up to
+  // date with the memory, and returns the pages of the range. The pages whose
+  // content changed since the last update have their id recomputed and their
+  // index reset to -1. Returns nullptr if the range is not cached.
+  // The returned pages are valid until the next call to update() or clear().
+  std::vector<Page>* update(const void* data, size_t size);
+
+  // resetIndices resets the resource index of all cached pages to -1.
+  void resetIndices();
+
+  // clear discards all cached ranges.
+  void clear();
+
+  // size returns the number of bytes of cached content.
+  uint64_t size() const { return mSize; }
+
+  // bytesHashed returns the number of bytes hashed by update() so far.
+  uint64_t bytesHashed() const { return mBytesHashed; }
+
+ private:
+  typedef std::pair<uintptr_t, size_t> Key;
+
+  // Range is a single cached range.
+  struct Range {
+    std::string data;
+    std::vector<Page> pages;
+    uint64_t lastUse;
+  };
+
+  // hash sets the id of the page at index i of range from its cached content.
+  void hash(Range* range, size_t i);
+
+  // evict discards the least recently used ranges until size bytes of
+  // content can be added without exceeding the limit.
+  void evict(size_t size);
+
+  const size_t mMinSize;
+  const size_t mMaxSize;
+
+  std::map<Key, Range> mRanges;
+  std::set<Key> mSeen;  // The ranges observed once.
+
+  uint64_t mUse;  // Incremented by each call to update().
+  uint64_t mSize;
+  uint64_t mBytesHashed;
+};
+
+}  // namespace gapii
+
+#endif  // GAPII_CONTENT_CACHE_H
@@ -0,0 +1,143 @@
+/*
+ * Copyright (C) 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "content_cache.h"
+
+#include <gtest/gtest.h>
+
+#include <algorithm>
+#include <vector>
+
+namespace gapii {
+namespace test {
+namespace {
+
+const size_t kPage = ContentCache::kPageSize;
+
+std::vector<uint8_t> pattern(size_t size) {
+  std::vector<uint8_t> data(size);
+  for (size_t i = 0; i < size; i++) {
+    data[i] = static_cast<uint8_t>(i * 31 + i / kPage);
+  }
+  return data;
+}
+
+}  // anonymous namespace
+
+TEST(ContentCacheTest, CachesFromSecondObservation) {
+  auto data = pattern(4 * kPage + 100);
+  ContentCache cache(kPage, 1024 * 1024);
+  EXPECT_EQ(nullptr, cache.update(data.data(), data.size()));
+  EXPECT_EQ(0, cache.bytesHashed());
+
+  auto pages = cache.update(data.data(), data.size());
+  ASSERT_NE(nullptr, pages);
+  ASSERT_EQ(5, pages->size());
+  EXPECT_EQ(data.size(), cache.bytesHashed());
+  EXPECT_EQ(data.size(), cache.size());
+  for (size_t i = 0; i < pages->size(); i++) {
+    size_t size = std::min(kPage, data.size() - i * kPage);
+    EXPECT_EQ(core::Id::Hash(&data[i * kPage], size), (*pages)[i].id);
+    EXPECT_EQ(-1, (*pages)[i].index);
+  }
+}
+
+TEST(ContentCacheTest, RehashesOnlyChangedPages) {
+  auto data = pattern(4 * kPage);
+  ContentCache cache(kPage, 1024 * 1024);
+  cache.update(data.data(), data.size());
+  auto pages = cache.update(data.data(), data.size());
+  ASSERT_NE(nullptr, pages);
+  for (size_t i = 0; i < pages->size(); i++) {
+    (*pages)[i].index = i;
+  }
+  auto hashed = cache.bytesHashed();
+
+  pages = cache.update(data.data(), data.size());
+  ASSERT_NE(nullptr, pages);
+  EXPECT_EQ(hashed, cache.bytesHashed());
+
+  data[2 * kPage + 17]++;
+  pages = cache.update(data.data(), data.size());
+  ASSERT_NE(nullptr, pages);
+  EXPECT_EQ(hashed + kPage, cache.bytesHashed());
+  EXPECT_EQ(0, (*pages)[0].index);
+  EXPECT_EQ(1, (*pages)[1].index);
+  EXPECT_EQ(-1, (*pages)[2].index);
+  EXPECT_EQ(3, (*pages)[3].index);
+  EXPECT_EQ(core::Id::Hash(&data[2 * kPage], kPage), (*pages)[2].id);
+
+  cache.resetIndices();
+  pages = cache.update(data.data(), data.size());
+  for (const auto& page : *pages) {
+    EXPECT_EQ(-1, page.index);
+  }
+}
+
+TEST(ContentCacheTest, SizeLimits) {
+  auto data = pattern(16 * kPage);
+  const uint8_t* a = &data[0];
+  const uint8_t* b = &data[8 * kPage];
+  const uint8_t* c = &data[12 * kPage];
+  ContentCache cache(2 * kPage, 10 * kPage);
+  for (int i = 0; i < 2; i++) {
+    EXPECT_EQ(nullptr, cache.update(a, kPage));
+    EXPECT_EQ(nullptr, cache.update(a, data.size()));
+  }
+  EXPECT_EQ(0, cache.size());
+
+  for (int i = 0; i < 2; i++) {
+    cache.update(a, 6 * kPage);
+    cache.update(b, 3 * kPage);
+  }
+  EXPECT_EQ(9 * kPage, cache.size());
+
+  // Caching another range evicts the least recently used one.
+  cache.update(a, 6 * kPage);
+  cache.update(c, 4 * kPage);
+  cache.update(c, 4 * kPage);
+  EXPECT_EQ(10 * kPage, cache.size());
+  EXPECT_NE(nullptr, cache.update(a, 6 * kPage));
+  EXPECT_EQ(nullptr, cache.update(b, 3 * kPage));
+
+  cache.clear();
+  EXPECT_EQ(0, cache.size());
+  EXPECT_EQ(nullptr, cache.update(a, 6 * kPage));
+}
+
+TEST(ContentCacheTest, RepeatedUpload) {
+  // A buffer uploaded every frame is only rehashed where it changed.
+  const size_t kPages = 256;
+  auto data = pattern(kPages * kPage);
+  ContentCache cache(kPage, data.size());
+  cache.update(data.data(), data.size());
+  cache.update(data.data(), data.size());
+  for (size_t changedPages : {size_t(0), size_t(1), kPages / 10, kPages}) {
+    for (size_t i = 0; i < changedPages; i++) {
+      data[i * kPages / changedPages * kPage + 5]++;
+    }
+    auto hashed = cache.bytesHashed();
+    auto pages = cache.update(data.data(), data.size());
+    ASSERT_NE(nullptr, pages);
+    EXPECT_EQ(changedPages * kPage, cache.bytesHashed() - hashed);
+    for (size_t i = 0; i < kPages; i++) {
+      EXPECT_EQ(core::Id::Hash(&data[i * kPage], kPage), (*pages)[i].id);
+    }
+  }
+}
+
+}  // namespace test
+}  // namespace gapii
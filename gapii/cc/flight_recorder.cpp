@@ -0,0 +1,297 @@
+/*
+ * Copyright (C) 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flight_recorder.h"
+
+#include "core/cc/stream_writer.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace {
+
+constexpr size_t kBufferSize = 64 * 1024;
+
+// readVarint decodes the varint at [p, end) into out, returning the number
+// of bytes read, or 0 if the varint is incomplete.
+inline size_t readVarint(const char* p, const char* end, uint64_t* out) {
+  uint64_t value = 0;
+  for (size_t i = 0; p + i < end && i < 10; i++) {
+    uint8_t b = static_cast<uint8_t>(p[i]);
+    value |= static_cast<uint64_t>(b & 0x7f) << (7 * i);
+    if ((b & 0x80) == 0) {
+      *out = value;
+      return i + 1;
+    }
+  }
+  return 0;
+}
+
+inline void writeVarint(std::string& buffer, uint64_t value) {
+  for (; value >= 0x80; value >>= 7) {
+    buffer.push_back(static_cast<char>(value | 0x80));
+  }
+  buffer.push_back(static_cast<char>(value));
+}
+
+inline int64_t decodeZigzag(uint64_t n) {
+  return static_cast<int64_t>(n >> 1) ^ -static_cast<int64_t>(n & 1);
+}
+
+inline uint64_t encodeZigzag(int64_t n) {
+  return (static_cast<uint64_t>(n) << 1) ^ static_cast<uint64_t>(n >> 63);
+}
+
+}  // anonymous namespace
+
+namespace gapii {
+
+uint64_t FlightRecorder::Segment::size() const {
+  return data.size() + chunks.size() * sizeof(Chunk);
+}
+
+FlightRecorder::FlightRecorder(uint32_t frames, uint64_t maxSize)
+    : mFrames(frames), mMaxSize(maxSize), mGeneration(0), mNextId(0),
+      mParseOffset(0), mSize(0) {
+  for (Segment* segment : {&mPrefix, &mResources}) {
+    segment->snapshotEnd = 0;
+    segment->frames = 0;
+    segment->generation = 0;
+  }
+}
+
+bool FlightRecorder::write(std::string& data) {
+  current()->data.append(data);
+  mSize += data.size();
+  parse();
+  return true;
+}
+
+bool FlightRecorder::beginSegment() {
+  while (mSegments.size() > 1) {
+    discardOldest();
+  }
+  bool reset = mResources.size() > mMaxSize / 2;
+  if (reset) {
+    mGeneration++;
+  }
+
+  // Carry over any partially written chunk.
+  Segment* previous = current();
+  std::string tail = previous->data.substr(mParseOffset);
+  previous->data.resize(mParseOffset);
+
+  mSegments.emplace_back();
+  Segment& segment = mSegments.back();
+  segment.data = std::move(tail);
+  segment.snapshotEnd = 0;
+  segment.frames = 0;
+  segment.generation = mGeneration;
+  mParseOffset = 0;
+  return reset;
+}
+
+void FlightRecorder::endSnapshot() {
+  if (!mSegments.empty()) {
+    mSegments.back().snapshotEnd = mSegments.back().chunks.size();
+  }
+}
+
+bool FlightRecorder::frame() {
+  if (mSegments.empty()) {
+    return false;
+  }
+  mSegments.back().frames++;
+  while (mSize > mMaxSize && mSegments.size() > 1) {
+    discardOldest();
+  }
+  return mSegments.back().frames >= mFrames || mSize > mMaxSize;
+}
+
+void FlightRecorder::clear() {
+  std::deque<Segment>().swap(mSegments);
+  mPrefix.data.clear();
+  mPrefix.data.shrink_to_fit();
+  std::vector<Chunk>().swap(mPrefix.chunks);
+  std::string().swap(mResources.data);
+  std::vector<Chunk>().swap(mResources.chunks);
+  mParseOffset = 0;
+  mSize = 0;
+}
+
+uint64_t FlightRecorder::size() const { return mSize; }
+
+uint32_t FlightRecorder::frames() const {
+  uint32_t frames = 0;
+  for (const auto& segment : mSegments) {
+    frames += segment.frames;
+  }
+  return frames;
+}
+
+FlightRecorder::Segment* FlightRecorder::current() {
+  return mSegments.empty() ? &mPrefix : &mSegments.back();
+}
+
+void FlightRecorder::parse() {
+  Segment* segment = current();
+  const char* data = segment->data.data();
+  const char* end = data + segment->data.size();
+  while (mParseOffset < segment->data.size()) {
+    const char* p = data + mParseOffset;
+    uint64_t encodedSize;
+    size_t header = readVarint(p, end, &encodedSize);
+    if (header == 0) {
+      return;
+    }
+    int64_t size = decodeZigzag(encodedSize);
+    uint64_t payloadSize = size < 0 ? -size : size;
+    if (static_cast<uint64_t>(end - p) - header < payloadSize) {
+      return;
+    }
+
+    Chunk chunk;
+    chunk.id = mNextId++;
+    chunk.offset = mParseOffset;
+    chunk.parent = 0;
+    chunk.size = static_cast<uint32_t>(header + payloadSize);
+    chunk.header = static_cast<uint8_t>(header);
+    chunk.parentSize = 0;
+    if (size < 0) {
+      chunk.kind = kTypeDef;
+    } else {
+      // Objects start with the zigzag encoded relative parent id and type.
+      // Missing values are implicitly 0.
+      const char* payload = p + header;
+      const char* payloadEnd = payload + payloadSize;
+      uint64_t parent = 0;
+      uint64_t type = 0;
+      size_t parentSize = readVarint(payload, payloadEnd, &parent);
+      readVarint(payload + parentSize, payloadEnd, &type);
+      int64_t relativeParent = decodeZigzag(parent);
+      if (relativeParent != 0) {
+        chunk.kind = kChild;
+        chunk.parent = chunk.id + relativeParent;
+        chunk.parentSize = static_cast<uint8_t>(parentSize);
+      } else {
+        chunk.kind = decodeZigzag(type) < 0 ? kGroup : kObject;
+      }
+    }
+    segment->chunks.push_back(chunk);
+    mSize += sizeof(Chunk);
+    mParseOffset += chunk.size;
+  }
+}
+
+void FlightRecorder::discardOldest() {
+  Segment& oldest = mSegments.front();
+  mSize -= oldest.size();
+  bool keepResources = oldest.generation == mGeneration;
+  for (const auto& chunk : oldest.chunks) {
+    Segment* keep = nullptr;
+    if (chunk.kind == kTypeDef) {
+      keep = &mPrefix;
+    } else if (chunk.kind == kObject && keepResources) {
+      keep = &mResources;  // The objects without a parent are resources.
+    } else {
+      continue;
+    }
+    Chunk moved = chunk;
+    moved.offset = keep->data.size();
+    keep->data.append(oldest.data, chunk.offset, chunk.size);
+    keep->chunks.push_back(moved);
+    mSize += chunk.size + sizeof(Chunk);
+  }
+  mSegments.pop_front();
+
+  // The resources of an older generation are released once no retained
+  // segment refers to them.
+  if (mResources.generation != mGeneration &&
+      mSegments.front().generation == mGeneration) {
+    mSize -= mResources.size();
+    std::string().swap(mResources.data);
+    std::vector<Chunk>().swap(mResources.chunks);
+    mResources.generation = mGeneration;
+  }
+}
+
+bool FlightRecorder::writeTo(core::StreamWriter* out) const {
+  // Old ids of the emitted chunks that may be parents, with their new ids.
+  // Chunks are emitted in increasing id order, so this stays sorted.
+  std::vector<std::pair<uint64_t, uint64_t>> ids;
+  uint64_t nextId = 0;
+
+  std::string buffer;
+  buffer.reserve(kBufferSize + 32);
+  bool ok = true;
+  auto flush = [&] {
+    ok = ok && out->write(buffer.data(), buffer.size()) == buffer.size();
+    buffer.clear();
+  };
+
+  // emit writes the chunks [first, last) of segment. If snapshot is true
+  // then groups are skipped.
+  auto emit = [&](const Segment& segment, size_t first, size_t last,
+                  bool snapshot) {
+    for (size_t i = first; i < last; i++) {
+      const Chunk& chunk = segment.chunks[i];
+      const char* data = segment.data.data() + chunk.offset;
+      uint64_t id = nextId;
+      if (chunk.kind == kGroup && snapshot) {
+        continue;
+      } else if (chunk.kind == kChild) {
+        auto it = std::lower_bound(
+            ids.begin(), ids.end(), std::make_pair(chunk.parent, uint64_t(0)));
+        if (it == ids.end() || it->first != chunk.parent) {
+          continue;  // The parent has been discarded.
+        }
+        // Re-encode the chunk with the renumbered relative parent id.
+        std::string parent;
+        writeVarint(parent, encodeZigzag(static_cast<int64_t>(it->second) -
+                                         static_cast<int64_t>(id)));
+        size_t skip = chunk.header + chunk.parentSize;
+        writeVarint(buffer,
+                    encodeZigzag(parent.size() + chunk.size - skip));
+        buffer.append(parent);
+        buffer.append(data + skip, chunk.size - skip);
+      } else {
+        buffer.append(data, chunk.size);
+      }
+      if (chunk.kind == kChild || chunk.kind == kGroup) {
+        ids.push_back(std::make_pair(chunk.id, id));
+      }
+      nextId++;
+      if (buffer.size() >= kBufferSize) {
+        flush();
+      }
+    }
+  };
+
+  emit(mPrefix, 0, mPrefix.chunks.size(), false);
+  emit(mResources, 0, mResources.chunks.size(), false);
+  for (size_t i = 0; i < mSegments.size(); i++) {
+    const Segment& segment = mSegments[i];
+    // Only the oldest segment's snapshot is the initial state. The state
+    // groups of newer snapshots are dropped, but the type definitions and
+    // resources they introduced are kept.
+    emit(segment, 0, segment.snapshotEnd, i > 0);
+    emit(segment, segment.snapshotEnd, segment.chunks.size(), false);
+  }
+  flush();
+  return ok;
+}
+
+}  // namespace gapii
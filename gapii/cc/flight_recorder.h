@@ -0,0 +1,160 @@
+/*
+ * Copyright (C) 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GAPII_FLIGHT_RECORDER_H
+#define GAPII_FLIGHT_RECORDER_H
+
+#include "core/cc/string_writer.h"
+
+#include <stdint.h>
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace core {
+class StreamWriter;
+}  // namespace core
+
+namespace gapii {
+
+// FlightRecorder is a StringWriter that retains the pack-stream chunks of the
+// most recent frames in memory, instead of sending them to the server.
+//
+// The chunks are partitioned into segments that start at frame boundaries.
+// Each segment starts with a serialized state snapshot (except for the first
+// segment, which starts with the empty state at the beginning of the
+// capture), and a new segment is started once the current one holds the
+// requested number of frames. Only the current and the previous segment are
+// kept, so the retained window always holds at least the requested number of
+// frames once that many frames have been recorded. Older segments are also
+// discarded whenever the retained data grows beyond the size limit.
+//
+// The resources of the discarded segments are kept, so that a snapshot only
+// has to send the resources that changed since they were sent. Once the kept
+// resources take up half of the size limit, beginSegment() starts a new
+// generation: the new segment has to send all its resources again, and the
+// kept resources are released with the last segment that may refer to them.
+//
+// writeTo() rebuilds a valid pack stream from the retained chunks: the chunks
+// written before the first segment and the type definitions and resources of
+// the discarded segments, followed by the oldest retained segment with its
+// state snapshot, followed by the commands of the newer segment. Parent chunk
+// references are renumbered, and chunks whose parent group was discarded are
+// dropped.
+//
+// A FlightRecorder is not thread-safe.
+class FlightRecorder : public core::StringWriter {
+ public:
+  typedef std::shared_ptr<FlightRecorder> SPtr;
+
+  // frames is the number of frames that should at least be retained.
+  // maxSize is the limit in bytes for the retained chunks and their index.
+  FlightRecorder(uint32_t frames, uint64_t maxSize);
+
+  // core::StringWriter compliance
+  virtual bool write(std::string& data) override;
+  virtual void flush() override {}
+
+  // beginSegment starts a new segment at a frame boundary, discarding all but
+  // the previous segment. The chunks written until endSnapshot() is called
+  // are the segment's state snapshot. Returns true if the new segment starts
+  // a new generation, in which case the resources sent before must not be
+  // referred to.
+  bool beginSegment();
+
+  // endSnapshot marks the end of the current segment's state snapshot.
+  void endSnapshot();
+
+  // frame notes the end of a frame in the current segment, and discards old
+  // segments if the size limit has been exceeded. Returns true if a new
+  // segment should be started.
+  bool frame();
+
+  // writeTo writes the retained window as a pack stream, without the pack
+  // header, to out. Returns false if the write failed.
+  bool writeTo(core::StreamWriter* out) const;
+
+  // clear releases all the retained chunks.
+  void clear();
+
+  // size returns the number of bytes currently used by the retained chunks
+  // and their index.
+  uint64_t size() const;
+
+  // frames returns the number of frames currently retained.
+  uint32_t frames() const;
+
+ private:
+  enum Kind : uint8_t {
+    kTypeDef,  // Type definition.
+    kObject,   // Object without a parent.
+    kGroup,    // Group without a parent.
+    kChild,    // Object, group or group end with a parent.
+  };
+
+  // Chunk describes a single chunk in a segment's data.
+  struct Chunk {
+    uint64_t id;         // Index of the chunk in the recorded stream.
+    uint64_t offset;     // Offset of the chunk in the segment data.
+    uint64_t parent;     // Absolute id of the parent chunk, if a kChild.
+    uint32_t size;       // Size of the chunk, including its encoded size.
+    uint8_t header;      // Size of the chunk's encoded size.
+    uint8_t parentSize;  // Size of the chunk's encoded relative parent id.
+    Kind kind;
+  };
+
+  // Segment is a run of chunks starting at a frame boundary.
+  struct Segment {
+    std::string data;
+    std::vector<Chunk> chunks;
+    size_t snapshotEnd;  // Index of the first chunk after the snapshot.
+    uint32_t frames;
+    uint32_t generation;  // The generation of the resources it refers to.
+
+    uint64_t size() const;
+  };
+
+  // parse indexes the complete chunks at the end of the current segment.
+  void parse();
+
+  // discardOldest discards the oldest segment, keeping its type definitions,
+  // and its resources if they are of the current generation.
+  void discardOldest();
+
+  // current returns the segment chunks are being written to.
+  Segment* current();
+
+  const uint32_t mFrames;
+  const uint64_t mMaxSize;
+
+  // The chunks written before the first segment and the type definitions of
+  // the discarded segments.
+  Segment mPrefix;
+  // The resources of the discarded segments of mResources.generation.
+  Segment mResources;
+  std::deque<Segment> mSegments;
+  uint32_t mGeneration;  // The generation of the current segment.
+
+  uint64_t mNextId;       // Id of the next chunk to be indexed.
+  uint64_t mParseOffset;  // Offset of the next chunk in the current data.
+  uint64_t mSize;         // Cached size of mPrefix and mSegments.
+};
+
+}  // namespace gapii
+
+#endif  // GAPII_FLIGHT_RECORDER_H
@@ -0,0 +1,348 @@
+/*
+ * Copyright (C) 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flight_recorder.h"
+#include "pack_encoder.h"
+
+#include "core/cc/stream_writer.h"
+
+#include <gtest/gtest.h>
+#include <string.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace gapii {
+namespace test {
+namespace {
+
+// The type descriptors. The encoder identifies types by their address.
+const char kHeaderType[] = "header";
+const char kCommandType[] = "command";
+const char kChildType[] = "child";
+const char kStateType[] = "state";
+const char kResourceType[] = "resource";
+const char kLateType[] = "late";
+
+class StringStreamWriter : public core::StreamWriter {
+ public:
+  virtual uint64_t write(const void* data, uint64_t size) override {
+    mData.append(static_cast<const char*>(data), size);
+    return size;
+  }
+  std::string mData;
+};
+
+// Collector is a StringWriter that appends all written chunks.
+class Collector : public core::StringWriter {
+ public:
+  virtual bool write(std::string& data) override {
+    mData.append(data);
+    return true;
+  }
+  virtual void flush() override {}
+  std::string mData;
+};
+
+// Recording drives a PackEncoder the way the spy does: a header, followed by
+// frames of commands with child objects. When a FlightRecorder is used, a
+// snapshot group with a resource starts each new segment.
+class Recording {
+ public:
+  Recording(const std::shared_ptr<core::StringWriter>& writer,
+            FlightRecorder* recorder)
+      : mEncoder(PackEncoder::create(writer)), mRecorder(recorder) {
+    object(kHeaderType, "header");
+    if (mRecorder != nullptr) {
+      mRecorder->beginSegment();
+      mRecorder->endSnapshot();
+    }
+  }
+
+  // frame records a frame of count commands.
+  void frame(uint32_t count) {
+    std::string marker = "f" + std::to_string(mFrame);
+    for (uint32_t i = 0; i < count; i++) {
+      std::unique_ptr<PackEncoder> cmd(group(mEncoder.get(), kCommandType,
+                                             marker));
+      object(cmd.get(), kChildType, "read");
+      object(cmd.get(), kChildType, "write");
+    }
+    mFrame++;
+    if (mRecorder != nullptr && mRecorder->frame()) {
+      if (mRecorder->beginSegment()) {
+        mGenerations.push_back(mFrame);
+      }
+      object(kResourceType, "r" + std::to_string(mFrame));
+      std::unique_ptr<PackEncoder> state(
+          group(mEncoder.get(), kStateType, "s" + std::to_string(mFrame)));
+      object(state.get(), kChildType, "memory");
+      state.reset();
+      mRecorder->endSnapshot();
+    }
+  }
+
+  PackEncoder* group(PackEncoder* parent, const char* type,
+                     const std::string& data) {
+    auto id = mEncoder->type(type, strlen(type), type).first;
+    return parent->group(id, data.size(), data.data());
+  }
+
+  void object(PackEncoder* parent, const char* type,
+              const std::string& data) {
+    auto id = mEncoder->type(type, strlen(type), type).first;
+    parent->object(id, data.size(), data.data());
+  }
+
+  void object(const char* type, const std::string& data) {
+    object(mEncoder.get(), type, data);
+  }
+
+  PackEncoder::SPtr mEncoder;
+  FlightRecorder* mRecorder;
+  uint32_t mFrame = 0;
+  std::vector<uint32_t> mGenerations;  // The frames starting a generation.
+};
+
+uint64_t readVarint(const std::string& s, size_t* offset) {
+  uint64_t value = 0;
+  for (int shift = 0;; shift += 7) {
+    uint8_t b = static_cast<uint8_t>(s[(*offset)++]);
+    value |= static_cast<uint64_t>(b & 0x7f) << shift;
+    if ((b & 0x80) == 0) {
+      return value;
+    }
+  }
+}
+
+int64_t readZigzag(const std::string& s, size_t* offset, size_t end) {
+  if (*offset >= end) {
+    return 0;
+  }
+  uint64_t n = readVarint(s, offset);
+  return static_cast<int64_t>(n >> 1) ^ -static_cast<int64_t>(n & 1);
+}
+
+// Summary is the result of decoding a pack stream.
+struct Summary {
+  std::vector<std::string> types;
+  std::vector<uint32_t> frames;  // The frame of each command.
+  std::vector<std::string> states;
+  std::vector<std::string> resources;
+  size_t headers = 0;
+};
+
+// decode decodes the chunks in data and checks that all types and parents
+// are valid.
+void decode(const std::string& data, Summary* summary) {
+  std::vector<std::string> types = {""};
+  std::set<uint64_t> open;
+  size_t offset = 0;
+  for (uint64_t id = 0; offset < data.size(); id++) {
+    int64_t size = readZigzag(data, &offset, data.size());
+    if (size < 0) {
+      size_t end = offset - size;
+      uint64_t length = readVarint(data, &offset);
+      types.push_back(data.substr(offset, length));
+      summary->types.push_back(types.back());
+      offset = end;
+      continue;
+    }
+    size_t end = offset + size;
+    int64_t parent = readZigzag(data, &offset, end);
+    int64_t type = readZigzag(data, &offset, end);
+    std::string payload = data.substr(offset, end - offset);
+    offset = end;
+
+    ASSERT_LT(std::abs(type), static_cast<int64_t>(types.size()))
+        << "Unknown type at chunk " << id;
+    if (parent != 0) {
+      ASSERT_LT(parent, 0);
+      ASSERT_EQ(1, open.count(id + parent))
+          << "Chunk " << id << " references parent " << id + parent
+          << " which is not an open group";
+    }
+    if (type == 0) {
+      open.erase(id + parent);  // Group end.
+      continue;
+    }
+    if (type < 0) {
+      open.insert(id);
+    }
+    const std::string& name = types[std::abs(type)];
+    if (name == kHeaderType) {
+      summary->headers++;
+    } else if (name == kCommandType) {
+      summary->frames.push_back(std::stoi(payload.substr(1)));
+    } else if (name == kStateType) {
+      summary->states.push_back(payload);
+    } else if (name == kResourceType) {
+      summary->resources.push_back(payload);
+    }
+  }
+}
+
+// window returns the decoded window retained by the recorder.
+void window(const FlightRecorder& recorder, Summary* summary) {
+  StringStreamWriter out;
+  ASSERT_TRUE(recorder.writeTo(&out));
+  decode(out.mData, summary);
+}
+
+}  // anonymous namespace
+
+TEST(FlightRecorderTest, KeepsEverythingBeforeFirstSegmentIsFull) {
+  auto collector = std::make_shared<Collector>();
+  Recording direct(collector, nullptr);
+  auto recorder = std::make_shared<FlightRecorder>(10, 1 << 30);
+  Recording recorded(recorder, recorder.get());
+  for (int i = 0; i < 5; i++) {
+    direct.frame(20);
+    recorded.frame(20);
+  }
+  EXPECT_EQ(5, recorder->frames());
+  StringStreamWriter out;
+  ASSERT_TRUE(recorder->writeTo(&out));
+  EXPECT_EQ(collector->mData, out.mData);
+}
+
+TEST(FlightRecorderTest, RetainsLastFrames) {
+  auto recorder = std::make_shared<FlightRecorder>(4, 1 << 30);
+  Recording recording(recorder, recorder.get());
+  for (int i = 0; i < 11; i++) {
+    recording.frame(10);
+  }
+  // Segments hold frames [4, 8) and [8, 11).
+  EXPECT_EQ(7, recorder->frames());
+
+  Summary summary;
+  window(*recorder, &summary);
+  EXPECT_EQ(1, summary.headers);
+  // Only the oldest retained snapshot is kept, but the resources of both.
+  EXPECT_EQ(std::vector<std::string>({"s4"}), summary.states);
+  EXPECT_EQ(std::vector<std::string>({"r4", "r8"}), summary.resources);
+  ASSERT_EQ(70, summary.frames.size());
+  EXPECT_EQ(4, summary.frames.front());
+  EXPECT_EQ(10, summary.frames.back());
+  // The type definitions of the discarded segments are kept.
+  EXPECT_EQ(5, summary.types.size());
+}
+
+TEST(FlightRecorderTest, TypesDefinedInDiscardedSegments) {
+  auto recorder = std::make_shared<FlightRecorder>(2, 1 << 30);
+  Recording recording(recorder, recorder.get());
+  recording.frame(1);
+  recording.object(kLateType, "late");  // First use in the first segment.
+  for (int i = 0; i < 7; i++) {
+    recording.frame(1);
+  }
+  recording.object(kLateType, "late");  // Only refers to the type.
+
+  Summary summary;
+  window(*recorder, &summary);
+  EXPECT_EQ(1, std::count(summary.types.begin(), summary.types.end(),
+                          std::string(kLateType)));
+}
+
+TEST(FlightRecorderTest, DropsChildrenOfDiscardedGroups) {
+  auto recorder = std::make_shared<FlightRecorder>(2, 1 << 30);
+  Recording recording(recorder, recorder.get());
+  // A blocking command on another thread keeps its group open over several
+  // frame boundaries.
+  std::unique_ptr<PackEncoder> blocking(
+      recording.group(recording.mEncoder.get(), kCommandType, "f0"));
+  for (int i = 0; i < 7; i++) {
+    recording.frame(3);
+  }
+  recording.object(blocking.get(), kChildType, "late");
+  blocking.reset();
+  recording.frame(3);
+
+  Summary summary;
+  window(*recorder, &summary);
+  // The retained segment holds frames [6, 8), the blocking group is dropped.
+  EXPECT_EQ(6, summary.frames.front());
+  EXPECT_EQ(7, summary.frames.back());
+}
+
+TEST(FlightRecorderTest, MemoryIsBounded) {
+  const uint64_t kMaxSize = 256 * 1024;
+  auto recorder = std::make_shared<FlightRecorder>(100, kMaxSize);
+  Recording recording(recorder, recorder.get());
+  uint64_t maxSize = 0;
+  for (int i = 0; i < 500; i++) {
+    recording.frame(100);
+    maxSize = std::max(maxSize, recorder->size());
+  }
+  // A single frame is about 30KB including the index.
+  EXPECT_LT(maxSize, kMaxSize + 64 * 1024);
+  EXPECT_LT(recorder->frames(), 100);
+
+  Summary summary;
+  window(*recorder, &summary);
+  EXPECT_EQ(1, summary.states.size());
+  EXPECT_EQ(499, summary.frames.back());
+}
+
+TEST(FlightRecorderTest, KeepsResourcesOfDiscardedSegments) {
+  auto recorder = std::make_shared<FlightRecorder>(2, 1 << 30);
+  Recording recording(recorder, recorder.get());
+  // Sent once, and referred to by all later frames.
+  recording.object(kResourceType, "shared");
+  for (int i = 0; i < 8; i++) {
+    recording.frame(1);
+  }
+
+  Summary summary;
+  window(*recorder, &summary);
+  EXPECT_EQ(std::vector<std::string>({"s6"}), summary.states);
+  EXPECT_EQ(std::vector<std::string>({"shared", "r2", "r4", "r6", "r8"}),
+            summary.resources);
+  EXPECT_TRUE(recording.mGenerations.empty());
+}
+
+TEST(FlightRecorderTest, NewGenerationReleasesResources) {
+  const uint64_t kMaxSize = 64 * 1024;
+  const size_t kResourceSize = 4 * 1024;
+  auto recorder = std::make_shared<FlightRecorder>(2, kMaxSize);
+  Recording recording(recorder, recorder.get());
+  uint64_t maxSize = 0;
+  for (int i = 0; i < 100; i++) {
+    recording.object(kResourceType, std::to_string(recording.mFrame) +
+                                        std::string(kResourceSize, ' '));
+    recording.frame(1);
+    maxSize = std::max(maxSize, recorder->size());
+  }
+  ASSERT_GE(recording.mGenerations.size(), 2u);
+  EXPECT_LT(maxSize, kMaxSize + 4 * kResourceSize);
+
+  // The resources sent before the previous generation are released.
+  Summary summary;
+  window(*recorder, &summary);
+  uint32_t oldest = recording.mGenerations[recording.mGenerations.size() - 2];
+  for (const auto& resource : summary.resources) {
+    if (resource[0] != 'r') {
+      EXPECT_GE(std::stoul(resource), oldest);
+    }
+  }
+}
+
+}  // namespace test
+}  // namespace gapii
@@ -0,0 +1,118 @@
+/*
+ * Copyright (C) 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "framebuffer_downsampler.h"
+
+#include "gapis/capture/capture.pb.h"
+
+namespace gapii {
+
+FramebufferDownsampler::Job::Job(std::vector<uint8_t>&& data, uint32_t width,
+                                 uint32_t height)
+    : mData(std::move(data)),
+      mWidth(width),
+      mHeight(height),
+      mObservation(nullptr) {}
+
+FramebufferDownsampler::Job::~Job() { delete mObservation; }
+
+capture::FramebufferObservation* FramebufferDownsampler::Job::wait() {
+  std::unique_lock<std::mutex> lock(mMutex);
+  mDone.wait(lock, [this] { return mObservation != nullptr; });
+  auto observation = mObservation;
+  mObservation = nullptr;
+  return observation;
+}
+
+FramebufferDownsampler::FramebufferDownsampler(uint32_t maxWidth,
+                                               uint32_t maxHeight, bool async)
+    : mMaxWidth(maxWidth), mMaxHeight(maxHeight), mStop(false) {
+  if (async) {
+    mThread.reset(new std::thread(&FramebufferDownsampler::worker, this));
+  }
+}
+
+FramebufferDownsampler::~FramebufferDownsampler() {
+  if (mThread) {
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mStop = true;
+    }
+    mSignal.notify_one();
+    mThread->join();
+  }
+}
+
+std::shared_ptr<FramebufferDownsampler::Job>
+FramebufferDownsampler::downsample(std::vector<uint8_t>&& data, uint32_t width,
+                                   uint32_t height) {
+  std::shared_ptr<Job> job(new Job(std::move(data), width, height));
+  if (mThread) {
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      mQueue.push_back(job);
+    }
+    mSignal.notify_one();
+  } else {
+    std::lock_guard<std::mutex> lock(mMutex);
+    run(job.get());
+  }
+  return job;
+}
+
+void FramebufferDownsampler::run(Job* job) {
+  uint32_t w = 0;
+  uint32_t h = 0;
+  core::Downsampler::dimensions(job->mWidth, job->mHeight, mMaxWidth,
+                                mMaxHeight, &w, &h);
+
+  // Downsample straight into the message's data buffer.
+  auto observation = new capture::FramebufferObservation();
+  observation->set_original_width(job->mWidth);
+  observation->set_original_height(job->mHeight);
+  observation->set_data_width(w);
+  observation->set_data_height(h);
+  auto out = observation->mutable_data();
+  out->resize(static_cast<size_t>(w) * h * 4);
+  mDownsampler.downsample(job->mData.data(), job->mWidth, job->mHeight,
+                          reinterpret_cast<uint8_t*>(&(*out)[0]), w, h);
+
+  // The full-size copy is no longer needed.
+  std::vector<uint8_t>().swap(job->mData);
+
+  std::lock_guard<std::mutex> lock(job->mMutex);
+  job->mObservation = observation;
+  job->mDone.notify_all();
+}
+
+void FramebufferDownsampler::worker(FramebufferDownsampler* downsampler) {
+  while (true) {
+    std::unique_lock<std::mutex> lock(downsampler->mMutex);
+    downsampler->mSignal.wait(lock, [downsampler] {
+      return downsampler->mStop || !downsampler->mQueue.empty();
+    });
+    if (downsampler->mQueue.empty()) {
+      return;  // Stop signalled with no work left.
+    }
+    auto job = downsampler->mQueue.front();
+    downsampler->mQueue.pop_front();
+    lock.unlock();
+
+    downsampler->run(job.get());
+  }
+}
+
+}  // namespace gapii
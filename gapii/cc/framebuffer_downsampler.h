@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GAPII_FRAMEBUFFER_DOWNSAMPLER_H
+#define GAPII_FRAMEBUFFER_DOWNSAMPLER_H
+
+#include "core/cc/downsample.h"
+
+#include <stdint.h>
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace capture {
+class FramebufferObservation;
+}  // namespace capture
+
+namespace gapii {
+
+// FramebufferDownsampler turns observed RGBA8 framebuffers into downsampled
+// FramebufferObservation messages. The downsampling is either done on the
+// calling thread or on a dedicated background thread.
+class FramebufferDownsampler {
+ public:
+  // Job is a single pending framebuffer downsample.
+  class Job {
+   public:
+    ~Job();
+
+    // wait blocks until the downsample has completed and returns the
+    // observation. Ownership of the observation is passed to the caller.
+    capture::FramebufferObservation* wait();
+
+   private:
+    friend class FramebufferDownsampler;
+
+    Job(std::vector<uint8_t>&& data, uint32_t width, uint32_t height);
+
+    std::mutex mMutex;
+    std::condition_variable mDone;
+    std::vector<uint8_t> mData;  // The full-size copy of the framebuffer.
+    uint32_t mWidth;
+    uint32_t mHeight;
+    capture::FramebufferObservation* mObservation;  // null until done.
+  };
+
+  // If async is true then downsampling is performed on a background thread.
+  FramebufferDownsampler(uint32_t maxWidth, uint32_t maxHeight, bool async);
+
+  // Destructor. Waits for all pending jobs to finish before returning.
+  ~FramebufferDownsampler();
+
+  // downsample begins downsampling the width x height RGBA8 pixels in data.
+  // If the downsampler is synchronous, the returned job has already
+  // completed.
+  std::shared_ptr<Job> downsample(std::vector<uint8_t>&& data, uint32_t width,
+                                  uint32_t height);
+
+  inline bool is_async() const { return mThread != nullptr; }
+
+ private:
+  FramebufferDownsampler(const FramebufferDownsampler&) = delete;
+  FramebufferDownsampler& operator=(const FramebufferDownsampler&) = delete;
+
+  // run performs the downsample for the job and signals its completion.
+  void run(Job* job);
+
+  static void worker(FramebufferDownsampler*);
+
+  const uint32_t mMaxWidth;
+  const uint32_t mMaxHeight;
+
+  // The image downsampler. Only used by the worker thread when asynchronous,
+  // otherwise guarded by mMutex.
+  core::Downsampler mDownsampler;
+
+  std::mutex mMutex;  // Guards mQueue and mStop.
+  std::condition_variable mSignal;
+  std::deque<std::shared_ptr<Job>> mQueue;
+  bool mStop;
+  std::unique_ptr<std::thread> mThread;
+};
+
+}  // namespace gapii
+
+#endif  // GAPII_FRAMEBUFFER_DOWNSAMPLER_H
@@ -18,11 +18,13 @@
 #include "chunk_writer.h"
 
 #include "core/cc/stream_writer.h"
+#include "core/cc/trace.h"
 
 #include <google/protobuf/descriptor.pb.h>
 #include <google/protobuf/io/coded_stream.h>
 #include <google/protobuf/message.h>
 
+#include <map>
 #include <mutex>
 
 using ::google::protobuf::Descriptor;
@@ -51,6 +53,7 @@ class PackEncoderImpl : public gapii::PackEncoder {
   virtual SPtr group(const Message* msg) override;
   virtual PackEncoder* group(TypeID type, size_t size,
                              const void* data) override;
+  virtual SPtr block() override;
   virtual void flush() override;
 
  private:
@@ -67,10 +70,52 @@ class PackEncoderImpl : public gapii::PackEncoder {
     std::unordered_map<const void*, TypeID> type_ids;
     TypeIDCache type_id_caches[TYPE_ID_CACHE_COUNT];
     uint64_t mCurrentChunkId;
+
+    // blocksPending returns true if a block has been created that has not
+    // been written to the stream yet. Must be called with mutex held.
+    bool blocksPending() const { return next_commit != next_block; }
+
+    // commit writes the chunks of the block with the given sequence number
+    // to the stream, followed by any blocks that were waiting for it. If an
+    // earlier block has not been committed yet, the chunks are held until it
+    // has.
+    void commit(uint64_t sequence, std::string& data, uint64_t chunks);
+
+    // The sequence number of the next block to be created. It is taken under
+    // mutex, like the stream position of the direct writes, so a block always
+    // precedes the root groups encoded after it was created.
+    uint64_t next_block;
+    // The sequence number of the next block to be written to the stream.
+    uint64_t next_commit;
+    // The data and chunk count of committed blocks waiting for an earlier
+    // block, keyed by sequence number.
+    std::map<uint64_t, std::pair<std::string, uint64_t>> pending;
+  };
+
+  // Block holds the chunks encoded to a block, and commits them when
+  // destroyed. Chunk identifiers within a block are relative to its start.
+  struct Block {
+    Block(const std::shared_ptr<Shared>& shared);
+    ~Block();
+
+    std::shared_ptr<Shared> shared;
+    uint64_t sequence;
+    std::string data;
+    uint64_t chunks;
   };
 
   PackEncoderImpl(const std::shared_ptr<Shared>& shared,
-                  uint64_t parentChunkId);
+                  uint64_t parentChunkId,
+                  const std::shared_ptr<Block>& block);
+
+  // lock returns a lock on the shared state, or an empty lock if this
+  // encoder writes to a block.
+  std::unique_lock<std::recursive_mutex> lock();
+
+  // deferred returns a new block to encode a root group to, if this encoder
+  // writes to the stream and an earlier block is still pending. Otherwise it
+  // returns nullptr and the group is written to the stream directly.
+  std::unique_ptr<PackEncoderImpl> deferred();
 
   void writeParentID(std::string& buffer);
   TypeIDAndIsNew writeTypeIfNew(const Descriptor* desc);
@@ -86,29 +131,88 @@ class PackEncoderImpl : public gapii::PackEncoder {
 
   std::shared_ptr<Shared> mShared;
   uint64_t mParentChunkId;
+  std::shared_ptr<Block> mBlock;  // nullptr if writing to the stream.
 };
 
 PackEncoderImpl::Shared::Shared(
     const std::shared_ptr<core::StringWriter>& writer)
-    : writer(writer), type_ids{{nullptr, 0}}, mCurrentChunkId(0) {}
+    : writer(writer),
+      type_ids{{nullptr, 0}},
+      mCurrentChunkId(0),
+      next_block(0),
+      next_commit(0) {}
+
+void PackEncoderImpl::Shared::commit(uint64_t sequence, std::string& data,
+                                     uint64_t chunks) {
+  std::lock_guard<std::recursive_mutex> lock(mutex);
+  if (sequence != next_commit) {
+    auto& waiting = pending[sequence];
+    waiting.first.swap(data);
+    waiting.second = chunks;
+    return;
+  }
+  while (true) {
+    if (!data.empty()) {
+      writer->write(data);
+    }
+    mCurrentChunkId += chunks;
+    next_commit++;
+
+    auto next = pending.begin();
+    if (next == pending.end() || next->first != next_commit) {
+      return;
+    }
+    data.swap(next->second.first);
+    chunks = next->second.second;
+    pending.erase(next);
+  }
+}
+
+PackEncoderImpl::Block::Block(const std::shared_ptr<Shared>& shared)
+    : shared(shared), chunks(0) {
+  std::lock_guard<std::recursive_mutex> lock(shared->mutex);
+  sequence = shared->next_block++;
+}
+
+PackEncoderImpl::Block::~Block() { shared->commit(sequence, data, chunks); }
 
 PackEncoderImpl::PackEncoderImpl(
     const std::shared_ptr<core::StringWriter>& writer)
     : mShared(new Shared(writer)), mParentChunkId(NO_ID) {}
 
 PackEncoderImpl::PackEncoderImpl(const std::shared_ptr<Shared>& shared,
-                                 uint64_t parentChunkId)
-    : mShared(shared), mParentChunkId(parentChunkId) {}
+                                 uint64_t parentChunkId,
+                                 const std::shared_ptr<Block>& block)
+    : mShared(shared), mParentChunkId(parentChunkId), mBlock(block) {}
 
 PackEncoderImpl::~PackEncoderImpl() {
   if (mParentChunkId != NO_ID) {
     std::string buffer;
-    std::lock_guard<std::recursive_mutex> lock(mShared->mutex);
+    auto l = lock();
     writeParentID(buffer);
     flushChunk(buffer, false);
   }
 }
 
+std::unique_lock<std::recursive_mutex> PackEncoderImpl::lock() {
+  if (mBlock) {
+    return std::unique_lock<std::recursive_mutex>();
+  }
+  return std::unique_lock<std::recursive_mutex>(mShared->mutex);
+}
+
+std::unique_ptr<PackEncoderImpl> PackEncoderImpl::deferred() {
+  if (mBlock || mParentChunkId != NO_ID) {
+    return nullptr;
+  }
+  std::lock_guard<std::recursive_mutex> lock(mShared->mutex);
+  if (!mShared->blocksPending()) {
+    return nullptr;
+  }
+  return std::unique_ptr<PackEncoderImpl>(
+      new PackEncoderImpl(mShared, NO_ID, std::make_shared<Block>(mShared)));
+}
+
 void PackEncoderImpl::flush() { mShared->writer->flush(); }
 
 gapii::PackEncoder::TypeIDAndIsNew PackEncoderImpl::type(const char* name,
@@ -118,10 +222,11 @@ gapii::PackEncoder::TypeIDAndIsNew PackEncoderImpl::type(const char* name,
 }
 
 void PackEncoderImpl::object(const Message* msg) {
+  GAPID_TRACE_NAME("PackEncoder::object");
   std::string buffer;
   auto type_id = writeTypeIfNew(msg->GetDescriptor()).first;
 
-  std::lock_guard<std::recursive_mutex> lock(mShared->mutex);
+  auto l = lock();
   writeParentID(buffer);
   writeZigzag(buffer, type_id);
   msg->AppendToString(&buffer);
@@ -129,8 +234,9 @@ void PackEncoderImpl::object(const Message* msg) {
 }
 
 void PackEncoderImpl::object(TypeID type_id, size_t size, const void* data) {
+  GAPID_TRACE_NAME("PackEncoder::object");
   std::string buffer;
-  std::lock_guard<std::recursive_mutex> lock(mShared->mutex);
+  auto l = lock();
   writeParentID(buffer);
   writeZigzag(buffer, type_id);
   buffer.append(reinterpret_cast<const char*>(data), size);
@@ -138,33 +244,48 @@ void PackEncoderImpl::object(TypeID type_id, size_t size, const void* data) {
 }
 
 gapii::PackEncoder::SPtr PackEncoderImpl::group(const Message* msg) {
+  if (auto block = deferred()) {
+    return block->group(msg);
+  }
+  GAPID_TRACE_NAME("PackEncoder::group");
   std::string buffer;
   auto type_id = writeTypeIfNew(msg->GetDescriptor()).first;
 
-  std::lock_guard<std::recursive_mutex> lock(mShared->mutex);
+  auto l = lock();
   writeParentID(buffer);
   writeZigzag(buffer, -(int64_t)type_id);
   msg->AppendToString(&buffer);
   auto chunkID = flushChunk(buffer, false);
 
-  return PackEncoder::SPtr(new PackEncoderImpl(mShared, chunkID));
+  return PackEncoder::SPtr(new PackEncoderImpl(mShared, chunkID, mBlock));
 }
 
 gapii::PackEncoder* PackEncoderImpl::group(TypeID type_id, size_t size,
                                            const void* data) {
+  if (auto block = deferred()) {
+    return block->group(type_id, size, data);
+  }
+  GAPID_TRACE_NAME("PackEncoder::group");
   std::string buffer;
-  std::lock_guard<std::recursive_mutex> lock(mShared->mutex);
+  auto l = lock();
   writeParentID(buffer);
   writeZigzag(buffer, -(int64_t)type_id);
   buffer.append(reinterpret_cast<const char*>(data), size);
   auto chunkID = flushChunk(buffer, false);
 
-  return new PackEncoderImpl(mShared, chunkID);
+  return new PackEncoderImpl(mShared, chunkID, mBlock);
+}
+
+gapii::PackEncoder::SPtr PackEncoderImpl::block() {
+  return PackEncoder::SPtr(
+      new PackEncoderImpl(mShared, NO_ID, std::make_shared<Block>(mShared)));
 }
 
 void PackEncoderImpl::writeParentID(std::string& buffer) {
   if (mParentChunkId == NO_ID) {
     writeZigzag(buffer, 0);
+  } else if (mBlock) {
+    writeZigzag(buffer, mParentChunkId - mBlock->chunks);
   } else {
     writeZigzag(buffer, mParentChunkId - mShared->mCurrentChunkId);
   }
@@ -296,6 +417,12 @@ void PackEncoderImpl::writeVarint(std::string& buffer, uint64_t value) {
 
 uint64_t PackEncoderImpl::flushChunk(std::string& buffer, bool isTypeDefChunk) {
   int64_t size = buffer.size();
+  if (mBlock && !isTypeDefChunk) {
+    writeZigzag(mBlock->data, size);
+    mBlock->data.append(buffer);
+    buffer.clear();
+    return mBlock->chunks++;
+  }
   std::string sizeBuffer;
   writeZigzag(sizeBuffer, isTypeDefChunk ? -size : size);
   mShared->writer->write(sizeBuffer);
@@ -320,6 +447,7 @@ class PackEncoderNoop : public gapii::PackEncoder {
                              const void* data) override {
     return new PackEncoderNoop();
   }
+  virtual SPtr block() override { return instance; }
   virtual void flush() override {}
 };
 
@@ -333,11 +461,22 @@ namespace gapii {
 // create returns a PackEncoder::SPtr that writes to output.
 PackEncoder::SPtr PackEncoder::create(
     std::shared_ptr<core::StreamWriter> stream, bool no_buffer) {
-  stream->write(header, sizeof(header));
+  writeHeader(stream.get());
   auto writer = ChunkWriter::create(stream, no_buffer);
   return PackEncoder::SPtr(new PackEncoderImpl(writer));
 }
 
+// create returns a PackEncoder::SPtr that writes chunks to writer.
+PackEncoder::SPtr PackEncoder::create(
+    const std::shared_ptr<core::StringWriter>& writer) {
+  return PackEncoder::SPtr(new PackEncoderImpl(writer));
+}
+
+// writeHeader writes the pack header to output.
+bool PackEncoder::writeHeader(core::StreamWriter* output) {
+  return output->write(header, sizeof(header)) == sizeof(header);
+}
+
 // noop returns a PackEncoder::SPtr that does nothing.
 PackEncoder::SPtr PackEncoder::noop() { return PackEncoderNoop::instance; }
 
@@ -33,6 +33,7 @@ class Message;
 
 namespace core {
 class StreamWriter;
+class StringWriter;
 }  // namespace core
 
 namespace gapii {
@@ -70,6 +71,19 @@ class PackEncoder {
   // and must be deleted by the caller.
   virtual PackEncoder* group(TypeID type, size_t size, const void* data) = 0;
 
+  // block returns a PackEncoder that encodes objects to the root of the
+  // stream, but buffers them, and the objects of its groups, instead of
+  // writing them to the stream. Once the block and all of its groups have
+  // been released, the buffered objects are written to the stream as one
+  // contiguous run. Blocks are numbered when created and are always written
+  // in that order, so blocks can be encoded on different threads without
+  // holding the stream lock for each object. A root group encoded to the
+  // stream while an earlier block is pending is buffered in a block of its
+  // own, so that it follows that block. Type definitions and root objects,
+  // such as resources, are still written directly to the stream, as they
+  // only need to precede their use.
+  virtual SPtr block() = 0;
+
   // flush flushes out all of the pending in the encoder
   virtual void flush() = 0;
 
@@ -78,6 +92,13 @@ class PackEncoder {
   static SPtr create(std::shared_ptr<core::StreamWriter> output,
                      bool no_buffer);
 
+  // create returns a PackEncoder::SPtr that writes the chunks of the stream to
+  // writer. The pack header is not written.
+  static SPtr create(const std::shared_ptr<core::StringWriter>& writer);
+
+  // writeHeader writes the pack header to output, returning true on success.
+  static bool writeHeader(core::StreamWriter* output);
+
   // noop returns a PackEncoder::SPtr that does nothing.
   static SPtr noop();
 };
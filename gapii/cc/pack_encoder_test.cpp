@@ -0,0 +1,237 @@
+/*
+ * Copyright (C) 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "pack_encoder.h"
+
+#include "core/cc/string_writer.h"
+
+#include <gtest/gtest.h>
+#include <string.h>
+
+#include <cstdlib>
+#include <memory>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace gapii {
+namespace test {
+namespace {
+
+// The type descriptors. The encoder identifies types by their address.
+const char kCommandType[] = "command";
+const char kChildType[] = "child";
+
+// Collector is a StringWriter that appends all written chunks.
+class Collector : public core::StringWriter {
+ public:
+  virtual bool write(std::string& data) override {
+    mData.append(data);
+    return true;
+  }
+  virtual void flush() override {}
+  std::string mData;
+};
+
+PackEncoder::TypeID typeID(PackEncoder* encoder, const char* type) {
+  return encoder->type(type, strlen(type), type).first;
+}
+
+// command encodes a command group named name with two child objects.
+void command(PackEncoder* encoder, const std::string& name) {
+  std::unique_ptr<PackEncoder> cmd(encoder->group(
+      typeID(encoder, kCommandType), name.size(), name.data()));
+  auto child = typeID(encoder, kChildType);
+  cmd->object(child, 4, "read");
+  cmd->object(child, 5, "write");
+}
+
+uint64_t readVarint(const std::string& s, size_t* offset) {
+  uint64_t value = 0;
+  for (int shift = 0;; shift += 7) {
+    uint8_t b = static_cast<uint8_t>(s[(*offset)++]);
+    value |= static_cast<uint64_t>(b & 0x7f) << shift;
+    if ((b & 0x80) == 0) {
+      return value;
+    }
+  }
+}
+
+int64_t readZigzag(const std::string& s, size_t* offset, size_t end) {
+  if (*offset >= end) {
+    return 0;
+  }
+  uint64_t n = readVarint(s, offset);
+  return static_cast<int64_t>(n >> 1) ^ -static_cast<int64_t>(n & 1);
+}
+
+// decode decodes the chunks in data, checking that every child refers to an
+// open group and that every command has both of its children. Returns the
+// names of the commands in stream order.
+void decode(const std::string& data, std::vector<std::string>* commands) {
+  std::vector<std::string> types = {""};
+  std::set<uint64_t> open;
+  std::vector<int> children;  // By chunk id.
+  size_t offset = 0;
+  for (uint64_t id = 0; offset < data.size(); id++) {
+    children.push_back(0);
+    int64_t size = readZigzag(data, &offset, data.size());
+    if (size < 0) {
+      size_t end = offset - size;
+      uint64_t length = readVarint(data, &offset);
+      types.push_back(data.substr(offset, length));
+      offset = end;
+      continue;
+    }
+    size_t end = offset + size;
+    int64_t parent = readZigzag(data, &offset, end);
+    int64_t type = readZigzag(data, &offset, end);
+    std::string payload = data.substr(offset, end - offset);
+    offset = end;
+
+    ASSERT_LT(std::abs(type), static_cast<int64_t>(types.size()))
+        << "Unknown type at chunk " << id;
+    if (parent != 0) {
+      ASSERT_LT(parent, 0);
+      ASSERT_EQ(1, open.count(id + parent))
+          << "Chunk " << id << " references parent " << id + parent
+          << " which is not an open group";
+    }
+    if (type == 0) {
+      EXPECT_EQ(2, children[id + parent]) << commands->back();
+      open.erase(id + parent);
+    } else if (type < 0) {
+      open.insert(id);
+      EXPECT_EQ(kCommandType, types[-type]);
+      commands->push_back(payload);
+    } else if (parent != 0) {
+      EXPECT_EQ(kChildType, types[type]);
+      children[id + parent]++;
+    }
+  }
+  EXPECT_TRUE(open.empty());
+}
+
+}  // anonymous namespace
+
+TEST(PackEncoderTest, BlocksAreWrittenInSequenceOrder) {
+  auto collector = std::make_shared<Collector>();
+  auto encoder = PackEncoder::create(collector);
+  command(encoder.get(), "a");
+  auto first = encoder->block();
+  auto second = encoder->block();
+  auto third = encoder->block();
+  command(third.get(), "d");
+  third.reset();
+  command(encoder.get(), "b");
+  command(second.get(), "c");
+  second.reset();
+  command(first.get(), "x");
+
+  std::vector<std::string> commands;
+  decode(collector->mData, &commands);
+  EXPECT_EQ(std::vector<std::string>({"a"}), commands);
+
+  first.reset();
+  commands.clear();
+  decode(collector->mData, &commands);
+  EXPECT_EQ(std::vector<std::string>({"a", "x", "c", "d", "b"}), commands);
+}
+
+TEST(PackEncoderTest, GlobalCommandsFollowEarlierBlocks) {
+  auto collector = std::make_shared<Collector>();
+  auto encoder = PackEncoder::create(collector);
+  std::unique_ptr<PackEncoder> before(
+      encoder->group(typeID(encoder.get(), kCommandType), 1, "a"));
+  auto block = encoder->block();
+
+  // A global command encoded on another thread while the block is pending,
+  // and a resource that the block may refer to.
+  std::thread global([&] {
+    command(encoder.get(), "g");
+    encoder->object(typeID(encoder.get(), kChildType), 1, "r");
+  });
+  global.join();
+  command(block.get(), "b");
+  before->object(typeID(encoder.get(), kChildType), 1, "1");
+  before->object(typeID(encoder.get(), kChildType), 1, "2");
+  before.reset();
+  EXPECT_NE(std::string::npos, collector->mData.find('r'));
+  EXPECT_EQ(std::string::npos, collector->mData.find('g'));
+
+  // The global command is written once the block commits.
+  block.reset();
+  std::vector<std::string> commands;
+  decode(collector->mData, &commands);
+  EXPECT_EQ(std::vector<std::string>({"a", "b", "g"}), commands);
+}
+
+TEST(PackEncoderTest, BlockGroupsOutliveTheBlock) {
+  auto collector = std::make_shared<Collector>();
+  auto encoder = PackEncoder::create(collector);
+  auto block = encoder->block();
+  std::unique_ptr<PackEncoder> group(
+      block->group(typeID(encoder.get(), kCommandType), 1, "g"));
+  block.reset();
+  command(encoder.get(), "a");
+  group->object(typeID(encoder.get(), kChildType), 1, "1");
+  group->object(typeID(encoder.get(), kChildType), 1, "2");
+  EXPECT_EQ(std::string::npos, collector->mData.find('g'));
+  group.reset();
+
+  std::vector<std::string> commands;
+  decode(collector->mData, &commands);
+  EXPECT_EQ(std::vector<std::string>({"g", "a"}), commands);
+}
+
+TEST(PackEncoderTest, ConcurrentBlocks) {
+  const int kThreads = 8;
+  const int kCommands = 2000;
+  auto collector = std::make_shared<Collector>();
+  auto encoder = PackEncoder::create(collector);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; t++) {
+    threads.emplace_back([&, t] {
+      for (int i = 0; i < kCommands; i++) {
+        auto block = encoder->block();
+        command(block.get(), std::to_string(t) + ":" + std::to_string(i));
+        if (i % 100 == 0) {
+          command(encoder.get(), "direct");
+        }
+      }
+    });
+  }
+  for (auto& thread : threads) {
+    thread.join();
+  }
+
+  std::vector<std::string> commands;
+  decode(collector->mData, &commands);
+  EXPECT_EQ(kThreads * kCommands * 101 / 100, commands.size());
+  // Each thread's commands are in the order they were encoded.
+  std::vector<int> next(kThreads, 0);
+  for (const auto& name : commands) {
+    if (name != "direct") {
+      auto colon = name.find(':');
+      int t = std::stoi(name.substr(0, colon));
+      EXPECT_EQ(next[t]++, std::stoi(name.substr(colon + 1)));
+    }
+  }
+}
+
+}  // namespace test
+}  // namespace gapii
@@ -0,0 +1,296 @@
+/*
+ * Copyright (C) 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "shared_memory_ring.h"
+
+#include "core/cc/log.h"
+#include "core/cc/target.h"
+
+#include <stddef.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+
+#if TARGET_OS == GAPID_OS_LINUX
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif  // TARGET_OS == GAPID_OS_LINUX
+
+namespace {
+
+const uint8_t kMagic[4] = {'r', 'i', 'n', 'g'};
+const uint32_t kVersion = 1;
+
+}  // anonymous namespace
+
+namespace gapii {
+
+struct SharedMemoryRing::Header {
+  uint8_t magic[4];
+  uint32_t version;
+  uint64_t capacity;
+  uint8_t pad0[48];
+
+  // Written by the writer.
+  std::atomic<uint64_t> head;
+  std::atomic<uint32_t> dataSeq;
+  std::atomic<uint32_t> writerWaiting;
+  std::atomic<uint32_t> writerClosed;
+  std::atomic<uint32_t> writerPid;
+  uint8_t pad1[40];
+
+  // Written by the reader.
+  std::atomic<uint64_t> tail;
+  std::atomic<uint32_t> spaceSeq;
+  std::atomic<uint32_t> readerWaiting;
+  std::atomic<uint32_t> readerClosed;
+  std::atomic<uint32_t> readerPid;
+  uint8_t pad2[104];
+};
+
+static_assert(sizeof(SharedMemoryRing::Header) == 256,
+              "SharedMemoryRing::Header must be 256 bytes");
+static_assert(offsetof(SharedMemoryRing::Header, head) == 64,
+              "SharedMemoryRing::Header::head must be at offset 64");
+static_assert(offsetof(SharedMemoryRing::Header, tail) == 128,
+              "SharedMemoryRing::Header::tail must be at offset 128");
+static_assert(offsetof(SharedMemoryRing::Header, readerPid) == 148,
+              "SharedMemoryRing::Header::readerPid must be at offset 148");
+
+#if TARGET_OS == GAPID_OS_LINUX
+
+namespace {
+
+// wait blocks until the futex seq no longer holds value, it is woken, or a
+// second passed.
+void wait(std::atomic<uint32_t>* seq, uint32_t value) {
+  struct timespec timeout = {1, 0};
+  syscall(SYS_futex, reinterpret_cast<uint32_t*>(seq), FUTEX_WAIT, value,
+          &timeout, nullptr, 0);
+}
+
+// wake changes the value of the futex seq and wakes its waiter.
+void wake(std::atomic<uint32_t>* seq) {
+  seq->fetch_add(1);
+  syscall(SYS_futex, reinterpret_cast<uint32_t*>(seq), FUTEX_WAKE, 1, nullptr,
+          nullptr, 0);
+}
+
+// alive returns false if the process pid, when set, has exited.
+bool alive(uint32_t pid) {
+  return pid == 0 || kill(static_cast<pid_t>(pid), 0) == 0 || errno != ESRCH;
+}
+
+}  // anonymous namespace
+
+std::unique_ptr<SharedMemoryRing> SharedMemoryRing::create(uint64_t capacity) {
+#ifdef SYS_memfd_create
+  uint64_t size = 4096;
+  while (size < capacity) {
+    size *= 2;
+  }
+  int fd = syscall(SYS_memfd_create, "gapii-capture", 1 /* MFD_CLOEXEC */);
+  if (fd < 0) {
+    GAPID_WARNING("memfd_create failed: %s", strerror(errno));
+    return nullptr;
+  }
+  if (ftruncate(fd, sizeof(Header) + size) != 0) {
+    GAPID_WARNING("Couldn't size the shared memory ring: %s", strerror(errno));
+    ::close(fd);
+    return nullptr;
+  }
+  void* memory = mmap(nullptr, sizeof(Header) + size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED, fd, 0);
+  if (memory == MAP_FAILED) {
+    GAPID_WARNING("Couldn't map the shared memory ring: %s", strerror(errno));
+    ::close(fd);
+    return nullptr;
+  }
+  // The file is zero-filled, which is the initial state of the atomics.
+  auto header = static_cast<Header*>(memory);
+  memcpy(header->magic, kMagic, sizeof(kMagic));
+  header->version = kVersion;
+  header->capacity = size;
+  header->writerPid.store(getpid());
+  return std::unique_ptr<SharedMemoryRing>(
+      new SharedMemoryRing(fd, header, size, true));
+#else   // SYS_memfd_create
+  return nullptr;
+#endif  // SYS_memfd_create
+}
+
+std::unique_ptr<SharedMemoryRing> SharedMemoryRing::open(uint32_t pid,
+                                                         int fd) {
+  char path[64];
+  snprintf(path, sizeof(path), "/proc/%u/fd/%d", pid, fd);
+  int file = ::open(path, O_RDWR | O_CLOEXEC);
+  if (file < 0) {
+    GAPID_WARNING("Couldn't open the shared memory ring %s: %s", path,
+                  strerror(errno));
+    return nullptr;
+  }
+  struct stat st;
+  if (fstat(file, &st) != 0 ||
+      static_cast<uint64_t>(st.st_size) < sizeof(Header)) {
+    ::close(file);
+    return nullptr;
+  }
+  void* memory =
+      mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, file, 0);
+  if (memory == MAP_FAILED) {
+    ::close(file);
+    return nullptr;
+  }
+  auto header = static_cast<Header*>(memory);
+  uint64_t size = header->capacity;
+  if (memcmp(header->magic, kMagic, sizeof(kMagic)) != 0 ||
+      header->version != kVersion || (size & (size - 1)) != 0 ||
+      sizeof(Header) + size > static_cast<uint64_t>(st.st_size)) {
+    GAPID_WARNING("%s is not a shared memory ring", path);
+    munmap(memory, st.st_size);
+    ::close(file);
+    return nullptr;
+  }
+  header->readerPid.store(getpid());
+  return std::unique_ptr<SharedMemoryRing>(
+      new SharedMemoryRing(file, header, size, false));
+}
+
+SharedMemoryRing::~SharedMemoryRing() {
+  munmap(mHeader, sizeof(Header) + mSize);
+  ::close(mFd);
+}
+
+uint64_t SharedMemoryRing::write(const void* data, uint64_t size) {
+  auto src = static_cast<const uint8_t*>(data);
+  uint64_t head = mHeader->head.load(std::memory_order_relaxed);
+  uint64_t written = 0;
+  while (written < size) {
+    uint64_t tail = mHeader->tail.load(std::memory_order_acquire);
+    if (head - tail == mSize) {
+      uint32_t seq = mHeader->spaceSeq.load();
+      if (mHeader->readerClosed.load() || !alive(mHeader->readerPid.load())) {
+        break;
+      }
+      // The reader wakes the writer only if it sees it waiting, so the tail is
+      // checked again after announcing it.
+      mHeader->writerWaiting.store(1);
+      if (mHeader->tail.load() == tail) {
+        wait(&mHeader->spaceSeq, seq);
+      }
+      mHeader->writerWaiting.store(0);
+      continue;
+    }
+    uint64_t count = std::min(mSize - (head - tail), size - written);
+    uint64_t offset = head & (mSize - 1);
+    uint64_t first = std::min(count, mSize - offset);
+    memcpy(mData + offset, src + written, first);
+    memcpy(mData, src + written + first, count - first);
+    head += count;
+    written += count;
+    mHeader->head.store(head);
+    if (mHeader->readerWaiting.load()) {
+      wake(&mHeader->dataSeq);
+    }
+  }
+  return written;
+}
+
+uint64_t SharedMemoryRing::read(void* data, uint64_t max_size) {
+  auto dst = static_cast<uint8_t*>(data);
+  uint64_t tail = mHeader->tail.load(std::memory_order_relaxed);
+  uint64_t head;
+  while ((head = mHeader->head.load(std::memory_order_acquire)) == tail) {
+    uint32_t seq = mHeader->dataSeq.load();
+    if (mHeader->writerClosed.load() || !alive(mHeader->writerPid.load())) {
+      // The writer closes the ring after its last write.
+      if (mHeader->head.load() == tail) {
+        return 0;
+      }
+      continue;
+    }
+    mHeader->readerWaiting.store(1);
+    if (mHeader->head.load() == tail) {
+      wait(&mHeader->dataSeq, seq);
+    }
+    mHeader->readerWaiting.store(0);
+  }
+  uint64_t count = std::min(head - tail, max_size);
+  uint64_t offset = tail & (mSize - 1);
+  uint64_t first = std::min(count, mSize - offset);
+  memcpy(dst, mData + offset, first);
+  memcpy(dst + first, mData, count - first);
+  mHeader->tail.store(tail + count);
+  if (mHeader->writerWaiting.load()) {
+    wake(&mHeader->spaceSeq);
+  }
+  return count;
+}
+
+void SharedMemoryRing::close() {
+  if (mWriter) {
+    mHeader->writerClosed.store(1);
+    wake(&mHeader->dataSeq);
+  } else {
+    mHeader->readerClosed.store(1);
+    wake(&mHeader->spaceSeq);
+  }
+}
+
+#else  // TARGET_OS == GAPID_OS_LINUX
+
+std::unique_ptr<SharedMemoryRing> SharedMemoryRing::create(uint64_t) {
+  return nullptr;
+}
+
+std::unique_ptr<SharedMemoryRing> SharedMemoryRing::open(uint32_t, int) {
+  return nullptr;
+}
+
+SharedMemoryRing::~SharedMemoryRing() {}
+
+uint64_t SharedMemoryRing::write(const void*, uint64_t) { return 0; }
+
+uint64_t SharedMemoryRing::read(void*, uint64_t) { return 0; }
+
+void SharedMemoryRing::close() {}
+
+#endif  // TARGET_OS == GAPID_OS_LINUX
+
+SharedMemoryRing::SharedMemoryRing(int fd, Header* header, uint64_t size,
+                                   bool writer)
+    : mFd(fd),
+      mHeader(header),
+      mData(reinterpret_cast<uint8_t*>(header + 1)),
+      mSize(size),
+      mWriter(writer) {}
+
+uint64_t SharedMemoryRing::capacity() const { return mSize; }
+
+uint32_t SharedMemoryRing::writerPid() const {
+  return mHeader->writerPid.load();
+}
+
+}  // namespace gapii
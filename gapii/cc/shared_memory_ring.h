@@ -0,0 +1,103 @@
+/*
+ * Copyright (C) 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GAPII_SHARED_MEMORY_RING_H
+#define GAPII_SHARED_MEMORY_RING_H
+
+#include <stdint.h>
+
+#include <memory>
+
+namespace gapii {
+
+// SharedMemoryRing is a single-producer, single-consumer byte ring in a shared
+// memory file. It lets the capture stream reach a receiver on the same machine
+// without being copied through the kernel, as a socket does.
+//
+// The ring is created by the writer, and opened by the reader through the
+// /proc/<pid>/fd/<fd> link of the writer's file. Each side waits for the other
+// on a futex in the shared memory, and is only woken if it is waiting.
+//
+// The layout of the file is shared with the receiver, and must be kept in sync
+// with gapii/client/shared_memory_linux.go:
+//
+//   offset   0: uint32 magic       'r', 'i', 'n', 'g'
+//   offset   4: uint32 version     1
+//   offset   8: uint64 capacity    size of the data, a power of two
+//   offset  64: uint64 head        bytes written, set by the writer
+//   offset  72: uint32 dataSeq     futex bumped to wake the reader
+//   offset  76: uint32 writerWaiting
+//   offset  80: uint32 writerClosed
+//   offset  84: uint32 writerPid
+//   offset 128: uint64 tail        bytes read, set by the reader
+//   offset 136: uint32 spaceSeq    futex bumped to wake the writer
+//   offset 140: uint32 readerWaiting
+//   offset 144: uint32 readerClosed
+//   offset 148: uint32 readerPid
+//   offset 256: the data
+//
+// Rings are only supported on Linux. On other platforms create() and open()
+// return nullptr.
+class SharedMemoryRing {
+ public:
+  struct Header;
+
+  // create returns a new ring with at least the given capacity in bytes, for
+  // the calling process to write to, or nullptr on failure.
+  static std::unique_ptr<SharedMemoryRing> create(uint64_t capacity);
+
+  // open maps the ring created by the process pid as its file descriptor fd,
+  // for the calling process to read from. It returns nullptr on failure.
+  static std::unique_ptr<SharedMemoryRing> open(uint32_t pid, int fd);
+
+  ~SharedMemoryRing();
+
+  // fd returns the file descriptor of the shared memory file.
+  inline int fd() const { return mFd; }
+
+  // capacity returns the size of the data of the ring in bytes.
+  uint64_t capacity() const;
+
+  // writerPid returns the process id of the writer.
+  uint32_t writerPid() const;
+
+  // write blocks until the size bytes of data are copied to the ring. It
+  // returns the number of bytes written, which is less than size if the reader
+  // closed the ring or exited.
+  uint64_t write(const void* data, uint64_t size);
+
+  // read blocks until data is available, and copies up to max_size bytes of it
+  // to data. It returns the number of bytes read, or 0 once the writer closed
+  // the ring or exited and all its data was read.
+  uint64_t read(void* data, uint64_t max_size);
+
+  // close marks the side of the ring of the calling process as closed, and
+  // wakes the other side.
+  void close();
+
+ private:
+  SharedMemoryRing(int fd, Header* header, uint64_t size, bool writer);
+
+  int mFd;
+  Header* mHeader;
+  uint8_t* mData;
+  uint64_t mSize;
+  bool mWriter;
+};
+
+}  // namespace gapii
+
+#endif  // GAPII_SHARED_MEMORY_RING_H
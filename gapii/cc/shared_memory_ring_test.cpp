@@ -0,0 +1,130 @@
+/*
+ * Copyright (C) 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "shared_memory_ring.h"
+
+#include "core/cc/target.h"
+
+#include <gtest/gtest.h>
+
+#if TARGET_OS == GAPID_OS_LINUX
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace gapii {
+namespace test {
+namespace {
+
+const uint64_t kCapacity = 64 * 1024;
+
+std::vector<uint8_t> pattern(size_t size) {
+  std::vector<uint8_t> data(size);
+  for (size_t i = 0; i < size; i++) {
+    data[i] = static_cast<uint8_t>(i * 31 + i / 977);
+  }
+  return data;
+}
+
+// writeAll writes data to ring in chunks of chunkSize bytes, then closes it.
+void writeAll(SharedMemoryRing* ring, const std::vector<uint8_t>& data,
+              size_t chunkSize) {
+  for (size_t offset = 0; offset < data.size(); offset += chunkSize) {
+    size_t size = std::min(chunkSize, data.size() - offset);
+    ASSERT_EQ(size, ring->write(&data[offset], size));
+  }
+  ring->close();
+}
+
+// readAll reads from ring until the end of the stream.
+std::vector<uint8_t> readAll(SharedMemoryRing* ring, size_t bufferSize) {
+  std::vector<uint8_t> data;
+  std::vector<uint8_t> buffer(bufferSize);
+  while (uint64_t size = ring->read(buffer.data(), buffer.size())) {
+    data.insert(data.end(), buffer.begin(), buffer.begin() + size);
+  }
+  return data;
+}
+
+}  // anonymous namespace
+
+TEST(SharedMemoryRingTest, WriteRead) {
+  auto writer = SharedMemoryRing::create(kCapacity);
+  ASSERT_NE(nullptr, writer);
+  EXPECT_EQ(kCapacity, writer->capacity());
+  auto reader = SharedMemoryRing::open(writer->writerPid(), writer->fd());
+  ASSERT_NE(nullptr, reader);
+  EXPECT_EQ(kCapacity, reader->capacity());
+
+  // Chunk sizes that are not a divisor of the capacity wrap around the end of
+  // the ring.
+  auto data = pattern(10 * 1024 * 1024 + 13);
+  std::thread thread([&] { writeAll(writer.get(), data, 7777); });
+  EXPECT_EQ(data, readAll(reader.get(), 5000));
+  thread.join();
+}
+
+TEST(SharedMemoryRingTest, ReadAfterClose) {
+  auto writer = SharedMemoryRing::create(kCapacity);
+  ASSERT_NE(nullptr, writer);
+  auto reader = SharedMemoryRing::open(writer->writerPid(), writer->fd());
+  ASSERT_NE(nullptr, reader);
+
+  // Data written before the writer closes the ring is still read.
+  auto data = pattern(1000);
+  writeAll(writer.get(), data, data.size());
+  EXPECT_EQ(data, readAll(reader.get(), 300));
+  uint8_t buffer[16];
+  EXPECT_EQ(0, reader->read(buffer, sizeof(buffer)));
+}
+
+TEST(SharedMemoryRingTest, WriteAfterReaderClose) {
+  auto writer = SharedMemoryRing::create(kCapacity);
+  ASSERT_NE(nullptr, writer);
+  auto reader = SharedMemoryRing::open(writer->writerPid(), writer->fd());
+  ASSERT_NE(nullptr, reader);
+
+  // The writer blocks once the ring is full, until the reader closes.
+  auto data = pattern(3 * kCapacity);
+  std::thread thread([&] {
+    uint8_t buffer[1024];
+    EXPECT_EQ(sizeof(buffer), reader->read(buffer, sizeof(buffer)));
+    reader->close();
+  });
+  EXPECT_EQ(kCapacity + 1024, writer->write(data.data(), data.size()));
+  thread.join();
+}
+
+TEST(SharedMemoryRingTest, OpenRejectsOtherFiles) {
+  FILE* file = tmpfile();
+  ASSERT_NE(nullptr, file);
+  auto data = pattern(4096);
+  fwrite(data.data(), 1, data.size(), file);
+  fflush(file);
+  EXPECT_EQ(nullptr, SharedMemoryRing::open(getpid(), fileno(file)));
+  fclose(file);
+  EXPECT_EQ(nullptr, SharedMemoryRing::open(getpid(), -1));
+}
+
+}  // namespace test
+}  // namespace gapii
+
+#endif  // TARGET_OS == GAPID_OS_LINUX
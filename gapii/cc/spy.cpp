@@ -18,23 +18,31 @@
 
 #include "connection_header.h"
 #include "connection_stream.h"
+#include "flight_recorder.h"
+#include "framebuffer_downsampler.h"
 
 #include "gapil/runtime/cc/runtime.h"
 
 #include "gapii/cc/gles_exports.h"
 #include "gapii/cc/spy.h"
 
+#include "core/cc/compressed_writer.h"
+#include "core/cc/direct_file_writer.h"
 #include "core/cc/gl/formats.h"
 #include "core/cc/lock.h"
 #include "core/cc/log.h"
 #include "core/cc/target.h"
+#include "core/cc/timer.h"
+#include "core/cc/trace.h"
 #include "core/os/device/deviceinfo/cc/query.h"
 
 #include "gapis/api/gles/gles_pb/extras.pb.h"
 #include "gapis/capture/capture.pb.h"
 #include "gapis/memory/memory_pb/memory.pb.h"
 
+#include <inttypes.h>
 #include <cstdlib>
+#include <cstring>
 #include <memory>
 #include <vector>
 
@@ -94,12 +102,30 @@ const uint32_t kMaxFramebufferObservationWidth = 1920 / 2;
 const uint32_t kMaxFramebufferObservationHeight = 1280 / 2;
 
 const uint32_t kStartMidExecutionCapture = 0xdeadbeef;
+const uint32_t kFlushFlightRecorder = 0xf1167ec0;
+
+const uint64_t kDefaultFlightRecorderBufferSize = 256 * 1024 * 1024;
+
+// The capacity of the shared memory ring the capture is streamed through.
+const uint64_t kSharedMemoryStreamSize = 1024 * 1024;
+
+// If set, the capture is written to this file instead of being sent over the
+// connection to the server.
+const char* kCaptureFileEnv = "GAPII_CAPTURE_FILE";
+// If set to a non-zero value, the capture file is synced at each frame
+// boundary.
+const char* kCaptureFileSyncEnv = "GAPII_CAPTURE_FILE_SYNC";
 
 const int32_t kSuspendIndefinitely = -1;
 
 std::recursive_mutex gMutex;  // Guards gSpy.
 std::unique_ptr<gapii::Spy> gSpy;
 thread_local gapii::CallObserver* gContext = nullptr;
+// The observers of the commands intercepted on this thread, indexed by their
+// nesting depth, reused from one command to the next. They are destroyed when
+// the thread exits.
+thread_local std::vector<std::unique_ptr<gapii::CallObserver>> gObservers;
+thread_local size_t gDepth = 0;
 
 }  // anonymous namespace
 
@@ -121,6 +147,8 @@ Spy* Spy::get() {
 Spy::Spy()
     : mNumFrames(0),
       mSuspendCaptureFrames(0),
+      mFlushFlightRecorder(false),
+      mSyncCaptureFile(false),
       mCaptureFrames(0),
       mNumDraws(0),
       mNumDrawsPerFrame(0),
@@ -128,29 +156,62 @@ Spy::Spy()
       mObserveDrawFrequency(0),
       mDisablePrecompiledShaders(false),
       mRecordGLErrorState(false),
+      mPerThreadCapture(false),
       mNestedFrameStart(0),
       mNestedFrameEnd(0) {
+  ConnectionHeader header;
+  const char* captureFile = getenv(kCaptureFileEnv);
+  if (captureFile != nullptr && captureFile[0] != '\0') {
+    // Write the capture straight to a file, using the default settings.
+    mCaptureFile = core::DirectFileWriter::create(captureFile);
+    if (!mCaptureFile) {
+      GAPID_FATAL("Couldn't create capture file '%s'", captureFile);
+    }
+    const char* sync = getenv(kCaptureFileSyncEnv);
+    mSyncCaptureFile =
+        sync != nullptr && sync[0] != '\0' && strcmp(sync, "0") != 0;
+    GAPID_INFO("Capturing to file '%s' (direct: %s, sync each frame: %s)",
+               captureFile, mCaptureFile->is_direct() ? "true" : "false",
+               mSyncCaptureFile ? "true" : "false");
+    // The capture ends with the process. Close the file before gSpy is
+    // destroyed, as other static objects may already be gone by then.
+    atexit([] {
+      std::lock_guard<std::recursive_mutex> lock(gMutex);
+      if (gSpy && !gSpy->is_suspended()) {
+        gSpy->mEncoder->flush();
+        gSpy->endCapture();
+      }
+    });
+  } else {
 #if TARGET_OS == GAPID_OS_ANDROID
-  // Use a "localabstract" pipe on Android to prevent depending on the traced
-  // application having the INTERNET permission set, required for opening and
-  // listening on a TCP socket.
-  mConnection = ConnectionStream::listenPipe("gapii", true);
+    // Use a "localabstract" pipe on Android to prevent depending on the
+    // traced application having the INTERNET permission set, required for
+    // opening and listening on a TCP socket.
+    mConnection = ConnectionStream::listenPipe("gapii", true);
 #else   // TARGET_OS
-  mConnection = ConnectionStream::listenSocket("127.0.0.1", "9286");
+    mConnection = ConnectionStream::listenSocket("127.0.0.1", "9286");
 #endif  // TARGET_OS
 
-  if (!mConnection->write("gapii", 5)) {  // handshake magic
-    GAPID_FATAL("Couldn't send handshake magic");
-  }
+    if (!mConnection->write("gapii", 5)) {  // handshake magic
+      GAPID_FATAL("Couldn't send handshake magic");
+    }
 
-  GAPID_INFO("Connection made");
+    GAPID_INFO("Connection made");
 
-  ConnectionHeader header;
-  if (!header.read(mConnection.get())) {
-    GAPID_FATAL("Failed to read connection header");
-  }
+    if (!header.read(mConnection.get())) {
+      GAPID_FATAL("Failed to read connection header");
+    }
 
-  GAPID_INFO("Connection header read");
+    GAPID_INFO("Connection header read");
+
+    if (header.mFlags & ConnectionHeader::FLAG_SHARED_MEMORY_STREAM) {
+      if (mConnection->offerSharedMemory(kSharedMemoryStreamSize)) {
+        GAPID_INFO("Streaming the capture through shared memory");
+      } else {
+        GAPID_INFO("Shared memory declined, streaming through the connection");
+      }
+    }
+  }
 
   mObserveFrameFrequency = header.mObserveFrameFrequency;
   mObserveDrawFrequency = header.mObserveDrawFrequency;
@@ -158,8 +219,13 @@ Spy::Spy()
       (header.mFlags & ConnectionHeader::FLAG_DISABLE_PRECOMPILED_SHADERS) != 0;
   mRecordGLErrorState =
       (header.mFlags & ConnectionHeader::FLAG_RECORD_ERROR_STATE) != 0;
+  bool asyncFramebufferObservations =
+      (header.mFlags &
+       ConnectionHeader::FLAG_ASYNC_FRAMEBUFFER_OBSERVATIONS) != 0;
   SpyBase::mHideUnknownExtensions =
       (header.mFlags & ConnectionHeader::FLAG_HIDE_UNKNOWN_EXTENSIONS) != 0;
+  mPerThreadCapture =
+      (header.mFlags & ConnectionHeader::FLAG_PER_THREAD_CAPTURE) != 0;
   // This will be over-written if we also set the header flags
   mSuspendCaptureFrames = header.mStartFrame;
   mCaptureFrames = header.mNumFrames;
@@ -177,16 +243,67 @@ Spy::Spy()
              mDisablePrecompiledShaders ? "true" : "false");
   GAPID_INFO("Hide unknown extensions: %s",
              mHideUnknownExtensions ? "true" : "false");
+  GAPID_INFO("Asynchronous framebuffer observations: %s",
+             asyncFramebufferObservations ? "true" : "false");
+  GAPID_INFO("Per-thread capture: %s", mPerThreadCapture ? "true" : "false");
+
+  mFramebufferDownsampler.reset(new FramebufferDownsampler(
+      kMaxFramebufferObservationWidth, kMaxFramebufferObservationHeight,
+      asyncFramebufferObservations));
+
+  std::shared_ptr<core::StreamWriter> output = mConnection;
+  if (mCaptureFile) {
+    output = mCaptureFile;
+  }
+  if (header.mFlags & ConnectionHeader::FLAG_COMPRESS_STREAM) {
+    if (header.mFlags & ConnectionHeader::FLAG_NO_BUFFER) {
+      // The compressor holds the data back until a whole block is written.
+      GAPID_WARNING("Not compressing the unbuffered capture stream");
+    } else {
+      GAPID_INFO("Compressing the capture stream");
+      mCompressor.reset(new core::CompressedWriter(output, true));
+      output = mCompressor;
+    }
+  }
 
-  mEncoder = gapii::PackEncoder::create(
-      mConnection, header.mFlags & ConnectionHeader::FLAG_NO_BUFFER);
+  if (header.mFlightRecorderFrames != 0) {
+    uint64_t bufferSize = header.mFlightRecorderBufferSize != 0
+                              ? header.mFlightRecorderBufferSize
+                              : kDefaultFlightRecorderBufferSize;
+    GAPID_INFO("Flight recorder: retaining the last %d frames, up to %" PRIu64
+               " bytes",
+               header.mFlightRecorderFrames, bufferSize);
+    if (mSuspendCaptureFrames.load() != 0 || mCaptureFrames != 0) {
+      GAPID_WARNING(
+          "Start frame and frame count are ignored by the flight recorder");
+      mSuspendCaptureFrames.store(0);
+      mCaptureFrames = 0;
+    }
+    if (mPerThreadCapture) {
+      // The per-thread blocks are committed to the recorder outside the spy
+      // lock, and could straddle the snapshot that starts a segment.
+      GAPID_WARNING("Per-thread capture is disabled by the flight recorder");
+      mPerThreadCapture = false;
+    }
+    mFlightRecorder.reset(
+        new FlightRecorder(header.mFlightRecorderFrames, bufferSize));
+    mEncoder = gapii::PackEncoder::create(mFlightRecorder);
+  } else {
+    mEncoder = gapii::PackEncoder::create(
+        output, header.mFlags & ConnectionHeader::FLAG_NO_BUFFER);
+  }
 
   // writeHeader needs to come before the installer is created as the
   // deviceinfo queries want to call into EGL / GL commands which will be
   // patched.
   query::Option query_opt;
+  query_opt.cache_path = query::defaultCachePath();
+  core::Timer query_timer;
+  query_timer.Start();
   SpyBase::set_device_instance(
       query::getDeviceInstance(query_opt, queryPlatformData()));
+  GAPID_INFO("Device info query took %.1fms (cache: '%s')",
+             query_timer.Stop() / 1e6, query_opt.cache_path.c_str());
   SpyBase::set_current_abi(query::currentABI());
   if (!SpyBase::writeHeader()) {
     GAPID_ERROR("Failed at writing trace header.");
@@ -209,6 +326,21 @@ Spy::Spy()
   SpyBase::init(context);
   exit();
 
+  if (mFlightRecorder) {
+    // The first segment starts with the empty state.
+    mFlightRecorder->beginSegment();
+    mFlightRecorder->endSnapshot();
+    mFlushFlightRecorderJob =
+        std::unique_ptr<core::AsyncJob>(new core::AsyncJob([this]() {
+          uint32_t buffer;
+          if (4 == mConnection->read(&buffer, 4)) {
+            if (buffer == kFlushFlightRecorder) {
+              mFlushFlightRecorder.store(true);
+            }
+          }
+        }));
+  }
+
   if (mSuspendCaptureFrames.load() == kSuspendIndefinitely) {
     mDeferStartJob =
         std::unique_ptr<core::AsyncJob>(new core::AsyncJob([this]() {
@@ -227,8 +359,22 @@ Spy::Spy()
 void Spy::resolveImports() { GlesSpy::mImports.resolve(); }
 
 CallObserver* Spy::enter(const char* name, uint32_t api) {
-  auto ctx = new CallObserver(this, gContext, api);
+  GAPID_TRACE_BEGIN(name);
+  CallObserver* ctx;
+  if (gDepth < gObservers.size()) {
+    ctx = gObservers[gDepth].get();
+    ctx->reset(this, gContext, api);
+  } else {
+    ctx = new CallObserver(this, gContext, api);
+    gObservers.emplace_back(ctx);
+  }
+  gDepth++;
   lock(ctx);
+  // Commands recorded to a command buffer only touch the command buffer's
+  // state, which Vulkan requires to be externally synchronized.
+  if (mPerThreadCapture && strncmp(name, "vkCmd", 5) == 0) {
+    ctx->setThreadLocal();
+  }
   ctx->setCurrentCommandName(name);
   gContext = ctx;
   return ctx;
@@ -237,8 +383,17 @@ CallObserver* Spy::enter(const char* name, uint32_t api) {
 void Spy::exit() {
   auto context = gContext;
   gContext = context->getParent();
-  delete context;
+  // The block of a thread-local command is written to the stream once the
+  // spy has been unlocked.
+  PackEncoder::SPtr block;
+  if (context->isThreadLocal()) {
+    block = context->encoder();
+  }
+  context->release();
+  gDepth--;
   unlock();
+  block.reset();
+  GAPID_TRACE_END();
 }
 
 EGLBoolean Spy::eglInitialize(CallObserver* observer, EGLDisplay dpy,
@@ -490,12 +645,34 @@ void Spy::saveInitialStateForApi(const char* name) {
 }
 
 void Spy::onPostFrameBoundary(bool isStartOfFrame) {
+  if (mSyncCaptureFile && !is_suspended()) {
+    mEncoder->flush();
+    if (!mCaptureFile->sync()) {
+      GAPID_WARNING("Failed to sync the capture file");
+    }
+  }
+  if (mFlightRecorder) {
+    if (mFlushFlightRecorder.exchange(false)) {
+      flushFlightRecorder();
+    } else if (!is_suspended() && mFlightRecorder->frame()) {
+      // Start a new segment with a snapshot of the current state, so that
+      // the older segments can be discarded. The recorder keeps the
+      // resources already sent, until it starts a new generation.
+      if (mFlightRecorder->beginSegment()) {
+        resetResources();
+      }
+      exit();
+      saveInitialState();
+      enter("RecreateState", 2);
+      mFlightRecorder->endSnapshot();
+    }
+    return;
+  }
   if (!is_suspended() && mCaptureFrames >= 1) {
     mCaptureFrames -= 1;
     if (mCaptureFrames == 0) {
       mEncoder->flush();
-      mConnection->close();
-      set_suspended(true);
+      endCapture();
     }
   }
   if (mSuspendCaptureFrames.load() > 0) {
@@ -508,6 +685,38 @@ void Spy::onPostFrameBoundary(bool isStartOfFrame) {
   }
 }
 
+void Spy::flushFlightRecorder() {
+  GAPID_INFO("Flushing the last %d frames", mFlightRecorder->frames());
+  std::shared_ptr<core::StreamWriter> output = mConnection;
+  if (mCaptureFile) {
+    output = mCaptureFile;
+  }
+  if (mCompressor) {
+    output = mCompressor;
+  }
+  if (!PackEncoder::writeHeader(output.get()) ||
+      !mFlightRecorder->writeTo(output.get())) {
+    GAPID_WARNING("Failed to send the flight recorder frames");
+  }
+  endCapture();
+  mFlightRecorder->clear();
+}
+
+void Spy::endCapture() {
+  if (mCompressor) {
+    mCompressor->flush();
+  }
+  if (mCaptureFile) {
+    // Writes the last partial buffer and truncates the file to its size.
+    if (!mCaptureFile->close()) {
+      GAPID_WARNING("Failed to write the capture file");
+    }
+  } else {
+    mConnection->close();
+  }
+  set_suspended(true);
+}
+
 void Spy::onPostStartOfFrame() {
   GAPID_ASSERT(mNestedFrameStart > 0);
   if (--mNestedFrameStart == 0) {
@@ -541,58 +750,6 @@ void Spy::onPostEndOfFrame() {
   }
 }
 
-static bool downsamplePixels(const std::vector<uint8_t>& srcData, uint32_t srcW,
-                             uint32_t srcH, std::vector<uint8_t>* outData,
-                             uint32_t* outW, uint32_t* outH, uint32_t maxW,
-                             uint32_t maxH) {
-  // Calculate the minimal scaling factor as integer fraction.
-  uint32_t mul = 1;
-  uint32_t div = 1;
-  if (mul * srcW > maxW * div) {  // if mul/div > maxW/srcW
-    mul = maxW;
-    div = srcW;
-  }
-  if (mul * srcH > maxH * div) {  // if mul/div > maxH/srcH
-    mul = maxH;
-    div = srcH;
-  }
-
-  // Calculate the final dimensions (round up) and allocate new buffer.
-  uint32_t dstW = (srcW * mul + div - 1) / div;
-  uint32_t dstH = (srcH * mul + div - 1) / div;
-  outData->reserve(dstW * dstH * 4);
-
-  // Downsample the image by averaging the colours of neighbouring pixels.
-  for (uint32_t srcY = 0, y = 0, dstY = 0; dstY < dstH; srcY = y, dstY++) {
-    for (uint32_t srcX = 0, x = 0, dstX = 0; dstX < dstW; srcX = x, dstX++) {
-      uint32_t r = 0, g = 0, b = 0, a = 0, n = 0;
-      // We need to loop over srcX/srcY ranges several times, so we keep them in
-      // x/y, and we update srcX/srcY to the last x/y only once we are done with
-      // the pixel.
-      for (y = srcY; y * dstH < (dstY + 1) * srcH;
-           y++) {  // while y*yScale < dstY+1
-        const uint8_t* src = &srcData[(srcX + y * srcW) * 4];
-        for (x = srcX; x * dstW < (dstX + 1) * srcW;
-             x++) {  // while x*xScale < dstX+1
-          r += *(src++);
-          g += *(src++);
-          b += *(src++);
-          a += *(src++);
-          n += 1;
-        }
-      }
-      outData->push_back(r / n);
-      outData->push_back(g / n);
-      outData->push_back(b / n);
-      outData->push_back(a / n);
-    }
-  }
-
-  *outW = dstW;
-  *outH = dstH;
-  return true;
-}
-
 // observeFramebuffer captures the currently bound framebuffer, and writes
 // it to a FramebufferObservation extra.
 void Spy::observeFramebuffer(CallObserver* observer, uint8_t api) {
@@ -617,18 +774,14 @@ void Spy::observeFramebuffer(CallObserver* observer, uint8_t api) {
       break;
   }
 
-  uint32_t downsampledW, downsampledH;
-  std::vector<uint8_t> downsampledData;
-  if (downsamplePixels(data, w, h, &downsampledData, &downsampledW,
-                       &downsampledH, kMaxFramebufferObservationWidth,
-                       kMaxFramebufferObservationHeight)) {
-    auto observation = new capture::FramebufferObservation();
-    observation->set_original_width(w);
-    observation->set_original_height(h);
-    observation->set_data_width(downsampledW);
-    observation->set_data_height(downsampledH);
-    observation->set_data(downsampledData.data(), downsampledData.size());
-    observer->encodeAndDelete(observation);
+  auto job = mFramebufferDownsampler->downsample(std::move(data), w, h);
+  if (mFramebufferDownsampler->is_async()) {
+    // Let the downsample overlap with the rest of the command, and encode the
+    // observation just before the command's group is closed.
+    observer->defer(
+        [observer, job] { observer->encodeAndDelete(job->wait()); });
+  } else {
+    observer->encodeAndDelete(job->wait());
   }
 }
 
@@ -26,8 +26,15 @@
 #include <memory>
 #include <unordered_map>
 
+namespace core {
+class CompressedWriter;
+class DirectFileWriter;
+}  // namespace core
+
 namespace gapii {
 class ConnectionStream;
+class FlightRecorder;
+class FramebufferDownsampler;
 class Spy : public GlesSpy, public GvrSpy, public VulkanSpy {
  public:
   // get lazily constructs and returns the singleton instance to the spy.
@@ -115,6 +122,14 @@ class Spy : public GlesSpy, public GvrSpy, public VulkanSpy {
   // onPostFrameBoundary is called from onPost{Start,End}OfFrame().
   void onPostFrameBoundary(bool isStartOfFrame);
 
+  // flushFlightRecorder sends the frames retained by the flight recorder to
+  // the server and ends the capture.
+  void flushFlightRecorder();
+
+  // endCapture flushes the compressor, closes the connection or the capture
+  // file, and suspends the capture.
+  void endCapture();
+
   std::unordered_map<std::string, void*> mSymbols;
 
   int mNumFrames;
@@ -124,6 +139,16 @@ class Spy : public GlesSpy, public GvrSpy, public VulkanSpy {
 
   // The connection stream to the server
   std::shared_ptr<ConnectionStream> mConnection;
+  // Compresses the data written to mConnection, if enabled.
+  std::shared_ptr<core::CompressedWriter> mCompressor;
+  // Retains the most recent frames instead of streaming them, if enabled.
+  std::shared_ptr<FlightRecorder> mFlightRecorder;
+  // Set when the server requests the flight recorder frames.
+  std::atomic<bool> mFlushFlightRecorder;
+  // The file the capture is written to instead of mConnection, if any.
+  std::shared_ptr<core::DirectFileWriter> mCaptureFile;
+  // If true, mCaptureFile is synced at each frame boundary.
+  bool mSyncCaptureFile;
   // The number of frames that we want to capture
   int mCaptureFrames;
   int mNumDraws;
@@ -132,12 +157,18 @@ class Spy : public GlesSpy, public GvrSpy, public VulkanSpy {
   int mObserveDrawFrequency;
   bool mDisablePrecompiledShaders;
   bool mRecordGLErrorState;
+  // If true, vkCmd* commands are captured without holding the spy lock for
+  // their driver calls, and are encoded to per-thread blocks.
+  bool mPerThreadCapture;
   // These keep track of nested frame start/end callbacks.
   int mNestedFrameStart;
   int mNestedFrameEnd;
 
   std::unordered_map<ContextID, GLenum_Error> mFakeGlError;
   std::unique_ptr<core::AsyncJob> mDeferStartJob;
+  std::unique_ptr<core::AsyncJob> mFlushFlightRecorderJob;
+  // Downsamples the framebuffer observations.
+  std::unique_ptr<FramebufferDownsampler> mFramebufferDownsampler;
 };
 
 }  // namespace gapii
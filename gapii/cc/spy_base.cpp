@@ -21,10 +21,19 @@
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
 
+#include <algorithm>
+
 // CurrentCaptureVersion is incremented on breaking changes to the capture
 // format. NB: Also update equally named field in capture.go
 static const int CurrentCaptureVersion = 3;
 
+// Observed ranges of at least this many bytes are held by the content cache
+// once they have been observed twice.
+static const size_t kMinCachedRangeSize = 64 * 1024;
+
+// The limit for the content held by the content cache.
+static const size_t kMaxContentCacheSize = 64 * 1024 * 1024;
+
 using core::Interval;
 
 namespace gapii {
@@ -39,6 +48,8 @@ SpyBase::SpyBase()
       mDeviceInstance(nullptr),
       mCurrentABI(nullptr),
       mResources{{core::Id{{0}}, 0}},
+      mNextResourceIndex(1),
+      mContentCache(kMinCachedRangeSize, kMaxContentCacheSize),
       mObserveApplicationPool(true),
       mWatchedApis(0xFFFFFFFF),
       mIsRecordingState(false) {
@@ -60,8 +71,33 @@ void SpyBase::abort() {
 
 int64_t SpyBase::sendResource(uint8_t api, const void* data, size_t size) {
   GAPID_ASSERT(should_trace(api));
-  auto hash = core::Id::Hash(data, size);
+  return sendResource(api, core::Id::Hash(data, size), data, size);
+}
 
+bool SpyBase::sendResourcePages(uint8_t api, const void* data, size_t size,
+                                std::vector<int64_t>* indices) {
+  GAPID_ASSERT(should_trace(api));
+  std::lock_guard<std::mutex> lock(mContentCacheMutex);
+  auto pages = mContentCache.update(data, size);
+  if (pages == nullptr) {
+    return false;
+  }
+  auto bytes = reinterpret_cast<const uint8_t*>(data);
+  indices->resize(pages->size());
+  for (size_t i = 0; i < pages->size(); i++) {
+    auto& page = (*pages)[i];
+    if (page.index < 0) {
+      size_t offset = i * ContentCache::kPageSize;
+      size_t length = std::min(ContentCache::kPageSize, size - offset);
+      page.index = sendResource(api, page.id, bytes + offset, length);
+    }
+    (*indices)[i] = page.index;
+  }
+  return true;
+}
+
+int64_t SpyBase::sendResource(uint8_t api, const core::Id& hash,
+                              const void* data, size_t size) {
   // Fast-path if resource with the same hash was already send.
   {
     std::lock_guard<std::mutex> lock(mResourcesMutex);
@@ -75,9 +111,10 @@ int64_t SpyBase::sendResource(uint8_t api, const void* data, size_t size) {
   capture::Resource resource;
   resource.set_data(data, size);
   std::lock_guard<std::mutex> lock(mResourcesMutex);
-  auto res = mResources.emplace(hash, mResources.size());
+  auto res = mResources.emplace(hash, mNextResourceIndex);
   int64_t index = res.first->second;
   if (res.second) {  // Inserted/new.
+    mNextResourceIndex++;
     // Keep the resource mutex during send to ensure other thread
     // can not read the index and reference it before we send it.
     resource.set_index(index);
@@ -87,6 +124,14 @@ int64_t SpyBase::sendResource(uint8_t api, const void* data, size_t size) {
   return index;
 }
 
+void SpyBase::resetResources() {
+  std::lock_guard<std::mutex> cacheLock(mContentCacheMutex);
+  mContentCache.resetIndices();
+  std::lock_guard<std::mutex> lock(mResourcesMutex);
+  mResources.clear();
+  mResources.emplace(core::Id{{0}}, 0);
+}
+
 bool SpyBase::writeHeader() {
   capture::Header file_header;
   file_header.set_version(CurrentCaptureVersion);
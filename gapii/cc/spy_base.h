@@ -19,6 +19,7 @@
 
 #include "abort_exception.h"
 #include "call_observer.h"
+#include "content_cache.h"
 #include "pack_encoder.h"
 
 #include "core/cc/assert.h"
@@ -45,6 +46,7 @@
 #include <mutex>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 namespace gapii {
 const uint8_t kAllAPIs = 0xFF;
@@ -68,6 +70,19 @@ class SpyBase {
   // Returns the index of the resource which can be used to reference it.
   int64_t sendResource(uint8_t api, const void* data, size_t size);
 
+  // Like sendResource, but sends the data as a resource per
+  // ContentCache::kPageSize page if the range is held by the content cache,
+  // so that only the pages that changed since the range was last observed
+  // are hashed and sent. Returns false, without sending anything, if the
+  // range is not cached; otherwise sets indices to the resource index of
+  // each page.
+  bool sendResourcePages(uint8_t api, const void* data, size_t size,
+                         std::vector<int64_t>* indices);
+
+  // Forgets all the resources that have been sent, so that they are sent
+  // again when next referenced. Resource indices keep increasing.
+  void resetResources();
+
   // writeHeader encodes a header with current tracing device and
   // ABI info then return true, if the encoder is ready. Otherwise returns
   // false.
@@ -192,6 +207,11 @@ class SpyBase {
   template <class T>
   bool shouldObserve(const gapil::Slice<T>& slice) const;
 
+  // Encode and write the data blob with the given hash if we have not already
+  // sent it.
+  int64_t sendResource(uint8_t api, const core::Id& hash, const void* data,
+                       size_t size);
+
   // Memory arena.
   core::Arena mArena;
 
@@ -207,8 +227,14 @@ class SpyBase {
 
   // The list of resources that have already been encoded and sent.
   std::unordered_map<core::Id, int64_t> mResources;
+  int64_t mNextResourceIndex;
   std::mutex mResourcesMutex;
 
+  // The content of the large ranges that are observed repeatedly.
+  // Locked before mResourcesMutex when both are held.
+  ContentCache mContentCache;
+  std::mutex mContentCacheMutex;
+
   // The mutex that should be locked for the duration of each of the intercepted
   // commands.
   std::recursive_mutex mMutex;
@@ -54,6 +54,10 @@ type Process struct {
 
 	// The connection
 	conn net.Conn
+
+	// The shared memory ring the capture is read from instead of conn, if the
+	// interceptor offered one.
+	ring *sharedMemoryRing
 }
 
 // Start launches an activity on an android device with the GAPII interceptor
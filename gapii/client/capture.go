@@ -51,6 +51,21 @@ const (
 	// HideUnkownExtensions will prevent any unknown extensions from being
 	// seen by the application
 	HideUnknownExtensions Flags = 0x00000040
+	// AsyncFramebufferObservations downsamples framebuffer observations on a
+	// background thread, overlapping the work with the application.
+	AsyncFramebufferObservations Flags = 0x00000080
+	// CompressStream compresses the capture stream on a background thread
+	// in the interceptor. The stream is decompressed by Capture. It is
+	// ignored with NoBuffer, as the compressor holds back partial blocks.
+	CompressStream Flags = 0x00000100
+	// PerThreadCapture captures commands recorded to command buffers on
+	// different threads concurrently, encoding each to a per-thread block.
+	// It cannot be used with the flight recorder.
+	PerThreadCapture Flags = 0x00000200
+	// SharedMemoryStream asks the interceptor to offer a shared memory ring to
+	// stream the capture through, instead of the connection. It falls back
+	// to the connection if the ring cannot be opened.
+	SharedMemoryStream Flags = 0x00000400
 
 	// GlesAPI is hard-coded bit mask for GLES API, it needs to be kept in sync
 	// with the api_index in the gles.api file.
@@ -79,11 +94,18 @@ type Options struct {
 	Flags Flags
 	// Additional flags to pass to am start
 	AdditionalFlags string
+	// If non-zero, then only the last n frames are retained in memory until
+	// the capture is flushed.
+	FlightRecorderFrames uint32
+	// The maximum number of bytes retained by the flight recorder.
+	// If zero, the interceptor uses its default limit.
+	FlightRecorderBufferSize uint64
 }
 
 const sizeGap = 1024 * 1024 * 5
 const timeGap = time.Second
 const startMidExecutionCapture = 0xdeadbeef
+const flushFlightRecorder = 0xf1167ec0
 
 type siSize int64
 
@@ -109,6 +131,12 @@ func (s siSize) String() string {
 }
 
 func (p *Process) connect(ctx context.Context, gvrHandle uint64, interceptorPath string) error {
+	if p.Options.FlightRecorderFrames != 0 && (p.Options.Flags&PerThreadCapture) != 0 {
+		// The per-thread blocks are committed outside the spy lock, which the
+		// flight recorder needs to start its segments at frame boundaries.
+		return log.Err(ctx, nil, "Per-thread capture cannot be used with the flight recorder")
+	}
+
 	log.I(ctx, "Waiting for connection to localhost:%d...", p.Port)
 
 	// ADB has an annoying tendancy to insta-close forwarded sockets when
@@ -134,16 +162,64 @@ func (p *Process) connect(ctx context.Context, gvrHandle uint64, interceptorPath
 			conn.Close()
 			return true, log.Err(ctx, err, "Failed to send header")
 		}
+		if (p.Options.Flags & SharedMemoryStream) != 0 {
+			conn.SetReadDeadline(time.Now().Add(time.Second))
+			ring, err := acceptSharedMemory(ctx, r, conn)
+			if err != nil {
+				conn.Close()
+				return true, log.Err(ctx, err, "Failed to negotiate shared memory")
+			}
+			p.ring = ring
+		}
+		conn.SetReadDeadline(time.Time{})
 		p.conn = conn
 		return true, nil
 	})
 }
 
+// acceptSharedMemory reads the shared memory ring offered by the interceptor
+// after the header, and answers whether it could open it. It returns nil if
+// the capture is to be read from the connection.
+// The offer is the uint32 process id of the interceptor and the int32 file
+// descriptor of the ring, -1 if it has none. The answer is a uint32, 1 if the
+// ring is used. All changes must be kept in sync with
+// gapii/cc/connection_stream.cpp.
+func acceptSharedMemory(ctx context.Context, in io.Reader, out io.Writer) (*sharedMemoryRing, error) {
+	r := endian.Reader(in, device.LittleEndian)
+	pid, fd := r.Uint32(), r.Int32()
+	if err := r.Error(); err != nil {
+		return nil, err
+	}
+	if fd < 0 {
+		log.I(ctx, "The interceptor has no shared memory ring")
+		return nil, nil
+	}
+	ring, err := openSharedMemoryRing(pid, fd)
+	accepted := uint32(0)
+	if err != nil {
+		log.W(ctx, "Couldn't open the shared memory ring: %v", err)
+	} else {
+		log.I(ctx, "Receiving the capture through shared memory")
+		accepted = 1
+	}
+	w := endian.Writer(out, device.LittleEndian)
+	w.Uint32(accepted)
+	if err := w.Error(); err != nil {
+		if ring != nil {
+			ring.Close()
+		}
+		return nil, err
+	}
+	return ring, nil
+}
+
 // Capture opens up the specified port and then waits for a capture to be
 // delivered using the specified capture options o.
 // It copies the capture into the supplied writer.
 // If the process was started with the DeferStart flag, then tracing will wait
 // until s is fired.
+// If the process was started with the flight recorder enabled, then the
+// retained frames are sent once s is fired.
 func (p *Process) Capture(ctx context.Context, s task.Signal, w io.Writer, written *int64) (size int64, err error) {
 	stopTiming := analytics.SendTiming("trace", "duration")
 	defer func() {
@@ -167,6 +243,21 @@ func (p *Process) Capture(ctx context.Context, s task.Signal, w io.Writer, writt
 	conn := p.conn
 	defer conn.Close()
 
+	var in io.Reader = conn
+	setReadDeadline := conn.SetReadDeadline
+	if ring := p.ring; ring != nil {
+		defer ring.Close()
+		in, setReadDeadline = ring, ring.SetReadDeadline
+	}
+
+	var out io.Writer = w
+	var d *decompressor
+	if (p.Options.Flags&CompressStream) != 0 && (p.Options.Flags&NoBuffer) == 0 {
+		d = newDecompressor(w)
+		out = d
+	}
+
+	flightRecorder := p.Options.FlightRecorderFrames != 0
 	var count siSize
 	started := false
 	for {
@@ -174,7 +265,13 @@ func (p *Process) Capture(ctx context.Context, s task.Signal, w io.Writer, writt
 			log.I(ctx, "Stop: %v", count)
 			break
 		}
-		if (p.Options.Flags & DeferStart) != 0 {
+		if flightRecorder {
+			if !started && s.Fired() {
+				started = true
+				w := endian.Writer(conn, device.LittleEndian)
+				w.Uint32(flushFlightRecorder)
+			}
+		} else if (p.Options.Flags & DeferStart) != 0 {
 			if !started && s.Fired() {
 				started = true
 				w := endian.Writer(conn, device.LittleEndian)
@@ -182,10 +279,14 @@ func (p *Process) Capture(ctx context.Context, s task.Signal, w io.Writer, writt
 			}
 		}
 		now := time.Now()
-		conn.SetReadDeadline(now.Add(time.Millisecond * 500)) // Allow for stop event and UI refreshes.
-		n, err := io.CopyN(w, conn, 1024*64)
+		setReadDeadline(now.Add(time.Millisecond * 500)) // Allow for stop event and UI refreshes.
+		n, err := io.CopyN(out, in, 1024*64)
 		count += siSize(n)
-		atomic.StoreInt64(written, int64(count))
+		if d != nil {
+			atomic.StoreInt64(written, d.size)
+		} else {
+			atomic.StoreInt64(written, int64(count))
+		}
 		switch {
 		case errors.Cause(err) == io.EOF:
 			// End of stream. End.
@@ -199,6 +300,10 @@ func (p *Process) Capture(ctx context.Context, s task.Signal, w io.Writer, writt
 				return int64(count), err
 			}
 		case err != nil && count == 0:
+			if err, isnet := err.(net.Error); flightRecorder && isnet && err.Timeout() {
+				// The flight recorder sends nothing until it is flushed.
+				continue
+			}
 			// Got an error without receiving a byte of data.
 			// Treat failure-to-connect as target-not-ready instead of an error.
 			return 0, nil
@@ -0,0 +1,102 @@
+// Copyright (C) 2018 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package client
+
+import (
+	"bytes"
+	"compress/zlib"
+	"encoding/binary"
+	"io"
+
+	"github.com/pkg/errors"
+)
+
+const (
+	// blockHeaderSize is the size of a compressed block's frame header:
+	// uint32 compressed size followed by uint32 uncompressed size.
+	blockHeaderSize = 8
+	// maxBlockSize is the largest uncompressed block size accepted.
+	maxBlockSize = 64 * 1024 * 1024
+)
+
+// decompressor is an io.Writer that decodes the block-framed stream written
+// by the interceptor's core::CompressedWriter, and writes the decompressed
+// data to out.
+// Each block is framed as a little-endian uint32 compressed size, followed by
+// a little-endian uint32 uncompressed size and the zlib compressed data. If
+// both sizes are equal then the block data is stored uncompressed.
+type decompressor struct {
+	out     io.Writer
+	pending []byte // Bytes of the partially received block.
+	block   []byte // Decompression buffer.
+	zlib    io.ReadCloser
+	size    int64 // Number of decompressed bytes written to out.
+}
+
+func newDecompressor(out io.Writer) *decompressor {
+	return &decompressor{out: out}
+}
+
+// Write implements io.Writer.
+func (d *decompressor) Write(p []byte) (int, error) {
+	d.pending = append(d.pending, p...)
+	offset := 0
+	for len(d.pending)-offset >= blockHeaderSize {
+		header := d.pending[offset:]
+		compressedSize := int(binary.LittleEndian.Uint32(header))
+		size := int(binary.LittleEndian.Uint32(header[4:]))
+		if size > maxBlockSize || compressedSize > maxBlockSize {
+			return 0, errors.Errorf("Invalid compressed block (%d -> %d bytes)", compressedSize, size)
+		}
+		if len(header)-blockHeaderSize < compressedSize {
+			break
+		}
+		data := header[blockHeaderSize : blockHeaderSize+compressedSize]
+		if compressedSize != size {
+			var err error
+			if data, err = d.decompress(data, size); err != nil {
+				return 0, err
+			}
+		}
+		if _, err := d.out.Write(data); err != nil {
+			return 0, err
+		}
+		d.size += int64(size)
+		offset += blockHeaderSize + compressedSize
+	}
+	d.pending = d.pending[:copy(d.pending, d.pending[offset:])]
+	return len(p), nil
+}
+
+func (d *decompressor) decompress(data []byte, size int) ([]byte, error) {
+	in := bytes.NewReader(data)
+	if d.zlib == nil {
+		r, err := zlib.NewReader(in)
+		if err != nil {
+			return nil, errors.Wrap(err, "Decompressing block")
+		}
+		d.zlib = r
+	} else if err := d.zlib.(zlib.Resetter).Reset(in, nil); err != nil {
+		return nil, errors.Wrap(err, "Decompressing block")
+	}
+	if cap(d.block) < size {
+		d.block = make([]byte, size)
+	}
+	out := d.block[:size]
+	if _, err := io.ReadFull(d.zlib, out); err != nil {
+		return nil, errors.Wrap(err, "Decompressing block")
+	}
+	return out, nil
+}
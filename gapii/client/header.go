@@ -23,7 +23,7 @@ import (
 
 var magic = [4]byte{'s', 'p', 'y', '0'}
 
-const version = 1
+const version = 2
 
 // The GAPII header is defined as:
 //
@@ -31,14 +31,18 @@ const version = 1
 //
 // struct ConnectionHeader {
 //     uint8_t  mMagic[4];                     // 's', 'p', 'y', '0'
-//     uint32_t mVersion;                      // 1
+//     uint32_t mVersion;                      // 2
 //     uint32_t mObserveFrameFrequency;        // non-zero == enabled.
 //     uint32_t mObserveDrawFrequency;         // non-zero == enabled.
 //     uint32_t mStartFrame;                   // non-zero == Frame to start at.
 //     uint32_t mNumFrames;                    // non-zero == Number of frames to capture.
 //     uint32_t mAPIs;                         // Bitset of APIS to enable.
 //     uint32_t mFlags;                        // Combination of FLAG_XX bits.
+//     uint64_t mGvrHandle;                    // Handle of GVR library.
 //     char     mLibInterceptorPath[MAX_PATH]; // Path to libinterceptor.so
+//     // Version 2:
+//     uint32_t mFlightRecorderFrames;         // non-zero == Frames to retain.
+//     uint64_t mFlightRecorderBufferSize;     // Retained bytes limit, 0 == default.
 // };
 //
 // All fields are encoded little-endian with no compression, regardless of
@@ -62,5 +66,7 @@ func sendHeader(out io.Writer, options Options, gvrHandle uint64, libInterceptor
 	var path [maxPath]byte
 	copy(path[:], libInterceptorPath)
 	w.Data(path[:])
+	w.Uint32(options.FlightRecorderFrames)
+	w.Uint64(options.FlightRecorderBufferSize)
 	return w.Error()
 }
@@ -0,0 +1,198 @@
+// Copyright (C) 2018 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// +build linux
+
+package client
+
+import (
+	"encoding/binary"
+	"fmt"
+	"io"
+	"os"
+	"sync/atomic"
+	"syscall"
+	"time"
+	"unsafe"
+
+	"github.com/pkg/errors"
+)
+
+// The layout of the shared memory ring header. All changes must be kept in
+// sync with gapii/cc/shared_memory_ring.h.
+const (
+	ringMagic         = "ring"
+	ringVersion       = 1
+	ringVersionOffset = 4
+	ringCapacity      = 8
+	ringHead          = 64
+	ringDataSeq       = 72
+	ringWriterWaiting = 76
+	ringWriterClosed  = 80
+	ringWriterPid     = 84
+	ringTail          = 128
+	ringSpaceSeq      = 136
+	ringReaderWaiting = 140
+	ringReaderClosed  = 144
+	ringReaderPid     = 148
+	ringHeaderSize    = 256
+
+	futexWait = 0
+	futexWake = 1
+
+	// maxRingWait is the longest time Read waits before checking that the
+	// interceptor is still alive.
+	maxRingWait = time.Second
+)
+
+// sharedMemoryRing is an io.Reader of the capture stream written by the
+// interceptor to a shared memory ring.
+type sharedMemoryRing struct {
+	mem      []byte
+	data     []byte
+	deadline time.Time
+}
+
+// ringTimeout is the net.Error returned by sharedMemoryRing.Read when the read
+// deadline passed.
+type ringTimeout struct{}
+
+func (ringTimeout) Error() string   { return "shared memory ring read timeout" }
+func (ringTimeout) Timeout() bool   { return true }
+func (ringTimeout) Temporary() bool { return true }
+
+// openSharedMemoryRing maps the shared memory ring of the process pid, open as
+// its file descriptor fd.
+func openSharedMemoryRing(pid uint32, fd int32) (*sharedMemoryRing, error) {
+	f, err := os.OpenFile(fmt.Sprintf("/proc/%d/fd/%d", pid, fd), os.O_RDWR, 0)
+	if err != nil {
+		return nil, err
+	}
+	defer f.Close()
+	info, err := f.Stat()
+	if err != nil {
+		return nil, err
+	}
+	size := info.Size()
+	if size < ringHeaderSize {
+		return nil, errors.Errorf("Shared memory ring too small: %d bytes", size)
+	}
+	mem, err := syscall.Mmap(int(f.Fd()), 0, int(size), syscall.PROT_READ|syscall.PROT_WRITE, syscall.MAP_SHARED)
+	if err != nil {
+		return nil, err
+	}
+	capacity := binary.LittleEndian.Uint64(mem[ringCapacity:])
+	if string(mem[:len(ringMagic)]) != ringMagic ||
+		binary.LittleEndian.Uint32(mem[ringVersionOffset:]) != ringVersion ||
+		capacity == 0 || capacity&(capacity-1) != 0 ||
+		ringHeaderSize+capacity > uint64(size) {
+		syscall.Munmap(mem)
+		return nil, errors.Errorf("Not a shared memory ring")
+	}
+	r := &sharedMemoryRing{mem: mem, data: mem[ringHeaderSize : ringHeaderSize+capacity]}
+	atomic.StoreUint32(r.uint32(ringReaderPid), uint32(os.Getpid()))
+	return r, nil
+}
+
+func (r *sharedMemoryRing) uint32(offset int) *uint32 {
+	return (*uint32)(unsafe.Pointer(&r.mem[offset]))
+}
+
+func (r *sharedMemoryRing) uint64(offset int) *uint64 {
+	return (*uint64)(unsafe.Pointer(&r.mem[offset]))
+}
+
+// SetReadDeadline sets the time after which Read returns a timeout error if
+// no data is available. A zero value disables the deadline.
+func (r *sharedMemoryRing) SetReadDeadline(t time.Time) error {
+	r.deadline = t
+	return nil
+}
+
+// Read implements io.Reader. It returns io.EOF once the interceptor closed
+// the ring or exited, and all its data was read.
+func (r *sharedMemoryRing) Read(p []byte) (int, error) {
+	if len(p) == 0 {
+		return 0, nil
+	}
+	tail := atomic.LoadUint64(r.uint64(ringTail))
+	head := atomic.LoadUint64(r.uint64(ringHead))
+	for head == tail {
+		seq := atomic.LoadUint32(r.uint32(ringDataSeq))
+		if atomic.LoadUint32(r.uint32(ringWriterClosed)) != 0 ||
+			!processAlive(atomic.LoadUint32(r.uint32(ringWriterPid))) {
+			// The interceptor closes the ring after its last write.
+			if head = atomic.LoadUint64(r.uint64(ringHead)); head == tail {
+				return 0, io.EOF
+			}
+			break
+		}
+		timeout := maxRingWait
+		if !r.deadline.IsZero() {
+			if timeout = time.Until(r.deadline); timeout <= 0 {
+				return 0, ringTimeout{}
+			} else if timeout > maxRingWait {
+				timeout = maxRingWait
+			}
+		}
+		// The interceptor wakes the reader only if it sees it waiting, so the
+		// head is checked again after announcing it.
+		atomic.StoreUint32(r.uint32(ringReaderWaiting), 1)
+		if atomic.LoadUint64(r.uint64(ringHead)) == tail {
+			r.wait(ringDataSeq, seq, timeout)
+		}
+		atomic.StoreUint32(r.uint32(ringReaderWaiting), 0)
+		head = atomic.LoadUint64(r.uint64(ringHead))
+	}
+	n := head - tail
+	if n > uint64(len(p)) {
+		n = uint64(len(p))
+	}
+	offset := tail & uint64(len(r.data)-1)
+	c := copy(p[:n], r.data[offset:])
+	copy(p[c:n], r.data)
+	atomic.StoreUint64(r.uint64(ringTail), tail+n)
+	if atomic.LoadUint32(r.uint32(ringWriterWaiting)) != 0 {
+		r.wake(ringSpaceSeq)
+	}
+	return int(n), nil
+}
+
+// Close marks the ring as closed by the reader, which stops the interceptor
+// from writing to it, and unmaps it.
+func (r *sharedMemoryRing) Close() error {
+	atomic.StoreUint32(r.uint32(ringReaderClosed), 1)
+	r.wake(ringSpaceSeq)
+	return syscall.Munmap(r.mem)
+}
+
+// wait blocks until the futex at offset no longer holds value, it is woken,
+// or timeout passed.
+func (r *sharedMemoryRing) wait(offset int, value uint32, timeout time.Duration) {
+	ts := syscall.NsecToTimespec(int64(timeout))
+	syscall.Syscall6(syscall.SYS_FUTEX, uintptr(unsafe.Pointer(r.uint32(offset))),
+		futexWait, uintptr(value), uintptr(unsafe.Pointer(&ts)), 0, 0)
+}
+
+// wake changes the value of the futex at offset and wakes its waiter.
+func (r *sharedMemoryRing) wake(offset int) {
+	atomic.AddUint32(r.uint32(offset), 1)
+	syscall.Syscall6(syscall.SYS_FUTEX, uintptr(unsafe.Pointer(r.uint32(offset))),
+		futexWake, 1, 0, 0, 0)
+}
+
+// processAlive returns false if the process pid, when set, has exited.
+func processAlive(pid uint32) bool {
+	return pid == 0 || syscall.Kill(int(pid), 0) != syscall.ESRCH
+}
@@ -0,0 +1,35 @@
+// Copyright (C) 2018 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// +build !linux
+
+package client
+
+import (
+	"time"
+
+	"github.com/pkg/errors"
+)
+
+// sharedMemoryRing is an io.Reader of the capture stream written by the
+// interceptor to a shared memory ring. Rings are only supported on Linux.
+type sharedMemoryRing struct{}
+
+func openSharedMemoryRing(pid uint32, fd int32) (*sharedMemoryRing, error) {
+	return nil, errors.Errorf("Shared memory rings are not supported on this platform")
+}
+
+func (r *sharedMemoryRing) SetReadDeadline(t time.Time) error { return nil }
+func (r *sharedMemoryRing) Read(p []byte) (int, error)        { return 0, nil }
+func (r *sharedMemoryRing) Close() error                      { return nil }
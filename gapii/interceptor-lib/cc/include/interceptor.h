@@ -17,6 +17,8 @@
 #ifndef INTERCEPTOR_INTERCEPTOR_H_
 #define INTERCEPTOR_INTERCEPTOR_H_
 
+#include <stddef.h>
+
 // -----------------------------------------------------------------------------
 // extern "C" interface designed for users who dlopen the interceptor-lib
 // instead of linking against it. The API for these functions using C structures
@@ -69,6 +71,21 @@ bool InterceptSymbol(void *interceptor, const char *symbol_name,
                      void (*error_callback)(void *, const char *) = nullptr,
                      void *error_callback_baton = nullptr);
 
+// Intercepts the "count" functions specified by "symbol_names" with the
+// matching entries of "new_functions". The list of loaded libraries is only
+// refreshed once for all of the symbols, what makes it considerably faster
+// than calling InterceptSymbol for each of them. If "callback_functions" is
+// not nullptr then its entries are used the same way as the "callback_function"
+// argument of InterceptFunction. Returns true if every function was
+// intercepted successfully. The functions failed to be intercepted are
+// reported through "error_callback" (if specified) and are left unmodified.
+bool InterceptSymbols(void *interceptor, size_t count,
+                      const char *const *symbol_names,
+                      void *const *new_functions,
+                      void **const *callback_functions,
+                      void (*error_callback)(void *, const char *) = nullptr,
+                      void *error_callback_baton = nullptr);
+
 }  // extern "C"
 
 #endif  // INTERCEPTOR_INTERCEPTOR_H_
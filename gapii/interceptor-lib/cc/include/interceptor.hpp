@@ -96,8 +96,7 @@ class Interceptor {
   template <typename DATA, size_t N, typename RET, typename... ARGS>
   struct SignleFunctionInterceptor {
     template <RET (*FUN)(DATA, RET (*)(ARGS...), ARGS...)>
-    static bool Impl(Interceptor &inteptor, const char *symbol_name, DATA data,
-                     std::string *error_message);
+    static void Impl(DATA data, void **new_function, void ***callback_function);
 
     template <RET (*FUN)(DATA, RET (*)(ARGS...), ARGS...)>
     static RET TrampolineFunction(ARGS... args);
@@ -115,10 +114,13 @@ class Interceptor {
             RET (*FUN)(DATA, RET (*)(ARGS...), ARGS...), size_t FUN_COUNT,
             size_t N>
   struct MultiFunctionInterceptor<DATA, RET(ARGS...), FUN, FUN_COUNT, N> {
-    static bool Impl(
-        Interceptor &interceptor,
+    // Appends the symbol name, the trampoline and the callback pointer of the
+    // first N non-empty functions to the arrays, and increments "count".
+    static void Impl(
         const std::array<std::pair<DATA, std::string>, FUN_COUNT> &functions,
-        std::string *error_message);
+        std::array<const char *, FUN_COUNT> &symbol_names,
+        std::array<void *, FUN_COUNT> &new_functions,
+        std::array<void **, FUN_COUNT> &callback_functions, size_t &count);
   };
 };
 
@@ -163,10 +165,25 @@ template <typename DATA, typename FUN_TYPE,
 bool Interceptor::InterceptMultipleFunction(
     const std::array<std::pair<DATA, std::string>, FUN_COUNT> &functions,
     std::string *error_message) {
-  if (error_message) error_message->clear();
-  return MultiFunctionInterceptor<DATA, FUN_TYPE, FUN, FUN_COUNT,
-                                  FUN_COUNT>::Impl(*this, functions,
-                                                   error_message);
+  std::array<const char *, FUN_COUNT> symbol_names;
+  std::array<void *, FUN_COUNT> new_functions;
+  std::array<void **, FUN_COUNT> callback_functions;
+  size_t count = 0;
+  MultiFunctionInterceptor<DATA, FUN_TYPE, FUN, FUN_COUNT, FUN_COUNT>::Impl(
+      functions, symbol_names, new_functions, callback_functions, count);
+
+  // All of the symbols are intercepted with a single call so they are looked
+  // up in a single pass over the loaded libraries.
+  std::ostringstream error_oss;
+  void *error_callback_baton = &error_oss;
+  void (*error_callback)(void *, const char *) =
+      error_message ? &ErrorCollector : nullptr;
+  bool res = ::InterceptSymbols(interceptor_, count, symbol_names.data(),
+                                new_functions.data(),
+                                callback_functions.data(), error_callback,
+                                error_callback_baton);
+  if (error_message) *error_message = error_oss.str();
+  return res;
 }
 
 template <typename DATA, size_t N, typename RET, typename... ARGS>
@@ -178,45 +195,42 @@ RET Interceptor::SignleFunctionInterceptor<
 
 template <typename DATA, size_t N, typename RET, typename... ARGS>
 template <RET (*FUN)(DATA, RET (*)(ARGS...), ARGS...)>
-bool Interceptor::SignleFunctionInterceptor<DATA, N, RET, ARGS...>::Impl(
-    Interceptor &interceptor, const char *symbol_name, DATA data,
-    std::string *error_message) {
+void Interceptor::SignleFunctionInterceptor<DATA, N, RET, ARGS...>::Impl(
+    DATA data, void **new_function, void ***callback_function) {
   s_data = data;
-  return interceptor.InterceptFunction(symbol_name, &TrampolineFunction<FUN>,
-                                       &s_callback, error_message);
+  *new_function = reinterpret_cast<void *>(&TrampolineFunction<FUN>);
+  *callback_function = reinterpret_cast<void **>(&s_callback);
 }
 
 template <typename DATA, typename RET, typename... ARGS,
           RET (*FUN)(DATA, RET (*)(ARGS...), ARGS...), size_t FUN_COUNT,
           size_t N>
-bool Interceptor::
+void Interceptor::
     MultiFunctionInterceptor<DATA, RET(ARGS...), FUN, FUN_COUNT, N>::Impl(
-        Interceptor &interceptor,
         const std::array<std::pair<DATA, std::string>, FUN_COUNT> &functions,
-        std::string *error_message) {
-  bool res =
-      MultiFunctionInterceptor<DATA, RET(ARGS...), FUN, FUN_COUNT, N - 1>::Impl(
-          interceptor, functions, error_message);
+        std::array<const char *, FUN_COUNT> &symbol_names,
+        std::array<void *, FUN_COUNT> &new_functions,
+        std::array<void **, FUN_COUNT> &callback_functions, size_t &count) {
+  MultiFunctionInterceptor<DATA, RET(ARGS...), FUN, FUN_COUNT, N - 1>::Impl(
+      functions, symbol_names, new_functions, callback_functions, count);
   if (!functions[N - 1].second.empty()) {
-    std::string temp_str;
-    res &= SignleFunctionInterceptor<DATA, N - 1, RET, ARGS...>::template Impl<
-        FUN>(interceptor, functions[N - 1].second.c_str(),
-             functions[N - 1].first, error_message ? &temp_str : nullptr);
-    if (error_message && !temp_str.empty()) error_message->append(temp_str);
+    symbol_names[count] = functions[N - 1].second.c_str();
+    SignleFunctionInterceptor<DATA, N - 1, RET, ARGS...>::template Impl<FUN>(
+        functions[N - 1].first, &new_functions[count],
+        &callback_functions[count]);
+    ++count;
   }
-  return res;
 }
 
 template <typename DATA, typename RET, typename... ARGS,
           RET (*FUN)(DATA, RET (*)(ARGS...), ARGS...), size_t FUN_COUNT>
 struct Interceptor::MultiFunctionInterceptor<DATA, RET(ARGS...), FUN, FUN_COUNT,
                                              0> {
-  static bool Impl(
-      Interceptor &interceptor,
+  static void Impl(
       const std::array<std::pair<DATA, std::string>, FUN_COUNT> &functions,
-      std::string *error_message) {
-    return true;
-  }
+      std::array<const char *, FUN_COUNT> &symbol_names,
+      std::array<void *, FUN_COUNT> &new_functions,
+      std::array<void **, FUN_COUNT> &callback_functions, size_t &count) {}
 };
 
 template <typename DATA, size_t N, typename RET, typename... ARGS>
@@ -0,0 +1,275 @@
+/*
+ * Copyright (C) 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "elf_file.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+
+using namespace interceptor;
+
+#if defined(__LP64__)
+static const unsigned char kElfClass = ELFCLASS64;
+#else
+static const unsigned char kElfClass = ELFCLASS32;
+#endif
+
+// The bit of a .gnu.version entry marking a non-default symbol version.
+static const ElfW(Half) kVersymHidden = 0x8000;
+
+static uint32_t GnuHash(const char *name) {
+  uint32_t h = 5381;
+  for (const uint8_t *it = reinterpret_cast<const uint8_t *>(name); *it; ++it)
+    h = (h << 5) + h + *it;
+  return h;
+}
+
+static uint32_t SysvHash(const char *name) {
+  uint32_t h = 0;
+  for (const uint8_t *it = reinterpret_cast<const uint8_t *>(name); *it;
+       ++it) {
+    h = (h << 4) + *it;
+    uint32_t g = h & 0xf0000000;
+    if (g) h ^= g >> 24;
+    h &= ~g;
+  }
+  return h;
+}
+
+size_t ElfFile::StrHash::operator()(const char *str) const {
+  return GnuHash(str);
+}
+
+ElfFile::ElfFile(const std::string &path, const uint8_t *data, size_t size)
+    : path_(path), data_(data), size_(size) {}
+
+ElfFile::~ElfFile() { munmap(const_cast<uint8_t *>(data_), size_); }
+
+Error ElfFile::Open(const std::string &path, std::unique_ptr<ElfFile> &file) {
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) return Error("Failed to open '%s'", path.c_str());
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(ElfW(Ehdr))) {
+    close(fd);
+    return Error("'%s' is too small to be an ELF file", path.c_str());
+  }
+
+  void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (data == MAP_FAILED) return Error("Failed to map '%s'", path.c_str());
+
+  file.reset(
+      new ElfFile(path, static_cast<const uint8_t *>(data), st.st_size));
+  Error error = file->Parse();
+  if (error.Fail()) file.reset();
+  return error;
+}
+
+Error ElfFile::Parse() {
+  const ElfW(Ehdr) *ehdr = reinterpret_cast<const ElfW(Ehdr) *>(data_);
+  if (memcmp(ehdr->e_ident, ELFMAG, SELFMAG) != 0)
+    return Error("'%s' is not an ELF file", path_.c_str());
+  if (ehdr->e_ident[EI_CLASS] != kElfClass)
+    return Error("'%s' has an unsupported ELF class", path_.c_str());
+  if (ehdr->e_shentsize != sizeof(ElfW(Shdr)) || ehdr->e_shoff > size_ ||
+      ehdr->e_shnum > (size_ - ehdr->e_shoff) / sizeof(ElfW(Shdr)))
+    return Error("'%s' has invalid section headers", path_.c_str());
+
+  const ElfW(Shdr) *shdrs =
+      reinterpret_cast<const ElfW(Shdr) *>(data_ + ehdr->e_shoff);
+  auto section_data = [&](const ElfW(Shdr) & shdr) -> const uint8_t * {
+    if (shdr.sh_type == SHT_NOBITS || shdr.sh_offset > size_ ||
+        shdr.sh_size > size_ - shdr.sh_offset)
+      return nullptr;
+    return data_ + shdr.sh_offset;
+  };
+  // Returns the string table linked from the given section.
+  auto linked_strings = [&](const ElfW(Shdr) & shdr, size_t &size) {
+    size = 0;
+    if (shdr.sh_link >= ehdr->e_shnum) return (const char *)nullptr;
+    const ElfW(Shdr) &strtab = shdrs[shdr.sh_link];
+    const char *strings =
+        reinterpret_cast<const char *>(section_data(strtab));
+    if (strings) size = strtab.sh_size;
+    return strings;
+  };
+
+  size_t versym_count = 0;
+  for (size_t i = 0; i < ehdr->e_shnum; ++i) {
+    const ElfW(Shdr) &shdr = shdrs[i];
+    const uint8_t *section = section_data(shdr);
+    if (!section) continue;
+    switch (shdr.sh_type) {
+      case SHT_DYNSYM:
+        dynsym_ = reinterpret_cast<const ElfW(Sym) *>(section);
+        dynsym_count_ = shdr.sh_size / sizeof(ElfW(Sym));
+        dynstr_ = linked_strings(shdr, dynstr_size_);
+        break;
+      case SHT_SYMTAB:
+        symtab_ = reinterpret_cast<const ElfW(Sym) *>(section);
+        symtab_count_ = shdr.sh_size / sizeof(ElfW(Sym));
+        strtab_ = linked_strings(shdr, strtab_size_);
+        break;
+      case SHT_GNU_HASH:
+        gnu_hash_ = reinterpret_cast<const uint32_t *>(section);
+        gnu_hash_size_ = shdr.sh_size / sizeof(uint32_t);
+        break;
+      case SHT_HASH:
+        sysv_hash_ = reinterpret_cast<const uint32_t *>(section);
+        sysv_hash_size_ = shdr.sh_size / sizeof(uint32_t);
+        break;
+      case SHT_GNU_versym:
+        versym_ = reinterpret_cast<const ElfW(Half) *>(section);
+        versym_count = shdr.sh_size / sizeof(ElfW(Half));
+        break;
+    }
+  }
+  if (!dynstr_) dynsym_count_ = 0;
+  if (versym_count < dynsym_count_) versym_ = nullptr;
+  if (!strtab_) symtab_count_ = 0;
+  return Error();
+}
+
+const char *ElfFile::GetString(const char *table, size_t table_size,
+                               size_t offset) const {
+  if (offset >= table_size) return nullptr;
+  const char *str = table + offset;
+  if (!memchr(str, '\0', table_size - offset)) return nullptr;
+  return str;
+}
+
+void ElfFile::FindSymbols(const char *name,
+                          std::vector<const ElfW(Sym) *> &exported,
+                          std::vector<const ElfW(Sym) *> &internal) {
+  std::vector<const ElfW(Sym) *> dynamic;
+  FindDynamicSymbols(name, dynamic);
+  for (const ElfW(Sym) * sym : dynamic) {
+    if (ELF32_ST_BIND(sym->st_info) == STB_LOCAL)
+      internal.push_back(sym);
+    else
+      exported.push_back(sym);
+  }
+
+  // The exported symbols usually also have an entry in the internal symbol
+  // table. Keep only the dynamic one of these.
+  size_t first = internal.size();
+  FindInternalSymbols(name, internal);
+  auto is_dynamic = [&](const ElfW(Sym) * sym) {
+    for (const ElfW(Sym) * dyn : dynamic) {
+      if (dyn->st_value == sym->st_value && dyn->st_shndx == sym->st_shndx)
+        return true;
+    }
+    return false;
+  };
+  internal.erase(std::remove_if(internal.begin() + first, internal.end(),
+                                is_dynamic),
+                 internal.end());
+}
+
+void ElfFile::FindDynamicSymbols(const char *name,
+                                 std::vector<const ElfW(Sym) *> &symbols) {
+  if (dynsym_count_ == 0) return;
+
+  auto match = [&](size_t index) {
+    if (index >= dynsym_count_) return false;
+    const ElfW(Sym) &sym = dynsym_[index];
+    if (sym.st_shndx == SHN_UNDEF) return false;
+    // Non-default versions of a symbol are only bound to by version.
+    if (versym_ && (versym_[index] & kVersymHidden)) return false;
+    const char *sym_name = GetString(dynstr_, dynstr_size_, sym.st_name);
+    if (!sym_name || strcmp(sym_name, name) != 0) return false;
+    symbols.push_back(&sym);
+    return true;
+  };
+
+  // The header of .gnu.hash is followed by the bloom filter, the buckets and
+  // the hash values of the symbols from symoffset onwards.
+  if (gnu_hash_ && gnu_hash_size_ >= 4) {
+    uint32_t nbuckets = gnu_hash_[0];
+    uint32_t symoffset = gnu_hash_[1];
+    uint32_t bloom_size = gnu_hash_[2];
+    uint32_t bloom_shift = gnu_hash_[3];
+    const size_t words_per_bloom = sizeof(ElfW(Addr)) / sizeof(uint32_t);
+    size_t chain_start = 4 + size_t(bloom_size) * words_per_bloom + nbuckets;
+    if (nbuckets != 0 && bloom_size != 0 && chain_start <= gnu_hash_size_) {
+      const ElfW(Addr) *bloom =
+          reinterpret_cast<const ElfW(Addr) *>(gnu_hash_ + 4);
+      const uint32_t *buckets = gnu_hash_ + 4 + bloom_size * words_per_bloom;
+      const uint32_t *chain = gnu_hash_ + chain_start;
+      size_t chain_size = gnu_hash_size_ - chain_start;
+
+      const uint32_t bits = sizeof(ElfW(Addr)) * 8;
+      uint32_t hash = GnuHash(name);
+      ElfW(Addr) word = bloom[(hash / bits) % bloom_size];
+      ElfW(Addr) mask = (ElfW(Addr)(1) << (hash % bits)) |
+                        (ElfW(Addr)(1) << ((hash >> bloom_shift) % bits));
+      if ((word & mask) != mask) return;
+
+      for (uint32_t index = buckets[hash % nbuckets];
+           index >= symoffset && index - symoffset < chain_size; ++index) {
+        uint32_t chain_hash = chain[index - symoffset];
+        if ((chain_hash | 1) == (hash | 1)) match(index);
+        if (chain_hash & 1) break;
+      }
+      return;
+    }
+  }
+
+  if (sysv_hash_ && sysv_hash_size_ >= 2) {
+    uint32_t nbuckets = sysv_hash_[0];
+    uint32_t nchains = sysv_hash_[1];
+    if (nbuckets != 0 && 2 + size_t(nbuckets) + nchains <= sysv_hash_size_) {
+      const uint32_t *buckets = sysv_hash_ + 2;
+      const uint32_t *chain = buckets + nbuckets;
+      // Bound the walk by the chain length in case of a cycle.
+      size_t steps = 0;
+      for (uint32_t index = buckets[SysvHash(name) % nbuckets];
+           index != STN_UNDEF && index < nchains && steps < nchains;
+           index = chain[index], ++steps)
+        match(index);
+      return;
+    }
+  }
+
+  for (size_t i = 1; i < dynsym_count_; ++i) match(i);
+}
+
+void ElfFile::FindInternalSymbols(const char *name,
+                                  std::vector<const ElfW(Sym) *> &symbols) {
+  if (symtab_count_ == 0) return;
+
+  if (!symtab_indexed_) {
+    symtab_indexed_ = true;
+    symtab_index_.reserve(symtab_count_);
+    for (size_t i = 1; i < symtab_count_; ++i) {
+      const ElfW(Sym) &sym = symtab_[i];
+      if (sym.st_shndx == SHN_UNDEF) continue;
+      const char *sym_name = GetString(strtab_, strtab_size_, sym.st_name);
+      if (!sym_name || !*sym_name) continue;
+      symtab_index_.emplace(sym_name, &sym);
+    }
+  }
+
+  auto range = symtab_index_.equal_range(name);
+  for (auto it = range.first; it != range.second; ++it)
+    symbols.push_back(it->second);
+}
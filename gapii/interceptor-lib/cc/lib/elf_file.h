@@ -0,0 +1,102 @@
+/*
+ * Copyright (C) 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef INTERCEPTOR_ELF_FILE_H_
+#define INTERCEPTOR_ELF_FILE_H_
+
+#include <link.h>
+
+#include <cstddef>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "error.h"
+
+namespace interceptor {
+
+// Read only view of an ELF file of the native ELF class mapped into memory.
+// Symbols are looked up in the dynamic symbol table through the .gnu.hash or
+// .hash tables, and in the internal symbol table (if not stripped) through an
+// index built on the first lookup. The symbol names are never copied out of
+// the mapping.
+class ElfFile {
+ public:
+  ~ElfFile();
+
+  static Error Open(const std::string &path, std::unique_ptr<ElfFile> &file);
+
+  // Appends the global symbols exported with the given name to "exported",
+  // and the other defined symbols with that name to "internal". Only the
+  // default version of a versioned symbol is exported. A symbol present in
+  // both symbol tables is only appended once.
+  void FindSymbols(const char *name, std::vector<const ElfW(Sym) *> &exported,
+                   std::vector<const ElfW(Sym) *> &internal);
+
+  const std::string &GetPath() const { return path_; }
+
+ private:
+  struct StrHash {
+    size_t operator()(const char *str) const;
+  };
+
+  struct StrEqual {
+    bool operator()(const char *a, const char *b) const {
+      return strcmp(a, b) == 0;
+    }
+  };
+
+  ElfFile(const std::string &path, const uint8_t *data, size_t size);
+
+  Error Parse();
+
+  void FindDynamicSymbols(const char *name,
+                          std::vector<const ElfW(Sym) *> &symbols);
+
+  void FindInternalSymbols(const char *name,
+                           std::vector<const ElfW(Sym) *> &symbols);
+
+  const char *GetString(const char *table, size_t table_size,
+                        size_t offset) const;
+
+  std::string path_;
+  const uint8_t *data_;
+  size_t size_;
+
+  const ElfW(Sym) * dynsym_ = nullptr;
+  size_t dynsym_count_ = 0;
+  const char *dynstr_ = nullptr;
+  size_t dynstr_size_ = 0;
+  const uint32_t *gnu_hash_ = nullptr;
+  size_t gnu_hash_size_ = 0;
+  const uint32_t *sysv_hash_ = nullptr;
+  size_t sysv_hash_size_ = 0;
+  const ElfW(Half) * versym_ = nullptr;  // Indexed like dynsym_.
+
+  const ElfW(Sym) * symtab_ = nullptr;
+  size_t symtab_count_ = 0;
+  const char *strtab_ = nullptr;
+  size_t strtab_size_ = 0;
+  bool symtab_indexed_ = false;
+  std::unordered_multimap<const char *, const ElfW(Sym) *, StrHash, StrEqual>
+      symtab_index_;
+};
+
+}  // end of namespace interceptor
+
+#endif  // INTERCEPTOR_ELF_FILE_H_
@@ -62,11 +62,15 @@ class InterceptorImpl {
   Error InterceptFunction(void *old_function, void *new_function,
                           void **callback_function);
 
+  // Intercepts the function with the given symbol name in the libraries
+  // loaded at the time of the last call to RefreshSymbolList.
   Error InterceptFunction(const char *symbol_name, void *new_function,
                           void **callback_function);
 
   void *FindFunctionByName(const char *symbol_name);
 
+  void RefreshSymbolList() { linker_.RefreshSymbolList(); }
+
  private:
   Error WriteMemory(void *target, const void *source, size_t num,
                     bool is_executable);
@@ -120,13 +124,12 @@ bool InterceptFunction(void *interceptor, void *old_function,
   return error.Success();
 }
 
-bool InterceptSymbol(void *interceptor, const char *symbol_name,
-                     void *new_function, void **callback_function,
-                     void (*error_callback)(void *, const char *),
-                     void *error_callback_baton) {
-  Error error =
-      static_cast<InterceptorImpl *>(interceptor)
-          ->InterceptFunction(symbol_name, new_function, callback_function);
+static bool InterceptLoadedSymbol(
+    InterceptorImpl *interceptor, const char *symbol_name, void *new_function,
+    void **callback_function, void (*error_callback)(void *, const char *),
+    void *error_callback_baton) {
+  Error error = interceptor->InterceptFunction(symbol_name, new_function,
+                                               callback_function);
   if (error_callback && error.Fail()) {
     std::ostringstream oss;
     oss << "Intercepting '" << symbol_name
@@ -136,6 +139,35 @@ bool InterceptSymbol(void *interceptor, const char *symbol_name,
   return error.Success();
 }
 
+bool InterceptSymbol(void *interceptor, const char *symbol_name,
+                     void *new_function, void **callback_function,
+                     void (*error_callback)(void *, const char *),
+                     void *error_callback_baton) {
+  InterceptorImpl *impl = static_cast<InterceptorImpl *>(interceptor);
+  impl->RefreshSymbolList();
+  return InterceptLoadedSymbol(impl, symbol_name, new_function,
+                               callback_function, error_callback,
+                               error_callback_baton);
+}
+
+bool InterceptSymbols(void *interceptor, size_t count,
+                      const char *const *symbol_names,
+                      void *const *new_functions,
+                      void **const *callback_functions,
+                      void (*error_callback)(void *, const char *),
+                      void *error_callback_baton) {
+  InterceptorImpl *impl = static_cast<InterceptorImpl *>(interceptor);
+  impl->RefreshSymbolList();
+  bool res = true;
+  for (size_t i = 0; i < count; ++i) {
+    res &= InterceptLoadedSymbol(
+        impl, symbol_names[i], new_functions[i],
+        callback_functions ? callback_functions[i] : nullptr, error_callback,
+        error_callback_baton);
+  }
+  return res;
+}
+
 }  // extern "C"
 
 static void InitializeLLVM() {
@@ -373,8 +405,6 @@ Error InterceptorImpl::InterceptFunction(void *old_function, void *new_function,
 Error InterceptorImpl::InterceptFunction(const char *symbol_name,
                                          void *new_function,
                                          void **callback_function) {
-  linker_.RefreshSymbolList();
-
   std::vector<Linker::Symbol> symbols = linker_.FindSymbols(symbol_name);
   if (symbols.empty())
     return Error("Failed to find symbol with name '%s'", symbol_name);
@@ -16,21 +16,14 @@
 
 #include "linker.h"
 
-#include <fcntl.h>
-#include <sys/stat.h>
-#include <sys/types.h>
+#include <link.h>
 #include <unistd.h>
 
-#include "llvm/Object/Binary.h"
-#include "llvm/Object/ELFObjectFile.h"
-#include "llvm/Object/ObjectFile.h"
-#include "llvm/Support/Error.h"
-
-// link.h #define EV_NONE on android what is used as an enum value inside llvm
-// so it have to be included after the llvm libraries to avoid the compilation
-// error.
-#include <link.h>
+#include <cctype>
+#include <cstdio>
+#include <utility>
 
+#include "elf_file.h"
 #include "error.h"
 
 using namespace interceptor;
@@ -57,37 +50,49 @@ static uintptr_t read_address(const char *buffer) {
   }
 }
 
-// Try to find the full path of the library mapped at a given address based on
-// the /proc/self/maps file. This code path is used when the linker reports a
-// library with file name only what is not located on the default search path
-// or if the linker reports a library with bogus library name.
-static std::string FindLibraryAtAddress(uintptr_t base_address) {
+static bool FileExists(const std::string &path) {
+  return !path.empty() && access(path.c_str(), F_OK) == 0;
+}
+
+// Reads the start address and path of the file backed mappings from the
+// /proc/self/maps file.
+static void ReadMappedFiles(std::map<uintptr_t, std::string> &mapped_files) {
   FILE *f = fopen("/proc/self/maps", "r");
-  if (f == nullptr) return "";
+  if (f == nullptr) return;
 
   char buffer[512];
-  std::string path;
   while (fgets(buffer, sizeof(buffer), f)) {
     uintptr_t start_addr = read_address(buffer);
-    if (start_addr == base_address) {
-      const char *last_space = buffer - 1, *last_alpha = buffer;
-      for (const char *it = buffer; *it; ++it) {
-        if (*it == ' ')
-          last_space = it;
-        else if (std::isalnum(*it))
-          last_alpha = it;
-      }
-      path.assign(last_space + 1, last_alpha - last_space);
+    const char *last_space = buffer - 1, *last_alpha = buffer;
+    for (const char *it = buffer; *it; ++it) {
+      if (*it == ' ')
+        last_space = it;
+      else if (std::isalnum(*it))
+        last_alpha = it;
     }
+    if (last_alpha > last_space)
+      mapped_files[start_addr].assign(last_space + 1, last_alpha - last_space);
   }
   fclose(f);
-  return path;
 }
 
-static std::string FindLibrary(const char *name, uintptr_t base_address) {
+// Try to find the full path of the library mapped at a given address based on
+// the /proc/self/maps file. This code path is used when the linker reports a
+// library with file name only what is not located on the default search path
+// or if the linker reports a library with bogus library name. The maps file is
+// only read once per refresh of the library list into "mapped_files".
+static std::string FindLibraryAtAddress(
+    uintptr_t base_address, std::map<uintptr_t, std::string> &mapped_files) {
+  if (mapped_files.empty()) ReadMappedFiles(mapped_files);
+  auto it = mapped_files.find(base_address);
+  return it != mapped_files.end() ? it->second : "";
+}
+
+static std::string FindLibrary(const char *name, uintptr_t base_address,
+                               std::map<uintptr_t, std::string> &mapped_files) {
   // Absolue library path
   if (name[0] == '/') {
-    if (llvm::sys::fs::exists(name)) return name;
+    if (FileExists(name)) return name;
     return "";
   }
 
@@ -95,121 +100,90 @@ static std::string FindLibrary(const char *name, uintptr_t base_address) {
   std::vector<std::string> search_paths = GetLibrarySearchPaths();
   for (const std::string &dir : search_paths) {
     std::string path = dir + '/' + name;
-    if (llvm::sys::fs::exists(path)) return path;
+    if (FileExists(path)) return path;
   }
 
   // Finding the library based on absolute and relative path is failed. Try to
   // find it based on the base address in /proc/self/maps
-  std::string path = FindLibraryAtAddress(base_address);
-  if (llvm::sys::fs::exists(path)) return path;
+  std::string path = FindLibraryAtAddress(base_address, mapped_files);
+  if (FileExists(path)) return path;
 
   return "";
 }
 
-Error Linker::ParseLibrary(const char *name, uintptr_t base_address) {
-  std::string library_path = FindLibrary(name, base_address);
-  if (library_path.empty())
-    return Error("Failed to find file for library: %s", name);
+Linker::Linker() = default;
 
-  llvm::Expected<llvm::object::OwningBinary<llvm::object::Binary>>
-      binary_or_err = llvm::object::createBinary(library_path);
-  if (!binary_or_err) {
-    std::error_code ec = llvm::errorToErrorCode(binary_or_err.takeError());
-    return Error("Failed to create llvm::object::Binary for '%s' (%s)",
-                 library_path.c_str(), ec.message().c_str());
-  }
+Linker::~Linker() = default;
 
-  llvm::object::Binary &binary = *binary_or_err.get().getBinary();
-  llvm::object::ObjectFile *obj_file =
-      llvm::dyn_cast<llvm::object::ObjectFile>(&binary);
-  if (!obj_file || !llvm::isa<llvm::object::ELFObjectFileBase>(obj_file))
-    return Error("Failer to convert '%s' to an object file",
-                 library_path.c_str());
-
-  for (const auto &symbol : obj_file->symbols()) {
-    llvm::Expected<llvm::StringRef> symbol_name_or_err = symbol.getName();
-    if (!symbol_name_or_err || symbol_name_or_err->empty()) continue;
-
-    std::string symbol_name = symbol_name_or_err->str();
-    uint32_t flags = symbol.getFlags();
-    uintptr_t address = 0;
-
-    if (flags & llvm::object::SymbolRef::SF_Absolute) {
-      llvm::Expected<uint64_t> exp_address = symbol.getAddress();
-      if (!exp_address) continue;
-      address = exp_address.get();
-    } else {
-      llvm::Expected<llvm::object::section_iterator> section_or_err =
-          symbol.getSection();
-      if (!section_or_err) continue;
-
-      llvm::object::section_iterator section = section_or_err.get();
-      if (section == obj_file->section_end()) continue;  // Undefined symbol
-
-      llvm::Expected<uint64_t> exp_address = symbol.getAddress();
-      if (!exp_address) continue;
-      address = base_address + exp_address.get();
-    }
-
-    if (flags & llvm::object::SymbolRef::SF_Thumb) address |= 1;
-
-    AddSymbol(symbol_name, address,
-              llvm::object::ELFSymbolRef(symbol).getSize(), flags);
-  }
-
-  return Error();
-}
+Error Linker::ParseLibrary(const char *name, uintptr_t base_address,
+                           std::map<uintptr_t, std::string> &mapped_files,
+                           std::unique_ptr<ElfFile> &file) {
+  std::string library_path = FindLibrary(name, base_address, mapped_files);
+  if (library_path.empty())
+    return Error("Failed to find file for library: %s", name);
 
-void Linker::AddSymbol(const std::string &name, uintptr_t address, size_t size,
-                       uint32_t flags) {
-  Symbol symbol{name, address, size, flags};
-  addr_to_symbol_.emplace(address, symbol);
-  name_to_symbol_.emplace(name, symbol);
+  return ElfFile::Open(library_path, file);
 }
 
 std::vector<Linker::Symbol> Linker::FindSymbols(const char *name) {
-  RefreshSymbolList();
-
   std::vector<Symbol> symbols;
-  auto symbol_range = name_to_symbol_.equal_range(name);
-  for (auto it = symbol_range.first; it != symbol_range.second; ++it)
-    symbols.push_back(it->second);
+  std::vector<const ElfW(Sym) *> exported;
+  std::vector<const ElfW(Sym) *> internal;
+  bool found_exported = false;
+  for (const Library &library : loaded_libraries_) {
+    if (!library.file) continue;
+
+    exported.clear();
+    internal.clear();
+    library.file->FindSymbols(name, exported, internal);
+    // The exports of the later libraries are interposed by the first one.
+    if (!found_exported && !exported.empty()) {
+      found_exported = true;
+      internal.insert(internal.begin(), exported.front());
+    }
+
+    for (const ElfW(Sym) * sym : internal) {
+      uintptr_t address = sym->st_value;
+      if (sym->st_shndx != SHN_ABS) address += library.base_address;
+      symbols.push_back(Symbol{name, address, sym->st_size, sym->st_info});
+    }
+  }
   return symbols;
 }
 
+// Collects the base address and name of the loaded libraries, in load order.
 static int CollectLibrary(struct dl_phdr_info *info, size_t size, void *data) {
-  std::map<uintptr_t, std::string> *libraries =
-      static_cast<std::map<uintptr_t, std::string> *>(data);
+  std::vector<std::pair<uintptr_t, std::string>> *libraries =
+      static_cast<std::vector<std::pair<uintptr_t, std::string>> *>(data);
 
   const char *file_name = info->dlpi_name;
   if (file_name == nullptr) return 0;
 
   uintptr_t base_address = info->dlpi_addr;
-  libraries->emplace(base_address, file_name);
+  libraries->emplace_back(base_address, file_name);
   return 0;
 }
 
 void Linker::RefreshSymbolList() {
-  std::map<uintptr_t, std::string> libraries;
+  std::vector<std::pair<uintptr_t, std::string>> libraries;
   dl_iterate_phdr(CollectLibrary, &libraries);
 
-  bool changed = false;
-  if (libraries.size() == loaded_libraries_.size()) {
-    for (const auto &it : loaded_libraries_) {
-      if (libraries.count(it.first) != 1 || libraries[it.first] != it.second) {
-        changed = true;
-        break;
-      }
+  std::map<uintptr_t, Library *> previous;
+  for (Library &library : loaded_libraries_)
+    previous[library.base_address] = &library;
+
+  std::vector<Library> loaded_libraries;
+  std::map<uintptr_t, std::string> mapped_files;
+  for (auto &it : libraries) {
+    auto loaded = previous.find(it.first);
+    if (loaded != previous.end() && loaded->second->name == it.second) {
+      loaded_libraries.push_back(std::move(*loaded->second));
+      continue;
     }
-  } else {
-    changed = true;
-  }
 
-  if (changed) {
-    addr_to_symbol_.clear();
-    name_to_symbol_.clear();
-    loaded_libraries_.swap(libraries);
-    for (const auto &it : loaded_libraries_)
-      ParseLibrary(it.second.c_str(), it.first);
+    Library library{it.first, it.second, nullptr};
+    ParseLibrary(it.second.c_str(), it.first, mapped_files, library.file);
+    loaded_libraries.push_back(std::move(library));
   }
+  loaded_libraries_.swap(loaded_libraries);
 }
@@ -19,6 +19,7 @@
 
 #include <cstddef>
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -26,28 +27,42 @@
 
 namespace interceptor {
 
+class ElfFile;
+
 class Linker {
  public:
   struct Symbol {
     std::string name;
     uintptr_t address;
     size_t size;
-    uint32_t flags;
+    uint8_t info;  // ELF st_info (binding and type) of the symbol.
   };
 
+  Linker();
+  ~Linker();
+
+  // Updates the list of loaded libraries. Only the newly loaded libraries are
+  // parsed, the libraries unloaded since the last call are released.
   void RefreshSymbolList();
 
+  // Returns the symbols with the given name in the libraries loaded at the
+  // time of the last call to RefreshSymbolList. Like the dynamic linker, an
+  // exported symbol is only returned from the first library exporting it in
+  // load order. The internal symbols are returned from every library.
   std::vector<Symbol> FindSymbols(const char *name);
 
  private:
-  Error ParseLibrary(const char *name, uintptr_t base_address);
+  struct Library {
+    uintptr_t base_address;
+    std::string name;
+    std::unique_ptr<ElfFile> file;  // nullptr if the library can't be parsed.
+  };
 
-  void AddSymbol(const std::string &name, uintptr_t address, size_t size,
-                 uint32_t flags);
+  Error ParseLibrary(const char *name, uintptr_t base_address,
+                     std::map<uintptr_t, std::string> &mapped_files,
+                     std::unique_ptr<ElfFile> &file);
 
-  std::map<uintptr_t, std::string> loaded_libraries_;
-  std::multimap<uintptr_t, Symbol> addr_to_symbol_;
-  std::multimap<std::string, Symbol> name_to_symbol_;
+  std::vector<Library> loaded_libraries_;  // In load order.
 };
 
 }  // end of namespace interceptor
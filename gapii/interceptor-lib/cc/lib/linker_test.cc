@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "linker.h"
+
+#include <dlfcn.h>
+
+#include <gtest/gtest.h>
+
+namespace interceptor {
+namespace test {
+
+TEST(LinkerTest, FindSymbolsMatchesDlsym) {
+  Linker linker;
+  linker.RefreshSymbolList();
+  // The symbols from realpath onwards have several versions in glibc.
+  // copysign is exported by both libc and libm.
+  for (const char *name :
+       {"malloc", "free", "fopen", "qsort", "getenv", "dl_iterate_phdr",
+        "copysign", "realpath", "glob", "nftw", "posix_spawn", "regexec",
+        "fmemopen", "pthread_create", "pthread_cond_wait"}) {
+    void *expected = dlsym(RTLD_DEFAULT, name);
+    ASSERT_NE(nullptr, expected) << name;
+    std::vector<Linker::Symbol> symbols = linker.FindSymbols(name);
+    ASSERT_EQ(1u, symbols.size()) << name;
+    EXPECT_EQ(expected, reinterpret_cast<void *>(symbols[0].address)) << name;
+  }
+}
+
+TEST(LinkerTest, FindSymbolsMissing) {
+  Linker linker;
+  linker.RefreshSymbolList();
+  EXPECT_TRUE(linker.FindSymbols("interceptor_no_such_symbol").empty());
+  EXPECT_TRUE(linker.FindSymbols("").empty());
+}
+
+}  // namespace test
+}  // namespace interceptor
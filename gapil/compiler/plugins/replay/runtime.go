@@ -73,7 +73,7 @@ func Build(env *executor.Env, layout *device.MemoryLayout) (replaysrv.Payload, e
 	for i, r := range resources {
 		id := slice.Bytes(unsafe.Pointer(&r.id[0]), 20)
 		payload.Resources[i] = &replaysrv.ResourceInfo{
-			Id:   string(id),
+			Id:   append([]byte(nil), id...),
 			Size: uint32(r.size),
 		}
 	}
@@ -49,7 +49,7 @@ uint32_t baseTypeSize(BaseType type) {
       return sizeof(void*);
     case BaseType::ConstantPointer:
     case BaseType::VolatilePointer:
-      return sizeof(uint32_t);
+      return sizeof(void*);
     default:
       GAPID_FATAL("Invalid BaseType: %d", int(type));
       return 0;
@@ -0,0 +1,159 @@
+/*
+ * Copyright (C) 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "checkpoint.h"
+#include "gles_renderer.h"
+#include "interpreter.h"
+#include "vulkan_renderer.h"
+
+#include <city.h>
+
+#include <algorithm>
+
+namespace gapir {
+namespace {
+
+// prefixConstantsSize returns the size of the constant memory used by the
+// first prefix instructions. The builder writes the constants in the order
+// they are first used, so the constants used by the prefix are the ones before
+// the first constant only used after it. Its offset is the smallest offset
+// used after the prefix which is greater than all the ones used by the prefix.
+uint64_t prefixConstantsSize(const uint32_t* instructions, uint32_t count,
+                             uint32_t prefix, uint64_t constantsSize) {
+  uint64_t prefixEnd = 0;
+  for (auto offset : Interpreter::constantOffsets(instructions, prefix)) {
+    prefixEnd = std::max(prefixEnd, offset + 1);
+  }
+  uint64_t constantsEnd = constantsSize;
+  for (auto offset : Interpreter::constantOffsets(instructions + prefix,
+                                                  count - prefix)) {
+    if (offset >= prefixEnd && offset < constantsEnd) {
+      constantsEnd = offset;
+    }
+  }
+  return constantsEnd;
+}
+
+// usedResources returns the resources loaded by the first prefix
+// instructions, in order.
+std::vector<Resource> usedResources(const uint32_t* instructions,
+                                    uint32_t prefix,
+                                    const std::vector<Resource>& resources) {
+  std::vector<Resource> used;
+  for (auto index : Interpreter::resourceIndices(instructions, prefix)) {
+    if (index < resources.size()) {
+      used.push_back(resources[index]);
+    }
+  }
+  return used;
+}
+
+}  // anonymous namespace
+
+uint64_t Checkpoint::computeKey(const uint32_t* instructions, uint32_t count,
+                                uint32_t prefix, const void* constants,
+                                uint64_t constantsSize,
+                                const std::vector<Resource>& resources,
+                                uint64_t volatileSize) {
+  prefix = std::min(prefix, count);
+  uint64_t hash =
+      CityHash64WithSeed(reinterpret_cast<const char*>(instructions),
+                         prefix * sizeof(uint32_t), volatileSize);
+
+  uint64_t constantsEnd =
+      prefixConstantsSize(instructions, count, prefix, constantsSize);
+  hash = CityHash64WithSeed(static_cast<const char*>(constants), constantsEnd,
+                            hash ^ constantsEnd);
+
+  for (const auto& resource : usedResources(instructions, prefix, resources)) {
+    hash = CityHash64WithSeed(reinterpret_cast<const char*>(resource.id.data),
+                              sizeof(resource.id.data), hash ^ resource.size);
+  }
+  return hash;
+}
+
+Checkpoint::Checkpoint()
+    : key(0),
+      instruction(0),
+      volatileSize(0),
+      thread(0),
+      label(0),
+      volatileAddress(nullptr),
+      vulkanRenderer(nullptr) {}
+
+void Checkpoint::setPrefix(const uint32_t* instructions, uint32_t count,
+                           uint32_t prefix, const void* constants,
+                           uint64_t constantsSize,
+                           const std::vector<Resource>& resources,
+                           uint64_t volatileSize) {
+  prefix = std::min(prefix, count);
+  key = computeKey(instructions, count, prefix, constants, constantsSize,
+                   resources, volatileSize);
+  instruction = prefix;
+  prefixInstructions.assign(instructions, instructions + prefix);
+  auto bytes = static_cast<const uint8_t*>(constants);
+  prefixConstants.assign(
+      bytes,
+      bytes + prefixConstantsSize(instructions, count, prefix, constantsSize));
+  prefixResources = usedResources(instructions, prefix, resources);
+  this->volatileSize = volatileSize;
+}
+
+bool Checkpoint::matches(const uint32_t* instructions, uint32_t count,
+                         const void* constants, uint64_t constantsSize,
+                         const std::vector<Resource>& resources,
+                         uint64_t volatileSize) const {
+  if (instruction > count || volatileSize != this->volatileSize ||
+      computeKey(instructions, count, instruction, constants, constantsSize,
+                 resources, volatileSize) != key) {
+    return false;
+  }
+  auto bytes = static_cast<const uint8_t*>(constants);
+  return std::equal(prefixInstructions.begin(), prefixInstructions.end(),
+                    instructions) &&
+         prefixConstantsSize(instructions, count, instruction,
+                             constantsSize) == prefixConstants.size() &&
+         std::equal(prefixConstants.begin(), prefixConstants.end(), bytes) &&
+         usedResources(instructions, instruction, resources) ==
+             prefixResources;
+}
+
+Checkpoint::~Checkpoint() {
+  // Stop the interpreter threads before destroying the renderers bound on
+  // them, as a context does.
+  interpreter.reset();
+  for (auto it : glesRenderers) {
+    delete it.second;
+  }
+  rootGlesRenderer.reset();
+  delete vulkanRenderer;
+}
+
+CheckpointStore::CheckpointStore(uint64_t maxBytes) : mMaxBytes(maxBytes) {}
+
+bool CheckpointStore::fits(uint64_t size) const {
+  return size <= mMaxBytes;
+}
+
+std::unique_ptr<Checkpoint> CheckpointStore::take() {
+  return std::move(mCheckpoint);
+}
+
+void CheckpointStore::put(std::unique_ptr<Checkpoint> checkpoint) {
+  mCheckpoint = std::move(checkpoint);
+}
+
+}  // namespace gapir
@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GAPIR_CHECKPOINT_H
+#define GAPIR_CHECKPOINT_H
+
+#include "resource.h"
+
+#include <stdint.h>
+
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace gapir {
+
+class GlesRenderer;
+class Interpreter;
+class VulkanRenderer;
+
+// Checkpoint is the state of a replay at a LABEL instruction, kept once the
+// replay is done so that the next replay, if it starts with the same
+// instructions, resumes from the LABEL instead of interpreting them again.
+//
+// The state of the renderers cannot be copied, so the checkpoint keeps the
+// renderers of the replay themselves, along with the interpreter whose threads
+// they are bound on. They are only in the state of the checkpoint if the
+// instructions interpreted after it left that state unchanged, which is the
+// case of the commands inserted by GAPIS at the end of a replay to read back
+// its results. Checkpoints are therefore only taken at the first LABEL of
+// these commands, and only the last one of a replay is kept.
+struct Checkpoint {
+  // The label of the commands inserted by GAPIS, which have no command index.
+  static const uint32_t kInsertedCommandLabel = 0x3ffffff;
+
+  // computeKey returns the key identifying the first prefix instructions of the
+  // replay. It covers the instructions, the constant memory and the resources
+  // they use, and the size of the volatile memory.
+  static uint64_t computeKey(const uint32_t* instructions, uint32_t count,
+                             uint32_t prefix, const void* constants,
+                             uint64_t constantsSize,
+                             const std::vector<Resource>& resources,
+                             uint64_t volatileSize);
+
+  Checkpoint();
+  ~Checkpoint();
+
+  // setPrefix keeps the first prefix instructions of the replay, the constant
+  // memory and the resources they use, and their key.
+  void setPrefix(const uint32_t* instructions, uint32_t count, uint32_t prefix,
+                 const void* constants, uint64_t constantsSize,
+                 const std::vector<Resource>& resources, uint64_t volatileSize);
+
+  // matches returns true if the replay starts with the instructions kept by
+  // setPrefix, using the same constant memory, resources and volatile memory
+  // size. Once the keys match, the kept prefix is compared byte for byte, so
+  // that a key collision never resumes from the state of another replay.
+  bool matches(const uint32_t* instructions, uint32_t count,
+               const void* constants, uint64_t constantsSize,
+               const std::vector<Resource>& resources,
+               uint64_t volatileSize) const;
+
+  // The key of the instructions before the checkpoint.
+  uint64_t key;
+  // The index of the instruction to resume from.
+  uint32_t instruction;
+  // The instructions before the checkpoint, and the constant memory, the
+  // resources and the size of the volatile memory they use.
+  std::vector<uint32_t> prefixInstructions;
+  std::vector<uint8_t> prefixConstants;
+  std::vector<Resource> prefixResources;
+  uint64_t volatileSize;
+  // The thread interpreting the instructions at the checkpoint.
+  uint32_t thread;
+  // The last label reached before the checkpoint.
+  uint32_t label;
+  // The address and the content of the volatile memory at the checkpoint.
+  void* volatileAddress;
+  std::vector<uint8_t> volatileMemory;
+
+  // The interpreter and the renderers of the replay.
+  std::unique_ptr<Interpreter> interpreter;
+  std::unique_ptr<GlesRenderer> rootGlesRenderer;
+  std::unordered_map<uint32_t, GlesRenderer*> glesRenderers;
+  VulkanRenderer* vulkanRenderer;
+};
+
+// CheckpointStore keeps the checkpoint of the last replay, if its copy of the
+// volatile memory and of the replay data before it fits in the memory budget
+// of the store.
+class CheckpointStore {
+ public:
+  explicit CheckpointStore(uint64_t maxBytes);
+
+  // Returns true if a checkpoint keeping the given number of bytes fits in the
+  // memory budget.
+  bool fits(uint64_t size) const;
+
+  // Removes and returns the stored checkpoint, or nullptr if there is none.
+  std::unique_ptr<Checkpoint> take();
+
+  // Stores the checkpoint, replacing the stored one.
+  void put(std::unique_ptr<Checkpoint> checkpoint);
+
+ private:
+  uint64_t mMaxBytes;
+  std::unique_ptr<Checkpoint> mCheckpoint;
+};
+
+}  // namespace gapir
+
+#endif  // GAPIR_CHECKPOINT_H
@@ -0,0 +1,280 @@
+/*
+ * Copyright (C) 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "checkpoint.h"
+#include "interpreter.h"
+#include "replay_connection.h"
+#include "test_utilities.h"
+
+#include "gapir/replay_service/service.pb.h"
+
+#include <gtest/gtest.h>
+#include <string.h>
+
+#include <fstream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace gapir {
+namespace test {
+namespace {
+
+const uint32_t PREFIX = 4;
+const uint64_t VOLATILE_SIZE = 1024;
+
+Resource resource(uint8_t n, uint32_t size) {
+  ResourceId id;
+  memset(id.data, n, sizeof(id.data));
+  return Resource(id, size);
+}
+
+class CheckpointTest : public ::testing::Test {
+ protected:
+  virtual void SetUp() {
+    // The first PREFIX instructions use the constant at 0 and the resource 0,
+    // the ones after them the constant at 4 and the resource 1.
+    mInstructions = {
+        instruction(Interpreter::InstructionCode::LABEL, 1),
+        instruction(Interpreter::InstructionCode::LOAD_C, BaseType::Uint32, 0),
+        instruction(Interpreter::InstructionCode::RESOURCE, 0),
+        instruction(Interpreter::InstructionCode::CALL, 0),
+        instruction(Interpreter::InstructionCode::LABEL,
+                    Checkpoint::kInsertedCommandLabel),
+        instruction(Interpreter::InstructionCode::LOAD_C, BaseType::Uint32, 4),
+        instruction(Interpreter::InstructionCode::RESOURCE, 1),
+        instruction(Interpreter::InstructionCode::CALL, 0)};
+    mConstants = {1, 2, 3, 4, 5, 6, 7, 8};
+    mResources = {resource(1, 16), resource(2, 32)};
+  }
+
+  uint64_t key() {
+    return Checkpoint::computeKey(mInstructions.data(), mInstructions.size(),
+                                  PREFIX, mConstants.data(), mConstants.size(),
+                                  mResources, VOLATILE_SIZE);
+  }
+
+  void setPrefix(Checkpoint* checkpoint) {
+    checkpoint->setPrefix(mInstructions.data(), mInstructions.size(), PREFIX,
+                          mConstants.data(), mConstants.size(), mResources,
+                          VOLATILE_SIZE);
+  }
+
+  bool matches(const Checkpoint& checkpoint,
+               uint64_t volatileSize = VOLATILE_SIZE) {
+    return checkpoint.matches(mInstructions.data(), mInstructions.size(),
+                              mConstants.data(), mConstants.size(), mResources,
+                              volatileSize);
+  }
+
+  std::vector<uint32_t> mInstructions;
+  std::vector<uint8_t> mConstants;
+  std::vector<Resource> mResources;
+};
+
+// BuilderPayload is a replay payload written by the GAPIS replay builder.
+class BuilderPayload {
+ public:
+  // Reads the payload written to the given file by
+  // gapis/replay/builder/checkpoint_payloads.
+  explicit BuilderPayload(const std::string& name) {
+    std::ifstream file("gapis/replay/builder/checkpoint_payloads/" + name,
+                       std::ios::binary);
+    std::stringstream data;
+    data << file.rdbuf();
+    std::unique_ptr<replay_service::Payload> proto(
+        new replay_service::Payload());
+    mValid = file.good() && proto->ParseFromString(data.str());
+    ReplayConnection::Payload payload(std::move(proto));
+    mInstructions.resize(payload.opcodes_size() / sizeof(uint32_t));
+    memcpy(mInstructions.data(), payload.opcodes_data(),
+           mInstructions.size() * sizeof(uint32_t));
+    auto constants = static_cast<const uint8_t*>(payload.constants_data());
+    mConstants.assign(constants, constants + payload.constants_size());
+    for (size_t i = 0; i < payload.resource_info_count(); i++) {
+      mResources.emplace_back(payload.resource_id(i), payload.resource_size(i));
+    }
+    mVolatileSize = payload.volatile_memory_size();
+  }
+
+  bool valid() const { return mValid; }
+
+  // checkpoint returns the index of the first label of the commands inserted
+  // by GAPIS, where the replay takes its checkpoint.
+  uint32_t checkpoint() const {
+    auto label = instruction(Interpreter::InstructionCode::LABEL,
+                             Checkpoint::kInsertedCommandLabel);
+    for (uint32_t i = 0; i < mInstructions.size(); i++) {
+      if (mInstructions[i] == label) {
+        return i;
+      }
+    }
+    return mInstructions.size();
+  }
+
+  uint64_t key() const {
+    return Checkpoint::computeKey(mInstructions.data(), mInstructions.size(),
+                                  checkpoint(), mConstants.data(),
+                                  mConstants.size(), mResources, mVolatileSize);
+  }
+
+  void setPrefix(Checkpoint* checkpoint) const {
+    checkpoint->setPrefix(mInstructions.data(), mInstructions.size(),
+                          this->checkpoint(), mConstants.data(),
+                          mConstants.size(), mResources, mVolatileSize);
+  }
+
+  bool matches(const Checkpoint& checkpoint) const {
+    return checkpoint.matches(mInstructions.data(), mInstructions.size(),
+                              mConstants.data(), mConstants.size(), mResources,
+                              mVolatileSize);
+  }
+
+  std::vector<uint8_t> mConstants;
+
+ private:
+  bool mValid;
+  std::vector<uint32_t> mInstructions;
+  std::vector<Resource> mResources;
+  uint64_t mVolatileSize;
+};
+
+}  // anonymous namespace
+
+TEST_F(CheckpointTest, KeyIgnoresInstructionsAfterPrefix) {
+  uint64_t expected = key();
+  mInstructions[7] = instruction(Interpreter::InstructionCode::CALL, 1);
+  mInstructions.push_back(instruction(Interpreter::InstructionCode::CALL, 2));
+  mConstants[4] = 42;
+  mConstants.push_back(9);
+  mResources[1] = resource(3, 64);
+  EXPECT_EQ(expected, key());
+}
+
+TEST_F(CheckpointTest, KeyCoversPrefixInstructions) {
+  uint64_t expected = key();
+  mInstructions[3] = instruction(Interpreter::InstructionCode::CALL, 1);
+  EXPECT_NE(expected, key());
+}
+
+TEST_F(CheckpointTest, KeyCoversPrefixConstants) {
+  uint64_t expected = key();
+  mConstants[2] = 42;
+  EXPECT_NE(expected, key());
+}
+
+TEST_F(CheckpointTest, KeyCoversPrefixResources) {
+  uint64_t expected = key();
+  mResources[0] = resource(3, 16);
+  EXPECT_NE(expected, key());
+  mResources[0] = resource(1, 8);
+  EXPECT_NE(expected, key());
+}
+
+TEST_F(CheckpointTest, KeyCoversVolatileSize) {
+  EXPECT_NE(key(), Checkpoint::computeKey(
+                       mInstructions.data(), mInstructions.size(), PREFIX,
+                       mConstants.data(), mConstants.size(), mResources,
+                       VOLATILE_SIZE * 2));
+}
+
+TEST_F(CheckpointTest, MatchesSamePrefix) {
+  Checkpoint checkpoint;
+  setPrefix(&checkpoint);
+  EXPECT_EQ(key(), checkpoint.key);
+  EXPECT_EQ(PREFIX, checkpoint.instruction);
+  EXPECT_TRUE(matches(checkpoint));
+
+  mInstructions[7] = instruction(Interpreter::InstructionCode::CALL, 1);
+  mConstants[4] = 42;
+  mResources[1] = resource(3, 64);
+  EXPECT_TRUE(matches(checkpoint));
+  EXPECT_FALSE(matches(checkpoint, VOLATILE_SIZE * 2));
+  mInstructions.resize(PREFIX - 1);
+  EXPECT_FALSE(matches(checkpoint));
+}
+
+// A replay whose key collides with the checkpoint's does not match it if its
+// prefix differs.
+TEST_F(CheckpointTest, MatchesComparesPrefix) {
+  Checkpoint checkpoint;
+  setPrefix(&checkpoint);
+  mInstructions[3] = instruction(Interpreter::InstructionCode::CALL, 1);
+  checkpoint.key = key();
+  EXPECT_FALSE(matches(checkpoint));
+
+  SetUp();
+  setPrefix(&checkpoint);
+  mConstants[2] = 42;
+  checkpoint.key = key();
+  EXPECT_FALSE(matches(checkpoint));
+
+  SetUp();
+  setPrefix(&checkpoint);
+  mResources[0] = resource(3, 16);
+  checkpoint.key = key();
+  EXPECT_FALSE(matches(checkpoint));
+}
+
+// The payloads built by GAPIS share the prefix of the checkpoint if they only
+// differ in the commands inserted at the end of the replay.
+TEST(CheckpointBuilderTest, ResumesSharedPrefix) {
+  BuilderPayload first("first.payload");
+  BuilderPayload second("second.payload");
+  BuilderPayload changed("changed.payload");
+  ASSERT_TRUE(first.valid());
+  ASSERT_TRUE(second.valid());
+  ASSERT_TRUE(changed.valid());
+  ASSERT_NE(0, first.checkpoint());
+  EXPECT_EQ(first.checkpoint(), second.checkpoint());
+  EXPECT_NE(first.mConstants, second.mConstants);
+
+  Checkpoint checkpoint;
+  first.setPrefix(&checkpoint);
+  EXPECT_EQ(first.key(), checkpoint.key);
+  EXPECT_TRUE(first.matches(checkpoint));
+  EXPECT_EQ(checkpoint.key, second.key());
+  EXPECT_TRUE(second.matches(checkpoint));
+  EXPECT_NE(checkpoint.key, changed.key());
+  EXPECT_FALSE(changed.matches(checkpoint));
+}
+
+TEST(CheckpointStoreTest, Fits) {
+  CheckpointStore store(VOLATILE_SIZE);
+  EXPECT_TRUE(store.fits(VOLATILE_SIZE));
+  EXPECT_FALSE(store.fits(VOLATILE_SIZE + 1));
+}
+
+TEST(CheckpointStoreTest, PutTake) {
+  CheckpointStore store(VOLATILE_SIZE);
+  EXPECT_EQ(nullptr, store.take());
+
+  std::unique_ptr<Checkpoint> first(new Checkpoint());
+  first->label = 1;
+  store.put(std::move(first));
+  std::unique_ptr<Checkpoint> second(new Checkpoint());
+  second->label = 2;
+  store.put(std::move(second));
+
+  auto checkpoint = store.take();
+  ASSERT_NE(nullptr, checkpoint);
+  EXPECT_EQ(2u, checkpoint->label);
+  EXPECT_EQ(nullptr, store.take());
+}
+
+}  // namespace test
+}  // namespace gapir
@@ -15,6 +15,7 @@
  */
 
 #include "context.h"
+#include "checkpoint.h"
 #include "gapir/cc/gles_gfx_api.h"
 #include "gapir/cc/vulkan_gfx_api.h"
 #include "gles_renderer.h"
@@ -36,17 +37,21 @@
 #include <inttypes.h>
 
 #include <cstdlib>
+#include <cstring>
 #include <sstream>
 #include <string>
+#include <unordered_set>
+#include <vector>
 
 namespace gapir {
 
 std::unique_ptr<Context> Context::create(ReplayConnection* conn,
                                          core::CrashHandler& crash_handler,
                                          ResourceProvider* resource_provider,
-                                         MemoryManager* memory_manager) {
-  std::unique_ptr<Context> context(
-      new Context(conn, crash_handler, resource_provider, memory_manager));
+                                         MemoryManager* memory_manager,
+                                         CheckpointStore* checkpoints) {
+  std::unique_ptr<Context> context(new Context(
+      conn, crash_handler, resource_provider, memory_manager, checkpoints));
 
   if (context->initialize()) {
     GAPID_DEBUG("Replay context initialized successfully");
@@ -60,7 +65,7 @@ std::unique_ptr<Context> Context::create(ReplayConnection* conn,
 // TODO: Make the PostBuffer size dynamic? It currently holds 2MB of data.
 Context::Context(ReplayConnection* conn, core::CrashHandler& crash_handler,
                  ResourceProvider* resource_provider,
-                 MemoryManager* memory_manager)
+                 MemoryManager* memory_manager, CheckpointStore* checkpoints)
     :
 
       mConnection(conn),
@@ -76,9 +81,15 @@ Context::Context(ReplayConnection* conn, core::CrashHandler& crash_handler,
             }
             return false;
           })),
-      mNumSentDebugMessages(0) {}
+      mNumSentDebugMessages(0),
+      mCheckpoints(checkpoints),
+      mLastLabel(Checkpoint::kInsertedCommandLabel) {}
 
 Context::~Context() {
+  // The interpreter of a replay resumed from a checkpoint is kept until the
+  // context is destroyed. Its threads are stopped before the renderers bound
+  // on them are destroyed.
+  mInterpreter.reset();
   for (auto it = mGlesRenderers.begin(); it != mGlesRenderers.end(); it++) {
     delete it->second;
   }
@@ -93,10 +104,23 @@ bool Context::initialize() {
   }
 
   GAPID_DEBUG("ReplayRequest created successfully");
+  mConnection->stats().volatileMemoryBytes =
+      mReplayRequest->getVolatileMemorySize();
+  if (mCheckpoints != nullptr && resumeFrom(mCheckpoints->take())) {
+    return true;
+  }
+  // Leave room for the replay data of the next replays to grow without
+  // moving the volatile memory, so that they can resume from the checkpoint.
+  uint64_t headroom = 0;
+  if (mCheckpoints != nullptr) {
+    headroom =
+        mMemoryManager->getConstantSize() + mMemoryManager->getOpcodeSize();
+  }
   if (!mMemoryManager->setVolatileMemory(
-          mReplayRequest->getVolatileMemorySize())) {
-    GAPID_WARNING("Setting the volatile memory size failed (size: %u)",
-                  mReplayRequest->getVolatileMemorySize());
+          mReplayRequest->getVolatileMemorySize(), headroom)) {
+    GAPID_WARNING(
+        "Setting the volatile memory size failed (size: %" PRIu64 ")",
+        mReplayRequest->getVolatileMemorySize());
     return false;
   }
 
@@ -104,14 +128,150 @@ bool Context::initialize() {
   return true;
 }
 
+bool Context::resumeFrom(std::unique_ptr<Checkpoint> checkpoint) {
+  if (checkpoint == nullptr) {
+    return false;
+  }
+  auto instAndCount = mReplayRequest->getInstructionList();
+  auto constants = mReplayRequest->getConstantMemory();
+  auto volatileSize = mReplayRequest->getVolatileMemorySize();
+  if (!checkpoint->matches(instAndCount.first, instAndCount.second,
+                           constants.first, constants.second,
+                           mReplayRequest->getResources(), volatileSize)) {
+    GAPID_INFO("Replay does not start with the instructions of the checkpoint");
+    return false;
+  }
+  if (!mMemoryManager->setVolatileMemoryAt(checkpoint->volatileAddress,
+                                           volatileSize)) {
+    GAPID_INFO("Replay data overlaps the volatile memory of the checkpoint");
+    return false;
+  }
+
+  mInterpreter = std::move(checkpoint->interpreter);
+  mRootGlesRenderer = std::move(checkpoint->rootGlesRenderer);
+  mGlesRenderers.swap(checkpoint->glesRenderers);
+  for (auto it : mGlesRenderers) {
+    it.second->setListener(this);
+  }
+  mVulkanRenderer = checkpoint->vulkanRenderer;
+  checkpoint->vulkanRenderer = nullptr;
+  if (mVulkanRenderer != nullptr) {
+    mVulkanRenderer->setListener(this);
+  }
+  mLastLabel = checkpoint->label;
+  mResume = std::move(checkpoint);
+  return true;
+}
+
+void Context::onLabel(uint32_t label) {
+  uint32_t lastLabel = mLastLabel;
+  mLastLabel = label;
+  if (label != Checkpoint::kInsertedCommandLabel) {
+    // The commands of the capture change the state of the renderers after the
+    // checkpoint.
+    mCheckpoint.reset();
+    return;
+  }
+  if (lastLabel == Checkpoint::kInsertedCommandLabel) {
+    return;
+  }
+
+  // The renderers bound on the thread of the replay connection could not be
+  // bound on the thread of the next one.
+  auto volatileSize = mMemoryManager->getVolatileSize();
+  auto instAndCount = mReplayRequest->getInstructionList();
+  auto constants = mReplayRequest->getConstantMemory();
+  // The checkpoint keeps a copy of the volatile memory, and of the
+  // instructions and the constants before it.
+  uint64_t keptSize = volatileSize + constants.second +
+                      mInterpreter->getInstruction() * sizeof(uint32_t);
+  bool hasGlesRenderers = mRootGlesRenderer || !mGlesRenderers.empty();
+  if (mInterpreter->getStackSize() != 0 ||
+      (mInterpreter->getThread() == 0 && hasGlesRenderers) ||
+      !mCheckpoints->fits(keptSize)) {
+    mCheckpoint.reset();
+    return;
+  }
+
+  if (mCheckpoint == nullptr) {
+    mCheckpoint.reset(new Checkpoint());
+  }
+  mCheckpoint->setPrefix(instAndCount.first, instAndCount.second,
+                         mInterpreter->getInstruction(), constants.first,
+                         constants.second, mReplayRequest->getResources(),
+                         volatileSize);
+  mCheckpoint->thread = mInterpreter->getThread();
+  mCheckpoint->label = lastLabel;
+  mCheckpoint->volatileAddress = mMemoryManager->getVolatileAddress();
+  auto volatileBase =
+      static_cast<const uint8_t*>(mMemoryManager->getVolatileAddress());
+  mCheckpoint->volatileMemory.assign(volatileBase, volatileBase + volatileSize);
+  GAPID_DEBUG("[%u]Checkpoint at instruction %u", mCheckpoint->label,
+              mCheckpoint->instruction);
+}
+
+void Context::storeCheckpoint() {
+  mInterpreter->setLabelCallback(nullptr);
+  for (auto it : mGlesRenderers) {
+    it.second->setListener(nullptr);
+  }
+  if (mVulkanRenderer != nullptr) {
+    mVulkanRenderer->setListener(nullptr);
+  }
+  mCheckpoint->interpreter = std::move(mInterpreter);
+  mCheckpoint->rootGlesRenderer = std::move(mRootGlesRenderer);
+  mCheckpoint->glesRenderers.swap(mGlesRenderers);
+  mCheckpoint->vulkanRenderer = mVulkanRenderer;
+  mVulkanRenderer = nullptr;
+  GAPID_INFO("Kept the checkpoint at label %u", mCheckpoint->label);
+  mCheckpoints->put(std::move(mCheckpoint));
+}
+
 void Context::prefetch(ResourceInMemoryCache* cache) const {
-  auto cacheSize = static_cast<uint32_t>(
+  auto cacheSize = static_cast<size_t>(
       static_cast<uint8_t*>(mMemoryManager->getVolatileAddress()) -
       static_cast<uint8_t*>(mMemoryManager->getBaseAddress()));
   cache->resize(cacheSize);
 
   auto resources = mReplayRequest->getResources();
   if (resources.size() > 0) {
+    // The cache evicts and fetches ahead based on the order in which the
+    // resources are loaded, so it is set before prefetching.
+    // A replay resuming from a checkpoint only loads the resources used after
+    // the checkpoint. The resources split into chunks are loaded from their
+    // chunks, and never fetched whole.
+    auto instAndCount = mReplayRequest->getInstructionList();
+    uint32_t start = mResume != nullptr ? mResume->instruction : 0;
+    std::vector<Resource> schedule;
+    for (auto index : Interpreter::resourceIndices(
+             instAndCount.first + start, instAndCount.second - start)) {
+      const auto& chunks = mReplayRequest->getResourceChunks(index);
+      if (!chunks.empty()) {
+        schedule.insert(schedule.end(), chunks.begin(), chunks.end());
+      } else if (index < resources.size()) {
+        schedule.push_back(resources[index]);
+      }
+    }
+    if (mResume != nullptr) {
+      std::unordered_set<ResourceId> used;
+      resources.clear();
+      for (const auto& resource : schedule) {
+        if (used.insert(resource.id).second) {
+          resources.push_back(resource);
+        }
+      }
+    } else {
+      std::vector<Resource> whole;
+      for (size_t i = 0; i < resources.size(); i++) {
+        if (mReplayRequest->getResourceChunks(i).empty()) {
+          whole.push_back(resources[i]);
+        }
+      }
+      resources.swap(whole);
+    }
+    cache->setSchedule(std::move(schedule));
+    cache->setLookahead(LOOKAHEAD_RESOURCES, LOOKAHEAD_BYTES);
+
     GAPID_INFO("Prefetching %zu resources...", resources.size());
     mResourceProvider->prefetch(resources.data(), resources.size(), mConnection,
                                 mMemoryManager->getVolatileAddress(),
@@ -124,7 +284,12 @@ bool Context::interpret() {
                                                     uint8_t api_index) -> bool {
     if (api_index == gapir::Vulkan::INDEX) {
       // There is only one vulkan "renderer" so we create it when requested.
+      core::Timer timer;
+      timer.Start();
       mVulkanRenderer = VulkanRenderer::create();
+      if (mConnection != nullptr) {
+        mConnection->stats().rendererNs += timer.Stop();
+      }
       if (mVulkanRenderer->isValid()) {
         mVulkanRenderer->setListener(this);
         Api* api = mVulkanRenderer->api();
@@ -136,13 +301,43 @@ bool Context::interpret() {
     return false;
   };
 
-  mInterpreter.reset(new Interpreter(mCrashHandler, mMemoryManager,
-                                     mReplayRequest->getStackSize(),
-                                     std::move(callback)));
-  registerCallbacks(mInterpreter.get());
   auto instAndCount = mReplayRequest->getInstructionList();
-  auto res = mInterpreter->run(instAndCount.first, instAndCount.second) &&
-             mPostBuffer->flush();
+  bool res;
+  if (mResume != nullptr) {
+    mInterpreter->reset(std::move(callback));
+    registerCallbacks(mInterpreter.get());
+    if (mCheckpoints != nullptr) {
+      mInterpreter->setLabelCallback(
+          [this](uint32_t label) { this->onLabel(label); });
+    }
+    // The prefetch may have used the volatile memory.
+    memcpy(mMemoryManager->getVolatileAddress(), mResume->volatileMemory.data(),
+           mResume->volatileMemory.size());
+    GAPID_INFO("Resuming from the checkpoint at label %u, skipping %u of %u "
+               "instructions",
+               mResume->label, mResume->instruction, instAndCount.second);
+    if (mConnection != nullptr) {
+      mConnection->stats().checkpointInstructions = mResume->instruction;
+    }
+    res = mInterpreter->resume(instAndCount.first, instAndCount.second,
+                               mResume->instruction, mResume->thread,
+                               mResume->label, mReplayRequest->getStackSize());
+    mResume.reset();
+  } else {
+    mInterpreter.reset(new Interpreter(mCrashHandler, mMemoryManager,
+                                       mReplayRequest->getStackSize(),
+                                       std::move(callback)));
+    registerCallbacks(mInterpreter.get());
+    if (mCheckpoints != nullptr) {
+      mInterpreter->setLabelCallback(
+          [this](uint32_t label) { this->onLabel(label); });
+    }
+    res = mInterpreter->run(instAndCount.first, instAndCount.second);
+  }
+  res = res && mPostBuffer->flush();
+  if (res && mCheckpoint != nullptr) {
+    storeCheckpoint();
+  }
   mInterpreter.reset(nullptr);
   return res;
 }
@@ -210,6 +405,8 @@ void Context::registerCallbacks(Interpreter* interpreter) {
         uint32_t id = stack->pop<uint32_t>();
         if (stack->isValid()) {
           GAPID_INFO("[%u]replayCreateRenderer(%u)", label, id);
+          core::Timer timer;
+          timer.Start();
           auto existing = mGlesRenderers.find(id);
           if (existing != mGlesRenderers.end()) {
             delete existing->second;
@@ -236,6 +433,9 @@ void Context::registerCallbacks(Interpreter* interpreter) {
           }
           renderer->setListener(this);
           mGlesRenderers[id] = renderer;
+          if (mConnection != nullptr) {
+            mConnection->stats().rendererNs += timer.Stop();
+          }
           return true;
         } else {
           GAPID_WARNING(
@@ -689,10 +889,17 @@ bool Context::loadResource(Stack* stack) {
   }
 
   const auto& resource = mReplayRequest->getResources()[resourceId];
-
-  if (!mResourceProvider->get(&resource, 1, mConnection, address,
-                              resource.size)) {
-    GAPID_WARNING("Can't fetch resource: %s", resource.id.c_str());
+  // A resource split into chunks is reassembled from its chunks, which the
+  // resource provider fetches and caches like any other resource.
+  const auto& chunks = mReplayRequest->getResourceChunks(resourceId);
+  bool loaded =
+      chunks.empty()
+          ? mResourceProvider->get(&resource, 1, mConnection, address,
+                                   resource.size)
+          : mResourceProvider->get(chunks.data(), chunks.size(), mConnection,
+                                   address, resource.size);
+  if (!loaded) {
+    GAPID_WARNING("Can't fetch resource: %s", resource.id.string().c_str());
     return false;
   }
 
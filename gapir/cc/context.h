@@ -30,6 +30,8 @@
 
 namespace gapir {
 
+class Checkpoint;
+class CheckpointStore;
 class GlesRenderer;
 class Interpreter;
 class MemoryManager;
@@ -47,11 +49,13 @@ class Context : private Renderer::Listener {
  public:
   // Creates a new Context object and initialize it with loading the replay
   // request, setting up the memory manager, setting up the caches and
-  // prefetching the resources
-  static std::unique_ptr<Context> create(ReplayConnection* conn,
-                                         core::CrashHandler& crash_handler,
-                                         ResourceProvider* resource_provider,
-                                         MemoryManager* memory_manager);
+  // prefetching the resources. If checkpoints is not null, the replay resumes
+  // from its checkpoint if it starts with the same instructions, and leaves
+  // its own checkpoint in it.
+  static std::unique_ptr<Context> create(
+      ReplayConnection* conn, core::CrashHandler& crash_handler,
+      ResourceProvider* resource_provider, MemoryManager* memory_manager,
+      CheckpointStore* checkpoints = nullptr);
 
   ~Context();
 
@@ -69,15 +73,34 @@ class Context : private Renderer::Listener {
   enum {
     MAX_TIMERS = 256,
     POST_BUFFER_SIZE = 2 * 1024 * 1024,
+    // The limits of the resources fetched ahead of their use once the
+    // resources stop fitting in the resource cache.
+    LOOKAHEAD_RESOURCES = 128,
+    LOOKAHEAD_BYTES = 16 * 1024 * 1024,
   };
 
   Context(ReplayConnection* conn, core::CrashHandler& crash_handler,
-          ResourceProvider* resource_provider, MemoryManager* memory_manager);
+          ResourceProvider* resource_provider, MemoryManager* memory_manager,
+          CheckpointStore* checkpoints);
 
   // Initialize the context object with loading the replay request, setting up
   // the memory manager, setting up the caches and prefetching the resources
   bool initialize();
 
+  // Takes over the interpreter and the renderers of the checkpoint and places
+  // the volatile memory where it was, if the replay request starts with the
+  // instructions before the checkpoint. Returns false and destroys the
+  // checkpoint otherwise.
+  bool resumeFrom(std::unique_ptr<Checkpoint> checkpoint);
+
+  // Called by the interpreter after each LABEL instruction to take or drop
+  // the checkpoint of the replay.
+  void onLabel(uint32_t label);
+
+  // Hands over the interpreter and the renderers to the checkpoint of the
+  // replay, and stores it.
+  void storeCheckpoint();
+
   // Register the callbacks for the interpreter (Gl functions, load resource,
   // post resource)
   void registerCallbacks(Interpreter* interpreter);
@@ -140,6 +163,18 @@ class Context : private Renderer::Listener {
 
   // The total number of debug messages sent to GAPIS.
   uint64_t mNumSentDebugMessages;
+
+  // The store of the checkpoints, or nullptr if checkpoints are disabled.
+  CheckpointStore* mCheckpoints;
+
+  // The checkpoint the replay resumes from, until interpret() is called.
+  std::unique_ptr<Checkpoint> mResume;
+
+  // The last checkpoint taken by the replay, if still valid.
+  std::unique_ptr<Checkpoint> mCheckpoint;
+
+  // The last label reached by the replay.
+  uint32_t mLastLabel;
 };
 
 }  // namespace gapir
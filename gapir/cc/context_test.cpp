@@ -37,12 +37,12 @@ namespace {
 
 const uint32_t MEMORY_SIZE = 4096;
 const ResourceId REPLAY_ID = "replay-id";
-const Resource A("A", 4);
+const Resource A(resourceId("A"), 4);
 
 class ContextTest : public ::testing::Test {
  protected:
   virtual void SetUp() {
-    std::vector<uint32_t> memorySizes = {MEMORY_SIZE};
+    std::vector<uint64_t> memorySizes = {MEMORY_SIZE};
     mMemoryManager.reset(new MemoryManager(memorySizes));
     mResourceProvider.reset(new StrictMock<MockResourceProvider>());
     mConn.reset(new MockReplayConnection());
@@ -114,6 +114,37 @@ TEST_F(ContextTest, LoadResource) {
   EXPECT_THAT(resourceA, ElementsAreArray(res, resourceA.size()));
 }
 
+TEST_F(ContextTest, LoadChunkedResource) {
+  const Resource B(resourceId("B"), 2);
+  const Resource C(resourceId("C"), 2);
+  auto payload =
+      createPayload(128, 1024, {}, {A, B, C},
+                    {instruction(Interpreter::InstructionCode::PUSH_I,
+                                 BaseType::VolatilePointer, 0),
+                     instruction(Interpreter::InstructionCode::RESOURCE, 0)},
+                    {{1, 2}});
+  std::vector<uint8_t> resourceA{1, 2, 3, 4};
+  const Resource* chunks = nullptr;
+
+  EXPECT_CALL(*mConn, getPayload())
+      .WillOnce(Return(ByMove(std::move(payload))));
+  EXPECT_CALL(*mResourceProvider, get(_, 2, _, _, 4))
+      .WillOnce(DoAll(SaveArg<0>(&chunks),
+                      WithArg<3>(SetVoidPointee(resourceA)), Return(true)));
+
+  core::CrashHandler crash_handler;
+  auto context = Context::create(mConn.get(), crash_handler,
+                                 mResourceProvider.get(), mMemoryManager.get());
+
+  EXPECT_THAT(context, NotNull());
+  EXPECT_TRUE(context->interpret());
+  ASSERT_THAT(chunks, NotNull());
+  EXPECT_EQ(B, chunks[0]);
+  EXPECT_EQ(C, chunks[1]);
+  auto res = (uint8_t*)mMemoryManager->volatileToAbsolute(0);
+  EXPECT_THAT(resourceA, ElementsAreArray(res, resourceA.size()));
+}
+
 TEST_F(ContextTest, LoadResourcePopFailed) {
   auto payload =
       createPayload(128, 1024, {}, {A},
@@ -19,9 +19,11 @@
 
 #include "core/cc/crash_handler.h"
 #include "core/cc/log.h"
+#include "core/cc/trace.h"
 
 #define __STDC_FORMAT_MACROS
 #include <inttypes.h>
+#include <string.h>
 
 #if !defined(_MSC_VER) || defined(__GNUC__)
 // If compiling with MSVC, (rather than MSYS)
@@ -72,6 +74,10 @@ Interpreter::Interpreter(core::CrashHandler& crash_handler,
       mCurrentInstruction(0),
       mNextThread(0),
       mLabel(0) {
+  registerBuiltins();
+}
+
+void Interpreter::registerBuiltins() {
   registerBuiltin(GLOBAL_INDEX, PRINT_STACK_FUNCTION_ID,
                   [](uint32_t, Stack* stack, bool) {
                     stack->printStack();
@@ -110,7 +116,85 @@ bool Interpreter::run(const uint32_t* instructions, uint32_t count) {
   return mExecResult.get_future().get() == SUCCESS;
 }
 
+bool Interpreter::resume(const uint32_t* instructions, uint32_t count,
+                         uint32_t start, uint32_t thread, uint32_t label,
+                         uint32_t stack_depth) {
+  GAPID_ASSERT(start <= count);
+  mInstructions = instructions;
+  mInstructionCount = count;
+  mCurrentInstruction = start;
+  mNextThread = thread;
+  mLabel = label;
+  mStack = Stack(stack_depth, mMemoryManager);
+  mExecResult = std::promise<Result>();
+  auto unregisterHandler = mCrashHandler.registerHandler(
+      [this](const std::string& minidumpPath, bool succeeded) {
+        GAPID_ERROR("--- CRASH DURING REPLAY ---");
+        GAPID_ERROR("LAST COMMAND:     %d", mLabel);
+        GAPID_ERROR("LAST INSTRUCTION: %d", mCurrentInstruction);
+      });
+  if (thread == 0) {
+    exec();
+  } else {
+    // Continue on the thread which had the renderers bound.
+    mThreadPool.enqueue(thread, [this] { this->exec(); });
+  }
+  auto result = mExecResult.get_future().get();
+  unregisterHandler();
+  return result == SUCCESS;
+}
+
+void Interpreter::reset(ApiRequestCallback callback) {
+  mBuiltins.clear();
+  registerBuiltins();
+  apiRequestCallback = std::move(callback);
+  mLabelCallback = nullptr;
+}
+
+void Interpreter::setLabelCallback(LabelCallback callback) {
+  mLabelCallback = std::move(callback);
+}
+
+std::vector<uint32_t> Interpreter::resourceIndices(
+    const uint32_t* instructions, uint32_t count) {
+  // The instructions have no branches, so the order of the RESOURCE
+  // instructions in the list is the order of the resource loads.
+  std::vector<uint32_t> indices;
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t opcode = instructions[i];
+    if (static_cast<InstructionCode>(opcode >> OPCODE_BIT_SHIFT) ==
+        InstructionCode::RESOURCE) {
+      indices.push_back(opcode & DATA_MASK26);
+    }
+  }
+  return indices;
+}
+
+std::vector<uint64_t> Interpreter::constantOffsets(
+    const uint32_t* instructions, uint32_t count) {
+  std::vector<uint64_t> offsets;
+  // Constant pointers wider than 20 bits are pushed by a PUSH_I followed by
+  // EXTEND instructions, each shifting in 26 more bits.
+  bool pushed = false;
+  for (uint32_t i = 0; i < count; i++) {
+    uint32_t opcode = instructions[i];
+    auto code = static_cast<InstructionCode>(opcode >> OPCODE_BIT_SHIFT);
+    auto type = BaseType((opcode & TYPE_MASK) >> TYPE_BIT_SHIFT);
+    if (code == InstructionCode::EXTEND && pushed) {
+      offsets.back() = (offsets.back() << 26) | (opcode & DATA_MASK26);
+      continue;
+    }
+    pushed = code == InstructionCode::PUSH_I &&
+             type == BaseType::ConstantPointer;
+    if (pushed || code == InstructionCode::LOAD_C) {
+      offsets.push_back(opcode & DATA_MASK20);
+    }
+  }
+  return offsets;
+}
+
 void Interpreter::exec() {
+  GAPID_TRACE_NAME("Interpreter::exec");
   for (; mCurrentInstruction < mInstructionCount; mCurrentInstruction++) {
     switch (interpret(mInstructions[mCurrentInstruction])) {
       case SUCCESS:
@@ -151,6 +235,7 @@ bool Interpreter::registerApi(uint8_t api) {
 }
 
 Interpreter::Result Interpreter::call(uint32_t opcode) {
+  GAPID_TRACE_NAME("Interpreter::call");
   auto id = opcode & FUNCTION_ID_MASK;
   auto api = (opcode & API_INDEX_MASK) >> API_BIT_SHIFT;
   auto func = mBuiltins[api].lookup(id);
@@ -340,16 +425,12 @@ Interpreter::Result Interpreter::strcpy(uint32_t opcode) {
     GAPID_WARNING("Error: strcpy destination address is null");
     return ERROR;
   }
-  uint32_t i;
-  for (i = 0; i < count - 1; i++) {
-    char c = source[i];
-    if (c == 0) {
-      break;
-    }
-    target[i] = c;
-  }
-  for (; i < count; i++) {
-    target[i] = 0;
+  if (count > 0) {
+    // strnlen, memcpy and memset are vectorized by the C library, unlike a
+    // loop over the characters.
+    size_t length = strnlen(source, count - 1);
+    memcpy(target, source, length);
+    memset(target + length, 0, count - length);
   }
   return mStack.isValid() ? SUCCESS : ERROR;
 }
@@ -448,6 +529,9 @@ Interpreter::Result Interpreter::add(uint32_t opcode) {
 
 Interpreter::Result Interpreter::label(uint32_t opcode) {
   mLabel = extract26bitData(opcode);
+  if (mLabelCallback) {
+    mLabelCallback(mLabel);
+  }
   return SUCCESS;
 }
 
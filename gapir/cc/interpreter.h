@@ -31,6 +31,7 @@
 #include <future>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 namespace gapir {
 
@@ -47,6 +48,10 @@ class Interpreter {
   // return true if the request is fulfilled.
   using ApiRequestCallback = std::function<bool(Interpreter*, uint8_t)>;
 
+  // The type of the callback function called after each LABEL instruction,
+  // with the new label value.
+  using LabelCallback = std::function<void(uint32_t label)>;
+
   using InstructionCode = vm::Opcode;
 
   enum : uint32_t {
@@ -82,14 +87,49 @@ class Interpreter {
   // by its size.
   bool run(const uint32_t* instructions, uint32_t count);
 
+  // Runs the interpreter on the instruction list from the instruction at index
+  // start, on the given thread and with an empty stack of the given size, as
+  // if the instructions before start had been run by a previous call to run()
+  // or resume() which reached the given label.
+  bool resume(const uint32_t* instructions, uint32_t count, uint32_t start,
+              uint32_t thread, uint32_t label, uint32_t stack_depth);
+
+  // Unregisters all the builtin functions and replaces the api request
+  // callback, keeping the threads and the renderer functions, so that another
+  // context can resume() with this interpreter.
+  void reset(ApiRequestCallback callback);
+
+  // Sets the callback called after each LABEL instruction.
+  void setLabelCallback(LabelCallback callback);
+
   // Registers an API instance if it has not already been done.
   bool registerApi(uint8_t api);
 
+  // Returns the indices of the resources loaded by the RESOURCE instructions
+  // of the instruction list, in the order run() will load them.
+  static std::vector<uint32_t> resourceIndices(const uint32_t* instructions,
+                                               uint32_t count);
+
+  // Returns the offsets of the constant memory referenced by the LOAD_C
+  // instructions and by the constant pointers pushed by the instruction list.
+  static std::vector<uint64_t> constantOffsets(const uint32_t* instructions,
+                                               uint32_t count);
+
   // Returns the last reached label value.
   inline uint32_t getLabel() const;
 
+  // Returns the index of the instruction being interpreted.
+  inline uint32_t getInstruction() const;
+
+  // Returns the thread the instructions are being interpreted on.
+  inline uint32_t getThread() const;
+
+  // Returns the number of elements on the stack.
+  inline uint32_t getStackSize() const;
+
  private:
   void exec();
+  void registerBuiltins();
 
   enum : uint32_t {
     TYPE_MASK = 0x03f00000U,
@@ -168,6 +208,9 @@ class Interpreter {
   // Callback function for requesting renderer functions for an unknown api.
   ApiRequestCallback apiRequestCallback;
 
+  // Callback function called after each LABEL instruction.
+  LabelCallback mLabelCallback;
+
   // The stack of the Virtual Machine.
   Stack mStack;
 
@@ -218,6 +261,14 @@ inline bool Interpreter::isWriteAddress(void* address) const {
 
 inline uint32_t Interpreter::getLabel() const { return mLabel; }
 
+inline uint32_t Interpreter::getInstruction() const {
+  return mCurrentInstruction;
+}
+
+inline uint32_t Interpreter::getThread() const { return mNextThread; }
+
+inline uint32_t Interpreter::getStackSize() const { return mStack.size(); }
+
 }  // namespace gapir
 
 #endif  // GAPIR_INTERPRETER_H
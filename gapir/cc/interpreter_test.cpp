@@ -17,6 +17,7 @@
 #include "interpreter.h"
 #include "test_utilities.h"
 
+#include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
 #include <memory>
@@ -41,7 +42,7 @@ struct CheckTopOfStack {
 class InterpreterTest : public ::testing::Test {
  protected:
   virtual void SetUp() {
-    std::vector<uint32_t> memorySizes = {MEMORY_SIZE};
+    std::vector<uint64_t> memorySizes = {MEMORY_SIZE};
     mMemoryManager.reset(new MemoryManager(memorySizes));
     auto callback = [](Interpreter*, uint8_t) { return false; };
     mInterpreter.reset(new Interpreter(crash_handler, mMemoryManager.get(),
@@ -363,6 +364,30 @@ TEST_F(InterpreterTest, StrcpyShortBuffer) {
   EXPECT_EQ('x', volatileMemory[5]);
 }
 
+TEST_F(InterpreterTest, StrcpyZeroCount) {
+  mMemoryManager->setReplayDataSize(20, 0);
+  uint8_t* constantBaseAddress =
+      static_cast<uint8_t*>(mMemoryManager->getConstantAddress());
+  memcpy(constantBaseAddress, "abc", 4);
+
+  uint8_t* volatileMemory =
+      static_cast<uint8_t*>(mMemoryManager->volatileToAbsolute(100));
+
+  memset(volatileMemory, 'x', 2);
+
+  std::vector<uint32_t> instructions{
+      instruction(Interpreter::InstructionCode::PUSH_I,
+                  BaseType::ConstantPointer, 0),
+      instruction(Interpreter::InstructionCode::PUSH_I,
+                  BaseType::VolatilePointer, 100),
+      instruction(Interpreter::InstructionCode::STRCPY, 0)};
+  bool res = mInterpreter->run(instructions.data(), instructions.size());
+  EXPECT_TRUE(res);
+
+  EXPECT_EQ('x', volatileMemory[0]);
+  EXPECT_EQ('x', volatileMemory[1]);
+}
+
 TEST_F(InterpreterTest, Post) {
   uint32_t callCount = 0;
   auto post = [&callCount](uint32_t, Stack*, bool) {
@@ -397,6 +422,65 @@ TEST_F(InterpreterTest, Resource) {
   EXPECT_EQ(1, callCount);
 }
 
+TEST_F(InterpreterTest, ResourceIndices) {
+  std::vector<uint32_t> instructions{
+      instruction(Interpreter::InstructionCode::RESOURCE, 7),
+      instruction(Interpreter::InstructionCode::PUSH_I, BaseType::Uint32, 8),
+      instruction(Interpreter::InstructionCode::CALL, 0),
+      instruction(Interpreter::InstructionCode::RESOURCE, 3),
+      instruction(Interpreter::InstructionCode::COPY, 9),
+      instruction(Interpreter::InstructionCode::RESOURCE, 7)};
+  EXPECT_THAT(Interpreter::resourceIndices(instructions.data(),
+                                           instructions.size()),
+              ::testing::ElementsAre(7, 3, 7));
+}
+
+TEST_F(InterpreterTest, ConstantOffsets) {
+  std::vector<uint32_t> instructions{
+      instruction(Interpreter::InstructionCode::LOAD_C, BaseType::Uint16, 4),
+      instruction(Interpreter::InstructionCode::PUSH_I,
+                  BaseType::ConstantPointer, 8),
+      instruction(Interpreter::InstructionCode::EXTEND, 3),
+      instruction(Interpreter::InstructionCode::PUSH_I, BaseType::Uint32, 5),
+      instruction(Interpreter::InstructionCode::EXTEND, 1)};
+  EXPECT_THAT(Interpreter::constantOffsets(instructions.data(),
+                                           instructions.size()),
+              ::testing::ElementsAre(4, (8ULL << 26) | 3));
+}
+
+TEST_F(InterpreterTest, LabelCallback) {
+  std::vector<uint32_t> labels;
+  mInterpreter->setLabelCallback(
+      [&labels](uint32_t label) { labels.push_back(label); });
+
+  std::vector<uint32_t> instructions{
+      instruction(Interpreter::InstructionCode::LABEL, 5),
+      instruction(Interpreter::InstructionCode::LABEL, 7)};
+  bool res = mInterpreter->run(instructions.data(), instructions.size());
+  EXPECT_TRUE(res);
+  EXPECT_THAT(labels, ::testing::ElementsAre(5, 7));
+}
+
+TEST_F(InterpreterTest, Resume) {
+  std::vector<uint32_t> calls;
+  mInterpreter->registerBuiltin(0, 0, [&calls](uint32_t, Stack* stack, bool) {
+    calls.push_back(stack->pop<uint32_t>());
+    return true;
+  });
+
+  std::vector<uint32_t> instructions{
+      instruction(Interpreter::InstructionCode::LABEL, 1),
+      instruction(Interpreter::InstructionCode::PUSH_I, BaseType::Uint32, 1),
+      instruction(Interpreter::InstructionCode::CALL, 0),
+      instruction(Interpreter::InstructionCode::PUSH_I, BaseType::Uint32, 2),
+      instruction(Interpreter::InstructionCode::CALL, 0)};
+  bool res = mInterpreter->resume(instructions.data(), instructions.size(), 3,
+                                  0, 1, STACK_SIZE);
+  EXPECT_TRUE(res);
+  EXPECT_THAT(calls, ::testing::ElementsAre(2));
+  EXPECT_EQ(1u, mInterpreter->getLabel());
+}
+
 TEST_F(InterpreterTest, InvalidOpcode) {
   std::vector<uint32_t> instructions{63U << 26};
   bool res = mInterpreter->run(instructions.data(), instructions.size());
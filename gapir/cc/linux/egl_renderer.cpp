@@ -0,0 +1,743 @@
+/*
+ * Copyright (C) 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "gapir/cc/linux/egl_renderer.h"
+#include "gapir/cc/gles_gfx_api.h"
+
+#include "core/cc/dl_loader.h"
+#include "core/cc/get_gles_proc_address.h"
+#include "core/cc/gl/formats.h"
+#include "core/cc/gl/versions.h"
+#include "core/cc/log.h"
+
+#include <stdint.h>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+namespace gapir {
+namespace {
+
+typedef void* EGLDisplay;
+typedef void* EGLConfig;
+typedef void* EGLContext;
+typedef void* EGLSurface;
+typedef void* EGLDeviceEXT;
+typedef int32_t EGLint;
+typedef unsigned int EGLBoolean;
+typedef unsigned int EGLenum;
+
+const EGLDisplay EGL_NO_DISPLAY = nullptr;
+const EGLContext EGL_NO_CONTEXT = nullptr;
+const EGLSurface EGL_NO_SURFACE = nullptr;
+const EGLConfig EGL_NO_CONFIG_KHR = nullptr;
+void* const EGL_DEFAULT_DISPLAY = nullptr;
+
+enum {
+  EGL_SUCCESS = 0x3000,
+  EGL_NONE = 0x3038,
+  EGL_EXTENSIONS = 0x3055,
+
+  // Used by eglChooseConfig.
+  EGL_ALPHA_SIZE = 0x3021,
+  EGL_BLUE_SIZE = 0x3022,
+  EGL_GREEN_SIZE = 0x3023,
+  EGL_RED_SIZE = 0x3024,
+  EGL_DEPTH_SIZE = 0x3025,
+  EGL_STENCIL_SIZE = 0x3026,
+  EGL_SURFACE_TYPE = 0x3033,
+  EGL_RENDERABLE_TYPE = 0x3040,
+  EGL_PBUFFER_BIT = 0x0001,
+  EGL_OPENGL_BIT = 0x0008,
+
+  // Used by eglCreatePbufferSurface.
+  EGL_HEIGHT = 0x3056,
+  EGL_WIDTH = 0x3057,
+
+  // Used by eglBindAPI.
+  EGL_OPENGL_API = 0x30A2,
+
+  // Used by eglGetPlatformDisplayEXT.
+  EGL_PLATFORM_DEVICE_EXT = 0x313F,
+  EGL_PLATFORM_SURFACELESS_MESA = 0x31DD,
+
+  // Attribute names for eglCreateContext.
+  EGL_CONTEXT_MAJOR_VERSION_KHR = 0x3098,
+  EGL_CONTEXT_MINOR_VERSION_KHR = 0x30FB,
+  EGL_CONTEXT_FLAGS_KHR = 0x30FC,
+  EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR = 0x30FD,
+
+  // Attribute values for eglCreateContext.
+  EGL_CONTEXT_OPENGL_DEBUG_BIT_KHR = 0x0001,
+  EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR = 0x0001,
+};
+
+extern "C" {
+
+typedef EGLint (*pfn_eglGetError)();
+typedef EGLDisplay (*pfn_eglGetDisplay)(void* native_display);
+typedef EGLDisplay (*pfn_eglGetPlatformDisplayEXT)(EGLenum platform,
+                                                   void* native_display,
+                                                   const EGLint* attrib_list);
+typedef EGLBoolean (*pfn_eglQueryDevicesEXT)(EGLint max_devices,
+                                             EGLDeviceEXT* devices,
+                                             EGLint* num_devices);
+typedef EGLBoolean (*pfn_eglInitialize)(EGLDisplay dpy, EGLint* major,
+                                        EGLint* minor);
+typedef const char* (*pfn_eglQueryString)(EGLDisplay dpy, EGLint name);
+typedef EGLBoolean (*pfn_eglBindAPI)(EGLenum api);
+typedef EGLBoolean (*pfn_eglChooseConfig)(EGLDisplay dpy,
+                                          const EGLint* attrib_list,
+                                          EGLConfig* configs,
+                                          EGLint config_size,
+                                          EGLint* num_config);
+typedef EGLContext (*pfn_eglCreateContext)(EGLDisplay dpy, EGLConfig config,
+                                           EGLContext share_context,
+                                           const EGLint* attrib_list);
+typedef EGLBoolean (*pfn_eglDestroyContext)(EGLDisplay dpy, EGLContext ctx);
+typedef EGLSurface (*pfn_eglCreatePbufferSurface)(EGLDisplay dpy,
+                                                  EGLConfig config,
+                                                  const EGLint* attrib_list);
+typedef EGLBoolean (*pfn_eglDestroySurface)(EGLDisplay dpy,
+                                            EGLSurface surface);
+typedef EGLBoolean (*pfn_eglMakeCurrent)(EGLDisplay dpy, EGLSurface draw,
+                                         EGLSurface read, EGLContext ctx);
+typedef void* (*pfn_eglGetProcAddress)(const char* procname);
+
+}  // extern "C"
+
+typedef GlesRenderer::Backbuffer Backbuffer;
+
+// The number of contexts created along with the root context of a share
+// group in the pool. Most replays use one or two contexts.
+const size_t kPooledContexts = 2;
+
+bool hasExtension(const char* extensions, const char* name) {
+  if (extensions == nullptr) {
+    return false;
+  }
+  size_t length = strlen(name);
+  for (const char* it = strstr(extensions, name); it != nullptr;
+       it = strstr(it + length, name)) {
+    if ((it == extensions || it[-1] == ' ') &&
+        (it[length] == ' ' || it[length] == '\0')) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Display is the EGL display shared by all the renderers of the process, with
+// the pool of pre-created share groups. It is never destroyed, as the pool is
+// refilled on a background thread.
+class Display {
+ public:
+  // ShareGroup is a root context and the unused contexts sharing with it.
+  struct ShareGroup {
+    EGLContext root = EGL_NO_CONTEXT;
+    std::vector<EGLContext> contexts;
+  };
+
+  // get returns the display of the process, initializing it on the first
+  // call. Returns nullptr if EGL could not be initialized.
+  static Display* get();
+
+  // takeGroup returns a share group from the pool, or a new one if the pool
+  // is empty.
+  ShareGroup takeGroup();
+
+  // releaseGroup destroys the unused contexts of a group taken from the pool,
+  // and starts refilling the pool. The pool is refilled once the replay is
+  // done rather than when the group is taken, so that the context creation
+  // does not compete with the replay.
+  void releaseGroup(const ShareGroup& group);
+
+  // fill creates share groups until the pool is full.
+  void fill();
+
+  // contextConfig returns the config to create a context rendering into a
+  // backbuffer with the given format, which is EGL_NO_CONFIG_KHR if contexts
+  // can render into pbuffers of any config.
+  EGLConfig contextConfig(const Backbuffer::Format& format);
+
+  EGLContext createContext(EGLConfig config, EGLContext share_context);
+  void destroyContext(EGLContext context);
+
+  // createPbuffer returns a new pbuffer for the backbuffer. Pbuffers are not
+  // reused, as they would hold the frames of previous replays.
+  EGLSurface createPbuffer(const Backbuffer& backbuffer);
+  void destroyPbuffer(EGLSurface surface);
+
+  bool makeCurrent(EGLSurface surface, EGLContext context);
+
+ private:
+  typedef std::tuple<uint32_t, uint32_t, uint32_t> FormatKey;
+
+  Display();
+
+  bool initialize();
+  EGLConfig config(const Backbuffer::Format& format);
+  ShareGroup createGroup(size_t contexts);
+  void refill();
+
+  static void* getProcAddress(const char* name);
+
+  core::DlLoader mLibEGL;
+  pfn_eglGetError fn_eglGetError;
+  pfn_eglGetDisplay fn_eglGetDisplay;
+  pfn_eglInitialize fn_eglInitialize;
+  pfn_eglQueryString fn_eglQueryString;
+  pfn_eglBindAPI fn_eglBindAPI;
+  pfn_eglChooseConfig fn_eglChooseConfig;
+  pfn_eglCreateContext fn_eglCreateContext;
+  pfn_eglDestroyContext fn_eglDestroyContext;
+  pfn_eglCreatePbufferSurface fn_eglCreatePbufferSurface;
+  pfn_eglDestroySurface fn_eglDestroySurface;
+  pfn_eglMakeCurrent fn_eglMakeCurrent;
+  pfn_eglGetProcAddress fn_eglGetProcAddress;
+
+  EGLDisplay mDisplay;
+  bool mNoConfigContext;
+  core::gl::Version mVersion;
+  size_t mPoolSize;
+
+  std::mutex mMutex;  // Guards the fields below.
+  std::map<FormatKey, EGLConfig> mConfigs;
+  std::vector<ShareGroup> mGroups;
+  bool mRefilling;
+
+  static core::GetGlesProcAddressFunc* sFallbackGetProcAddress;
+};
+
+core::GetGlesProcAddressFunc* Display::sFallbackGetProcAddress = nullptr;
+
+Display::Display()
+    : mLibEGL("libEGL.so.1"),
+      mDisplay(EGL_NO_DISPLAY),
+      mNoConfigContext(false),
+      mVersion(core::gl::sVersionSearchOrder[0]),
+      mPoolSize(1),
+      mRefilling(false) {
+  fn_eglGetError = (pfn_eglGetError)mLibEGL.lookup("eglGetError");
+  fn_eglGetDisplay = (pfn_eglGetDisplay)mLibEGL.lookup("eglGetDisplay");
+  fn_eglInitialize = (pfn_eglInitialize)mLibEGL.lookup("eglInitialize");
+  fn_eglQueryString = (pfn_eglQueryString)mLibEGL.lookup("eglQueryString");
+  fn_eglBindAPI = (pfn_eglBindAPI)mLibEGL.lookup("eglBindAPI");
+  fn_eglChooseConfig = (pfn_eglChooseConfig)mLibEGL.lookup("eglChooseConfig");
+  fn_eglCreateContext =
+      (pfn_eglCreateContext)mLibEGL.lookup("eglCreateContext");
+  fn_eglDestroyContext =
+      (pfn_eglDestroyContext)mLibEGL.lookup("eglDestroyContext");
+  fn_eglCreatePbufferSurface =
+      (pfn_eglCreatePbufferSurface)mLibEGL.lookup("eglCreatePbufferSurface");
+  fn_eglDestroySurface =
+      (pfn_eglDestroySurface)mLibEGL.lookup("eglDestroySurface");
+  fn_eglMakeCurrent = (pfn_eglMakeCurrent)mLibEGL.lookup("eglMakeCurrent");
+  fn_eglGetProcAddress =
+      (pfn_eglGetProcAddress)mLibEGL.lookup("eglGetProcAddress");
+
+  if (const char* size = getenv("GAPIR_GLES_POOL_SIZE")) {
+    mPoolSize = strtoul(size, nullptr, 10);
+  }
+}
+
+Display* Display::get() {
+  static Display* display = []() -> Display* {
+    auto display = new Display();
+    if (!display->initialize()) {
+      delete display;
+      return nullptr;
+    }
+    return display;
+  }();
+  return display;
+}
+
+bool Display::initialize() {
+  // Prefer the displays which do not need a window system: Mesa's surfaceless
+  // platform, then the first EGL device.
+  const char* clientExtensions =
+      fn_eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+  auto eglGetPlatformDisplayEXT =
+      (pfn_eglGetPlatformDisplayEXT)fn_eglGetProcAddress(
+          "eglGetPlatformDisplayEXT");
+  if (eglGetPlatformDisplayEXT != nullptr &&
+      hasExtension(clientExtensions, "EGL_MESA_platform_surfaceless")) {
+    mDisplay = eglGetPlatformDisplayEXT(EGL_PLATFORM_SURFACELESS_MESA,
+                                        EGL_DEFAULT_DISPLAY, nullptr);
+  }
+  if (mDisplay == EGL_NO_DISPLAY && eglGetPlatformDisplayEXT != nullptr &&
+      hasExtension(clientExtensions, "EGL_EXT_platform_device")) {
+    auto eglQueryDevicesEXT =
+        (pfn_eglQueryDevicesEXT)fn_eglGetProcAddress("eglQueryDevicesEXT");
+    EGLDeviceEXT device;
+    EGLint count = 0;
+    if (eglQueryDevicesEXT != nullptr &&
+        eglQueryDevicesEXT(1, &device, &count) && count > 0) {
+      mDisplay =
+          eglGetPlatformDisplayEXT(EGL_PLATFORM_DEVICE_EXT, device, nullptr);
+    }
+  }
+  if (mDisplay == EGL_NO_DISPLAY) {
+    mDisplay = fn_eglGetDisplay(EGL_DEFAULT_DISPLAY);
+  }
+
+  EGLint major, minor;
+  if (mDisplay == EGL_NO_DISPLAY ||
+      !fn_eglInitialize(mDisplay, &major, &minor)) {
+    GAPID_ERROR("Unable to initialize EGL display: 0x%x", fn_eglGetError());
+    return false;
+  }
+  const char* extensions = fn_eglQueryString(mDisplay, EGL_EXTENSIONS);
+  if (!hasExtension(extensions, "EGL_KHR_create_context")) {
+    GAPID_ERROR("EGL_KHR_create_context unsupported by EGL %d.%d", major,
+                minor);
+    return false;
+  }
+  mNoConfigContext = hasExtension(extensions, "EGL_KHR_no_config_context");
+
+  // Find the most recent GL version supported, once for all the contexts.
+  fn_eglBindAPI(EGL_OPENGL_API);
+  EGLConfig config = contextConfig(Backbuffer::Format(
+      core::gl::GL_RGBA8, core::gl::GL_DEPTH24_STENCIL8,
+      core::gl::GL_DEPTH24_STENCIL8));
+  EGLContext context = EGL_NO_CONTEXT;
+  for (auto gl_version : core::gl::sVersionSearchOrder) {
+    mVersion = gl_version;
+    context = createContext(config, EGL_NO_CONTEXT);
+    if (context != EGL_NO_CONTEXT) {
+      break;
+    }
+  }
+  if (context == EGL_NO_CONTEXT) {
+    GAPID_ERROR("Failed to create EGL context: 0x%x", fn_eglGetError());
+    return false;
+  }
+  destroyContext(context);
+  GAPID_INFO("Initialized EGL %d.%d display for GL %d.%d contexts", major,
+             minor, mVersion.major, mVersion.minor);
+
+  // Resolve the GL functions through EGL, as they may not be exposed by the
+  // libGL used for GLX.
+  sFallbackGetProcAddress = core::GetGlesProcAddress;
+  core::GetGlesProcAddress = &Display::getProcAddress;
+  return true;
+}
+
+void* Display::getProcAddress(const char* name) {
+  if (void* proc = get()->fn_eglGetProcAddress(name)) {
+    return proc;
+  }
+  return sFallbackGetProcAddress(name);
+}
+
+EGLConfig Display::config(const Backbuffer::Format& format) {
+  std::lock_guard<std::mutex> lock(mMutex);
+  FormatKey key(format.color, format.depth, format.stencil);
+  auto it = mConfigs.find(key);
+  if (it != mConfigs.end()) {
+    return it->second;
+  }
+
+  int r = 8, g = 8, b = 8, a = 8, d = 24, s = 8;
+  core::gl::getColorBits(format.color, r, g, b, a);
+  core::gl::getDepthBits(format.depth, d);
+  core::gl::getStencilBits(format.stencil, s);
+  const EGLint configAttribs[] = {
+      // clang-format off
+      EGL_RED_SIZE, r,
+      EGL_GREEN_SIZE, g,
+      EGL_BLUE_SIZE, b,
+      EGL_ALPHA_SIZE, a,
+      EGL_DEPTH_SIZE, d,
+      EGL_STENCIL_SIZE, s,
+      EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+      EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+      EGL_NONE
+      // clang-format on
+  };
+  EGLConfig config;
+  EGLint count = 0;
+  if (!fn_eglChooseConfig(mDisplay, configAttribs, &config, 1, &count) ||
+      count == 0) {
+    GAPID_FATAL("Unable to find a suitable EGL config");
+  }
+  mConfigs[key] = config;
+  return config;
+}
+
+EGLConfig Display::contextConfig(const Backbuffer::Format& format) {
+  return mNoConfigContext ? EGL_NO_CONFIG_KHR : config(format);
+}
+
+EGLContext Display::createContext(EGLConfig config, EGLContext share_context) {
+  const EGLint contextAttribs[] = {
+      // clang-format off
+      EGL_CONTEXT_MAJOR_VERSION_KHR, mVersion.major,
+      EGL_CONTEXT_MINOR_VERSION_KHR, mVersion.minor,
+      EGL_CONTEXT_FLAGS_KHR, EGL_CONTEXT_OPENGL_DEBUG_BIT_KHR,
+      EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR,
+          EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR,
+      EGL_NONE
+      // clang-format on
+  };
+  // The bound API is per-thread state.
+  fn_eglBindAPI(EGL_OPENGL_API);
+  EGLContext context = fn_eglCreateContext(mDisplay, config, share_context,
+                                           contextAttribs);
+  if (context != EGL_NO_CONTEXT) {
+    GAPID_DEBUG("Created GL %i.%i context %p (shared with context %p)",
+                mVersion.major, mVersion.minor, context, share_context);
+  }
+  return context;
+}
+
+void Display::destroyContext(EGLContext context) {
+  if (context != EGL_NO_CONTEXT) {
+    fn_eglDestroyContext(mDisplay, context);
+    GAPID_DEBUG("Destroyed context %p", context);
+  }
+}
+
+Display::ShareGroup Display::createGroup(size_t contexts) {
+  EGLConfig config = contextConfig(Backbuffer::Format(
+      core::gl::GL_RGBA8, core::gl::GL_DEPTH24_STENCIL8,
+      core::gl::GL_DEPTH24_STENCIL8));
+  ShareGroup group;
+  group.root = createContext(config, EGL_NO_CONTEXT);
+  if (group.root == EGL_NO_CONTEXT) {
+    GAPID_FATAL("Failed to create EGL context: 0x%x", fn_eglGetError());
+  }
+  for (size_t i = 0; i < contexts; i++) {
+    EGLContext context = createContext(config, group.root);
+    if (context == EGL_NO_CONTEXT) {
+      break;
+    }
+    group.contexts.push_back(context);
+  }
+  return group;
+}
+
+Display::ShareGroup Display::takeGroup() {
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (!mGroups.empty()) {
+      ShareGroup group = std::move(mGroups.back());
+      mGroups.pop_back();
+      return group;
+    }
+  }
+  return createGroup(0);
+}
+
+void Display::releaseGroup(const ShareGroup& group) {
+  for (auto context : group.contexts) {
+    destroyContext(context);
+  }
+  std::lock_guard<std::mutex> lock(mMutex);
+  if (mGroups.size() < mPoolSize && !mRefilling) {
+    mRefilling = true;
+    std::thread(&Display::refill, this).detach();
+  }
+}
+
+void Display::fill() {
+  while (true) {
+    {
+      std::lock_guard<std::mutex> lock(mMutex);
+      if (mGroups.size() >= mPoolSize) {
+        return;
+      }
+    }
+    auto group = createGroup(kPooledContexts);
+    std::lock_guard<std::mutex> lock(mMutex);
+    mGroups.push_back(std::move(group));
+  }
+}
+
+void Display::refill() {
+  fill();
+  std::lock_guard<std::mutex> lock(mMutex);
+  mRefilling = false;
+}
+
+EGLSurface Display::createPbuffer(const Backbuffer& backbuffer) {
+  // Some exotic extensions let you create contexts without a backbuffer.
+  // In these cases the backbuffer is zero size - just create a small one.
+  const EGLint pbufferAttribs[] = {
+      // clang-format off
+      EGL_WIDTH, (backbuffer.width > 0) ? backbuffer.width : 8,
+      EGL_HEIGHT, (backbuffer.height > 0) ? backbuffer.height : 8,
+      EGL_NONE
+      // clang-format on
+  };
+  EGLSurface surface = fn_eglCreatePbufferSurface(
+      mDisplay, config(backbuffer.format), pbufferAttribs);
+  if (surface == EGL_NO_SURFACE) {
+    GAPID_FATAL("Failed to create EGL pbuffer: 0x%x", fn_eglGetError());
+  }
+  return surface;
+}
+
+void Display::destroyPbuffer(EGLSurface surface) {
+  if (surface != EGL_NO_SURFACE) {
+    fn_eglDestroySurface(mDisplay, surface);
+  }
+}
+
+bool Display::makeCurrent(EGLSurface surface, EGLContext context) {
+  return fn_eglMakeCurrent(mDisplay, surface, surface, context);
+}
+
+class EglRendererImpl : public GlesRenderer {
+ public:
+  EglRendererImpl(Display* display, EglRendererImpl* shared_context);
+  virtual ~EglRendererImpl() override;
+
+  virtual Api* api() override;
+  virtual void setBackbuffer(Backbuffer backbuffer) override;
+  virtual void bind() override;
+  virtual void unbind() override;
+  virtual const char* name() override;
+  virtual const char* extensions() override;
+  virtual const char* vendor() override;
+  virtual const char* version() override;
+
+ private:
+  Display* mDisplay;
+  Backbuffer mBackbuffer;
+  bool mNeedsResolve;
+  Gles mApi;
+  std::string mExtensions;
+  bool mQueriedExtensions;
+
+  // The unused contexts of the share group, if this is a root renderer.
+  Display::ShareGroup mGroup;
+  EGLContext mContext;
+  EGLContext mSharedContext;
+  EGLConfig mConfig;
+  EGLSurface mSurface;
+
+  static thread_local EglRendererImpl* tlsBound;
+};
+
+thread_local EglRendererImpl* EglRendererImpl::tlsBound = nullptr;
+
+EglRendererImpl::EglRendererImpl(Display* display,
+                                 EglRendererImpl* shared_context)
+    : mDisplay(display),
+      mNeedsResolve(true),
+      mQueriedExtensions(false),
+      mContext(EGL_NO_CONTEXT),
+      mSharedContext(shared_context != nullptr ? shared_context->mContext
+                                               : EGL_NO_CONTEXT),
+      mSurface(EGL_NO_SURFACE) {
+  Backbuffer backbuffer(8, 8, core::gl::GL_RGBA8,
+                        core::gl::GL_DEPTH24_STENCIL8,
+                        core::gl::GL_DEPTH24_STENCIL8);
+  // The pooled contexts are created for the default backbuffer format.
+  mConfig = mDisplay->contextConfig(backbuffer.format);
+  if (shared_context == nullptr) {
+    mGroup = mDisplay->takeGroup();
+    mContext = mGroup.root;
+  } else if (!shared_context->mGroup.contexts.empty()) {
+    mContext = shared_context->mGroup.contexts.back();
+    shared_context->mGroup.contexts.pop_back();
+  } else {
+    mContext = mDisplay->createContext(mConfig, mSharedContext);
+    if (mContext == EGL_NO_CONTEXT) {
+      GAPID_FATAL("Failed to create EGL context");
+    }
+  }
+
+  // Initialize with a default target.
+  setBackbuffer(backbuffer);
+}
+
+EglRendererImpl::~EglRendererImpl() {
+  unbind();
+  mDisplay->destroyPbuffer(mSurface);
+  mDisplay->destroyContext(mContext);
+  if (mGroup.root != EGL_NO_CONTEXT) {
+    mDisplay->releaseGroup(mGroup);
+  }
+}
+
+Api* EglRendererImpl::api() { return &mApi; }
+
+static void DebugCallback(uint32_t source, uint32_t type, Gles::GLuint id,
+                          uint32_t severity, Gles::GLsizei length,
+                          const Gles::GLchar* message, const void* user_param) {
+  auto renderer = reinterpret_cast<const EglRendererImpl*>(user_param);
+  auto listener = renderer->getListener();
+  if (listener != nullptr) {
+    if (type == Gles::GLenum::GL_DEBUG_TYPE_ERROR ||
+        severity == Gles::GLenum::GL_DEBUG_SEVERITY_HIGH) {
+      listener->onDebugMessage(LOG_LEVEL_ERROR, Gles::INDEX, message);
+    } else {
+      listener->onDebugMessage(LOG_LEVEL_DEBUG, Gles::INDEX, message);
+    }
+  }
+}
+
+void EglRendererImpl::setBackbuffer(Backbuffer backbuffer) {
+  if (mBackbuffer == backbuffer) {
+    return;  // No change
+  }
+
+  if (mSurface != EGL_NO_SURFACE) {
+    GAPID_DEBUG("Changing backbuffer: %dx%d [0x%x, 0x%x, 0x%x] -> %dx%d "
+                "[0x%x, 0x%x, 0x%x]",
+                mBackbuffer.width, mBackbuffer.height, mBackbuffer.format.color,
+                mBackbuffer.format.depth, mBackbuffer.format.stencil,
+                backbuffer.width, backbuffer.height, backbuffer.format.color,
+                backbuffer.format.depth, backbuffer.format.stencil);
+  }
+
+  auto wasBound = tlsBound == this;
+  unbind();
+
+  // Without EGL_KHR_no_config_context the context can only render into
+  // pbuffers of its own config.
+  EGLConfig config = mDisplay->contextConfig(backbuffer.format);
+  if (config != mConfig) {
+    GAPID_WARNING(
+        "Recreating renderer: [0x%x, 0x%x, 0x%x] -> [0x%x, 0x%x, 0x%x]",
+        mBackbuffer.format.color, mBackbuffer.format.depth,
+        mBackbuffer.format.stencil, backbuffer.format.color,
+        backbuffer.format.depth, backbuffer.format.stencil);
+    mDisplay->destroyContext(mContext);
+    mContext = mDisplay->createContext(config, mSharedContext);
+    if (mContext == EGL_NO_CONTEXT) {
+      GAPID_FATAL("Failed to create EGL context");
+    }
+    if (mGroup.root != EGL_NO_CONTEXT) {
+      // The pooled contexts share with the destroyed root context, so the
+      // renderers sharing with this one create their own contexts instead.
+      for (auto context : mGroup.contexts) {
+        mDisplay->destroyContext(context);
+      }
+      mGroup.contexts.clear();
+      mGroup.root = mContext;
+    }
+    mConfig = config;
+    mNeedsResolve = true;
+  }
+
+  mDisplay->destroyPbuffer(mSurface);
+  mSurface = mDisplay->createPbuffer(backbuffer);
+  mBackbuffer = backbuffer;
+
+  if (wasBound) {
+    bind();
+  }
+}
+
+void EglRendererImpl::bind() {
+  auto bound = tlsBound;
+  if (bound == this) {
+    return;
+  }
+
+  if (bound != nullptr) {
+    bound->unbind();
+  }
+
+  if (!mDisplay->makeCurrent(mSurface, mContext)) {
+    GAPID_FATAL("Unable to make EGL context current");
+  }
+  tlsBound = this;
+
+  if (mNeedsResolve) {
+    mNeedsResolve = false;
+    mApi.resolve();
+  }
+
+  if (mApi.mFunctionStubs.glDebugMessageCallback != nullptr) {
+    mApi.mFunctionStubs.glDebugMessageCallback(
+        reinterpret_cast<void*>(&DebugCallback), this);
+    mApi.mFunctionStubs.glEnable(Gles::GLenum::GL_DEBUG_OUTPUT);
+    mApi.mFunctionStubs.glEnable(Gles::GLenum::GL_DEBUG_OUTPUT_SYNCHRONOUS);
+    GAPID_DEBUG("Enabled KHR_debug extension");
+  }
+}
+
+void EglRendererImpl::unbind() {
+  if (tlsBound == this) {
+    mDisplay->makeCurrent(EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    tlsBound = nullptr;
+  }
+}
+
+const char* EglRendererImpl::name() {
+  return reinterpret_cast<const char*>(
+      mApi.mFunctionStubs.glGetString(Gles::GLenum::GL_RENDERER));
+}
+
+const char* EglRendererImpl::extensions() {
+  if (!mQueriedExtensions) {
+    mQueriedExtensions = true;
+    int32_t n, i;
+    mApi.mFunctionStubs.glGetIntegerv(Gles::GLenum::GL_NUM_EXTENSIONS, &n);
+    for (i = 0; i < n; i++) {
+      if (i > 0) {
+        mExtensions += " ";
+      }
+      mExtensions += reinterpret_cast<const char*>(
+          mApi.mFunctionStubs.glGetStringi(Gles::GLenum::GL_EXTENSIONS, i));
+    }
+  }
+  return &mExtensions[0];
+}
+
+const char* EglRendererImpl::vendor() {
+  return reinterpret_cast<const char*>(
+      mApi.mFunctionStubs.glGetString(Gles::GLenum::GL_VENDOR));
+}
+
+const char* EglRendererImpl::version() {
+  return reinterpret_cast<const char*>(
+      mApi.mFunctionStubs.glGetString(Gles::GLenum::GL_VERSION));
+}
+
+}  // anonymous namespace
+
+bool canCreateEglRenderer() { return core::DlLoader::can_load("libEGL.so.1"); }
+
+bool fillEglRendererPool() {
+  Display* display = Display::get();
+  if (display == nullptr) {
+    return false;
+  }
+  display->fill();
+  return true;
+}
+
+GlesRenderer* createEglRenderer(GlesRenderer* shared_context) {
+  Display* display = Display::get();
+  if (display == nullptr) {
+    return nullptr;
+  }
+  return new EglRendererImpl(display,
+                             static_cast<EglRendererImpl*>(shared_context));
+}
+
+}  // namespace gapir
@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GAPIR_LINUX_EGL_RENDERER_H
+#define GAPIR_LINUX_EGL_RENDERER_H
+
+#include "gapir/cc/gles_renderer.h"
+
+namespace gapir {
+
+// canCreateEglRenderer returns true if the EGL library can be loaded.
+bool canCreateEglRenderer();
+
+// createEglRenderer returns a headless GLES renderer rendering into EGL
+// pbuffers, which does not need an X server. All the renderers share a single
+// EGL display for the lifetime of the process, and a pool of pre-created
+// contexts, so that replays do not pay for the driver initialization and for
+// most of the context creation.
+//
+// The root renderers (created without a shared_context) take a share group of
+// pre-created contexts from the pool, which is refilled on a background
+// thread. The renderers sharing with a root take the remaining contexts of its
+// group. Contexts and pbuffers are destroyed with their renderer rather than
+// reused, as a replay expects a context in its initial state, a share group
+// without the objects of previous replays and a backbuffer without their
+// frames. A root renderer whose context is recreated for another config
+// discards the remaining contexts of its group. The number of share groups
+// kept in the pool is set by the GAPIR_GLES_POOL_SIZE environment variable,
+// and defaults to 1.
+GlesRenderer* createEglRenderer(GlesRenderer* shared_context);
+
+// fillEglRendererPool creates the share groups of the pool of the EGL
+// renderers, without waiting for a renderer to be released. Returns false if
+// EGL could not be initialized.
+bool fillEglRendererPool();
+
+}  // namespace gapir
+
+#endif  // GAPIR_LINUX_EGL_RENDERER_H
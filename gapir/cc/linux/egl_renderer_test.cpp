@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "gapir/cc/linux/egl_renderer.h"
+#include "gapir/cc/gles_gfx_api.h"
+
+#include "core/cc/gl/formats.h"
+
+#include <gtest/gtest.h>
+
+#include <memory>
+
+namespace gapir {
+namespace test {
+namespace {
+
+typedef GlesRenderer::Backbuffer Backbuffer;
+
+// The tests are skipped on machines without an EGL display.
+std::unique_ptr<GlesRenderer> createRenderer(GlesRenderer* shared_context) {
+  if (!canCreateEglRenderer()) {
+    return nullptr;
+  }
+  // The root renderers take a share group with pooled contexts.
+  if (shared_context == nullptr && !fillEglRendererPool()) {
+    return nullptr;
+  }
+  return std::unique_ptr<GlesRenderer>(createEglRenderer(shared_context));
+}
+
+Gles* gles(GlesRenderer* renderer) {
+  return static_cast<Gles*>(renderer->api());
+}
+
+// createTexture returns a new texture object of the context of renderer.
+Gles::TextureId createTexture(GlesRenderer* renderer) {
+  renderer->bind();
+  Gles::TextureId texture = 0;
+  gles(renderer)->mFunctionStubs.glGenTextures(1, &texture);
+  gles(renderer)->mFunctionStubs.glBindTexture(
+      Gles::GLenum::GL_TEXTURE_2D, texture);
+  return texture;
+}
+
+bool isTexture(GlesRenderer* renderer, Gles::TextureId texture) {
+  renderer->bind();
+  return gles(renderer)->mFunctionStubs.glIsTexture(texture) != 0;
+}
+
+}  // anonymous namespace
+
+TEST(EglRendererTest, Create) {
+  auto renderer = createRenderer(nullptr);
+  if (renderer == nullptr) {
+    return;
+  }
+  renderer->bind();
+  EXPECT_NE(nullptr, renderer->name());
+  EXPECT_NE(nullptr, renderer->version());
+  renderer->setBackbuffer(Backbuffer(64, 32, core::gl::GL_RGBA8,
+                                     core::gl::GL_DEPTH24_STENCIL8,
+                                     core::gl::GL_DEPTH24_STENCIL8));
+  EXPECT_NE(nullptr, renderer->name());
+  renderer->unbind();
+}
+
+TEST(EglRendererTest, ShareGroup) {
+  auto root = createRenderer(nullptr);
+  if (root == nullptr) {
+    return;
+  }
+  auto first = createRenderer(root.get());
+  ASSERT_NE(nullptr, first);
+  auto texture = createTexture(root.get());
+  EXPECT_TRUE(isTexture(first.get(), texture));
+
+  // More renderers than the pooled contexts of the group.
+  auto second = createRenderer(root.get());
+  auto third = createRenderer(root.get());
+  EXPECT_TRUE(isTexture(second.get(), texture));
+  EXPECT_TRUE(isTexture(third.get(), texture));
+
+  // A new root does not share with the previous one.
+  first.reset();
+  second.reset();
+  third.reset();
+  root.reset();
+  auto other = createRenderer(nullptr);
+  ASSERT_NE(nullptr, other);
+  EXPECT_FALSE(isTexture(other.get(), texture));
+}
+
+TEST(EglRendererTest, ConfigChange) {
+  auto root = createRenderer(nullptr);
+  if (root == nullptr) {
+    return;
+  }
+  // Without EGL_KHR_no_config_context the root context is recreated for the
+  // new config. The renderers created after it must share with the new one.
+  root->setBackbuffer(Backbuffer(16, 16, core::gl::GL_RGB565, 0, 0));
+  auto texture = createTexture(root.get());
+  auto first = createRenderer(root.get());
+  auto second = createRenderer(root.get());
+  auto third = createRenderer(root.get());
+  EXPECT_TRUE(isTexture(first.get(), texture));
+  EXPECT_TRUE(isTexture(second.get(), texture));
+  EXPECT_TRUE(isTexture(third.get(), texture));
+  third->unbind();
+}
+
+}  // namespace test
+}  // namespace gapir
@@ -16,6 +16,7 @@
 
 #include "gapir/cc/gles_renderer.h"
 #include "gapir/cc/gles_gfx_api.h"
+#include "gapir/cc/linux/egl_renderer.h"
 
 #include "core/cc/dl_loader.h"
 #include "core/cc/get_gles_proc_address.h"
@@ -24,6 +25,7 @@
 #include "core/cc/log.h"
 
 #include <X11/Xresource.h>
+#include <cstdlib>
 #include <cstring>
 
 namespace gapir {
@@ -447,7 +449,27 @@ const char* GlesRendererImpl::version() {
 
 }  // anonymous namespace
 
+// useEgl returns true if the renderers should be created with EGL rather than
+// GLX. The GAPIR_GLES_BACKEND environment variable selects either "egl" or
+// "glx", otherwise EGL is used when there is no X display to connect to.
+static bool useEgl() {
+  static const bool egl = []() {
+    const char* backend = getenv("GAPIR_GLES_BACKEND");
+    if (backend != nullptr && strcmp(backend, "egl") == 0) {
+      return true;
+    }
+    if (backend != nullptr && strcmp(backend, "glx") == 0) {
+      return false;
+    }
+    return getenv("DISPLAY") == nullptr && canCreateEglRenderer();
+  }();
+  return egl;
+}
+
 GlesRenderer* GlesRenderer::create(GlesRenderer* shared_context) {
+  if (useEgl()) {
+    return createEglRenderer(shared_context);
+  }
   if (core::hasGLorGLES() && core::DlLoader::can_load("libX11.so")) {
     return new GlesRendererImpl(
         reinterpret_cast<GlesRendererImpl*>(shared_context));
@@ -17,7 +17,23 @@
 #include "memory_manager.h"
 
 #include "core/cc/log.h"
+#include "core/cc/target.h"
 
+#if TARGET_OS == GAPID_OS_WINDOWS
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#define __STDC_FORMAT_MACROS
+#include <inttypes.h>
+
+#include <algorithm>
+#include <limits>
+#include <memory>
 #include <new>
 #include <utility>
 #include <vector>
@@ -47,59 +63,179 @@ namespace {
 // Expected driver memory overhead to be left free as a factor of allocated
 // managed memory.
 const float kDriverOverheadFactor = 0.3f;
+
+// The granularity of reserving and committing memory. This is the most common
+// huge page size, so that whole huge pages can back the memory.
+const uint64_t kChunkSize = 2 * 1024 * 1024;
+
+uint64_t roundUpToChunk(uint64_t size) {
+  return (size + kChunkSize - 1) / kChunkSize * kChunkSize;
+}
+
+// reserve reserves size bytes of address space without committing any memory
+// to it. size must be a multiple of kChunkSize. Returns nullptr on failure.
+uint8_t* reserve(uint64_t size) {
+  if (size > std::numeric_limits<size_t>::max()) {
+    return nullptr;  // Larger than the address space.
+  }
+#if TARGET_OS == GAPID_OS_WINDOWS
+  return static_cast<uint8_t*>(VirtualAlloc(nullptr, static_cast<size_t>(size),
+                                            MEM_RESERVE, PAGE_NOACCESS));
+#else
+  // Only the committed range is advised to use transparent huge pages, see
+  // commit. Explicit huge pages (MAP_HUGETLB) would be taken from the
+  // system's pool for the whole reservation up-front.
+  const int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+#if defined(MAP_NORESERVE)
+  void* memory = mmap(nullptr, static_cast<size_t>(size), PROT_NONE,
+                      flags | MAP_NORESERVE, -1, 0);
+#else
+  void* memory =
+      mmap(nullptr, static_cast<size_t>(size), PROT_NONE, flags, -1, 0);
+#endif
+  return memory != MAP_FAILED ? static_cast<uint8_t*>(memory) : nullptr;
+#endif
+}
+
+// commit makes the size bytes of reserved address space at base readable and
+// writable. Pages are only backed by physical memory once they are touched.
+bool commit(uint8_t* base, uint64_t size) {
+#if TARGET_OS == GAPID_OS_WINDOWS
+  return VirtualAlloc(base, static_cast<size_t>(size), MEM_COMMIT,
+                      PAGE_READWRITE) != nullptr;
+#else
+  if (mprotect(base, static_cast<size_t>(size), PROT_READ | PROT_WRITE) != 0) {
+    return false;
+  }
+#if defined(MADV_HUGEPAGE)
+  // The replay touches the memory randomly, so use transparent huge pages
+  // where possible to reduce the TLB misses. This is only a hint.
+  madvise(base, static_cast<size_t>(size), MADV_HUGEPAGE);
+#endif
+  return true;
+#endif
+}
+
+// release releases the size bytes of address space reserved at base.
+void release(uint8_t* base, uint64_t size) {
+#if TARGET_OS == GAPID_OS_WINDOWS
+  VirtualFree(base, 0, MEM_RELEASE);
+#else
+  munmap(base, static_cast<size_t>(size));
+#endif
+}
+
 }  // namespace
 
 MemoryManager::MemoryRange::MemoryRange() : base(nullptr), size(0) {}
 
-MemoryManager::MemoryRange::MemoryRange(uint8_t* base, uint32_t size)
+MemoryManager::MemoryRange::MemoryRange(uint8_t* base, uint64_t size)
     : base(base), size(size) {}
 
-MemoryManager::MemoryManager(const std::vector<uint32_t>& sizeList)
-    : mConstantMemory(nullptr, 0) {
+MemoryManager::MemoryManager(const std::vector<uint64_t>& sizeList,
+                             uint64_t maxSize)
+    : mSize(0),
+      mMemory(nullptr),
+      mReservedSize(0),
+      mCommittedSize(0),
+      mConstantMemory(nullptr, 0) {
   for (auto size : sizeList) {
     // Try over-allocating to leave at least (size * kDriverOverheadFactor) free
     // bytes.
-    mSize = static_cast<uint32_t>(size * (1 + kDriverOverheadFactor));
-    mMemory.reset(new (std::nothrow) uint8_t[mSize]);
-    if (mMemory) {
+    // Reserving address space always succeeds, so the over-allocation is
+    // probed with a regular allocation, which is charged against the system's
+    // commit limit.
+    uint64_t overSize =
+        static_cast<uint64_t>(size * (1 + kDriverOverheadFactor));
+    std::unique_ptr<uint8_t[]> probe;
+    if (overSize <= std::numeric_limits<size_t>::max()) {
+      probe.reset(new (std::nothrow) uint8_t[static_cast<size_t>(overSize)]);
+    }
+    if (probe) {
       // Free the over-allocation first, then attempt allocating the (smaller)
-      // original size.
-      mMemory.reset();
-      mSize = size;
-      mMemory.reset(new (std::nothrow) uint8_t[mSize]);
-      break;
+      // original size, with the address space to grow to maxSize if possible.
+      probe.reset();
+      mCommittedSize = roundUpToChunk(size);
+      mReservedSize = roundUpToChunk(std::max(size, maxSize));
+      mMemory = reserve(mReservedSize);
+      if (mMemory == nullptr && mReservedSize > mCommittedSize) {
+        mReservedSize = mCommittedSize;
+        mMemory = reserve(mReservedSize);
+      }
+      if (mMemory != nullptr && !commit(mMemory, mCommittedSize)) {
+        release(mMemory, mReservedSize);
+        mMemory = nullptr;
+      }
+      if (mMemory != nullptr) {
+        mSize = size;
+        break;
+      }
     }
-    GAPID_DEBUG("Failed to allocate %u bytes of volatile memory, continuing...",
+    GAPID_DEBUG("Failed to allocate %" PRIu64
+                " bytes of volatile memory, continuing...",
                 size);
   }
 
-  if (!mMemory) {
+  if (mMemory == nullptr) {
     GAPID_FATAL("Couldn't allocate any volatile memory size.");
   }
 
-  GAPID_DEBUG("Base address: %p", mMemory.get());
+  GAPID_DEBUG("Base address: %p, reserved: %" PRIu64 " bytes", mMemory,
+              mReservedSize);
   setReplayDataSize(0, 0);
   setVolatileMemory(mSize);
 }
 
-bool MemoryManager::setReplayDataSize(uint32_t constantMemorySize,
-                                      uint32_t opcodeMemorySize) {
-  GAPID_DEBUG("MemoryManager::setReplayDataSize(%d, %d)", constantMemorySize,
-              opcodeMemorySize);
+MemoryManager::~MemoryManager() { release(mMemory, mReservedSize); }
+
+bool MemoryManager::grow(uint64_t size) {
+  // Leave room for aligning each of the regions.
+  size += 3 * kAlignment;
+  if (size <= mSize) {
+    return true;
+  }
+  if (size > mReservedSize) {
+    GAPID_ERROR("Memory size: %" PRIu64
+                " larger than reserved memory size: %" PRIu64,
+                size, mReservedSize);
+    return false;
+  }
+  uint64_t committedSize = std::min(roundUpToChunk(size), mReservedSize);
+  if (committedSize > mCommittedSize) {
+    if (!commit(mMemory + mCommittedSize, committedSize - mCommittedSize)) {
+      GAPID_ERROR("Failed to commit %" PRIu64 " bytes of memory",
+                  committedSize);
+      return false;
+    }
+    mCommittedSize = committedSize;
+  }
+  GAPID_DEBUG("Memory grown from %" PRIu64 " to %" PRIu64 " bytes", mSize,
+              size);
+  mSize = size;
+  setReplayDataSize(0, 0);
+  setVolatileMemory(mSize);
+  return true;
+}
+
+bool MemoryManager::setReplayDataSize(uint64_t constantMemorySize,
+                                      uint64_t opcodeMemorySize) {
+  GAPID_DEBUG("MemoryManager::setReplayDataSize(%" PRIu64 ", %" PRIu64 ")",
+              constantMemorySize, opcodeMemorySize);
   if (opcodeMemorySize > mSize) {
-    GAPID_ERROR("Opcode memory size: %d larger than total memory size: %d",
+    GAPID_ERROR("Opcode memory size: %" PRIu64
+                " larger than total memory size: %" PRIu64,
                 opcodeMemorySize, mSize);
     return false;
   }
-  mOpcodeMemory = {align(mMemory.get() + mSize - opcodeMemorySize),
+  mOpcodeMemory = {align(mMemory + mSize - opcodeMemorySize),
                    opcodeMemorySize};
   GAPID_DEBUG("Opcode range: [%p,%p]", mOpcodeMemory.base,
               mOpcodeMemory.base + mOpcodeMemory.size - 1);
 
   if (constantMemorySize > mSize - mOpcodeMemory.size) {
-    GAPID_ERROR(
-        "Constant memory size: %d larger than available memory size: %d",
-        constantMemorySize, mSize - mOpcodeMemory.size);
+    GAPID_ERROR("Constant memory size: %" PRIu64
+                " larger than available memory size: %" PRIu64,
+                constantMemorySize, mSize - mOpcodeMemory.size);
     return false;
   }
   mConstantMemory = {align(mOpcodeMemory.base - constantMemorySize),
@@ -114,12 +250,28 @@ bool MemoryManager::setReplayDataSize(uint32_t constantMemorySize,
   return true;
 }
 
-bool MemoryManager::setVolatileMemory(uint32_t size) {
+bool MemoryManager::setVolatileMemory(uint64_t size, uint64_t headroom) {
   if (size > mSize - mReplayData.size) {
     return false;
   }
+  if (headroom > mSize - mReplayData.size - size) {
+    headroom = 0;
+  }
+
+  mVolatileMemory = {align(mReplayData.base - headroom - size), size};
+  GAPID_DEBUG("Volatile range: [%p,%p]", mVolatileMemory.base,
+              mVolatileMemory.base + mVolatileMemory.size - 1);
+  return true;
+}
+
+bool MemoryManager::setVolatileMemoryAt(void* base, uint64_t size) {
+  uint8_t* addr = static_cast<uint8_t*>(base);
+  if (addr != align(addr) || addr < mMemory || addr > mReplayData.base ||
+      size > static_cast<uint64_t>(mReplayData.base - addr)) {
+    return false;
+  }
 
-  mVolatileMemory = {align(mReplayData.base - size), size};
+  mVolatileMemory = {addr, size};
   GAPID_DEBUG("Volatile range: [%p,%p]", mVolatileMemory.base,
               mVolatileMemory.base + mVolatileMemory.size - 1);
   return true;
@@ -17,9 +17,9 @@
 #ifndef GAPIR_MEMORY_MANAGER_H
 #define GAPIR_MEMORY_MANAGER_H
 
+#include <stddef.h>
 #include <stdint.h>
 
-#include <memory>
 #include <type_traits>
 #include <utility>
 #include <vector>
@@ -33,45 +33,67 @@ namespace gapir {
 // The layout of the memory managed by the memory manager (extra paddings are
 // possible between the different memory regions): | In memory resource cache |
 // Volatile Memory | Replay data |
+//
+// The memory is a reservation of virtual address space, of which only the
+// managed size is committed. Physical pages are only used once touched, and
+// may be backed by transparent huge pages where the platform supports it.
 class MemoryManager {
  public:
   // Creating a memory manager will try to allocate memory based on the size
   // list provided, while keeping at least size * kOverheadFactor free bytes for
   // possible driver overhead allocations. Stopping after the first successful
   // allocation and cause a fatal error if none of the sizes could be allocated.
-  explicit MemoryManager(const std::vector<uint32_t>& sizeList);
+  // If maxSize is greater than the allocated size then maxSize bytes of
+  // address space are reserved, so that the memory can later grow up to
+  // maxSize bytes.
+  explicit MemoryManager(const std::vector<uint64_t>& sizeList,
+                         uint64_t maxSize = 0);
+  ~MemoryManager();
+
+  // Grows the memory so that regions totalling size bytes fit in it. Growing
+  // resets the replay data and the volatile memory, which have to be set
+  // again. Returns true if the memory is large enough and false if size
+  // exceeds the reserved address space.
+  bool grow(uint64_t size);
 
   // Sets the size of the replay data. Returns true if the given size fits in
   // the memory and false otherwise
-  bool setReplayDataSize(uint32_t constantMemorySize,
-                         uint32_t opcodeMemorySize);
+  bool setReplayDataSize(uint64_t constantMemorySize,
+                         uint64_t opcodeMemorySize);
+
+  // Sets the size of the volatile memory, leaving headroom bytes free between
+  // the volatile memory and the replay data. Returns true if the given size
+  // fits in the memory and false otherwise
+  bool setVolatileMemory(uint64_t size, uint64_t headroom = 0);
 
-  // Sets the size of the volatile memory. Returns true if the given size fits
-  // in the memory and false otherwise
-  bool setVolatileMemory(uint32_t size);
+  // Places the volatile memory of the given size at the given address, which
+  // must be below the replay data. Returns true if the volatile memory fits
+  // there and false otherwise
+  bool setVolatileMemoryAt(void* base, uint64_t size);
 
   // Returns the size and the base address of the different memory regions
   // managed by the memory manager
-  void* getBaseAddress() const { return mMemory.get(); }
+  void* getBaseAddress() const { return mMemory; }
   void* getReplayAddress() const { return mReplayData.base; }
   void* getOpcodeAddress() const { return mOpcodeMemory.base; }
   void* getConstantAddress() const { return mConstantMemory.base; }
   void* getVolatileAddress() const { return mVolatileMemory.base; }
-  uint32_t getSize() const { return mSize; }
-  uint32_t getOpcodeSize() const { return mOpcodeMemory.size; }
-  uint32_t getConstantSize() const { return mConstantMemory.size; }
-  uint32_t getVolatileSize() const { return mVolatileMemory.size; }
+  uint64_t getSize() const { return mSize; }
+  uint64_t getMaxSize() const { return mReservedSize; }
+  uint64_t getOpcodeSize() const { return mOpcodeMemory.size; }
+  uint64_t getConstantSize() const { return mConstantMemory.size; }
+  uint64_t getVolatileSize() const { return mVolatileMemory.size; }
 
   // Converts a given relative (constant or volatile) pointer to an absolute
   // pointer without checking if the given offset is inside the range of that
   // memory
-  const void* constantToAbsolute(uint32_t offset) const;
-  void* volatileToAbsolute(uint32_t offset) const;
+  const void* constantToAbsolute(uint64_t offset) const;
+  void* volatileToAbsolute(uint64_t offset) const;
 
   // Converts an absolute pointer to a relative (constant or volatile) pointer
   // without checking if the address is inside the range
-  uint32_t absoluteToConstant(const void* address) const;
-  uint32_t absoluteToVolatile(const void* address) const;
+  uint64_t absoluteToConstant(const void* address) const;
+  uint64_t absoluteToVolatile(const void* address) const;
 
   // Checks if the given absolute pointer points inside the constant or inside
   // the volatile memory
@@ -88,14 +110,17 @@ class MemoryManager {
   bool isNotObservedAbsoluteAddress(const void* address) const;
 
  private:
+  MemoryManager(const MemoryManager&) = delete;
+  MemoryManager& operator=(const MemoryManager&) = delete;
+
   // Struct to represent a memory interval inside the memory manager with its
   // base address and its size
   struct MemoryRange {
     MemoryRange();
-    MemoryRange(uint8_t* base, uint32_t size);
+    MemoryRange(uint8_t* base, uint64_t size);
     uint8_t* end() const { return base + size; }
 
-    void* toAbsolute(uint32_t offset) const { return base + offset; }
+    void* toAbsolute(uint64_t offset) const { return base + offset; }
 
     bool isInRange(const void* address) const {
       return address >= base && address < base + size;
@@ -106,13 +131,13 @@ class MemoryManager {
       return address >= base && addr + s <= base + size;
     }
 
-    uint32_t toOffset(const void* address) const {
+    uint64_t toOffset(const void* address) const {
       const uint8_t* addr = static_cast<const uint8_t*>(address);
-      return static_cast<uint32_t>(addr - base);
+      return static_cast<uint64_t>(addr - base);
     }
 
     uint8_t* base;
-    uint32_t size;
+    uint64_t size;
   };
 
   // Alignment used for each memory region in bytes
@@ -124,9 +149,14 @@ class MemoryManager {
   uint8_t* align(uint8_t* addr) const;
 
   // The size and the base address of the memory block managed by the memory
-  // manager. This pointer owns the allocated memory
-  uint32_t mSize;
-  std::unique_ptr<uint8_t[]> mMemory;
+  // manager. This pointer owns the reserved address space
+  uint64_t mSize;
+  uint8_t* mMemory;
+
+  // The size of the reserved address space, and the size of the committed
+  // memory at its start. mSize <= mCommittedSize <= mReservedSize.
+  uint64_t mReservedSize;
+  uint64_t mCommittedSize;
 
   // The size and base address of the replay data. The memory range specified by
   // these values have to specify a subset of the memory managed by the memory
@@ -151,19 +181,19 @@ class MemoryManager {
   MemoryRange mVolatileMemory;
 };
 
-inline const void* MemoryManager::constantToAbsolute(uint32_t offset) const {
+inline const void* MemoryManager::constantToAbsolute(uint64_t offset) const {
   return mConstantMemory.toAbsolute(offset);
 }
 
-inline void* MemoryManager::volatileToAbsolute(uint32_t offset) const {
+inline void* MemoryManager::volatileToAbsolute(uint64_t offset) const {
   return mVolatileMemory.toAbsolute(offset);
 }
 
-inline uint32_t MemoryManager::absoluteToConstant(const void* address) const {
+inline uint64_t MemoryManager::absoluteToConstant(const void* address) const {
   return mConstantMemory.toOffset(address);
 }
 
-inline uint32_t MemoryManager::absoluteToVolatile(const void* address) const {
+inline uint64_t MemoryManager::absoluteToVolatile(const void* address) const {
   return mVolatileMemory.toOffset(address);
 }
 
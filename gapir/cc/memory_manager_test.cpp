@@ -18,6 +18,8 @@
 
 #include <gtest/gtest.h>
 
+#include <string.h>
+
 #include <memory>
 #include <vector>
 
@@ -26,11 +28,12 @@ namespace test {
 namespace {
 
 const uint32_t MEMORY_SIZE = 4096;
+const uint64_t GB = 1024 * 1024 * 1024ULL;
 
 class MemoryManagerTest : public ::testing::Test {
  protected:
   virtual void SetUp() {
-    std::vector<uint32_t> memorySizes = {MEMORY_SIZE};
+    std::vector<uint64_t> memorySizes = {MEMORY_SIZE};
     mMemoryManager.reset(new MemoryManager(memorySizes));
   }
 
@@ -81,6 +84,42 @@ TEST_F(MemoryManagerTest, OutOfBoundsVolatileSizeFails) {
   EXPECT_TRUE(mMemoryManager->setVolatileMemory(MEMORY_SIZE / 2));
 }
 
+TEST_F(MemoryManagerTest, VolatileHeadroom) {
+  EXPECT_TRUE(mMemoryManager->setReplayDataSize(512, 0));
+  uint8_t* replayBase =
+      static_cast<uint8_t*>(mMemoryManager->getReplayAddress());
+
+  EXPECT_TRUE(mMemoryManager->setVolatileMemory(1024, 256));
+  EXPECT_EQ(replayBase - 256 - 1024, mMemoryManager->getVolatileAddress());
+  EXPECT_EQ(1024, mMemoryManager->getVolatileSize());
+
+  // The headroom is dropped if the volatile memory would not fit with it.
+  EXPECT_TRUE(mMemoryManager->setVolatileMemory(MEMORY_SIZE - 512, 256));
+  EXPECT_EQ(replayBase - (MEMORY_SIZE - 512),
+            mMemoryManager->getVolatileAddress());
+}
+
+TEST_F(MemoryManagerTest, SetVolatileMemoryAt) {
+  EXPECT_TRUE(mMemoryManager->setReplayDataSize(1024, 0));
+  EXPECT_TRUE(mMemoryManager->setVolatileMemory(1024, 1024));
+  void* base = mMemoryManager->getVolatileAddress();
+
+  // A larger replay data still leaves room for the volatile memory at base.
+  EXPECT_TRUE(mMemoryManager->setReplayDataSize(2048, 0));
+  EXPECT_TRUE(mMemoryManager->setVolatileMemoryAt(base, 1024));
+  EXPECT_EQ(base, mMemoryManager->getVolatileAddress());
+  EXPECT_EQ(1024, mMemoryManager->getVolatileSize());
+
+  // Overlapping the replay data, or outside of the memory.
+  EXPECT_TRUE(mMemoryManager->setReplayDataSize(2048 + 8, 0));
+  EXPECT_FALSE(mMemoryManager->setVolatileMemoryAt(base, 1024));
+  uint8_t* replayBase =
+      static_cast<uint8_t*>(mMemoryManager->getReplayAddress());
+  EXPECT_FALSE(mMemoryManager->setVolatileMemoryAt(replayBase + 8, 8));
+  uint8_t* memoryBase = static_cast<uint8_t*>(mMemoryManager->getBaseAddress());
+  EXPECT_FALSE(mMemoryManager->setVolatileMemoryAt(memoryBase - 8, 8));
+}
+
 TEST_F(MemoryManagerTest, IsConstantAddressWorks) {
   uint32_t constantMemorySize = 1024;
 
@@ -145,5 +184,66 @@ TEST_F(MemoryManagerTest, AbsoluteToConstant) {
           10));
 }
 
+TEST(MemoryManagerGrowTest, Grow) {
+  const uint64_t maxSize = 64 * 1024 * 1024;
+  std::vector<uint64_t> memorySizes = {MEMORY_SIZE};
+  MemoryManager memoryManager(memorySizes, maxSize);
+  void* base = memoryManager.getBaseAddress();
+  EXPECT_EQ(MEMORY_SIZE, memoryManager.getSize());
+  EXPECT_LE(maxSize, memoryManager.getMaxSize());
+
+  const uint64_t volatileSize = 4 * 1024 * 1024;
+  EXPECT_FALSE(memoryManager.setVolatileMemory(volatileSize));
+  EXPECT_TRUE(memoryManager.grow(1024 + 128 + volatileSize));
+  EXPECT_EQ(base, memoryManager.getBaseAddress());
+  EXPECT_TRUE(memoryManager.setReplayDataSize(1024, 128));
+  EXPECT_TRUE(memoryManager.setVolatileMemory(volatileSize));
+
+  // The whole of the grown memory is usable.
+  memset(memoryManager.getBaseAddress(), 0xab, memoryManager.getSize());
+
+  EXPECT_FALSE(memoryManager.grow(memoryManager.getMaxSize() + 1));
+}
+
+TEST(MemoryManagerGrowTest, LargerThan4GB) {
+  if (sizeof(void*) < 8) {
+    return;  // Not enough address space.
+  }
+  std::vector<uint64_t> memorySizes = {5 * GB, MEMORY_SIZE};
+  MemoryManager memoryManager(memorySizes);
+  if (memoryManager.getSize() != 5 * GB) {
+    return;  // Not enough memory to leave room for the driver overhead.
+  }
+  EXPECT_TRUE(memoryManager.setReplayDataSize(1024, 128));
+  EXPECT_TRUE(memoryManager.setVolatileMemory(4 * GB + 512));
+
+  // Only the touched pages are backed by physical memory.
+  const uint64_t offset = 4 * GB + 256;
+  auto address =
+      static_cast<uint8_t*>(memoryManager.volatileToAbsolute(offset));
+  EXPECT_TRUE(memoryManager.isVolatileAddressWithSize(address, 8));
+  memset(address, 0xcd, 8);
+  EXPECT_EQ(0xcd, address[7]);
+  EXPECT_EQ(offset, memoryManager.absoluteToVolatile(address));
+  EXPECT_FALSE(memoryManager.isVolatileAddress(
+      memoryManager.volatileToAbsolute(4 * GB + 512)));
+}
+
+TEST(MemoryManagerGrowTest, GrowBeyond4GB) {
+  if (sizeof(void*) < 8) {
+    return;  // Not enough address space.
+  }
+  std::vector<uint64_t> memorySizes = {MEMORY_SIZE};
+  MemoryManager memoryManager(memorySizes, 8 * GB);
+  EXPECT_TRUE(memoryManager.grow(GB + 4096 + 5 * GB));
+  EXPECT_TRUE(memoryManager.setReplayDataSize(GB, 4096));
+  EXPECT_TRUE(memoryManager.setVolatileMemory(5 * GB));
+
+  auto opcodes = static_cast<uint8_t*>(memoryManager.getOpcodeAddress());
+  memset(opcodes, 0xef, 4096);
+  auto end = static_cast<uint8_t*>(memoryManager.volatileToAbsolute(5 * GB));
+  EXPECT_LE(end, memoryManager.getConstantAddress());
+}
+
 }  // namespace test
 }  // namespace gapir
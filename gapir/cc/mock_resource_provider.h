@@ -70,7 +70,7 @@ class PatternedResourceProvider : public ResourceProvider {
     std::vector<uint8_t> v;
     for (auto resource : resources) {
       for (size_t i = 0; i < resource.size; i++) {
-        v.push_back(resource.id[i % resource.id.size()]);
+        v.push_back(resource.id.data[i % sizeof(resource.id.data)]);
       }
     }
     return v;
@@ -0,0 +1,91 @@
+/*
+ * Copyright (C) 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "post_encoder.h"
+
+#include <zlib.h>
+
+#include <functional>
+
+#include "core/cc/log.h"
+#include "gapir/replay_service/service.pb.h"
+
+namespace gapir {
+
+PostEncoder::PostEncoder(bool compress, uint32_t dedupWindow,
+                         uint32_t dedupMinSize)
+    : mCompress(compress),
+      mDedupWindow(dedupWindow),
+      mDedupMinSize(dedupMinSize) {}
+
+void PostEncoder::dedup(replay_service::PostData* posts) {
+  if (mDedupWindow == 0) {
+    return;
+  }
+  for (auto& piece : *posts->mutable_post_data_pieces()) {
+    const std::string& data = piece.data();
+    if (data.size() < mDedupMinSize) {
+      continue;
+    }
+    size_t hash = std::hash<std::string>()(data);
+
+    // Search newest first, as consecutive posts are the most likely to match.
+    std::shared_ptr<const std::string> shared;
+    for (auto it = mWindow.rbegin(); it != mWindow.rend(); ++it) {
+      if (it->hash == hash && *it->data == data) {
+        piece.set_is_duplicate(true);
+        piece.set_duplicate_of(it->id);
+        piece.clear_data();
+        shared = it->data;
+        break;
+      }
+    }
+    if (shared == nullptr) {
+      shared = std::make_shared<const std::string>(data);
+    }
+
+    mWindow.push_back(Entry{piece.id(), hash, std::move(shared)});
+    if (mWindow.size() > mDedupWindow) {
+      mWindow.pop_front();
+    }
+  }
+}
+
+bool PostEncoder::encode(const replay_service::PostData& posts,
+                         replay_service::EncodedPostData* out) {
+  mSerialized.clear();
+  if (!posts.SerializeToString(&mSerialized)) {
+    GAPID_WARNING("Failed to serialize post data");
+    return false;
+  }
+
+  auto data = out->mutable_data();
+  uLongf size = compressBound(mSerialized.size());
+  data->resize(size);
+  int err = compress2(reinterpret_cast<Bytef*>(&(*data)[0]), &size,
+                      reinterpret_cast<const Bytef*>(mSerialized.data()),
+                      mSerialized.size(), Z_BEST_SPEED);
+  if (err != Z_OK) {
+    GAPID_WARNING("Failed to compress post data: %d", err);
+    return false;
+  }
+  data->resize(size);
+  out->set_encoding(replay_service::PostEncodingDeflate);
+  out->set_size(mSerialized.size());
+  return true;
+}
+
+}  // namespace gapir
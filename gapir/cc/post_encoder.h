@@ -0,0 +1,80 @@
+/*
+ * Copyright (C) 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GAPIR_POST_ENCODER_H
+#define GAPIR_POST_ENCODER_H
+
+#include <stdint.h>
+
+#include <deque>
+#include <memory>
+#include <string>
+
+namespace replay_service {
+class PostData;
+class EncodedPostData;
+}  // namespace replay_service
+
+namespace gapir {
+
+// PostEncoder prepares batches of post data for sending to GAPIS, using the
+// encoding negotiated by the replay payload. Pieces that repeat one of the
+// recently posted pieces are replaced with a reference to that piece, and the
+// batches can be compressed with zlib.
+// GAPIS keeps the same window of recent pieces, so batches must be encoded in
+// post order. A PostEncoder is not thread-safe.
+class PostEncoder {
+ public:
+  // If compress is true, batches are compressed by encode(). dedupWindow is
+  // the number of most recent pieces of at least dedupMinSize bytes that a
+  // piece can be deduplicated against. A dedupWindow of 0 disables
+  // deduplication.
+  PostEncoder(bool compress, uint32_t dedupWindow, uint32_t dedupMinSize);
+
+  // dedup replaces the data of each piece in posts that is identical to a
+  // piece in the window with a reference to that piece, and updates the
+  // window.
+  void dedup(replay_service::PostData* posts);
+
+  // encode serializes posts and compresses them into out. Returns false on
+  // error.
+  bool encode(const replay_service::PostData& posts,
+              replay_service::EncodedPostData* out);
+
+  inline bool compresses() const { return mCompress; }
+
+ private:
+  // Entry is a recently posted piece in the deduplication window.
+  struct Entry {
+    uint64_t id;
+    size_t hash;
+    std::shared_ptr<const std::string> data;
+  };
+
+  const bool mCompress;
+  const uint32_t mDedupWindow;
+  const uint32_t mDedupMinSize;
+
+  // The deduplication window, oldest piece first.
+  std::deque<Entry> mWindow;
+
+  // Scratch buffer for the serialized batch, kept between calls.
+  std::string mSerialized;
+};
+
+}  // namespace gapir
+
+#endif  // GAPIR_POST_ENCODER_H
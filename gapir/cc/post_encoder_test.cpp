@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "post_encoder.h"
+
+#include <gtest/gtest.h>
+#include <zlib.h>
+
+#include <string>
+#include <vector>
+
+#include "gapir/replay_service/service.pb.h"
+
+namespace gapir {
+namespace test {
+namespace {
+
+const uint32_t kWindow = 4;
+const uint32_t kMinSize = 16;
+
+std::string piece(char fill, size_t size) { return std::string(size, fill); }
+
+// framebuffer returns a w x h RGBA8 image with smooth gradients, roughly
+// resembling a rendered frame.
+std::string framebuffer(uint32_t w, uint32_t h, uint32_t frame) {
+  std::string data(w * h * 4, 0);
+  for (uint32_t y = 0; y < h; y++) {
+    for (uint32_t x = 0; x < w; x++) {
+      char* p = &data[(y * w + x) * 4];
+      p[0] = static_cast<char>(x + frame);
+      p[1] = static_cast<char>(y);
+      p[2] = static_cast<char>((x * y) >> 8);
+      p[3] = static_cast<char>(0xff);
+    }
+  }
+  return data;
+}
+
+class PostEncoderTest : public ::testing::Test {
+ protected:
+  // post adds a piece with the next ID to posts.
+  void post(replay_service::PostData* posts, const std::string& data) {
+    auto p = posts->add_post_data_pieces();
+    p->set_id(mNextID++);
+    p->set_data(data);
+  }
+
+  uint64_t mNextID = 0;
+};
+
+}  // anonymous namespace
+
+TEST_F(PostEncoderTest, DedupRepeatedPieces) {
+  PostEncoder encoder(false, kWindow, kMinSize);
+  replay_service::PostData posts;
+  post(&posts, piece('a', 32));
+  post(&posts, piece('b', 32));
+  post(&posts, piece('a', 32));
+  post(&posts, piece('b', 32));
+  encoder.dedup(&posts);
+
+  ASSERT_EQ(4, posts.post_data_pieces_size());
+  EXPECT_FALSE(posts.post_data_pieces(0).is_duplicate());
+  EXPECT_FALSE(posts.post_data_pieces(1).is_duplicate());
+  EXPECT_TRUE(posts.post_data_pieces(2).is_duplicate());
+  EXPECT_EQ(0, posts.post_data_pieces(2).duplicate_of());
+  EXPECT_EQ("", posts.post_data_pieces(2).data());
+  EXPECT_TRUE(posts.post_data_pieces(3).is_duplicate());
+  EXPECT_EQ(1, posts.post_data_pieces(3).duplicate_of());
+}
+
+TEST_F(PostEncoderTest, DedupAcrossBatchesReferencesNewest) {
+  PostEncoder encoder(false, kWindow, kMinSize);
+  replay_service::PostData first;
+  post(&first, piece('a', 32));
+  encoder.dedup(&first);
+
+  replay_service::PostData second;
+  post(&second, piece('a', 32));
+  post(&second, piece('a', 32));
+  encoder.dedup(&second);
+  EXPECT_EQ(0, second.post_data_pieces(0).duplicate_of());
+  EXPECT_EQ(1, second.post_data_pieces(1).duplicate_of());
+}
+
+TEST_F(PostEncoderTest, DedupSkipsSmallPieces) {
+  PostEncoder encoder(false, kWindow, kMinSize);
+  replay_service::PostData posts;
+  post(&posts, piece('a', kMinSize - 1));
+  post(&posts, piece('a', kMinSize - 1));
+  encoder.dedup(&posts);
+  EXPECT_FALSE(posts.post_data_pieces(1).is_duplicate());
+  EXPECT_EQ(piece('a', kMinSize - 1), posts.post_data_pieces(1).data());
+}
+
+TEST_F(PostEncoderTest, DedupWindowEvictsOldest) {
+  PostEncoder encoder(false, kWindow, kMinSize);
+  replay_service::PostData posts;
+  post(&posts, piece('a', 32));
+  for (uint32_t i = 0; i < kWindow; i++) {
+    post(&posts, piece('b' + i, 32));
+  }
+  post(&posts, piece('a', 32));
+  post(&posts, piece('c', 32));
+  encoder.dedup(&posts);
+  EXPECT_FALSE(posts.post_data_pieces(kWindow + 1).is_duplicate());
+  EXPECT_TRUE(posts.post_data_pieces(kWindow + 2).is_duplicate());
+  EXPECT_EQ(2, posts.post_data_pieces(kWindow + 2).duplicate_of());
+}
+
+TEST_F(PostEncoderTest, DedupDisabled) {
+  PostEncoder encoder(true, 0, kMinSize);
+  replay_service::PostData posts;
+  post(&posts, piece('a', 32));
+  post(&posts, piece('a', 32));
+  encoder.dedup(&posts);
+  EXPECT_FALSE(posts.post_data_pieces(1).is_duplicate());
+}
+
+TEST_F(PostEncoderTest, EncodeRoundTrip) {
+  PostEncoder encoder(true, 0, kMinSize);
+  replay_service::PostData posts;
+  post(&posts, piece('a', 1000));
+  post(&posts, "hello");
+
+  replay_service::EncodedPostData encoded;
+  ASSERT_TRUE(encoder.encode(posts, &encoded));
+  EXPECT_EQ(replay_service::PostEncodingDeflate, encoded.encoding());
+  EXPECT_EQ(posts.ByteSizeLong(), encoded.size());
+  EXPECT_LT(encoded.data().size(), encoded.size());
+
+  std::string serialized(encoded.size(), 0);
+  uLongf size = serialized.size();
+  ASSERT_EQ(Z_OK, uncompress(reinterpret_cast<Bytef*>(&serialized[0]), &size,
+                             reinterpret_cast<const Bytef*>(
+                                 encoded.data().data()),
+                             encoded.data().size()));
+  replay_service::PostData decoded;
+  ASSERT_TRUE(decoded.ParseFromString(serialized));
+  EXPECT_EQ(posts.SerializeAsString(), decoded.SerializeAsString());
+}
+
+// Encodes a sequence of framebuffer posts where every other frame is
+// unchanged, which must take less than half of the raw posts' size.
+TEST_F(PostEncoderTest, FramebufferBandwidth) {
+  const uint32_t kWidth = 960;
+  const uint32_t kHeight = 540;
+  const uint32_t kFrames = 8;
+  PostEncoder encoder(true, kWindow, 4096);
+
+  size_t rawBytes = 0;
+  size_t encodedBytes = 0;
+  for (uint32_t i = 0; i < kFrames; i++) {
+    replay_service::PostData posts;
+    post(&posts, framebuffer(kWidth, kHeight, i / 2));
+    rawBytes += posts.ByteSizeLong();
+
+    replay_service::EncodedPostData encoded;
+    encoder.dedup(&posts);
+    ASSERT_TRUE(encoder.encode(posts, &encoded));
+    encodedBytes += encoded.ByteSizeLong();
+  }
+  EXPECT_LT(encodedBytes * 2, rawBytes);
+}
+
+}  // namespace test
+}  // namespace gapir
@@ -17,11 +17,17 @@
 #include "replay_connection.h"
 
 #include <grpc++/grpc++.h>
+#include <string.h>
+
+#include <algorithm>
 #include <memory>
 
 #include "core/cc/log.h"
+#include "core/cc/timer.h"
 #include "gapir/replay_service/service.grpc.pb.h"
 #include "gapis/service/severity/severity.pb.h"
+#include "post_encoder.h"
+#include "thread_pool.h"
 
 namespace gapir {
 
@@ -29,12 +35,12 @@ namespace gapir {
 
 ReplayConnection::ResourceRequest::~ResourceRequest() = default;
 
-bool ReplayConnection::ResourceRequest::append(const std::string& id,
+bool ReplayConnection::ResourceRequest::append(const ResourceId& id,
                                                size_t size) {
   if (mProtoResourceRequest == nullptr) {
     return false;
   }
-  mProtoResourceRequest->add_ids(id);
+  mProtoResourceRequest->add_ids(id.data, sizeof(id.data));
   mProtoResourceRequest->set_expected_total_size(
       mProtoResourceRequest->expected_total_size() + size);
   return true;
@@ -117,7 +123,7 @@ uint32_t ReplayConnection::Payload::stack_size() const {
   return mProtoReplayRequest->payload().stack_size();
 }
 
-uint32_t ReplayConnection::Payload::volatile_memory_size() const {
+uint64_t ReplayConnection::Payload::volatile_memory_size() const {
   return mProtoReplayRequest->payload().volatile_memory_size();
 }
 
@@ -133,14 +139,23 @@ size_t ReplayConnection::Payload::resource_info_count() const {
   return mProtoReplayRequest->payload().resources_size();
 }
 
-const std::string ReplayConnection::Payload::resource_id(int index) const {
-  return mProtoReplayRequest->payload().resources(index).id();
+ResourceId ReplayConnection::Payload::resource_id(int index) const {
+  const auto& bytes = mProtoReplayRequest->payload().resources(index).id();
+  ResourceId id = {};
+  memcpy(id.data, bytes.data(), std::min(bytes.size(), sizeof(id.data)));
+  return id;
 }
 
 uint32_t ReplayConnection::Payload::resource_size(int index) const {
   return mProtoReplayRequest->payload().resources(index).size();
 }
 
+std::vector<uint32_t> ReplayConnection::Payload::resource_chunks(
+    int index) const {
+  const auto& chunks = mProtoReplayRequest->payload().resources(index).chunks();
+  return std::vector<uint32_t>(chunks.begin(), chunks.end());
+}
+
 size_t ReplayConnection::Payload::opcodes_size() const {
   return mProtoReplayRequest->payload().opcodes().size();
 }
@@ -149,6 +164,19 @@ const void* ReplayConnection::Payload::opcodes_data() const {
   return mProtoReplayRequest->payload().opcodes().data();
 }
 
+bool ReplayConnection::Payload::post_compression() const {
+  return mProtoReplayRequest->payload().post_encoding() ==
+         replay_service::PostEncodingDeflate;
+}
+
+uint32_t ReplayConnection::Payload::post_dedup_window() const {
+  return mProtoReplayRequest->payload().post_dedup_window();
+}
+
+uint32_t ReplayConnection::Payload::post_dedup_min_size() const {
+  return mProtoReplayRequest->payload().post_dedup_min_size();
+}
+
 ReplayConnection::Payload::Payload(
     std::unique_ptr<replay_service::ReplayRequest> req)
     : mProtoReplayRequest(std::move(req)) {}
@@ -190,48 +218,95 @@ ReplayConnection::Resources::Resources(
 
 // ReplayConnection member methods
 
+ReplayConnection::ReplayConnection(ReplayGrpcStream* stream)
+    : mGrpcStream(stream),
+      mPostSlots(kMaxPendingPosts),
+      mPostFailed(false),
+      mFinished(false) {}
+
 ReplayConnection::~ReplayConnection() {
-  if (mGrpcStream != nullptr) {
+  if (mGrpcStream != nullptr && !mFinished) {
     this->sendReplayFinished();
   }
 }
 
 std::unique_ptr<ReplayConnection::Payload> ReplayConnection::getPayload() {
   // Send a replay response with payload request
+  core::Timer timer;
+  timer.Start();
   replay_service::ReplayResponse res;
   res.set_allocated_payload_request(new replay_service::PayloadRequest());
-  mGrpcStream->Write(res);
-  return ReplayConnection::ReplayConnection::Payload::get(mGrpcStream);
+  write(res);
+  auto payload = ReplayConnection::ReplayConnection::Payload::get(mGrpcStream);
+  if (payload != nullptr) {
+    setPostEncoding(*payload);
+    mStats.payloadBytes = payload->constants_size() + payload->opcodes_size();
+    mStats.payloadResources = payload->resource_info_count();
+  }
+  mStats.payloadNs = timer.Stop();
+  return payload;
 }
 
 std::unique_ptr<ReplayConnection::Resources> ReplayConnection::getResources(
     std::unique_ptr<ReplayConnection::ResourceRequest> req) {
+  std::lock_guard<std::mutex> lock(mResourceMutex);
+  core::Timer timer;
+  timer.Start();
   // Send a replay response with resources request
   replay_service::ReplayResponse res;
   res.set_allocated_resource_request(req->release_to_proto());
-  mGrpcStream->Write(res);
-  return ReplayConnection::ReplayConnection::Resources::get(mGrpcStream);
+  mStats.resourceRequests++;
+  mStats.resourcesRequested += res.resource_request().ids_size();
+  mStats.resourceBytesRequested +=
+      res.resource_request().expected_total_size();
+  write(res);
+  auto resources =
+      ReplayConnection::ReplayConnection::Resources::get(mGrpcStream);
+  mStats.resourceFetchNs += timer.Stop();
+  return resources;
 }
 
 bool ReplayConnection::sendReplayFinished() {
+  // All the post data must arrive before the replay is reported finished.
+  flushPostData();
   replay_service::ReplayResponse res;
-  res.set_allocated_finished(new replay_service::Finished());
-  return mGrpcStream->Write(res);
+  mStats.toProto(res.mutable_finished()->mutable_stats());
+  mFinished = true;
+  return write(res);
 }
 
 bool ReplayConnection::sendCrashDump(const std::string& filepath,
                                      const void* crash_data,
                                      uint32_t crash_size) {
+  // Pending post data is not flushed here, as the crash may have happened on
+  // the post worker.
   replay_service::ReplayResponse res;
   res.mutable_crash_dump()->set_filepath(filepath);
   res.mutable_crash_dump()->set_crash_data(crash_data, crash_size);
-  return mGrpcStream->Write(res);
+  return write(res);
 }
 
 bool ReplayConnection::sendPostData(std::unique_ptr<Posts> posts) {
-  replay_service::ReplayResponse res;
-  res.set_allocated_post_data(posts->release_to_proto());
-  return mGrpcStream->Write(res);
+  mStats.posts += posts->piece_count();
+  for (size_t i = 0; i < posts->piece_count(); i++) {
+    mStats.postBytes += posts->piece_size(i);
+  }
+  std::unique_ptr<replay_service::PostData> data(posts->release_to_proto());
+  if (mPostWorker == nullptr) {
+    return writePostData(std::move(data));
+  }
+  if (mPostFailed) {
+    return false;
+  }
+  mPostSlots.acquire();
+  auto raw = data.release();
+  mPostWorker->enqueue(0, [this, raw] {
+    if (!writePostData(std::unique_ptr<replay_service::PostData>(raw))) {
+      mPostFailed = true;
+    }
+    mPostSlots.release();
+  });
+  return true;
 }
 
 bool ReplayConnection::sendNotification(uint64_t id, uint32_t severity,
@@ -256,6 +331,53 @@ bool ReplayConnection::sendNotification(uint64_t id, uint32_t severity,
   notification->set_label(label);
   notification->set_msg(msg);
   notification->set_data(data, data_size);
+  return write(res);
+}
+
+void ReplayConnection::setPostEncoding(const Payload& payload) {
+  bool compress = payload.post_compression();
+  uint32_t dedupWindow = payload.post_dedup_window();
+  if (!compress && dedupWindow == 0) {
+    return;
+  }
+  GAPID_DEBUG("Post data compression: %s, deduplication window: %u",
+              compress ? "deflate" : "none", dedupWindow);
+  mPostEncoder.reset(
+      new PostEncoder(compress, dedupWindow, payload.post_dedup_min_size()));
+  if (compress) {
+    // Compression is slow enough to be worth overlapping with the replay.
+    mPostWorker.reset(new ThreadPool());
+  }
+}
+
+bool ReplayConnection::writePostData(
+    std::unique_ptr<replay_service::PostData> posts) {
+  replay_service::ReplayResponse res;
+  if (mPostEncoder != nullptr) {
+    mPostEncoder->dedup(posts.get());
+    if (mPostEncoder->compresses()) {
+      if (!mPostEncoder->encode(*posts, res.mutable_encoded_post_data())) {
+        return false;
+      }
+      return write(res);
+    }
+  }
+  res.set_allocated_post_data(posts.release());
+  return write(res);
+}
+
+void ReplayConnection::flushPostData() {
+  // Destroying the worker waits for all of its work to finish. Any later
+  // post data is sent synchronously.
+  mPostWorker.reset();
+}
+
+bool ReplayConnection::write(const replay_service::ReplayResponse& res) {
+  if (res.res_case() == replay_service::ReplayResponse::kPostData ||
+      res.res_case() == replay_service::ReplayResponse::kEncodedPostData) {
+    mStats.postWireBytes += res.ByteSizeLong();
+  }
+  std::lock_guard<std::mutex> lock(mWriteMutex);
   return mGrpcStream->Write(res);
 }
 
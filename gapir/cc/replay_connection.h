@@ -17,12 +17,18 @@
 #ifndef GAPIR_REPLAY_CONNECTION_H
 #define GAPIR_REPLAY_CONNECTION_H
 
+#include <atomic>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <tuple>
 #include <vector>
 
+#include "core/cc/semaphore.h"
+#include "replay_stats.h"
+#include "resource.h"
+
 namespace grpc {
 template <typename RES, typename REQ>
 class ServerReaderWriter;
@@ -41,6 +47,9 @@ class Notification;
 
 namespace gapir {
 
+class PostEncoder;
+class ThreadPool;
+
 using ReplayGrpcStream =
     grpc::ServerReaderWriter<replay_service::ReplayResponse,
                              replay_service::ReplayRequest>;
@@ -69,7 +78,7 @@ class ReplayConnection {
     ResourceRequest& operator=(ResourceRequest&&) = delete;
 
     // Adds a resource, with its ID and expected size, to the request list.
-    bool append(const std::string& id, size_t size);
+    bool append(const ResourceId& id, size_t size);
     // Get the internal proto object raw pointer, and gives away the ownership
     // of the proto object.
     replay_service::ResourceRequest* release_to_proto();
@@ -142,7 +151,7 @@ class ReplayConnection {
     uint32_t stack_size() const;
     // Returns the volatile memory size in bytes specified by this replay
     // payload.
-    uint32_t volatile_memory_size() const;
+    uint64_t volatile_memory_size() const;
     // Returns the constant memory size in bytes specified by this replay
     // payload.
     size_t constants_size() const;
@@ -151,13 +160,23 @@ class ReplayConnection {
     // Returns the count of resource info.
     size_t resource_info_count() const;
     // Returns the ID of the 'index'th (starts from 0) resource info.
-    const std::string resource_id(int index) const;
+    ResourceId resource_id(int index) const;
     // Returns the expected size of the 'index'th (starts from 0) resource info.
     uint32_t resource_size(int index) const;
+    // Returns the indices of the resources holding the chunks of the 'index'th
+    // (starts from 0) resource info, or an empty list if it is not split.
+    std::vector<uint32_t> resource_chunks(int index) const;
     // Returns the size in bytes of the opcodes in this replay payload.
     size_t opcodes_size() const;
     // Gets a pointer to the opcodes in this replay payload.
     const void* opcodes_data() const;
+    // Returns true if GAPIS accepts compressed post data.
+    bool post_compression() const;
+    // Returns the number of recent post data pieces that post data can be
+    // deduplicated against, or 0 if deduplication is disabled.
+    uint32_t post_dedup_window() const;
+    // Returns the minimum size in bytes of deduplicated post data pieces.
+    uint32_t post_dedup_min_size() const;
 
    private:
     Payload(std::unique_ptr<replay_service::ReplayRequest> req);
@@ -219,13 +238,17 @@ class ReplayConnection {
   virtual std::unique_ptr<Resources> getResources(
       std::unique_ptr<ResourceRequest> req);
 
-  // Sends ReplayFinished signal. Returns true if succeeded, otherwise returns
-  // false.
+  // Sends ReplayFinished signal, along with the replay stats. It is sent by
+  // the destructor if it has not been sent before. Returns true if succeeded,
+  // otherwise returns false.
   virtual bool sendReplayFinished();
   // Sends crash dump. Returns true if succeeded, otherwise returns false.
   virtual bool sendCrashDump(const std::string& filepath,
                              const void* crash_data, uint32_t crash_size);
-  // Sends post data. Returns true if succeeded, otherwise returns false.
+  // Sends post data, encoded as requested by the payload. Compressed post
+  // data is encoded and sent on a worker thread, in which case a failure is
+  // reported by the next call. Returns true if succeeded, otherwise returns
+  // false.
   virtual bool sendPostData(std::unique_ptr<Posts> posts);
   // Sends notification. Returns true if succeeded, otherwise returns false.
   virtual bool sendNotification(uint64_t id, uint32_t severity,
@@ -233,12 +256,48 @@ class ReplayConnection {
                                 const std::string& msg, const void* data,
                                 uint32_t data_size);
 
+  // Returns the stats of the replay running on this connection.
+  inline ReplayStats& stats() { return mStats; }
+
  protected:
-  ReplayConnection(ReplayGrpcStream* stream) : mGrpcStream(stream) {}
+  ReplayConnection(ReplayGrpcStream* stream);
 
  private:
+  // The maximum number of post data batches waiting to be encoded.
+  static const unsigned int kMaxPendingPosts = 4;
+
+  // Sets up the post data encoding requested by the payload.
+  void setPostEncoding(const Payload& payload);
+  // Encodes and sends the post data. Returns true if succeeded, otherwise
+  // returns false.
+  bool writePostData(std::unique_ptr<replay_service::PostData> posts);
+  // Waits for all the pending post data to be sent.
+  void flushPostData();
+  // Writes the response to the gRPC stream.
+  bool write(const replay_service::ReplayResponse& res);
+
   // The gRPC stream connection.
   ReplayGrpcStream* mGrpcStream;
+  // Guards writes to mGrpcStream, which may come from the post worker.
+  std::mutex mWriteMutex;
+  // Serializes getResources calls, so that each request is matched with its
+  // response when resources are fetched from several threads.
+  std::mutex mResourceMutex;
+
+  // The post data encoder, or nullptr if post data is sent unencoded.
+  std::unique_ptr<PostEncoder> mPostEncoder;
+  // The thread encoding and sending the post data, in post order. nullptr if
+  // post data is sent synchronously.
+  std::unique_ptr<ThreadPool> mPostWorker;
+  // Limits the number of batches queued on mPostWorker.
+  core::Semaphore mPostSlots;
+  // Set when the post worker failed to send post data.
+  std::atomic<bool> mPostFailed;
+
+  // The stats of the replay.
+  ReplayStats mStats;
+  // Set once ReplayFinished has been sent.
+  bool mFinished;
 };
 }  // namespace gapir
 
@@ -43,7 +43,14 @@ std::unique_ptr<ReplayRequest> ReplayRequest::create(
     GAPID_ERROR("Failed to create ReplayRequest: null Payload")
     return nullptr;  // failed at getting payload.
   }
-  // Reserve Replay data segments and load data into the memory manager.
+  // Grow the memory if the replay does not fit in it, then reserve Replay data
+  // segments and load data into the memory manager.
+  if (!memoryManager->grow(payload->constants_size() + payload->opcodes_size() +
+                           payload->volatile_memory_size())) {
+    GAPID_ERROR(
+        "Failed to create ReplayRequest: replay does not fit in the memory")
+    return nullptr;
+  }
   if (!memoryManager->setReplayDataSize(payload->constants_size(),
                                         payload->opcodes_size())) {
     GAPID_ERROR(
@@ -61,7 +68,7 @@ std::unique_ptr<ReplayRequest> ReplayRequest::create(
   req->mStackSize = payload->stack_size();
   GAPID_DEBUG("Stack size: %d", req->mStackSize);
   req->mVolatileMemorySize = payload->volatile_memory_size();
-  GAPID_DEBUG("Volatile memory size: %d", req->mVolatileMemorySize);
+  GAPID_DEBUG("Volatile memory size: %" PRIu64, req->mVolatileMemorySize);
   req->mConstantMemory = {memoryManager->getConstantAddress(),
                           payload->constants_size()};
   GAPID_DEBUG("Constant memory size: %zu", payload->constants_size());
@@ -71,6 +78,36 @@ std::unique_ptr<ReplayRequest> ReplayRequest::create(
                                  payload->resource_size(i));
   }
   GAPID_DEBUG("Resources: %zu", req->mResources.size());
+  size_t chunked = 0;
+  for (size_t i = 0; i < payload->resource_info_count(); i++) {
+    auto indices = payload->resource_chunks(i);
+    if (indices.empty()) {
+      continue;
+    }
+    std::vector<Resource> chunks;
+    uint64_t size = 0;
+    for (auto index : indices) {
+      if (index >= req->mResources.size()) {
+        GAPID_ERROR(
+            "Failed to create ReplayRequest: invalid chunk %u of resource %zu",
+            index, i);
+        return nullptr;
+      }
+      chunks.push_back(req->mResources[index]);
+      size += req->mResources[index].size;
+    }
+    if (size != req->mResources[i].size) {
+      GAPID_ERROR(
+          "Failed to create ReplayRequest: the chunks of resource %zu hold "
+          "%" PRIu64 " bytes instead of %u",
+          i, size, req->mResources[i].size);
+      return nullptr;
+    }
+    req->mResourceChunks.resize(req->mResources.size());
+    req->mResourceChunks[i] = std::move(chunks);
+    chunked++;
+  }
+  GAPID_DEBUG("Resources split into chunks: %zu", chunked);
   const uint32_t instCount = payload->opcodes_size() / sizeof(uint32_t);
   req->mInstructionList = {
       static_cast<uint32_t*>(memoryManager->getOpcodeAddress()), instCount};
@@ -80,7 +117,7 @@ std::unique_ptr<ReplayRequest> ReplayRequest::create(
 
 uint32_t ReplayRequest::getStackSize() const { return mStackSize; }
 
-uint32_t ReplayRequest::getVolatileMemorySize() const {
+uint64_t ReplayRequest::getVolatileMemorySize() const {
   return mVolatileMemorySize;
 }
 
@@ -88,6 +125,12 @@ const std::vector<Resource>& ReplayRequest::getResources() const {
   return mResources;
 }
 
+const std::vector<Resource>& ReplayRequest::getResourceChunks(
+    uint32_t index) const {
+  static const std::vector<Resource> none;
+  return index < mResourceChunks.size() ? mResourceChunks[index] : none;
+}
+
 const std::pair<const void*, uint32_t>& ReplayRequest::getConstantMemory()
     const {
   return mConstantMemory;
@@ -46,7 +46,7 @@ class ReplayRequest {
   uint32_t getStackSize() const;
 
   // Get the volatile memory size required by the replay
-  uint32_t getVolatileMemorySize() const;
+  uint64_t getVolatileMemorySize() const;
 
   // Get the base address and the size of the constant memory
   const std::pair<const void*, uint32_t>& getConstantMemory() const;
@@ -54,6 +54,11 @@ class ReplayRequest {
   // Get the list of the resources with their size required by this replay
   const std::vector<Resource>& getResources() const;
 
+  // Get the chunks the resource of the given index was split into, in order,
+  // or an empty list if it was not split. A resource split into chunks is
+  // loaded by loading its chunks.
+  const std::vector<Resource>& getResourceChunks(uint32_t index) const;
+
   // Get the base address and the size (count of instructions) of the
   // instruction list
   const std::pair<const uint32_t*, uint32_t>& getInstructionList() const;
@@ -65,7 +70,7 @@ class ReplayRequest {
   uint32_t mStackSize;
 
   // The size of the volatile memory required by the replay
-  uint32_t mVolatileMemorySize;
+  uint64_t mVolatileMemorySize;
 
   // The base address and the size in bytes of the constant memory
   std::pair<const void*, uint32_t> mConstantMemory;
@@ -75,6 +80,9 @@ class ReplayRequest {
 
   // The list of resources (resource id, resource size) used by the replay
   std::vector<Resource> mResources;
+
+  // The chunks of each resource, empty if no resource was split into chunks
+  std::vector<std::vector<Resource>> mResourceChunks;
 };
 
 }  // namespace gapir
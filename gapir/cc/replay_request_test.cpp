@@ -19,11 +19,14 @@
 #include "mock_replay_connection.h"
 #include "mock_resource_provider.h"
 #include "replay_connection.h"
+#include "resource_in_memory_cache.h"
 #include "test_utilities.h"
 
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <string.h>
+
 #include <memory>
 #include <string>
 #include <vector>
@@ -44,7 +47,8 @@ TEST(ReplayRequestTestStatic, Create) {
   uint32_t volatileMemorySize = 1024;
   std::vector<uint8_t> constantMemory = {'A', 'B', 'C', 'D',
                                          'E', 'F', 'G', 'H'};
-  std::vector<Resource> resources{{"ZYX", 16}, {"1234", 32}};
+  std::vector<Resource> resources{{resourceId("ZYX"), 16},
+                                  {resourceId("1234"), 32}};
   std::vector<uint32_t> instructionList{0, 1, 2};
 
   auto payload = createPayload(stackSize, volatileMemorySize, constantMemory,
@@ -56,7 +60,7 @@ TEST(ReplayRequestTestStatic, Create) {
   EXPECT_CALL(*mock_conn, getPayload())
       .WillOnce(Return(ByMove(std::move(payload))));
 
-  std::vector<uint32_t> memorySizes = {MEMORY_SIZE};
+  std::vector<uint64_t> memorySizes = {MEMORY_SIZE};
   std::unique_ptr<MemoryManager> memoryManager(new MemoryManager(memorySizes));
 
   auto replayRequest =
@@ -76,12 +80,90 @@ TEST(ReplayRequestTestStatic, Create) {
                                replayRequest->getInstructionList().second));
 }
 
+TEST(ReplayRequestTestStatic, CreateManyResources) {
+  // Decodes the resource ids of a large payload and builds the resource
+  // cache schedule from them.
+  const uint32_t count = 10000;
+  std::vector<Resource> resources;
+  resources.reserve(count);
+  for (uint32_t i = 0; i < count; i++) {
+    ResourceId id;
+    for (size_t j = 0; j < sizeof(id.data); j += sizeof(uint32_t)) {
+      uint32_t word = (i + 1) * 2654435761u + j * 40503u;
+      memcpy(&id.data[j], &word, sizeof(word));
+    }
+    resources.emplace_back(id, 64);
+  }
+  auto payload = createPayload(128, 1024, {}, resources, {});
+
+  auto mock_conn =
+      std::unique_ptr<MockReplayConnection>(new MockReplayConnection());
+  EXPECT_CALL(*mock_conn, getPayload())
+      .WillOnce(Return(ByMove(std::move(payload))));
+
+  std::vector<uint64_t> memorySizes = {MEMORY_SIZE};
+  std::unique_ptr<MemoryManager> memoryManager(new MemoryManager(memorySizes));
+  auto cache = ResourceInMemoryCache::create(
+      std::unique_ptr<ResourceProvider>(new MockResourceProvider()),
+      memoryManager->getBaseAddress());
+
+  auto replayRequest =
+      ReplayRequest::create(mock_conn.get(), memoryManager.get());
+  ASSERT_THAT(replayRequest, NotNull());
+  cache->setSchedule(replayRequest->getResources());
+  EXPECT_EQ(resources, replayRequest->getResources());
+}
+
+TEST(ReplayRequestTestStatic, CreateChunkedResources) {
+  const Resource A(resourceId("A"), 6);
+  const Resource B(resourceId("B"), 4);
+  const Resource C(resourceId("C"), 2);
+  auto payload = createPayload(128, 1024, {}, {A, B, C}, {}, {{1, 2}});
+
+  auto mock_conn =
+      std::unique_ptr<MockReplayConnection>(new MockReplayConnection());
+  EXPECT_CALL(*mock_conn, getPayload())
+      .WillOnce(Return(ByMove(std::move(payload))));
+
+  std::vector<uint64_t> memorySizes = {MEMORY_SIZE};
+  std::unique_ptr<MemoryManager> memoryManager(new MemoryManager(memorySizes));
+  auto replayRequest =
+      ReplayRequest::create(mock_conn.get(), memoryManager.get());
+  ASSERT_THAT(replayRequest, NotNull());
+  EXPECT_EQ((std::vector<Resource>{A, B, C}), replayRequest->getResources());
+  EXPECT_EQ((std::vector<Resource>{B, C}), replayRequest->getResourceChunks(0));
+  EXPECT_TRUE(replayRequest->getResourceChunks(1).empty());
+  EXPECT_TRUE(replayRequest->getResourceChunks(3).empty());
+}
+
+TEST(ReplayRequestTestStatic, CreateErrorChunks) {
+  const Resource A(resourceId("A"), 6);
+  const Resource B(resourceId("B"), 4);
+  const Resource C(resourceId("C"), 2);
+  // The chunks of a resource must be listed and hold all of its bytes.
+  for (const auto& chunks : std::vector<std::vector<std::vector<uint32_t>>>{
+           {{1, 3}}, {{1}}, {{1, 2, 2}}}) {
+    auto payload = createPayload(128, 1024, {}, {A, B, C}, {}, chunks);
+
+    auto mock_conn =
+        std::unique_ptr<MockReplayConnection>(new MockReplayConnection());
+    EXPECT_CALL(*mock_conn, getPayload())
+        .WillOnce(Return(ByMove(std::move(payload))));
+
+    std::vector<uint64_t> memorySizes = {MEMORY_SIZE};
+    std::unique_ptr<MemoryManager> memoryManager(
+        new MemoryManager(memorySizes));
+    EXPECT_EQ(nullptr,
+              ReplayRequest::create(mock_conn.get(), memoryManager.get()));
+  }
+}
+
 TEST(ReplayRequestTestStatic, CreateErrorGet) {
   auto mock_conn =
       std::unique_ptr<MockReplayConnection>(new MockReplayConnection());
   EXPECT_CALL(*mock_conn, getPayload()).WillOnce(Return(ByMove(nullptr)));
 
-  std::vector<uint32_t> memorySizes = {MEMORY_SIZE};
+  std::vector<uint64_t> memorySizes = {MEMORY_SIZE};
   std::unique_ptr<MemoryManager> memoryManager(new MemoryManager(memorySizes));
 
   auto replayRequest =
@@ -0,0 +1,65 @@
+/*
+ * Copyright (C) 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "replay_stats.h"
+
+#include "gapir/replay_service/service.pb.h"
+
+namespace gapir {
+
+ReplayStats::ReplayStats()
+    : payloadNs(0),
+      contextNs(0),
+      prefetchNs(0),
+      interpretNs(0),
+      rendererNs(0),
+      resourceFetchNs(0),
+      payloadBytes(0),
+      payloadResources(0),
+      resourceRequests(0),
+      resourcesRequested(0),
+      resourceBytesRequested(0),
+      resourceCacheHits(0),
+      posts(0),
+      postBytes(0),
+      postWireBytes(0),
+      volatileMemoryBytes(0),
+      resourceLookaheadHits(0),
+      checkpointInstructions(0) {}
+
+void ReplayStats::toProto(replay_service::ReplayStats* out) const {
+  out->set_replay_id(replayId);
+  out->set_payload_ns(payloadNs);
+  out->set_context_ns(contextNs);
+  out->set_prefetch_ns(prefetchNs);
+  out->set_interpret_ns(interpretNs);
+  out->set_renderer_ns(rendererNs);
+  out->set_resource_fetch_ns(resourceFetchNs);
+  out->set_payload_bytes(payloadBytes);
+  out->set_payload_resources(payloadResources);
+  out->set_resource_requests(resourceRequests);
+  out->set_resources_requested(resourcesRequested);
+  out->set_resource_bytes_requested(resourceBytesRequested);
+  out->set_resource_cache_hits(resourceCacheHits);
+  out->set_posts(posts);
+  out->set_post_bytes(postBytes);
+  out->set_post_wire_bytes(postWireBytes);
+  out->set_volatile_memory_bytes(volatileMemoryBytes);
+  out->set_resource_lookahead_hits(resourceLookaheadHits);
+  out->set_checkpoint_instructions(checkpointInstructions);
+}
+
+}  // namespace gapir
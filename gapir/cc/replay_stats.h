@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef GAPIR_REPLAY_STATS_H
+#define GAPIR_REPLAY_STATS_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <string>
+
+namespace replay_service {
+class ReplayStats;
+}  // namespace replay_service
+
+namespace gapir {
+
+// ReplayStats holds the time spent in each phase of a replay, and the amount
+// of data transferred and processed by the replay. The fields are atomic, as
+// they are updated from the replay threads and the post data worker.
+// See replay_service::ReplayStats for the meaning of each field.
+struct ReplayStats {
+  ReplayStats();
+
+  // toProto copies the stats into the proto message.
+  void toProto(replay_service::ReplayStats* out) const;
+
+  // The ID of the replay. Set before the replay starts.
+  std::string replayId;
+
+  // Times in nanoseconds.
+  std::atomic<uint64_t> payloadNs;
+  std::atomic<uint64_t> contextNs;
+  std::atomic<uint64_t> prefetchNs;
+  std::atomic<uint64_t> interpretNs;
+  std::atomic<uint64_t> rendererNs;
+  std::atomic<uint64_t> resourceFetchNs;
+
+  std::atomic<uint64_t> payloadBytes;
+  std::atomic<uint64_t> payloadResources;
+  std::atomic<uint64_t> resourceRequests;
+  std::atomic<uint64_t> resourcesRequested;
+  std::atomic<uint64_t> resourceBytesRequested;
+  std::atomic<uint64_t> resourceCacheHits;
+  std::atomic<uint64_t> posts;
+  std::atomic<uint64_t> postBytes;
+  std::atomic<uint64_t> postWireBytes;
+  std::atomic<uint64_t> volatileMemoryBytes;
+  std::atomic<uint64_t> resourceLookaheadHits;
+  std::atomic<uint64_t> checkpointInstructions;
+
+ private:
+  ReplayStats(const ReplayStats&) = delete;
+  ReplayStats& operator=(const ReplayStats&) = delete;
+};
+
+}  // namespace gapir
+
+#endif  // GAPIR_REPLAY_STATS_H
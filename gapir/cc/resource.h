@@ -17,30 +17,32 @@
 #ifndef GAPIR_RESOURCE_H
 #define GAPIR_RESOURCE_H
 
-#include <stdint.h>
+#include "core/cc/id.h"
 
-#include <string>
+#include <stdint.h>
 
 namespace gapir {
 
-typedef std::string ResourceId;
+// ResourceId is the 20-byte content hash identifying a resource. It is sent as
+// raw bytes over the replay connection.
+typedef core::Id ResourceId;
 
 // Resource represent a requestable blob of data from the server.
 class Resource {
  public:
   inline Resource();
   inline Resource(const Resource& other);
-  inline Resource(ResourceId id, uint32_t size);
+  inline Resource(const ResourceId& id, uint32_t size);
   inline bool operator==(const Resource& other) const;
 
   ResourceId id;  // The resource identifier.
   uint32_t size;  // The resource size in bytes.
 };
 
-inline Resource::Resource() {}
+inline Resource::Resource() : id(), size(0) {}
 inline Resource::Resource(const Resource& other)
     : id(other.id), size(other.size) {}
-inline Resource::Resource(ResourceId id_, uint32_t size_)
+inline Resource::Resource(const ResourceId& id_, uint32_t size_)
     : id(id_), size(size_) {}
 inline bool Resource::operator==(const Resource& other) const {
   return id == other.id && size == other.size;
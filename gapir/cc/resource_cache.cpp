@@ -16,18 +16,68 @@
 
 #include "resource_cache.h"
 
+#include <string.h>
+
+#include <algorithm>
 #include <memory>
 
 #include "core/cc/assert.h"
+#include "core/cc/trace.h"
 #include "replay_connection.h"
 
 namespace gapir {
 
 ResourceCache::ResourceCache(std::unique_ptr<ResourceProvider> fallbackProvider)
-    : mFallbackProvider(std::move(fallbackProvider)) {}
+    : mFallbackProvider(std::move(fallbackProvider)),
+      mScheduleCursor(0),
+      mScheduleScanned(0),
+      mLookaheadCount(0),
+      mLookaheadBytes(0),
+      mLookaheadActive(false),
+      mStagedBytes(0) {}
+
+namespace {
+
+// The distance ahead of the schedule cursor searched for a resource loaded
+// out of the scheduled order.
+const size_t kScheduleSearchLimit = 256;
+
+}  // anonymous namespace
+
+const size_t ResourceCache::kNoUse;
+
+void ResourceCache::setSchedule(std::vector<Resource> schedule) {
+  mSchedule = std::move(schedule);
+  mScheduleCursor = 0;
+  mScheduleScanned = 0;
+  mLookaheadActive = false;
+  mUses.clear();
+  for (size_t i = 0; i < mSchedule.size(); i++) {
+    mUses[mSchedule[i].id].indices.push_back(i);
+  }
+}
+
+void ResourceCache::setLookahead(size_t maxCount, size_t maxBytes) {
+  mLookaheadCount = maxCount;
+  mLookaheadBytes = maxBytes;
+}
+
+size_t ResourceCache::nextUse(const ResourceId& id) {
+  auto it = mUses.find(id);
+  if (it == mUses.end()) {
+    return kNoUse;
+  }
+  Uses& uses = it->second;
+  while (uses.next < uses.indices.size() &&
+         uses.indices[uses.next] < mScheduleCursor) {
+    uses.next++;
+  }
+  return uses.next < uses.indices.size() ? uses.indices[uses.next] : kNoUse;
+}
 
 bool ResourceCache::get(const Resource* resources, size_t count,
                         ReplayConnection* conn, void* target, size_t size) {
+  GAPID_TRACE_NAME("ResourceCache::get");
   uint8_t* dst = reinterpret_cast<uint8_t*>(target);
   Batch batch(dst, size);
   for (size_t i = 0; i < count; i++) {
@@ -35,8 +85,22 @@ bool ResourceCache::get(const Resource* resources, size_t count,
     if (size < resource.size) {
       return false;  // Not enough space
     }
-    // Try fetching the resource from the cache.
-    if (getCache(resource, dst)) {
+    advance(resource);
+    // Try fetching the resource from the cache, then from the resources
+    // fetched ahead.
+    bool hit = getCache(resource, dst);
+    if (hit) {
+      if (conn != nullptr) {
+        conn->stats().resourceCacheHits++;
+      }
+    } else if (getStaged(resource, dst)) {
+      putCache(resource, dst);
+      if (conn != nullptr) {
+        conn->stats().resourceLookaheadHits++;
+      }
+      hit = true;
+    }
+    if (hit) {
       // In cache. Flush the pending requests.
       // Note: This implementation can result in many round trips to the
       // GAPIS, because whenever a cache hit happens, all the pending
@@ -56,11 +120,96 @@ bool ResourceCache::get(const Resource* resources, size_t count,
       // Not in cache.
       // Add this to the batch we need to request from the fallback provider.
       batch.append(resource);
+      mLookaheadActive = mLookaheadCount > 0 && !mSchedule.empty();
     }
     dst += resource.size;
     size -= resource.size;
   }
-  return batch.flush(*this, conn);
+  if (!batch.flush(*this, conn)) {
+    return false;
+  }
+  // The lookahead request is only made once the misses of this call have been
+  // fetched, so that they don't queue up behind it.
+  if (mLookaheadActive) {
+    lookahead(conn);
+  }
+  return true;
+}
+
+void ResourceCache::advance(const Resource& resource) {
+  // Resources are normally loaded in the scheduled order. Otherwise look for
+  // the resource a limited distance ahead, keeping the cursor if not found.
+  size_t end =
+      std::min(mSchedule.size(), mScheduleCursor + kScheduleSearchLimit);
+  for (size_t i = mScheduleCursor; i < end; i++) {
+    if (mSchedule[i].id == resource.id) {
+      mScheduleCursor = i + 1;
+      return;
+    }
+  }
+}
+
+bool ResourceCache::getStaged(const Resource& resource, void* data) {
+  auto it = mStaged.find(resource.id);
+  if (it == mStaged.end()) {
+    return false;
+  }
+  Staged staged = std::move(it->second);
+  mStaged.erase(it);
+  mStagedBytes -= resource.size;
+
+  GAPID_TRACE_NAME("ResourceCache::getStaged");
+  if (!staged.fetch->done.get()) {
+    return false;  // The lookahead request failed.
+  }
+  memcpy(data, staged.fetch->data.data() + staged.offset, resource.size);
+  return true;
+}
+
+void ResourceCache::lookahead(ReplayConnection* conn) {
+  // Wait for half of the staged resources to be loaded, so that the requests
+  // don't degrade into one round trip per resource.
+  if (conn == nullptr || mStaged.size() > mLookaheadCount / 2) {
+    return;
+  }
+  if (mScheduleScanned < mScheduleCursor) {
+    mScheduleScanned = mScheduleCursor;
+  }
+
+  auto fetch = std::make_shared<Fetch>();
+  size_t fetchSize = 0;
+  while (mScheduleScanned < mSchedule.size() &&
+         mStaged.size() < mLookaheadCount) {
+    const Resource& resource = mSchedule[mScheduleScanned];
+    if (resource.size <= mLookaheadBytes) {
+      if (mStagedBytes + resource.size > mLookaheadBytes) {
+        break;  // Out of budget until staged resources are loaded.
+      }
+      if (mStaged.count(resource.id) == 0 && !hasCache(resource)) {
+        mStaged[resource.id] = Staged{fetch, fetchSize};
+        mStagedBytes += resource.size;
+        fetch->resources.push_back(resource);
+        fetchSize += resource.size;
+      }
+    }  // Resources larger than the budget are left to be fetched on use.
+    mScheduleScanned++;
+  }
+  if (fetch->resources.empty()) {
+    return;
+  }
+
+  GAPID_TRACE_INT("ResourceCache::lookahead count",
+                  static_cast<int32_t>(fetch->resources.size()));
+  fetch->data.resize(fetchSize);
+  fetch->done = fetch->result.get_future().share();
+  ResourceProvider* provider = mFallbackProvider.get();
+  mLookaheadWorker.enqueue(0, [provider, conn, fetch] {
+    GAPID_TRACE_NAME("ResourceCache::lookahead");
+    fetch->result.set_value(provider->get(fetch->resources.data(),
+                                          fetch->resources.size(), conn,
+                                          fetch->data.data(),
+                                          fetch->data.size()));
+  });
 }
 
 ResourceCache::Batch::Batch(void* target, size_t size)
@@ -88,6 +237,8 @@ bool ResourceCache::Batch::flush(ResourceCache& cache, ReplayConnection* conn) {
   if (count == 0) {
     return true;
   }
+  GAPID_TRACE_NAME("ResourceCache::fetch");
+  GAPID_TRACE_INT("ResourceCache::fetch count", static_cast<int32_t>(count));
   if (!cache.mFallbackProvider->get(mResources.data(), count, conn, ptr,
                                     mSize)) {
     return false;
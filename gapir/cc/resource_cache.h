@@ -19,10 +19,15 @@
 
 #include "resource_provider.h"
 
+#include <stdint.h>
+
+#include <future>
 #include <memory>
+#include <unordered_map>
 #include <vector>
 
 #include "replay_connection.h"
+#include "thread_pool.h"
 
 namespace gapir {
 
@@ -38,9 +43,34 @@ class ResourceCache : public ResourceProvider {
   bool get(const Resource* resources, size_t count, ReplayConnection* conn,
            void* target, size_t size) override;
 
+  // setSchedule sets the resources in the order they will be loaded with get.
+  // The schedule is used for fetching resources ahead of their use, and by
+  // the caches that evict based on the future resource loads.
+  void setSchedule(std::vector<Resource> schedule);
+
+  // setLookahead enables fetching resources ahead of their use. Once a
+  // resource misses the cache, the next resources of the schedule that are
+  // not cached are requested from the fallback provider on a background
+  // thread, at most maxCount resources and maxBytes bytes at a time, while the
+  // replay continues.
+  void setLookahead(size_t maxCount, size_t maxBytes);
+
  protected:
   virtual void putCache(const Resource& resource, const void* data) = 0;
   virtual bool getCache(const Resource& resource, void* data) = 0;
+  // hasCache returns true if the resource is in the cache.
+  virtual bool hasCache(const Resource& resource) = 0;
+
+  // kNoUse is the nextUse of resources that are not loaded again.
+  static const size_t kNoUse = SIZE_MAX;
+
+  // nextUse returns the schedule index of the next load of the resource
+  // with the given id, not counting the load in progress, or kNoUse if the
+  // resource is not loaded again.
+  size_t nextUse(const ResourceId& id);
+
+  // hasSchedule returns true if a non-empty schedule has been set.
+  inline bool hasSchedule() const { return !mSchedule.empty(); }
 
   // Fall back resource provider for the cases when the requested resource is
   // not in the cache.
@@ -72,6 +102,57 @@ class ResourceCache : public ResourceProvider {
     size_t mSize;                      // Target buffer size.
     size_t mSpace;  // mSize - size of all resources in batch.
   };
+
+ private:
+  // Fetch is a request for resources made ahead of their use.
+  struct Fetch {
+    std::vector<Resource> resources;  // The requested resources.
+    std::vector<uint8_t> data;        // The data of the requested resources.
+    std::promise<bool> result;        // Set once the request has completed.
+    std::shared_future<bool> done;    // The future of result.
+  };
+
+  // Staged is a resource fetched ahead that has not been loaded yet.
+  struct Staged {
+    std::shared_ptr<Fetch> fetch;  // The fetch holding the resource.
+    size_t offset;                 // The offset of the data in fetch->data.
+  };
+
+  // Uses holds the schedule indices of the loads of a resource.
+  struct Uses {
+    std::vector<size_t> indices;  // In increasing order.
+    size_t next;                  // The first element not before the cursor.
+  };
+
+  // advance moves the schedule cursor past the resource being loaded.
+  void advance(const Resource& resource);
+
+  // getStaged loads the resource fetched ahead into data, waiting for the
+  // fetch to complete if needed. Returns false if the resource was not fetched
+  // ahead or the fetch failed.
+  bool getStaged(const Resource& resource, void* data);
+
+  // lookahead requests the next scheduled resources that are not cached, if
+  // enough of the previously fetched ones have been loaded.
+  void lookahead(ReplayConnection* conn);
+
+  std::vector<Resource> mSchedule;  // Resources in the order of loading.
+  size_t mScheduleCursor;   // Index of the next resource expected by get.
+  size_t mScheduleScanned;  // Index of the next resource to fetch ahead.
+  size_t mLookaheadCount;   // Maximum number of staged resources.
+  size_t mLookaheadBytes;   // Maximum size in bytes of the staged resources.
+  bool mLookaheadActive;    // True once a scheduled resource missed the cache.
+
+  // The uses of each resource of the schedule.
+  std::unordered_map<ResourceId, Uses> mUses;
+
+  // The resources fetched ahead that have not been loaded yet.
+  std::unordered_map<ResourceId, Staged> mStaged;
+  size_t mStagedBytes;  // Sum of the sizes of the resources in mStaged.
+
+  // The thread making the lookahead requests. Declared last so that pending
+  // requests complete before any other member is destroyed.
+  ThreadPool mLookaheadWorker;
 };
 
 }  // namespace gapir
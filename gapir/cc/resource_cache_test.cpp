@@ -0,0 +1,194 @@
+/*
+ * Copyright (C) 2018 Google Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *      http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "memory_manager.h"
+#include "mock_replay_connection.h"
+#include "replay_connection.h"
+#include "resource_in_memory_cache.h"
+#include "resource_requester.h"
+#include "test_utilities.h"
+
+#include <gmock/gmock.h>
+#include <gtest/gtest.h>
+
+#include <climits>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "gapir/replay_service/service.pb.h"
+
+using namespace ::testing;
+
+namespace gapir {
+namespace test {
+namespace {
+
+const uint32_t MEMORY_SIZE = 4096;
+const uint32_t RESOURCE_SIZE = 64;
+
+// The data of a resource is the first byte of its id repeated.
+std::vector<uint8_t> dataFor(const Resource& resource) {
+  return std::vector<uint8_t>(resource.size, resource.id.data[0]);
+}
+
+class ResourceCacheTest : public Test {
+ protected:
+  virtual void SetUp() {
+    std::vector<uint64_t> memorySizes = {MEMORY_SIZE};
+    mMemoryManager.reset(new MemoryManager(memorySizes));
+    mMemoryManager->setVolatileMemory(MEMORY_SIZE);
+    mConn.reset(new MockReplayConnection());
+
+    // ResourceInMemoryCache -> ResourceRequester -> MockReplayConnection.
+    // The cache is left empty, so every resource misses the cache.
+    mCache = ResourceInMemoryCache::create(ResourceRequester::create(),
+                                           mMemoryManager->getBaseAddress());
+  }
+
+  // createSchedule returns count resources, each loaded once.
+  std::vector<Resource> createSchedule(size_t count) {
+    std::vector<Resource> schedule;
+    for (size_t i = 0; i < count; i++) {
+      schedule.emplace_back(
+          resourceId(char('a' + i % 26) + std::to_string(i)), RESOURCE_SIZE);
+      mSizes[schedule.back().id] = RESOURCE_SIZE;
+    }
+    return schedule;
+  }
+
+  // serve answers the resource requests with the data of the requested
+  // resources. Requests with more than failAbove resources fail.
+  void serve(int failAbove = INT_MAX) {
+    EXPECT_CALL(*mConn, mockedGetResources(NotNull()))
+        .WillRepeatedly(Invoke([this, failAbove](
+                                   ReplayConnection::ResourceRequest* req)
+                                   -> std::unique_ptr<
+                                       ReplayConnection::Resources> {
+          auto p = std::unique_ptr<replay_service::ResourceRequest>(
+              req->release_to_proto());
+          {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mRequestSizes.push_back(p->expected_total_size());
+          }
+          if (p->ids_size() > failAbove) {
+            return nullptr;
+          }
+          std::vector<uint8_t> data;
+          for (const auto& bytesId : p->ids()) {
+            auto id = resourceId(bytesId);
+            auto bytes = dataFor(Resource(id, mSizes.at(id)));
+            data.insert(data.end(), bytes.begin(), bytes.end());
+          }
+          return createResources(data);
+        }));
+  }
+
+  // loadAll loads the resources of the schedule one by one, as the replay
+  // would, and checks their data.
+  void loadAll(const std::vector<Resource>& schedule) {
+    for (const auto& resource : schedule) {
+      std::vector<uint8_t> got(resource.size);
+      EXPECT_TRUE(
+          mCache->get(&resource, 1, mConn.get(), got.data(), got.size()));
+      EXPECT_EQ(dataFor(resource), got) << resource.id.string();
+    }
+  }
+
+  std::unique_ptr<MemoryManager> mMemoryManager;
+  std::unique_ptr<MockReplayConnection> mConn;
+  std::unique_ptr<ResourceInMemoryCache> mCache;
+  std::unordered_map<ResourceId, uint32_t> mSizes;
+  std::mutex mMutex;  // Guards mRequestSizes.
+  std::vector<uint64_t> mRequestSizes;
+};
+
+}  // anonymous namespace
+
+TEST_F(ResourceCacheTest, NoLookahead) {
+  auto schedule = createSchedule(16);
+  serve();
+  loadAll(schedule);
+  EXPECT_EQ(16, mRequestSizes.size());
+}
+
+TEST_F(ResourceCacheTest, LookaheadBatchesMisses) {
+  auto schedule = createSchedule(64);
+  mCache->setSchedule(schedule);
+  mCache->setLookahead(16, 1024 * 1024);
+  serve();
+  loadAll(schedule);
+  // One request for the first miss, then one per half of the lookahead.
+  EXPECT_LE(mRequestSizes.size(), 1 + 64 / 8);
+  EXPECT_EQ(63, mConn->stats().resourceLookaheadHits);
+}
+
+TEST_F(ResourceCacheTest, LookaheadByteBudget) {
+  auto schedule = createSchedule(32);
+  mCache->setSchedule(schedule);
+  mCache->setLookahead(16, 4 * RESOURCE_SIZE);
+  serve();
+  loadAll(schedule);
+  for (auto size : mRequestSizes) {
+    EXPECT_LE(size, 4 * RESOURCE_SIZE);
+  }
+  EXPECT_LT(mRequestSizes.size(), 32);
+}
+
+TEST_F(ResourceCacheTest, LookaheadRepeatedResources) {
+  auto resources = createSchedule(8);
+  std::vector<Resource> schedule;
+  for (int i = 0; i < 4; i++) {
+    schedule.insert(schedule.end(), resources.begin(), resources.end());
+  }
+  mCache->setSchedule(schedule);
+  mCache->setLookahead(16, 1024 * 1024);
+  serve();
+  loadAll(schedule);
+}
+
+TEST_F(ResourceCacheTest, FailedLookaheadFallsBack) {
+  auto schedule = createSchedule(32);
+  mCache->setSchedule(schedule);
+  mCache->setLookahead(16, 1024 * 1024);
+  serve(1);
+  loadAll(schedule);
+}
+
+TEST_F(ResourceCacheTest, LookaheadRoundTrips) {
+  const size_t count = 256;
+  auto schedule = createSchedule(count);
+  serve();
+
+  loadAll(schedule);
+  auto syncRequests = mRequestSizes.size();
+
+  mCache = ResourceInMemoryCache::create(ResourceRequester::create(),
+                                         mMemoryManager->getBaseAddress());
+  mCache->setSchedule(schedule);
+  mCache->setLookahead(64, 1024 * 1024);
+  mRequestSizes.clear();
+  loadAll(schedule);
+  auto lookaheadRequests = mRequestSizes.size();
+
+  EXPECT_EQ(count, syncRequests);
+  EXPECT_LT(lookaheadRequests * 8, syncRequests);
+}
+
+}  // namespace test
+}  // namespace gapir
@@ -105,4 +105,8 @@ bool ResourceDiskCache::getCache(const Resource& resource, void* data) {
   return mArchive.read(resource.id, data, resource.size);
 }
 
+bool ResourceDiskCache::hasCache(const Resource& resource) {
+  return mArchive.contains(resource.id);
+}
+
 }  // namespace gapir
@@ -43,6 +43,7 @@ class ResourceDiskCache : public ResourceCache {
  protected:
   void putCache(const Resource& resource, const void* data) override;
   bool getCache(const Resource& resource, void* data) override;
+  bool hasCache(const Resource& resource) override;
 
  private:
   ResourceDiskCache(std::unique_ptr<ResourceProvider> fallbackProvider,
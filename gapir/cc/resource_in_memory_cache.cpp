@@ -18,6 +18,7 @@
 #include "replay_connection.h"
 
 #include "core/cc/assert.h"
+#include "core/cc/trace.h"
 
 #include <string.h>
 
@@ -29,14 +30,17 @@
 namespace gapir {
 
 std::unique_ptr<ResourceInMemoryCache> ResourceInMemoryCache::create(
-    std::unique_ptr<ResourceProvider> fallbackProvider, void* buffer) {
+    std::unique_ptr<ResourceProvider> fallbackProvider, void* buffer,
+    EvictionPolicy policy) {
   return std::unique_ptr<ResourceInMemoryCache>(
-      new ResourceInMemoryCache(std::move(fallbackProvider), buffer));
+      new ResourceInMemoryCache(std::move(fallbackProvider), buffer, policy));
 }
 
 ResourceInMemoryCache::ResourceInMemoryCache(
-    std::unique_ptr<ResourceProvider> fallbackProvider, void* buffer)
+    std::unique_ptr<ResourceProvider> fallbackProvider, void* buffer,
+    EvictionPolicy policy)
     : ResourceCache(std::move(fallbackProvider)),
+      mPolicy(policy),
       mHead(new Block(0, 0)),
       mBuffer(static_cast<uint8_t*>(buffer)),
       mBufferSize(0) {}
@@ -54,6 +58,7 @@ void ResourceInMemoryCache::prefetch(const Resource* resources, size_t count,
   if (temp == nullptr) {
     return;
   }
+  GAPID_TRACE_NAME("ResourceInMemoryCache::prefetch");
   GAPID_DEBUG(
       "ResourceInMemoryCache::prefetch(count: %zu, mBufferSize: %zu, tempSize: "
       "%zu)",
@@ -65,6 +70,10 @@ void ResourceInMemoryCache::prefetch(const Resource* resources, size_t count,
     if (space < resource.size) {
       break;
     }
+    if (mPolicy == EvictionPolicy::BELADY && hasSchedule() &&
+        nextUse(resource.id) == kNoUse) {
+      continue;  // Never loaded, it would not be cached.
+    }
     space -= resource.size;
     if (mCache.find(resource.id) != mCache.end()) {
       continue;
@@ -143,7 +152,7 @@ void ResourceInMemoryCache::dump(FILE* out) {
     if (block->isFree()) {
       fprintf(out, "┃ free           ");
     } else {
-      fprintf(out, "┃ id: %10.10s ", block->id.c_str());
+      fprintf(out, "┃ id: %10.10s ", block->id.string().c_str());
     }
   });
   fprintf(out, "┃\n");
@@ -162,6 +171,10 @@ void ResourceInMemoryCache::putCache(const Resource& resource,
   if (resource.size > mBufferSize) {
     return;  // Wouldn't fit even if everything was evicted.
   }
+  if (mPolicy == EvictionPolicy::BELADY) {
+    putBelady(resource, data);
+    return;
+  }
 
   // Merge mHead into next block(s) until it is big enough to hold our resource.
   while (mHead->size < resource.size) {
@@ -219,4 +232,130 @@ bool ResourceInMemoryCache::getCache(const Resource& resource, void* data) {
   return true;
 }
 
+bool ResourceInMemoryCache::hasCache(const Resource& resource) {
+  return mCache.count(resource.id) > 0;
+}
+
+void ResourceInMemoryCache::putBelady(const Resource& resource,
+                                      const void* data) {
+  if (resource.size == 0 || mCache.count(resource.id) > 0) {
+    return;
+  }
+  // Without a schedule all resources are considered to be used next.
+  size_t use = hasSchedule() ? nextUse(resource.id) : 0;
+  if (use == kNoUse) {
+    return;  // Not loaded again.
+  }
+
+  Block* block = findSpace(resource.size);
+  if (block == nullptr) {
+    // Pick the blocks to evict, furthest next use first. Only the blocks used
+    // later than this resource are worth evicting.
+    std::vector<std::pair<size_t, Block*>> candidates;
+    size_t space = 0;
+    foreach_block(first(), [&](Block* b) {
+      if (b->isFree()) {
+        space += b->size;
+      } else if (hasSchedule()) {
+        size_t blockUse = nextUse(b->id);
+        if (blockUse > use) {
+          candidates.emplace_back(blockUse, b);
+        }
+      }
+    });
+    std::sort(candidates.begin(), candidates.end(),
+              [](const std::pair<size_t, Block*>& a,
+                 const std::pair<size_t, Block*>& b) {
+                return a.first > b.first;
+              });
+    size_t count = 0;
+    while (space < resource.size && count < candidates.size()) {
+      space += candidates[count++].second->size;
+    }
+    if (space < resource.size) {
+      return;  // Cheaper to fetch this resource again than what it evicts.
+    }
+    for (size_t i = 0; i < count; i++) {
+      free(candidates[i].second);
+    }
+    block = findSpace(resource.size);
+    if (block == nullptr) {
+      // The space is fragmented.
+      compact();
+      block = findSpace(resource.size);
+    }
+    GAPID_ASSERT(block != nullptr);
+  }
+
+  if (block->size > resource.size) {
+    // Split the left-over space into a new free block.
+    auto next = new Block(block->offset + resource.size,
+                          block->size - resource.size);
+    next->linkAfter(block);
+    block->size = resource.size;
+  }
+  block->id = resource.id;
+  mCache.emplace(resource.id, block->offset);
+  memcpy(mBuffer + block->offset, data, resource.size);
+}
+
+ResourceInMemoryCache::Block* ResourceInMemoryCache::findSpace(size_t size) {
+  Block* best = nullptr;
+  Block* start = first();
+  Block* block = start;
+  do {
+    if (block->isFree()) {
+      // Merge the following free blocks. Blocks never wrap around the buffer,
+      // so the first block is never merged into the last.
+      while (block->next != start && block->next->isFree() &&
+             block->next->offset == block->end()) {
+        block->size += block->next->size;
+        destroy(block->next);
+      }
+      if (block->size >= size && block->end() <= mBufferSize &&
+          (best == nullptr || block->size < best->size)) {
+        best = block;
+      }
+    }
+    block = block->next;
+  } while (block != start);
+  return best;
+}
+
+void ResourceInMemoryCache::compact() {
+  GAPID_TRACE_NAME("ResourceInMemoryCache::compact");
+  std::vector<Block*> blocks;
+  foreach_block(first(), [&](Block* block) { blocks.push_back(block); });
+  for (Block* block : blocks) {
+    if (block->next != block) {
+      block->unlink();
+    }
+  }
+
+  // Move the cached resources down, in offset order, so they never overlap
+  // a resource that is still to be moved.
+  Block* prev = nullptr;
+  size_t offset = 0;
+  for (Block* block : blocks) {
+    if (block->isFree()) {
+      delete block;
+      continue;
+    }
+    if (block->offset != offset) {
+      memmove(mBuffer + offset, mBuffer + block->offset, block->size);
+      block->offset = offset;
+      mCache[block->id] = offset;
+    }
+    offset += block->size;
+    if (prev != nullptr) {
+      block->linkAfter(prev);
+    }
+    prev = block;
+  }
+  mHead = new Block(offset, mBufferSize - offset);
+  if (prev != nullptr) {
+    mHead->linkAfter(prev);
+  }
+}
+
 }  // namespace gapir
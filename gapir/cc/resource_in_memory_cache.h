@@ -28,15 +28,26 @@
 
 namespace gapir {
 
-// Fixed size in-memory resource cache. It uses a ring buffer to store the cache
-// and starts invalidating cache entries from the oldest to the newest when more
-// space is required.
+// Fixed size in-memory resource cache. With the FIFO eviction policy it uses a
+// ring buffer to store the cache and starts invalidating cache entries from
+// the oldest to the newest when more space is required.
 class ResourceInMemoryCache : public ResourceCache {
  public:
-  // Creates a new in-memory cache with the given fallback provider and base
-  // address. The initial cache size is 0 byte.
+  enum class EvictionPolicy {
+    // Evicts the oldest cache entries first.
+    FIFO,
+    // Evicts the cache entries whose next load in the schedule is the
+    // furthest away, and doesn't cache resources that would be loaded later
+    // than everything they would evict. Without a schedule, resources are
+    // cached until the cache is full and never evicted.
+    BELADY,
+  };
+
+  // Creates a new in-memory cache with the given fallback provider, base
+  // address and eviction policy. The initial cache size is 0 byte.
   static std::unique_ptr<ResourceInMemoryCache> create(
-      std::unique_ptr<ResourceProvider> fallbackProvider, void* buffer);
+      std::unique_ptr<ResourceProvider> fallbackProvider, void* buffer,
+      EvictionPolicy policy = EvictionPolicy::FIFO);
 
   // destructor
   ~ResourceInMemoryCache();
@@ -73,13 +84,14 @@ class ResourceInMemoryCache : public ResourceCache {
 
     size_t offset;  // offset in bytes from mBuffer.
     size_t size;    // size in bytes. May wrap-around the cache buffer.
-    ResourceId id;
+    ResourceId id;  // all zeros when the block is free.
     Block* next;
     Block* prev;
   };
 
   void putCache(const Resource& resource, const void* data) override;
   bool getCache(const Resource& resource, void* data) override;
+  bool hasCache(const Resource& resource) override;
 
   // free evicts the cache entry for block, transforming it into a free block.
   void free(Block* block);
@@ -99,12 +111,28 @@ class ResourceInMemoryCache : public ResourceCache {
  private:
   // constructor
   ResourceInMemoryCache(std::unique_ptr<ResourceProvider> fallbackProvider,
-                        void* buffer);
+                        void* buffer, EvictionPolicy policy);
 
   // put adds the the resource to the cache.
   // size must be less or equal to mBufferSize.
   void put(const ResourceId& id, size_t size, const uint8_t* data);
 
+  // putBelady adds the resource to the cache with the BELADY eviction policy.
+  // With this policy blocks never wrap around the end of the buffer.
+  void putBelady(const Resource& resource, const void* data);
+
+  // findSpace merges the adjacent free blocks and returns the smallest free
+  // block that can hold size bytes without wrapping, or nullptr if there is
+  // none.
+  Block* findSpace(size_t size);
+
+  // compact moves all the cached resources to the start of the buffer,
+  // leaving a single free block at the end.
+  void compact();
+
+  // The eviction policy of the cache.
+  EvictionPolicy mPolicy;
+
   // A pointer to the next block to be used for a resource allocation.
   // While filling the cache, mHead will point to the first free block. Once
   // the cache is full it will point to an existing cache entry that will be
@@ -122,9 +150,9 @@ class ResourceInMemoryCache : public ResourceCache {
 };
 
 inline ResourceInMemoryCache::Block::Block()
-    : offset(0), size(0), next(this), prev(this) {}
+    : offset(0), size(0), id(), next(this), prev(this) {}
 inline ResourceInMemoryCache::Block::Block(size_t offset_, size_t size_)
-    : offset(offset_), size(size_), next(this), prev(this) {}
+    : offset(offset_), size(size_), id(), next(this), prev(this) {}
 inline ResourceInMemoryCache::Block::Block(size_t offset_, size_t size_,
                                            const ResourceId& id_)
     : offset(offset_), size(size_), id(id_), next(this), prev(this) {}
@@ -158,7 +186,7 @@ inline void ResourceInMemoryCache::Block::unlink() {
 }
 
 inline bool ResourceInMemoryCache::Block::isFree() const {
-  return id.size() == 0;
+  return id == ResourceId();
 }
 
 inline size_t ResourceInMemoryCache::Block::end() const {
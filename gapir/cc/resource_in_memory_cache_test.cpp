@@ -23,7 +23,11 @@
 #include <gmock/gmock.h>
 #include <gtest/gtest.h>
 
+#include <string.h>
+
 #include <memory>
+#include <string>
+#include <utility>
 #include <vector>
 
 using namespace ::testing;
@@ -35,17 +39,17 @@ namespace {
 const uint32_t MEMORY_SIZE = 4096;
 const uint32_t CACHE_SIZE = 2048;
 
-const Resource A("A", 64);
-const Resource B("B", 256);
-const Resource C("C", 512);
-const Resource D("D", 1024);
-const Resource E("E", 2048);
-const Resource Z("Z", 1);
+const Resource A(resourceId("A"), 64);
+const Resource B(resourceId("B"), 256);
+const Resource C(resourceId("C"), 512);
+const Resource D(resourceId("D"), 1024);
+const Resource E(resourceId("E"), 2048);
+const Resource Z(resourceId("Z"), 1);
 
 class ResourceInMemoryCacheTest : public Test {
  protected:
   virtual void SetUp() {
-    std::vector<uint32_t> memorySizes = {MEMORY_SIZE};
+    std::vector<uint64_t> memorySizes = {MEMORY_SIZE};
     mMemoryManager.reset(new MemoryManager(memorySizes));
     mMemoryManager->setVolatileMemory(MEMORY_SIZE - CACHE_SIZE);
 
@@ -276,9 +280,12 @@ TEST_F(ResourceInMemoryCacheTest, Resize) {
 TEST_F(ResourceInMemoryCacheTest, CachingLogic) {
   InSequence x;
 
-  Resource A1("A1", 1), B1("B1", 1), C1("C1", 1), D1("D1", 1);
-  Resource E1("E1", 1), F1("F1", 1), G1("G1", 1), H1("H1", 1);
-  Resource A2("A2", 2), B2("B2", 2), C2("C2", 2), D2("D2", 2);
+  Resource A1(resourceId("A1"), 1), B1(resourceId("B1"), 1);
+  Resource C1(resourceId("C1"), 1), D1(resourceId("D1"), 1);
+  Resource E1(resourceId("E1"), 1), F1(resourceId("F1"), 1);
+  Resource G1(resourceId("G1"), 1), H1(resourceId("H1"), 1);
+  Resource A2(resourceId("A2"), 2), B2(resourceId("B2"), 2);
+  Resource C2(resourceId("C2"), 2), D2(resourceId("D2"), 2);
   mResourceInMemoryCache->resize(8);
   // ┏━━━━━━━━━━━━━━━━┓
   // ┃ offset:      0 ┃
@@ -401,9 +408,12 @@ TEST_F(ResourceInMemoryCacheTest, CachingLogic) {
 TEST_F(ResourceInMemoryCacheTest, PrefecthOverrun) {
   InSequence x;
 
-  Resource A1("A1", 1), B1("B1", 1), C1("C1", 1), D1("D1", 1);
-  Resource E1("E1", 1), F1("F1", 1), G1("G1", 1), H1("H1", 1);
-  Resource A2("A2", 2), B2("B2", 2), C2("C2", 2), D2("D2", 2);
+  Resource A1(resourceId("A1"), 1), B1(resourceId("B1"), 1);
+  Resource C1(resourceId("C1"), 1), D1(resourceId("D1"), 1);
+  Resource E1(resourceId("E1"), 1), F1(resourceId("F1"), 1);
+  Resource G1(resourceId("G1"), 1), H1(resourceId("H1"), 1);
+  Resource A2(resourceId("A2"), 2), B2(resourceId("B2"), 2);
+  Resource C2(resourceId("C2"), 2), D2(resourceId("D2"), 2);
   mResourceInMemoryCache->resize(8);
 
   Resource resources1[] = {A1, B1, C1, D1, E1};
@@ -427,5 +437,152 @@ TEST_F(ResourceInMemoryCacheTest, PrefecthOverrun) {
   expectCacheMiss({A1});
 }
 
+namespace {
+
+// CountingResourceProvider is a ResourceProvider that writes the patterns of
+// the resources to the target pointer, and counts the resources and bytes
+// requested.
+class CountingResourceProvider : public ResourceProvider {
+ public:
+  CountingResourceProvider(size_t* count, size_t* bytes)
+      : mCount(count), mBytes(bytes) {}
+
+  bool get(const Resource* resources, size_t count, ReplayConnection* conn,
+           void* target, size_t targetSize) override {
+    auto pattern = PatternedResourceProvider::patternFor(
+        std::vector<Resource>(resources, resources + count));
+    memcpy(target, pattern.data(), pattern.size());
+    *mCount += count;
+    *mBytes += pattern.size();
+    return true;
+  }
+
+  void prefetch(const Resource* resources, size_t count,
+                ReplayConnection* conn, void* temp, size_t tempSize) override {}
+
+ private:
+  size_t* mCount;
+  size_t* mBytes;
+};
+
+// TraceResult is the outcome of loading a trace of resources.
+struct TraceResult {
+  size_t hits;
+  size_t bytesFetched;
+};
+
+// runTrace loads the resources of trace in order through a cache of
+// cacheSize bytes using the given policy, checking the loaded data.
+TraceResult runTrace(ResourceInMemoryCache::EvictionPolicy policy,
+                     size_t cacheSize, const std::vector<Resource>& trace) {
+  std::vector<uint8_t> buffer(cacheSize);
+  size_t fetched = 0;
+  size_t bytes = 0;
+  auto cache = ResourceInMemoryCache::create(
+      std::unique_ptr<ResourceProvider>(
+          new CountingResourceProvider(&fetched, &bytes)),
+      buffer.data(), policy);
+  cache->resize(cacheSize);
+  cache->setSchedule(trace);
+  for (const auto& resource : trace) {
+    std::vector<uint8_t> got(resource.size);
+    EXPECT_TRUE(cache->get(&resource, 1, nullptr, got.data(), got.size()));
+    EXPECT_EQ(PatternedResourceProvider::patternFor({resource}), got)
+        << resource.id.string();
+  }
+  return TraceResult{trace.size() - fetched, bytes};
+}
+
+// compareTrace runs the trace with the FIFO and the Belady policies, and
+// returns their results.
+std::pair<TraceResult, TraceResult> compareTrace(
+    size_t cacheSize, const std::vector<Resource>& trace) {
+  auto fifo =
+      runTrace(ResourceInMemoryCache::EvictionPolicy::FIFO, cacheSize, trace);
+  auto belady =
+      runTrace(ResourceInMemoryCache::EvictionPolicy::BELADY, cacheSize, trace);
+  return std::make_pair(fifo, belady);
+}
+
+}  // anonymous namespace
+
+TEST(ResourceInMemoryCacheBeladyTest, UnusedResourcesAreNotCached) {
+  InSequence x;
+  std::vector<uint8_t> buffer(CACHE_SIZE);
+  auto fallback = new StrictMock<MockResourceProvider>();
+  auto cache = ResourceInMemoryCache::create(
+      std::unique_ptr<ResourceProvider>(new PatternedResourceProvider(
+          std::unique_ptr<ResourceProvider>(fallback))),
+      buffer.data(), ResourceInMemoryCache::EvictionPolicy::BELADY);
+  cache->resize(D.size);
+  cache->setSchedule({D, C, D, C});
+
+  std::vector<uint8_t> got(D.size);
+  // D fills the cache. C is loaded again after D, so it isn't cached.
+  EXPECT_CALL(*fallback, get(_, 1, _, _, D.size)).WillOnce(Return(true));
+  EXPECT_TRUE(cache->get(&D, 1, nullptr, got.data(), D.size));
+  EXPECT_CALL(*fallback, get(_, 1, _, _, C.size)).WillOnce(Return(true));
+  EXPECT_TRUE(cache->get(&C, 1, nullptr, got.data(), C.size));
+  EXPECT_TRUE(cache->get(&D, 1, nullptr, got.data(), D.size));
+  // D is not loaded again, so C replaces it.
+  EXPECT_CALL(*fallback, get(_, 1, _, _, C.size)).WillOnce(Return(true));
+  EXPECT_TRUE(cache->get(&C, 1, nullptr, got.data(), C.size));
+}
+
+TEST(ResourceInMemoryCacheBeladyTest, ReusedTexturesTrace) {
+  // Every frame uses the same four textures, and streams in new vertex data.
+  std::vector<Resource> textures;
+  for (int i = 0; i < 4; i++) {
+    textures.emplace_back(resourceId("texture" + std::to_string(i)), 256);
+  }
+  std::vector<Resource> trace;
+  for (int frame = 0; frame < 32; frame++) {
+    for (int i = 0; i < 6; i++) {
+      trace.emplace_back(resourceId("v" + std::to_string(frame) + "_" +
+                                    std::to_string(i)),
+                         96);
+      trace.push_back(textures[i % textures.size()]);
+    }
+  }
+  auto results = compareTrace(1536, trace);
+  EXPECT_LT(results.first.hits, results.second.hits);
+  EXPECT_EQ(trace.size() / 2 - textures.size(), results.second.hits);
+}
+
+TEST(ResourceInMemoryCacheBeladyTest, LoopTrace) {
+  // A loop over slightly more resources than fit in the cache.
+  std::vector<Resource> loop;
+  for (int i = 0; i < 10; i++) {
+    loop.emplace_back(resourceId("R" + std::to_string(i)), 100 + i * 10);
+  }
+  std::vector<Resource> trace;
+  for (int i = 0; i < 20; i++) {
+    trace.insert(trace.end(), loop.begin(), loop.end());
+  }
+  auto results = compareTrace(1200, trace);
+  EXPECT_EQ(0, results.first.hits);
+  EXPECT_GT(results.second.hits, trace.size() / 2);
+}
+
+TEST(ResourceInMemoryCacheBeladyTest, SkewedRandomTrace) {
+  // Random loads of resources of varied sizes, where a few resources make up
+  // most of the loads.
+  std::vector<Resource> resources;
+  for (int i = 0; i < 64; i++) {
+    resources.emplace_back(resourceId("R" + std::to_string(i)),
+                           32 + (i * 37) % 480);
+  }
+  std::vector<Resource> trace;
+  uint32_t seed = 1;
+  for (int i = 0; i < 4000; i++) {
+    seed = seed * 1103515245 + 12345;
+    uint32_t r = (seed >> 16) % 1024;
+    trace.push_back(resources[(r * r) / (1024 * 1024 / 64)]);
+  }
+  auto results = compareTrace(CACHE_SIZE, trace);
+  EXPECT_GT(results.second.hits, results.first.hits);
+  EXPECT_LT(results.second.bytesFetched, results.first.bytesFetched);
+}
+
 }  // namespace test
 }  // namespace gapir
@@ -17,6 +17,8 @@
 #include "resource_requester.h"
 #include "replay_connection.h"
 
+#include "core/cc/trace.h"
+
 #include <cstring>
 #include <memory>
 #include <vector>
@@ -35,6 +37,7 @@ bool ResourceRequester::get(const Resource* resources, size_t count,
   if (conn == nullptr) {
     return false;  // no replay connection to get data.
   }
+  GAPID_TRACE_NAME("ResourceRequester::get");
   size_t requestSize = 0;
   std::unique_ptr<ReplayConnection::ResourceRequest> req =
       ReplayConnection::ResourceRequest::create();
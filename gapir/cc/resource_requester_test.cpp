@@ -35,8 +35,8 @@ namespace gapir {
 namespace test {
 namespace {
 
-const Resource A("A", 3);
-const Resource B("B", 5);
+const Resource A(resourceId("A"), 3);
+const Resource B(resourceId("B"), 5);
 
 class ResourceRequesterTest : public Test {
  protected:
@@ -64,7 +64,7 @@ TEST_F(ResourceRequesterTest, SingleGet) {
             req->release_to_proto());
         EXPECT_EQ(p->expected_total_size(), A.size);
         EXPECT_EQ(p->ids_size(), 1);
-        EXPECT_EQ(p->ids(0), A.id);
+        EXPECT_EQ(resourceId(p->ids(0)), A.id);
         return std::move(res);
       }));
   EXPECT_TRUE(mResourceProvider->get(&A, 1, mConn.get(), mBuffer.data(), 3));
@@ -83,8 +83,8 @@ TEST_F(ResourceRequesterTest, MultiGet) {
             req->release_to_proto());
         EXPECT_EQ(p->expected_total_size(), A.size + B.size);
         EXPECT_EQ(p->ids_size(), 2);
-        EXPECT_EQ(p->ids(0), A.id);
-        EXPECT_EQ(p->ids(1), B.id);
+        EXPECT_EQ(resourceId(p->ids(0)), A.id);
+        EXPECT_EQ(resourceId(p->ids(1)), B.id);
         return std::move(res);
       }));
 
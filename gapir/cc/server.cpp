@@ -68,7 +68,16 @@ Status GapirServiceImpl::Replay(ServerContext* context, ReplayStream* stream) {
       std::unique_ptr<ReplayConnection> replay_conn =
           ReplayConnection::create(stream);
       if (replay_conn != nullptr) {
+        replay_conn->stats().replayId = req.replay_id();
         mHandleReplay(replay_conn.get(), req.replay_id());
+        replay_conn->sendReplayFinished();
+
+        std::lock_guard<std::mutex> lock(mReplayStatsMutex);
+        mReplayStats.emplace_back();
+        replay_conn->stats().toProto(&mReplayStats.back());
+        if (mReplayStats.size() > kMaxReplayStats) {
+          mReplayStats.pop_front();
+        }
       }
     }
   }
@@ -99,6 +108,20 @@ Status GapirServiceImpl::Shutdown(ServerContext* context,
   return Status::OK;
 }
 
+Status GapirServiceImpl::Stats(ServerContext* context,
+                               const replay_service::StatsRequest*,
+                               replay_service::StatsResponse* res) {
+  if (!CheckAuthToken(context, mAuthToken)) {
+    return Status(grpc::StatusCode::UNAUTHENTICATED,
+                  grpc::string("Invalid auth token"));
+  }
+  std::lock_guard<std::mutex> lock(mReplayStatsMutex);
+  for (const auto& stats : mReplayStats) {
+    *res->add_replays() = stats;
+  }
+  return Status::OK;
+}
+
 Server::Server(const char* authToken, int idleTimeoutSec,
                ReplayHandler handle_replay)
     : mSecCounter(0),
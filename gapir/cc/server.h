@@ -19,8 +19,10 @@
 
 #include <grpc++/grpc++.h>
 #include <atomic>
+#include <deque>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <thread>
 
@@ -60,8 +62,14 @@ class GapirServiceImpl final : public replay_service::Gapir::Service {
   grpc::Status Shutdown(grpc::ServerContext* context,
                         const replay_service::ShutdownRequest*,
                         replay_service::ShutdownResponse*) override;
+  grpc::Status Stats(grpc::ServerContext* context,
+                     const replay_service::StatsRequest*,
+                     replay_service::StatsResponse* res) override;
 
  private:
+  // The number of most recent replays returned by Stats.
+  static const size_t kMaxReplayStats = 16;
+
   GapirServiceImpl(const char* authToken, ReplayHandler handle_replay,
                    WatchDogFeeder feed_watchdog)
       : mHandleReplay(handle_replay),
@@ -78,6 +86,10 @@ class GapirServiceImpl final : public replay_service::Gapir::Service {
   grpc::Server* mGrpcServer;
   // The authentication token to be used for checking every request.
   std::string mAuthToken;
+  // The stats of the most recent replays, oldest first.
+  std::deque<replay_service::ReplayStats> mReplayStats;
+  // Guards mReplayStats.
+  std::mutex mReplayStatsMutex;
 };
 
 // Server setups a listening port and processes the replay request sent from
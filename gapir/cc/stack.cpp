@@ -53,6 +53,21 @@ bool Stack::popCheck(const char* what) {
   return true;
 }
 
+bool Stack::popCheck(const char* what, uint32_t count) {
+  if (!mValid) {
+    GAPID_WARNING("%s on invalid stack", what);
+    return false;
+  }
+
+  if (count > mTop || mTop > mStack.size()) {
+    mValid = false;
+    GAPID_WARNING("%s of %u elements with invalid stack head, offset: %d",
+                  what, count, mTop);
+    return false;
+  }
+  return true;
+}
+
 const char* Stack::Entry::debugInfo(const MemoryManager* memoryManager) const {
   static const size_t size = 256;
   static char buf[size];
@@ -100,22 +115,26 @@ const char* Stack::Entry::debugInfo(const MemoryManager* memoryManager) const {
       break;
     }
     case BaseType::ConstantPointer: {
-      uint32_t offset = value<uint32_t>();
+      uint64_t offset = pointerOffset();
       const void* pointer = memoryManager->constantToAbsolute(offset);
       if (memoryManager->isConstantAddress(pointer)) {
-        snprintf(buf, size, "constant-ptr<0x%x> valid (%p)", offset, pointer);
+        snprintf(buf, size, "constant-ptr<0x%" PRIx64 "> valid (%p)", offset,
+                 pointer);
       } else {
-        snprintf(buf, size, "constant-ptr<0x%x> INVALID (%p)", offset, pointer);
+        snprintf(buf, size, "constant-ptr<0x%" PRIx64 "> INVALID (%p)", offset,
+                 pointer);
       }
       break;
     }
     case BaseType::VolatilePointer: {
-      uint32_t offset = value<uint32_t>();
+      uint64_t offset = pointerOffset();
       const void* pointer = memoryManager->volatileToAbsolute(offset);
       if (memoryManager->isVolatileAddress(pointer)) {
-        snprintf(buf, size, "volatile-ptr<0x%x> valid (%p)", offset, pointer);
+        snprintf(buf, size, "volatile-ptr<0x%" PRIx64 "> valid (%p)", offset,
+                 pointer);
       } else {
-        snprintf(buf, size, "volatile-ptr<0x%x> INVALID (%p)", offset, pointer);
+        snprintf(buf, size, "volatile-ptr<0x%" PRIx64 "> INVALID (%p)", offset,
+                 pointer);
       }
       break;
     }
@@ -237,16 +256,20 @@ void Stack::clone(uint32_t n) {
 }
 
 const void* Stack::checkAndGetTopPointer(const char* what) {
-  auto type = mStack[mTop].type();
+  return checkAndGetPointer(mStack[mTop], what);
+}
+
+const void* Stack::checkAndGetPointer(const Entry& entry, const char* what) {
+  auto type = entry.type();
   switch (type) {
     case BaseType::AbsolutePointer: {
-      return mStack[mTop].value<const void*>();
+      return entry.value<const void*>();
     }
     case BaseType::ConstantPointer: {
-      uint32_t offset = mStack[mTop].value<uint32_t>();
+      uint64_t offset = entry.pointerOffset();
       const void* pointer = mMemoryManager->constantToAbsolute(offset);
       if (!mMemoryManager->isConstantAddress(pointer)) {
-        GAPID_WARNING("%s: Invalid constant address %p offset 0x%x", what,
+        GAPID_WARNING("%s: Invalid constant address %p offset 0x%" PRIx64, what,
                       pointer, offset);
         mValid = false;
         return nullptr;
@@ -254,10 +277,10 @@ const void* Stack::checkAndGetTopPointer(const char* what) {
       return pointer;
     }
     case BaseType::VolatilePointer: {
-      uint32_t offset = mStack[mTop].value<uint32_t>();
+      uint64_t offset = entry.pointerOffset();
       void* pointer = mMemoryManager->volatileToAbsolute(offset);
       if (!mMemoryManager->isVolatileAddress(pointer)) {
-        GAPID_WARNING("%s Invalid volatile address %p offset 0x%x", what,
+        GAPID_WARNING("%s Invalid volatile address %p offset 0x%" PRIx64, what,
                       pointer, offset);
         mValid = false;
         return nullptr;
@@ -273,6 +296,23 @@ const void* Stack::checkAndGetTopPointer(const char* what) {
   return nullptr;
 }
 
+bool Stack::checkSignature(const Entry* entries, const BaseType* expected,
+                           uint32_t count) {
+  for (uint32_t i = 0; i < count; i++) {
+    BaseType type = entries[i].type();
+    if (type != expected[i] && !(expected[i] == BaseType::AbsolutePointer &&
+                                 isPointerType(type))) {
+      mValid = false;
+      GAPID_WARNING(
+          "popFrame argument %u type (%s) doesn't match with the type in the "
+          "stack (%s)",
+          i, baseTypeName(expected[i]), baseTypeName(type));
+      return false;
+    }
+  }
+  return true;
+}
+
 bool Stack::checkTopForInvalidPointer(const char* what) {
   auto type = mStack[mTop].type();
   switch (type) {
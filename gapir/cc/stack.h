@@ -26,9 +26,17 @@
 #include <stdint.h>
 #include <string.h>
 
+#include <tuple>
 #include <type_traits>
 #include <vector>
 
+// When GAPIR_VALIDATE_EACH_POP is non-zero, popFrame() pops, validates and
+// logs each argument individually with pop() instead of validating the whole
+// frame at once. This is slower, but pinpoints the offending argument.
+#ifndef GAPIR_VALIDATE_EACH_POP
+#define GAPIR_VALIDATE_EACH_POP 0
+#endif
+
 namespace gapir {
 
 // Strongly typed, limited size stack for the stack based virtual machine. If an
@@ -70,6 +78,34 @@ class Stack {
     return out;
   }
 
+  // Pop a whole frame of function arguments from the top of the stack and
+  // return them as a tuple. The last type of Args corresponds to the element
+  // at the top of the stack, so the tuple holds the arguments in call order.
+  // The stack depth is checked once for the whole frame, and the element types
+  // are validated against the frame's Signature in a single pass. Pointer
+  // arguments accept any of the pointer base types and are converted to
+  // absolute pointers. Puts the stack into an invalid state if the stack holds
+  // fewer elements than the frame, or if any of the types do not match.
+  template <typename... Args>
+  std::tuple<Args...> popFrame() {
+    std::tuple<Args...> frame;
+    const uint32_t count = sizeof...(Args);
+#if GAPIR_VALIDATE_EACH_POP
+    popEach<count>(&frame);
+#else   // GAPIR_VALIDATE_EACH_POP
+    if (!popCheck("popFrame", count)) {
+      return frame;
+    }
+    const Entry* entries = &mStack[mTop - count];
+    if (!checkSignature(entries, Signature<Args...>::types, count)) {
+      return frame;
+    }
+    mTop -= count;
+    unpack<0>(entries, &frame);
+#endif  // GAPIR_VALIDATE_EACH_POP
+    return frame;
+  }
+
   // Pop the volatile pointer from the top of the stack. If the top element
   // is not a volatile pointer puts the stack into and invalid state. Also,
   // puts the stack into an invalid state if called on an empty stack.
@@ -169,6 +205,9 @@ class Stack {
   // Returns if the stack is in a valid state or not.
   bool isValid() const { return mValid; }
 
+  // Returns the number of elements on the stack.
+  uint32_t size() const { return mTop; }
+
   // Pop the item from the top of the stack to the given memory address. The
   // number of bytes written to the address is determined by the type of the
   // element at the top of the stack. Pointers are converted to absolute
@@ -186,6 +225,8 @@ class Stack {
  private:
   // Check that the stack is valid and a pop is allowed (non-empty).
   bool popCheck(const char* what);
+  // Check that the stack is valid and holds at least count elements.
+  bool popCheck(const char* what, uint32_t count);
   // Check that the stack is valid and a push is allowed (non-full).
   bool pushCheck(const char* what);
   // Check that if top is a pointer type that it is valid.
@@ -193,6 +234,87 @@ class Stack {
   // Check that top is a pointer type, that it is valid and return it.
   const void* checkAndGetTopPointer(const char* what);
 
+  class Entry;
+
+  // Check that entry is a pointer type, that it is valid and return it.
+  const void* checkAndGetPointer(const Entry& entry, const char* what);
+
+  // Check that the types of the count entries match the expected types. A
+  // BaseType::AbsolutePointer in expected matches any pointer type.
+  bool checkSignature(const Entry* entries, const BaseType* expected,
+                      uint32_t count);
+
+  // Implementation of the popFrame method for a single argument of type T.
+  template <typename T>
+  struct FrameArg {
+    typedef typename std::remove_cv<T>::type Type;
+    static const BaseType type = TypeToBaseType<Type>::type;
+    static T get(Stack*, const Entry& entry) {
+      return entry.template uncheckedValue<Type>();
+    }
+    static T pop(Stack* stack) { return stack->pop<T>(); }
+  };
+
+  template <typename T>
+  struct FrameArg<T*> {
+    static const BaseType type = BaseType::AbsolutePointer;
+    static T* get(Stack* stack, const Entry& entry) {
+      const void* pointer = stack->checkAndGetPointer(entry, "popFrame");
+      return const_cast<T*>(static_cast<const T*>(pointer));
+    }
+    static T* pop(Stack* stack) { return stack->pop<T*>(); }
+  };
+
+  template <typename T, int N>
+  struct FrameArg<core::StaticArray<T, N> > {
+    static const BaseType type = BaseType::AbsolutePointer;
+    static core::StaticArray<T, N> get(Stack* stack, const Entry& entry) {
+      const T* ptr = FrameArg<const T*>::get(stack, entry);
+      core::StaticArray<T, N> out;
+      if (ptr != nullptr) {
+        for (int i = 0; i < N; i++) {
+          out[i] = ptr[i];
+        }
+      }
+      return out;
+    }
+    static core::StaticArray<T, N> pop(Stack* stack) {
+      return stack->pop<T, N>();
+    }
+  };
+
+  // The expected base types of a frame of function arguments, bottom-most
+  // argument first. There is one instance per distinct function signature.
+  template <typename... Args>
+  struct Signature {
+    static const BaseType types[sizeof...(Args)];
+  };
+
+  // Converts the entries of a validated frame into the tuple elements,
+  // starting with element I.
+  template <size_t I, typename Tuple>
+  typename std::enable_if<(I == std::tuple_size<Tuple>::value)>::type unpack(
+      const Entry*, Tuple*) {}
+
+  template <size_t I, typename Tuple>
+  typename std::enable_if<(I < std::tuple_size<Tuple>::value)>::type unpack(
+      const Entry* entries, Tuple* frame) {
+    typedef typename std::tuple_element<I, Tuple>::type T;
+    std::get<I>(*frame) = FrameArg<T>::get(this, entries[I]);
+    unpack<I + 1>(entries, frame);
+  }
+
+  // Pops the first N elements of the tuple individually, top-most first.
+  template <size_t N, typename Tuple>
+  typename std::enable_if<(N == 0)>::type popEach(Tuple*) {}
+
+  template <size_t N, typename Tuple>
+  typename std::enable_if<(N > 0)>::type popEach(Tuple* frame) {
+    typedef typename std::tuple_element<N - 1, Tuple>::type T;
+    std::get<N - 1>(*frame) = FrameArg<T>::pop(this);
+    popEach<N - 1>(frame);
+  }
+
   // Implementation of the pop method for non pointer types.
   template <typename T>
   struct PopImpl {
@@ -243,6 +365,17 @@ class Stack {
       return t;
     }
 
+    // Returns the value as T without checking the type of the entry.
+    template <typename T>
+    T uncheckedValue() const {
+      static_assert(sizeof(mValue) >= sizeof(T),
+                    "T is too large to be used as value");
+      T t;
+      // Little endian assumption
+      memcpy(&t, &mValue, sizeof(T));
+      return t;
+    }
+
     const BaseType& type() const { return mType; }
 
     void set(bool b) {
@@ -419,6 +552,12 @@ class Stack {
 
     BaseValue getBaseValue() const { return mValue.bv; }
 
+    // Returns the offset held by a constant or volatile pointer entry. The
+    // offsets are pointer sized, so volatile memory can exceed 4GB.
+    uint64_t pointerOffset() const {
+      return sizeof(void*) == sizeof(uint64_t) ? mValue.u64 : mValue.u32;
+    }
+
     // Return a string describing the stack entry.
     // The pointer returned is only valid until the next call to debugInfo,
     // regardless of the Entry instance. This function is not thread safe.
@@ -474,6 +613,10 @@ class Stack {
   const MemoryManager* mMemoryManager;
 };
 
+template <typename... Args>
+const BaseType Stack::Signature<Args...>::types[sizeof...(Args)] = {
+    Stack::FrameArg<Args>::type...};
+
 }  // namespace gapir
 
 #endif  // GAPIR_STACK_H
@@ -21,6 +21,7 @@
 #include <gtest/gtest.h>
 
 #include <memory>
+#include <tuple>
 
 namespace gapir {
 namespace test {
@@ -33,7 +34,7 @@ const uint32_t CONSTANT_SIZE = 128;
 class StackTest : public ::testing::Test {
  protected:
   virtual void SetUp() {
-    std::vector<uint32_t> memorySizes = {MEMORY_SIZE};
+    std::vector<uint64_t> memorySizes = {MEMORY_SIZE};
     mMemoryManager.reset(new MemoryManager(memorySizes));
     mStack.reset(new Stack(STACK_CAPACITY, mMemoryManager.get()));
     mMemoryManager->setReplayDataSize(CONSTANT_SIZE, 0);
@@ -113,6 +114,29 @@ TEST_F(StackTest, PopVolatilePtrWithConvert) {
   EXPECT_EQ(mMemoryManager->volatileToAbsolute(offset), pointer);
 }
 
+TEST(StackLargeMemoryTest, PopVolatilePtrAbove4GB) {
+  if (sizeof(void*) < 8) {
+    return;  // Not enough address space.
+  }
+  // Offsets above 4GB are pushed with a PUSH_I followed by an EXTEND.
+  // Only the pages that are touched use physical memory.
+  const uint64_t size = 5 * 1024 * 1024 * 1024ULL;
+  std::vector<uint64_t> memorySizes = {MEMORY_SIZE};
+  MemoryManager memoryManager(memorySizes, 2 * size);
+  ASSERT_TRUE(memoryManager.grow(size));
+  ASSERT_TRUE(memoryManager.setVolatileMemory(size));
+  Stack stack(STACK_CAPACITY, &memoryManager);
+  uint64_t offset = 0x100000123ULL;
+  stack.pushValue(BaseType::VolatilePointer, offset >> 26);
+  uint64_t value = stack.popBaseValue();
+  stack.pushValue(BaseType::VolatilePointer,
+                  (value << 26) | (offset & 0x3ffffff));
+
+  const void* pointer = stack.popVolatile<const void*>();
+  EXPECT_TRUE(stack.isValid());
+  EXPECT_EQ(memoryManager.volatileToAbsolute(offset), pointer);
+}
+
 TEST_F(StackTest, PopConstantPtrWithoutConvert) {
   uint32_t offset = 0x12;
   mStack->pushValue(BaseType::ConstantPointer, offset);
@@ -292,5 +316,131 @@ TEST_F(StackTest, PushErrorOverCapacity) {
   EXPECT_FALSE(mStack->isValid());
 }
 
+TEST_F(StackTest, PopFrame) {
+  uint32_t offset = 0x10;
+  mStack->push<uint32_t>(1);
+  mStack->push<float>(2.5f);
+  mStack->pushValue(BaseType::VolatilePointer, offset);
+  mStack->push<bool>(true);
+  EXPECT_TRUE(mStack->isValid());
+
+  auto frame = mStack->popFrame<uint32_t, float, void*, bool>();
+  EXPECT_TRUE(mStack->isValid());
+  EXPECT_EQ(1, std::get<0>(frame));
+  EXPECT_EQ(2.5f, std::get<1>(frame));
+  EXPECT_EQ(mMemoryManager->volatileToAbsolute(offset), std::get<2>(frame));
+  EXPECT_EQ(true, std::get<3>(frame));
+
+  mStack->pop<uint32_t>();
+  EXPECT_FALSE(mStack->isValid());
+}
+
+TEST_F(StackTest, PopFrameLeavesRestOfStack) {
+  mStack->push<uint32_t>(123);
+  mStack->push<int16_t>(-4);
+  mStack->push<uint64_t>(5);
+
+  auto frame = mStack->popFrame<int16_t, uint64_t>();
+  EXPECT_TRUE(mStack->isValid());
+  EXPECT_EQ(-4, std::get<0>(frame));
+  EXPECT_EQ(5, std::get<1>(frame));
+  EXPECT_EQ(123, mStack->pop<uint32_t>());
+  EXPECT_TRUE(mStack->isValid());
+}
+
+TEST_F(StackTest, PopFrameStaticArray) {
+  uint32_t offset = 0x20;
+  uint32_t* array =
+      static_cast<uint32_t*>(mMemoryManager->volatileToAbsolute(offset));
+  array[0] = 7;
+  array[1] = 8;
+  array[2] = 9;
+  mStack->pushValue(BaseType::VolatilePointer, offset);
+
+  auto frame = mStack->popFrame<core::StaticArray<uint32_t, 3> >();
+  EXPECT_TRUE(mStack->isValid());
+  uint32_t* got = std::get<0>(frame);
+  EXPECT_EQ(7, got[0]);
+  EXPECT_EQ(8, got[1]);
+  EXPECT_EQ(9, got[2]);
+}
+
+TEST_F(StackTest, PopFrameErrorStackUnderflow) {
+  mStack->push<uint32_t>(1);
+  mStack->popFrame<uint32_t, uint32_t>();
+  EXPECT_FALSE(mStack->isValid());
+}
+
+TEST_F(StackTest, PopFrameErrorTypeMissmatch) {
+  mStack->push<uint32_t>(1);
+  mStack->push<uint16_t>(2);
+  mStack->popFrame<uint32_t, uint32_t>();
+  EXPECT_FALSE(mStack->isValid());
+}
+
+TEST_F(StackTest, PopFrameErrorMismatchingPointerType) {
+  mStack->push<uint32_t>(1);
+  mStack->push<uint32_t>(2);
+  mStack->popFrame<uint32_t, void*>();
+  EXPECT_FALSE(mStack->isValid());
+}
+
+TEST_F(StackTest, PopFrameErrorInvalidPointer) {
+  uint32_t offset = MEMORY_SIZE * 2;
+  mStack->pushValue(BaseType::VolatilePointer, offset);
+  mStack->popFrame<void*>();
+  EXPECT_FALSE(mStack->isValid());
+}
+
+// Checks that popping a 10 argument frame with popFrame() returns the same
+// values as popping the arguments one by one.
+TEST_F(StackTest, PopFrameMatchesPop) {
+  const int kCalls = 1000;
+  uint32_t offset = 0x10;
+  auto pushArgs = [&] {
+    mStack->push<uint32_t>(1);
+    mStack->push<int32_t>(2);
+    mStack->push<int32_t>(3);
+    mStack->push<int32_t>(4);
+    mStack->push<int32_t>(5);
+    mStack->push<uint32_t>(6);
+    mStack->push<uint32_t>(7);
+    mStack->pushValue(BaseType::VolatilePointer, offset);
+    mStack->push<float>(8.f);
+    mStack->push<bool>(true);
+  };
+
+  uint64_t sum = 0;
+  for (int i = 0; i < kCalls; i++) {
+    pushArgs();
+    sum += static_cast<uint64_t>(mStack->pop<bool>());
+    sum += static_cast<uint64_t>(mStack->pop<float>());
+    sum += reinterpret_cast<uintptr_t>(mStack->pop<void*>()) & 1;
+    sum += mStack->pop<uint32_t>();
+    sum += mStack->pop<uint32_t>();
+    sum += mStack->pop<int32_t>();
+    sum += mStack->pop<int32_t>();
+    sum += mStack->pop<int32_t>();
+    sum += mStack->pop<int32_t>();
+    sum += mStack->pop<uint32_t>();
+  }
+  EXPECT_TRUE(mStack->isValid());
+
+  uint64_t frameSum = 0;
+  for (int i = 0; i < kCalls; i++) {
+    pushArgs();
+    auto frame = mStack->popFrame<uint32_t, int32_t, int32_t, int32_t, int32_t,
+                                  uint32_t, uint32_t, void*, float, bool>();
+    frameSum += static_cast<uint64_t>(std::get<9>(frame));
+    frameSum += static_cast<uint64_t>(std::get<8>(frame));
+    frameSum += reinterpret_cast<uintptr_t>(std::get<7>(frame)) & 1;
+    frameSum += std::get<6>(frame) + std::get<5>(frame);
+    frameSum += std::get<4>(frame) + std::get<3>(frame);
+    frameSum += std::get<2>(frame) + std::get<1>(frame) + std::get<0>(frame);
+  }
+  EXPECT_TRUE(mStack->isValid());
+  EXPECT_EQ(sum, frameSum);
+}
+
 }  // namespace test
 }  // namespace gapir
@@ -60,11 +60,18 @@ void pushUint32(std::vector<uint8_t>* buf, uint32_t v);
 void pushString(std::vector<uint8_t>* buf, const std::string& str);
 void pushString(std::vector<uint8_t>* buf, const char* str);
 
+// resourceId returns the ResourceId holding the bytes of name, which must be
+// at most 20 bytes long, padded with zeros.
+ResourceId resourceId(const std::string& name);
+
+// Creates a payload. chunks lists the indices of the chunks of each resource,
+// if any resource is split into chunks.
 std::unique_ptr<ReplayConnection::Payload> createPayload(
     uint32_t stackSize, uint32_t volatileMemorySize,
     const std::vector<uint8_t>& constantMemory,
     const std::vector<Resource>& resources,
-    const std::vector<uint32_t>& instructions);
+    const std::vector<uint32_t>& instructions,
+    const std::vector<std::vector<uint32_t>>& chunks = {});
 
 std::unique_ptr<ReplayConnection::Resources> createResources(
     const std::vector<uint8_t>& data);
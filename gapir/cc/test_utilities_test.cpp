@@ -23,6 +23,9 @@
 
 #include <gmock/gmock.h>
 
+#include <string.h>
+
+#include <algorithm>
 #include <memory>
 #include <string>
 #include <vector>
@@ -74,11 +77,18 @@ void pushString(std::vector<uint8_t>* buf, const char* str) {
   buf->push_back(0);
 }
 
+ResourceId resourceId(const std::string& name) {
+  ResourceId id = {};
+  memcpy(id.data, name.data(), std::min(name.size(), sizeof(id.data)));
+  return id;
+}
+
 std::unique_ptr<ReplayConnection::Payload> createPayload(
     uint32_t stackSize, uint32_t volatileMemorySize,
     const std::vector<uint8_t>& constantMemory,
     const std::vector<Resource>& resources,
-    const std::vector<uint32_t>& instructions) {
+    const std::vector<uint32_t>& instructions,
+    const std::vector<std::vector<uint32_t>>& chunks) {
   auto p =
       std::unique_ptr<replay_service::Payload>(new replay_service::Payload);
   p->set_stack_size(stackSize);
@@ -87,8 +97,13 @@ std::unique_ptr<ReplayConnection::Payload> createPayload(
   p->set_opcodes(instructions.data(), instructions.size() * sizeof(uint32_t));
   for (size_t i = 0; i < resources.size(); i++) {
     auto* r = p->add_resources();
-    r->set_id(resources[i].id);
+    r->set_id(resources[i].id.data, sizeof(resources[i].id.data));
     r->set_size(resources[i].size);
+    if (i < chunks.size()) {
+      for (auto chunk : chunks[i]) {
+        r->add_chunks(chunk);
+      }
+    }
   }
   return std::unique_ptr<ReplayConnection::Payload>(
       new ReplayConnection::Payload(std::move(p)));
@@ -21,6 +21,7 @@ import (
 	"github.com/google/gapid/core/app/auth"
 	"github.com/google/gapid/core/log"
 	replaysrv "github.com/google/gapid/gapir/replay_service"
+	"github.com/google/gapid/gapis/config"
 	"github.com/google/gapid/gapis/service/severity"
 	"google.golang.org/grpc"
 	"google.golang.org/grpc/metadata"
@@ -50,6 +51,8 @@ type (
 	PostData = replaysrv.PostData
 	// Notification contains an Id, the ApiIndex, Label, Msg in string and arbitary Data in bytes.
 	Notification = replaysrv.Notification
+	// ReplayStats contains the time spent in each phase of a replay, and the number of bytes and resources transferred.
+	ReplayStats = replaysrv.ReplayStats
 	// Severity represents the severity level of notification messages. It uses the same enum as gapis
 	Severity = severity.Severity
 )
@@ -64,6 +67,7 @@ type Connection struct {
 	conn       *grpc.ClientConn
 	servClient replaysrv.GapirClient
 	stream     replaysrv.Gapir_ReplayClient
+	posts      *postDecoder
 	authToken  auth.Token
 }
 
@@ -88,6 +92,7 @@ func (c *Connection) Close() {
 	c.conn = nil
 	c.servClient = nil
 	c.stream = nil
+	c.posts = nil
 }
 
 // Ping sends a ping to the connected GAPIR device and expect a response to make
@@ -121,6 +126,20 @@ func (c *Connection) Shutdown(ctx context.Context) error {
 	return nil
 }
 
+// Stats returns the stats of the most recent replays performed by the
+// connected GAPIR device, oldest first.
+func (c *Connection) Stats(ctx context.Context) ([]*ReplayStats, error) {
+	if c.servClient == nil {
+		return nil, log.Err(ctx, nil, "Gapir not connected")
+	}
+	ctx = c.attachAuthToken(ctx)
+	r, err := c.servClient.Stats(ctx, &replaysrv.StatsRequest{})
+	if err != nil {
+		return nil, log.Err(ctx, err, "Requesting replay stats")
+	}
+	return r.GetReplays(), nil
+}
+
 // SendResources sends the given resources data to the connected GAPIR device.
 func (c *Connection) SendResources(ctx context.Context, resources []byte) error {
 	if c.conn == nil || c.servClient == nil {
@@ -148,6 +167,7 @@ func (c *Connection) SendPayload(ctx context.Context, payload Payload) error {
 	if c.stream == nil {
 		return log.Err(ctx, nil, "Replay Communication not initiated")
 	}
+	c.posts.setPostEncoding(&payload, config.CompressReplayPostData, config.DedupReplayPostData)
 	payloadReq := replaysrv.ReplayRequest{
 		Req: &replaysrv.ReplayRequest_Payload{
 			Payload: &payload,
@@ -173,6 +193,9 @@ type ReplayResponseHandler interface {
 	HandlePostData(context.Context, *PostData, *Connection) error
 	// HandleNotification handles the given notification message.
 	HandleNotification(context.Context, *Notification, *Connection) error
+	// HandleReplayStats handles the stats sent with the replay finished
+	// message. stats is nil if the GAPIR device did not send any.
+	HandleReplayStats(context.Context, *ReplayStats, *Connection) error
 }
 
 // HandleReplayCommunication handles the communication with the GAPIR device on
@@ -203,6 +226,7 @@ func (c *Connection) HandleReplayCommunication(
 		if c.stream != nil {
 			c.stream.CloseSend()
 			c.stream = nil
+			c.posts = nil
 		}
 	}()
 	for {
@@ -229,7 +253,19 @@ func (c *Connection) HandleReplayCommunication(
 			// No valid replay response after crash dump.
 			return nil
 		case *replaysrv.ReplayResponse_PostData:
-			if err := handler.HandlePostData(ctx, r.GetPostData(), c); err != nil {
+			pd := r.GetPostData()
+			if err := c.posts.resolve(ctx, pd); err != nil {
+				return log.Errf(ctx, err, "Decoding post data")
+			}
+			if err := handler.HandlePostData(ctx, pd, c); err != nil {
+				return log.Errf(ctx, err, "Handling post data")
+			}
+		case *replaysrv.ReplayResponse_EncodedPostData:
+			pd, err := c.posts.decode(ctx, r.GetEncodedPostData())
+			if err != nil {
+				return log.Errf(ctx, err, "Decoding post data")
+			}
+			if err := handler.HandlePostData(ctx, pd, c); err != nil {
 				return log.Errf(ctx, err, "Handling post data")
 			}
 		case *replaysrv.ReplayResponse_Notification:
@@ -238,6 +274,9 @@ func (c *Connection) HandleReplayCommunication(
 			}
 		case *replaysrv.ReplayResponse_Finished:
 			log.D(ctx, "Replay Finished Response received")
+			if err := handler.HandleReplayStats(ctx, r.GetFinished().GetStats(), c); err != nil {
+				return log.Errf(ctx, err, "Handling replay stats")
+			}
 			return nil
 		default:
 			return log.Errf(ctx, nil, "Unhandled ReplayResponse type")
@@ -265,6 +304,7 @@ func (c *Connection) beginReplay(ctx context.Context, id string) error {
 		return log.Err(ctx, err, "Sending replay id")
 	}
 	c.stream = replayStream
+	c.posts = &postDecoder{}
 	return nil
 }
 
@@ -0,0 +1,110 @@
+// Copyright (C) 2018 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package client
+
+import (
+	"bytes"
+	"compress/zlib"
+	"context"
+	"io"
+
+	"github.com/golang/protobuf/proto"
+	"github.com/google/gapid/core/log"
+	replaysrv "github.com/google/gapid/gapir/replay_service"
+)
+
+const (
+	// The number of most recent post data pieces that GAPIR may deduplicate
+	// post data against.
+	postDedupWindow = 8
+	// The minimum size in bytes of the post data pieces that are deduplicated.
+	postDedupMinSize = 4096
+)
+
+// postDecoder decodes the post data sent by a GAPIR device with the encoding
+// requested by setPostEncoding, and resolves the deduplicated pieces. A new
+// postDecoder must be used for each replay.
+type postDecoder struct {
+	window []*replaysrv.PostDataPiece // Oldest piece first.
+	size   int                        // The window size, 0 if disabled.
+}
+
+// setPostEncoding sets the post data encoding requested from GAPIR in the
+// payload, and configures the decoder to match.
+func (d *postDecoder) setPostEncoding(p *Payload, compress, dedup bool) {
+	if compress {
+		p.PostEncoding = replaysrv.PostEncoding_PostEncodingDeflate
+	}
+	if dedup {
+		p.PostDedupWindow = postDedupWindow
+		p.PostDedupMinSize = postDedupMinSize
+		d.size = postDedupWindow
+	}
+}
+
+// decode decompresses the encoded post data and resolves its deduplicated
+// pieces.
+func (d *postDecoder) decode(ctx context.Context, e *replaysrv.EncodedPostData) (*PostData, error) {
+	if e.Encoding != replaysrv.PostEncoding_PostEncodingDeflate {
+		return nil, log.Errf(ctx, nil, "Unsupported post data encoding: %v", e.Encoding)
+	}
+	r, err := zlib.NewReader(bytes.NewReader(e.Data))
+	if err != nil {
+		return nil, log.Err(ctx, err, "Decompressing post data")
+	}
+	defer r.Close()
+	buf := make([]byte, e.Size)
+	if _, err := io.ReadFull(r, buf); err != nil {
+		return nil, log.Err(ctx, err, "Decompressing post data")
+	}
+	pd := &PostData{}
+	if err := proto.Unmarshal(buf, pd); err != nil {
+		return nil, log.Err(ctx, err, "Unmarshalling post data")
+	}
+	if err := d.resolve(ctx, pd); err != nil {
+		return nil, err
+	}
+	return pd, nil
+}
+
+// resolve replaces the deduplicated pieces of pd with the data of the pieces
+// they duplicate, and updates the window in the same way as GAPIR.
+func (d *postDecoder) resolve(ctx context.Context, pd *PostData) error {
+	if d.size == 0 {
+		return nil
+	}
+	for _, p := range pd.PostDataPieces {
+		if p.IsDuplicate {
+			found := false
+			for i := len(d.window) - 1; i >= 0; i-- {
+				if d.window[i].ID == p.DuplicateOf {
+					p.Data, p.IsDuplicate, found = d.window[i].Data, false, true
+					break
+				}
+			}
+			if !found {
+				return log.Errf(ctx, nil, "Post data %d duplicates unknown post data %d", p.ID, p.DuplicateOf)
+			}
+		}
+		if len(p.Data) < postDedupMinSize {
+			continue
+		}
+		d.window = append(d.window, p)
+		if len(d.window) > d.size {
+			d.window = d.window[1:]
+		}
+	}
+	return nil
+}
@@ -0,0 +1,91 @@
+// Copyright (C) 2018 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package client
+
+import (
+	"bytes"
+	"compress/zlib"
+	"context"
+	"testing"
+
+	"github.com/golang/protobuf/proto"
+	"github.com/google/gapid/core/assert"
+	"github.com/google/gapid/core/log"
+	replaysrv "github.com/google/gapid/gapir/replay_service"
+)
+
+// encodePostData encodes pd the same way as GAPIR.
+func encodePostData(pd *PostData) *replaysrv.EncodedPostData {
+	data, err := proto.Marshal(pd)
+	if err != nil {
+		panic(err)
+	}
+	buf := bytes.Buffer{}
+	w, _ := zlib.NewWriterLevel(&buf, zlib.BestSpeed)
+	w.Write(data)
+	w.Close()
+	return &replaysrv.EncodedPostData{
+		Encoding: replaysrv.PostEncoding_PostEncodingDeflate,
+		Size:     uint64(len(data)),
+		Data:     buf.Bytes(),
+	}
+}
+
+func TestPostDecoderResolvesDuplicates(t *testing.T) {
+	ctx := log.Testing(t)
+	d := &postDecoder{}
+	d.setPostEncoding(&Payload{}, true, true)
+
+	frame := bytes.Repeat([]byte{1, 2, 3, 4}, postDedupMinSize)
+	first := &PostData{PostDataPieces: []*replaysrv.PostDataPiece{
+		{ID: 0, Data: frame},
+		{ID: 1, Data: []byte{5}},
+	}}
+	got, err := d.decode(ctx, encodePostData(first))
+	assert.For(ctx, "err").ThatError(err).Succeeded()
+	assert.For(ctx, "first").That(proto.Equal(got, first)).Equals(true)
+
+	second := &PostData{PostDataPieces: []*replaysrv.PostDataPiece{
+		{ID: 2, IsDuplicate: true, DuplicateOf: 0},
+	}}
+	got, err = d.decode(ctx, encodePostData(second))
+	assert.For(ctx, "err").ThatError(err).Succeeded()
+	assert.For(ctx, "resolved").ThatSlice(got.PostDataPieces[0].Data).Equals(frame)
+
+	unknown := &PostData{PostDataPieces: []*replaysrv.PostDataPiece{
+		{ID: 3, IsDuplicate: true, DuplicateOf: 1},
+	}}
+	_, err = d.decode(ctx, encodePostData(unknown))
+	assert.For(ctx, "unknown").ThatError(err).Failed()
+}
+
+// BenchmarkPostDecoder measures the decoding of compressed framebuffer posts.
+func BenchmarkPostDecoder(b *testing.B) {
+	ctx := context.Background()
+	frame := make([]byte, 960*540*4)
+	for i := range frame {
+		frame[i] = byte(i / 4 % 960)
+	}
+	pd := &PostData{PostDataPieces: []*replaysrv.PostDataPiece{{Data: frame}}}
+	encoded := encodePostData(pd)
+	b.SetBytes(int64(len(frame)))
+	b.ResetTimer()
+	for i := 0; i < b.N; i++ {
+		d := &postDecoder{}
+		if _, err := d.decode(ctx, encoded); err != nil {
+			b.Fatal(err)
+		}
+	}
+}
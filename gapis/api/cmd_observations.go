@@ -101,6 +101,83 @@ func (o CmdObservation) String() string {
 	return fmt.Sprintf("{Range: %v, ID: %v}", o.Range, o.ID)
 }
 
+// CmdObservationBatch is a set of read or write observations made by a
+// command, whose data is held back to back by a single resource, or by a
+// resource per range.
+type CmdObservationBatch struct {
+	Pool   memory.PoolID  // The pool in which the memory was observed.
+	Ranges []memory.Range // Memory ranges that were observed, in order.
+	ID     id.ID          // The resource identifier of the data of all ranges.
+	IDs    []id.ID        // If not empty, the resource identifier per range.
+}
+
+// Split returns the individual observations of the batch. Runs of adjacent
+// ranges, such as the pages of a large observation, are coalesced into a
+// single observation whose data is stored as one resource.
+func (b CmdObservationBatch) Split(ctx context.Context) ([]CmdObservation, error) {
+	if len(b.IDs) > 0 && len(b.IDs) != len(b.Ranges) {
+		return nil, fmt.Errorf("Observation batch has %v resources for %v ranges", len(b.IDs), len(b.Ranges))
+	}
+	var blob []byte
+	if len(b.IDs) == 0 {
+		data, err := database.Resolve(ctx, b.ID)
+		if err != nil {
+			return nil, err
+		}
+		var ok bool
+		if blob, ok = data.([]byte); !ok {
+			return nil, fmt.Errorf("Observation batch resource is %T, not []byte", data)
+		}
+	}
+	out := []CmdObservation{}
+	offset := uint64(0)
+	for i := 0; i < len(b.Ranges); {
+		rng := b.Ranges[i]
+		end := i + 1
+		for end < len(b.Ranges) && b.Ranges[end].Base == rng.End() {
+			rng.Size += b.Ranges[end].Size
+			end++
+		}
+		var resource id.ID
+		switch {
+		case len(b.IDs) > 0 && end == i+1:
+			resource = b.IDs[i]
+		case len(b.IDs) > 0:
+			run := make([]byte, 0, rng.Size)
+			for _, resID := range b.IDs[i:end] {
+				data, err := database.Resolve(ctx, resID)
+				if err != nil {
+					return nil, err
+				}
+				page, ok := data.([]byte)
+				if !ok {
+					return nil, fmt.Errorf("Observation batch resource is %T, not []byte", data)
+				}
+				run = append(run, page...)
+			}
+			if uint64(len(run)) != rng.Size {
+				return nil, fmt.Errorf("Observation batch resources hold %v bytes for a range of %v bytes", len(run), rng.Size)
+			}
+			var err error
+			if resource, err = database.Store(ctx, run); err != nil {
+				return nil, err
+			}
+		default:
+			if offset+rng.Size > uint64(len(blob)) {
+				return nil, fmt.Errorf("Observation batch resource is too small (%v bytes) for its ranges", len(blob))
+			}
+			var err error
+			if resource, err = database.Store(ctx, blob[offset:offset+rng.Size]); err != nil {
+				return nil, err
+			}
+			offset += rng.Size
+		}
+		out = append(out, CmdObservation{Pool: b.Pool, Range: rng, ID: resource})
+		i = end
+	}
+	return out, nil
+}
+
 func init() {
 	protoconv.Register(
 		func(ctx context.Context, a CmdObservation) (*memory_pb.Observation, error) {
@@ -128,4 +205,67 @@ func init() {
 			return o, nil
 		},
 	)
+	protoconv.Register(
+		func(ctx context.Context, a CmdObservationBatch) (*memory_pb.Observations, error) {
+			out := &memory_pb.Observations{
+				Pool:  uint32(a.Pool),
+				Gaps:  make([]uint64, len(a.Ranges)),
+				Sizes: make([]uint64, len(a.Ranges)),
+			}
+			if len(a.IDs) > 0 {
+				out.ResIndices = make([]int64, len(a.IDs))
+				for i, resID := range a.IDs {
+					resIndex, err := id.GetRemapper(ctx).RemapID(ctx, resID)
+					if err != nil {
+						return nil, err
+					}
+					out.ResIndices[i] = resIndex
+				}
+			} else {
+				resIndex, err := id.GetRemapper(ctx).RemapID(ctx, a.ID)
+				if err != nil {
+					return nil, err
+				}
+				out.ResIndex = resIndex
+			}
+			end := uint64(0)
+			for i, r := range a.Ranges {
+				out.Gaps[i] = r.Base - end
+				out.Sizes[i] = r.Size
+				end = r.End()
+			}
+			return out, nil
+		},
+		func(ctx context.Context, a *memory_pb.Observations) (CmdObservationBatch, error) {
+			if len(a.Gaps) != len(a.Sizes) {
+				return CmdObservationBatch{}, fmt.Errorf("Observations has %v gaps but %v sizes", len(a.Gaps), len(a.Sizes))
+			}
+			o := CmdObservationBatch{
+				Pool:   memory.PoolID(a.Pool),
+				Ranges: make([]memory.Range, len(a.Sizes)),
+			}
+			if len(a.ResIndices) > 0 {
+				o.IDs = make([]id.ID, len(a.ResIndices))
+				for i, resIndex := range a.ResIndices {
+					resID, err := id.GetRemapper(ctx).RemapIndex(ctx, resIndex)
+					if err != nil {
+						return CmdObservationBatch{}, err
+					}
+					o.IDs[i] = resID
+				}
+			} else {
+				resID, err := id.GetRemapper(ctx).RemapIndex(ctx, a.ResIndex)
+				if err != nil {
+					return CmdObservationBatch{}, err
+				}
+				o.ID = resID
+			}
+			end := uint64(0)
+			for i, size := range a.Sizes {
+				o.Ranges[i] = memory.Range{Base: end + a.Gaps[i], Size: size}
+				end = o.Ranges[i].End()
+			}
+			return o, nil
+		},
+	)
 }
@@ -0,0 +1,103 @@
+// Copyright (C) 2018 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package api_test
+
+import (
+	"context"
+	"testing"
+
+	"github.com/google/gapid/core/assert"
+	"github.com/google/gapid/core/data/id"
+	"github.com/google/gapid/core/log"
+	"github.com/google/gapid/gapis/api"
+	"github.com/google/gapid/gapis/database"
+	"github.com/google/gapid/gapis/memory"
+)
+
+const pageSize = 4096
+
+func pattern(size int, seed byte) []byte {
+	data := make([]byte, size)
+	for i := range data {
+		data[i] = seed + byte(i*31)
+	}
+	return data
+}
+
+func resolve(ctx context.Context, t *testing.T, resID id.ID) []byte {
+	data, err := database.Resolve(ctx, resID)
+	if err != nil {
+		t.Fatalf("Couldn't resolve %v: %v", resID, err)
+	}
+	return data.([]byte)
+}
+
+func TestSplitCoalescesPages(t *testing.T) {
+	ctx := log.Testing(t)
+	ctx = database.Put(ctx, database.NewInMemory(ctx))
+
+	// A 4-page observation, sent as a resource per page, followed by a
+	// separate small observation.
+	batch := api.CmdObservationBatch{Pool: 1}
+	large := []byte{}
+	for i := 0; i < 4; i++ {
+		page := pattern(pageSize, byte(i))
+		resID, err := database.Store(ctx, page)
+		assert.For(ctx, "store").ThatError(err).Succeeded()
+		batch.Ranges = append(batch.Ranges, memory.Range{Base: 0x10000 + uint64(i*pageSize), Size: pageSize})
+		batch.IDs = append(batch.IDs, resID)
+		large = append(large, page...)
+	}
+	small := pattern(16, 99)
+	smallID, err := database.Store(ctx, small)
+	assert.For(ctx, "store").ThatError(err).Succeeded()
+	batch.Ranges = append(batch.Ranges, memory.Range{Base: 0x20000, Size: 16})
+	batch.IDs = append(batch.IDs, smallID)
+
+	observations, err := batch.Split(ctx)
+	assert.For(ctx, "err").ThatError(err).Succeeded()
+	assert.For(ctx, "observations").ThatSlice(observations).IsLength(2)
+	assert.For(ctx, "range").That(observations[0].Range).Equals(memory.Range{Base: 0x10000, Size: 4 * pageSize})
+	assert.For(ctx, "data").ThatSlice(resolve(ctx, t, observations[0].ID)).Equals(large)
+	assert.For(ctx, "range").That(observations[1].Range).Equals(memory.Range{Base: 0x20000, Size: 16})
+	assert.For(ctx, "id").That(observations[1].ID).Equals(smallID)
+}
+
+func TestSplitCoalescesAdjacentRangesOfBlob(t *testing.T) {
+	ctx := log.Testing(t)
+	ctx = database.Put(ctx, database.NewInMemory(ctx))
+
+	blob := pattern(3*pageSize+32, 7)
+	blobID, err := database.Store(ctx, blob)
+	assert.For(ctx, "store").ThatError(err).Succeeded()
+	batch := api.CmdObservationBatch{
+		Pool: 1,
+		Ranges: []memory.Range{
+			{Base: 0x1000, Size: 32},
+			{Base: 0x8000, Size: pageSize},
+			{Base: 0x9000, Size: pageSize},
+			{Base: 0xa000, Size: pageSize},
+		},
+		ID: blobID,
+	}
+
+	observations, err := batch.Split(ctx)
+	assert.For(ctx, "err").ThatError(err).Succeeded()
+	assert.For(ctx, "observations").ThatSlice(observations).IsLength(2)
+	assert.For(ctx, "range").That(observations[0].Range).Equals(memory.Range{Base: 0x1000, Size: 32})
+	assert.For(ctx, "data").ThatSlice(resolve(ctx, t, observations[0].ID)).Equals(blob[:32])
+	assert.For(ctx, "range").That(observations[1].Range).Equals(memory.Range{Base: 0x8000, Size: 3 * pageSize})
+	assert.For(ctx, "data").ThatSlice(resolve(ctx, t, observations[1].ID)).Equals(blob[32:])
+}
@@ -83,9 +83,10 @@ func checkResource(ctx context.Context, gotInfos []*client.ResourceInfo, expecte
 	got := make([]interface{}, len(gotInfos))
 	for i, g := range gotInfos {
 		ctx := log.V{"id": g.Id}.Bind(ctx)
-		id, err := id.Parse(g.Id)
-		assert.For(ctx, "Parse resource ID").ThatError(err).Succeeded()
-		got[i], err = database.Resolve(ctx, id)
+		assert.For(ctx, "Resource ID size").That(len(g.Id)).Equals(id.Size)
+		rID := id.ID{}
+		copy(rID[:], g.Id)
+		got[i], err = database.Resolve(ctx, rID)
 		assert.For(ctx, "Get resource").ThatError(err).Succeeded()
 	}
 
@@ -408,6 +408,11 @@ func (b *builder) addRes(ctx context.Context, expectedIndex int64, data []byte)
 	if err != nil {
 		return err
 	}
+	// The resources of frames discarded by the flight recorder leave gaps in
+	// the indices. Nothing references the missing resources.
+	for expectedIndex > int64(len(b.resIDs)) {
+		b.resIDs = append(b.resIDs, id.ID{})
+	}
 	arrayIndex := int64(len(b.resIDs))
 	b.resIDs = append(b.resIDs, dID)
 	// If the Resource had the optional Index field, use it for verification.
@@ -97,6 +97,20 @@ func (d *decoder) ChildObject(ctx context.Context, msg proto.Message, parentID u
 }
 
 func (d *decoder) add(ctx context.Context, child, parent interface{}) error {
+	if batch, ok := child.(api.CmdObservationBatch); ok {
+		// Observations sent as a batch are split back into an observation
+		// per range.
+		observations, err := batch.Split(ctx)
+		if err != nil {
+			return err
+		}
+		for _, o := range observations {
+			if err := d.add(ctx, o, parent); err != nil {
+				return err
+			}
+		}
+		return nil
+	}
 	if parent, ok := parent.(*cmdGroup); ok {
 		// adding something to a command
 
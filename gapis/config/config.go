@@ -29,4 +29,14 @@ const (
 	LogTransformsToFile    = false
 	LogTransformsToCapture = false
 	SeparateMutateStates   = false
+	// Requests compressed post data from GAPIR, trading device CPU time for
+	// bandwidth.
+	CompressReplayPostData = true
+	// Lets GAPIR send references to recently posted data instead of sending
+	// identical post data again.
+	DedupReplayPostData = true
+	// The average size in bytes of the chunks that large replay resources are
+	// split into, so that GAPIR only fetches the chunks it has not cached.
+	// 0 disables the chunking. See builder.SetResourceChunkSize.
+	ReplayResourceChunkSize = 0
 )
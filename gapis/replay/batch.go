@@ -137,6 +137,9 @@ func (m *Manager) execute(
 	ctx = log.V{"replay target ABI": replayABI}.Bind(ctx)
 
 	b := builder.New(replayABI.MemoryLayout)
+	if err := b.SetResourceChunkSize(config.ReplayResourceChunkSize); err != nil {
+		return log.Err(ctx, err, "Invalid replay resource chunk size")
+	}
 
 	_, ranges, err := initialcmds.InitialCommands(ctx, capturePath)
 
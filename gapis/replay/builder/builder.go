@@ -93,6 +93,7 @@ type Builder struct {
 	cmdStart            int    // index of current commands's first instruction
 	pendingLabel        uint64 // label passed to BeginCommand written
 	lastLabel           uint64 // label of last CommitCommand written
+	resourceChunkSize   uint32 // average size of the resource chunks, 0 if not split
 
 	// Remappings is a map of a arbitrary keys to pointers. Typically, this is
 	// used as a map of observed values to values that are only known at replay
@@ -563,7 +564,7 @@ func (b *Builder) Write(rng memory.Range, resourceID id.ID) {
 			idx = uint32(len(b.resources))
 			b.resourceIDToIdx[resourceID] = idx
 			b.resources = append(b.resources, &gapir.ResourceInfo{
-				Id:   resourceID.String(),
+				Id:   resourceID[:],
 				Size: uint32(rng.Size),
 			})
 		}
@@ -575,6 +576,20 @@ func (b *Builder) Write(rng memory.Range, resourceID id.ID) {
 	b.ReserveMemory(rng)
 }
 
+// SetResourceChunkSize enables the content-defined chunking of the resources
+// of at least 2 * avgSize bytes into chunks of about avgSize bytes, done by
+// Build. Each chunk is a resource of its own, which GAPIR fetches and caches
+// separately, so the chunks that resources have in common are only sent once.
+// GAPIR loads a resource split into chunks by loading its chunks one after the
+// other. An avgSize of 0 disables the chunking, which is the default.
+func (b *Builder) SetResourceChunkSize(avgSize uint32) error {
+	if avgSize != 0 && avgSize < MinResourceChunkSize {
+		return fmt.Errorf("Resource chunk size %v is less than %v", avgSize, MinResourceChunkSize)
+	}
+	b.resourceChunkSize = avgSize
+	return nil
+}
+
 func (b *Builder) RegisterNotificationReader(reader NotificationReader) {
 	b.notificationReaders = append(b.notificationReaders, reader)
 }
@@ -589,6 +604,12 @@ func (b *Builder) Build(ctx context.Context) (gapir.Payload, PostDataHandler, No
 		b.assertResourceSizesAreAsExpected(ctx)
 	}
 
+	if b.resourceChunkSize != 0 {
+		if err := b.chunkResources(ctx); err != nil {
+			return gapir.Payload{}, nil, nil, err
+		}
+	}
+
 	byteOrder := b.memoryLayout.GetEndian()
 
 	opcodes := &bytes.Buffer{}
@@ -609,7 +630,7 @@ func (b *Builder) Build(ctx context.Context) (gapir.Payload, PostDataHandler, No
 
 	payload := gapir.Payload{
 		StackSize:          uint32(512), // TODO: Calculate stack size
-		VolatileMemorySize: uint32(vml.size),
+		VolatileMemorySize: vml.size,
 		Constants:          b.constantMemory.data,
 		Resources:          b.resources,
 		Opcodes:            opcodes.Bytes(),
@@ -668,10 +689,11 @@ const ErrInvalidResource = fault.Const("Invaid resource")
 func (b *Builder) assertResourceSizesAreAsExpected(ctx context.Context) {
 	for _, r := range b.resources {
 		ctx := log.V{"resource-id": r.Id}.Bind(ctx)
-		id, err := id.Parse(r.Id)
-		if err != nil {
+		if len(r.Id) != id.Size {
 			panic(log.Err(ctx, ErrInvalidResource, "Couldn't parse identifier"))
 		}
+		id := id.ID{}
+		copy(id[:], r.Id)
 		obj, err := database.Resolve(ctx, id)
 		if err != nil {
 			panic(log.Err(ctx, ErrInvalidResource, "Couldn't resolve"))
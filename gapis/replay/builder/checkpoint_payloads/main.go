@@ -0,0 +1,93 @@
+// Copyright (C) 2018 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+// checkpoint_payloads builds the replay payloads used by the gapir checkpoint
+// tests.
+package main
+
+import (
+	"context"
+	"flag"
+	"fmt"
+	"io/ioutil"
+
+	"github.com/golang/protobuf/proto"
+	"github.com/google/gapid/core/app"
+	"github.com/google/gapid/core/data/id"
+	"github.com/google/gapid/core/log"
+	"github.com/google/gapid/core/os/device"
+	"github.com/google/gapid/gapis/api"
+	"github.com/google/gapid/gapis/memory"
+	"github.com/google/gapid/gapis/replay/builder"
+	"github.com/google/gapid/gapis/replay/protocol"
+	"github.com/google/gapid/gapis/replay/value"
+)
+
+func main() {
+	app.ShortHelp = "checkpoint_payloads writes the replay payloads <first> <second> <changed>."
+	app.Run(run)
+}
+
+func run(ctx context.Context) error {
+	if flag.NArg() != 3 {
+		app.Usage(ctx, "Expected 3 payload paths, got %d", flag.NArg())
+		return nil
+	}
+	// first and second only differ in the commands inserted after the capture,
+	// changed differs from first in the captured commands.
+	for i, p := range []struct {
+		capture string
+		tail    string
+	}{
+		{"capture", "first tail"},
+		{"capture", "other tail"},
+		{"changed", "first tail"},
+	} {
+		data, err := build(ctx, p.capture, p.tail)
+		if err != nil {
+			return err
+		}
+		if err := ioutil.WriteFile(flag.Arg(i), data, 0666); err != nil {
+			return log.Errf(ctx, err, "Writing %v", flag.Arg(i))
+		}
+	}
+	return nil
+}
+
+// build returns the marshalled payload replaying the captured commands with
+// the given name, followed by a command inserted by GAPIS with the given name.
+func build(ctx context.Context, capture, tail string) ([]byte, error) {
+	b := builder.New(device.Little64)
+	for i := uint64(0); i < 4; i++ {
+		name := fmt.Sprintf("%v %d", capture, i)
+		b.BeginCommand(i, 0)
+		b.Push(value.U32(i))
+		b.Push(b.String(name))
+		b.Write(memory.Range{Base: 0x1000 * (i + 1), Size: 16}, id.OfString(name))
+		b.Call(builder.FunctionInfo{ID: uint16(i), ReturnType: protocol.Type_Void, Parameters: 2})
+		b.CommitCommand()
+	}
+
+	b.BeginCommand(uint64(api.CmdNoID), 0)
+	b.Push(b.String(tail))
+	b.Write(memory.Range{Base: 0x8000, Size: 16}, id.OfString(tail))
+	b.Call(builder.FunctionInfo{ID: 4, ReturnType: protocol.Type_Void, Parameters: 1})
+	b.CommitCommand()
+
+	payload, _, _, err := b.Build(ctx)
+	if err != nil {
+		return nil, err
+	}
+	return proto.Marshal(&payload)
+}
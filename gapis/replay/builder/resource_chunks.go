@@ -0,0 +1,132 @@
+// Copyright (C) 2018 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package builder
+
+import (
+	"context"
+
+	"github.com/google/gapid/core/data/id"
+	"github.com/google/gapid/core/log"
+	gapir "github.com/google/gapid/gapir/client"
+	"github.com/google/gapid/gapis/database"
+)
+
+// MinResourceChunkSize is the smallest average chunk size accepted by
+// SetResourceChunkSize.
+const MinResourceChunkSize = 64
+
+// gear holds the random value of each byte for the gear rolling hash. It is
+// generated with splitmix64, so that the chunk boundaries never change.
+var gear = func() (values [256]uint64) {
+	x := uint64(0)
+	for i := range values {
+		x += 0x9e3779b97f4a7c15
+		z := x
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9
+		z = (z ^ (z >> 27)) * 0x94d049bb133111eb
+		values[i] = z ^ (z >> 31)
+	}
+	return
+}()
+
+// chunkSize returns the size of the chunk starting at the beginning of data.
+// The chunk ends at the first byte where the top log2(avgSize) bits of the
+// gear hash are clear. The hash only depends on the last 64 bytes, so the
+// boundaries move with the content when bytes are inserted or removed before
+// them. The chunks are at least avgSize / 8 and at most avgSize * 4 bytes, and
+// about avgSize * 9 / 8 bytes on average.
+// avgSize must be at least MinResourceChunkSize.
+func chunkSize(data []byte, avgSize uint32) int {
+	minSize, maxSize := int(avgSize/8), int(avgSize)*4
+	if len(data) <= minSize {
+		return len(data)
+	}
+	if len(data) > maxSize {
+		data = data[:maxSize]
+	}
+	bits := uint(0)
+	for uint64(2)<<bits <= uint64(avgSize) {
+		bits++
+	}
+	mask := ^uint64(0) << (64 - bits)
+	hash := uint64(0)
+	for i := minSize; i < len(data); i++ {
+		hash = (hash << 1) + gear[data[i]]
+		if hash&mask == 0 {
+			return i + 1
+		}
+	}
+	return len(data)
+}
+
+// chunks splits data into content-defined chunks of about avgSize bytes.
+func chunks(data []byte, avgSize uint32) [][]byte {
+	out := [][]byte{}
+	for len(data) > 0 {
+		n := chunkSize(data, avgSize)
+		out = append(out, data[:n])
+		data = data[n:]
+	}
+	return out
+}
+
+// chunkResources splits the resources of at least twice the chunk size into
+// content-defined chunks. Each chunk is stored in the database and added as a
+// resource, unless an identical resource was already added, and the indices of
+// the chunks are listed by the resource they were split from.
+func (b *Builder) chunkResources(ctx context.Context) error {
+	split, splitBytes, newBytes := 0, uint64(0), uint64(0)
+	// The chunks appended to b.resources are not visited.
+	for _, r := range b.resources {
+		if uint64(r.Size) < 2*uint64(b.resourceChunkSize) {
+			continue
+		}
+		rID := id.ID{}
+		copy(rID[:], r.Id)
+		obj, err := database.Resolve(ctx, rID)
+		if err != nil {
+			return log.Errf(ctx, err, "Resolving resource %v", rID)
+		}
+		data, ok := obj.([]byte)
+		if !ok {
+			return log.Errf(ctx, ErrInvalidResource, "Resource %v is not a byte slice", rID)
+		}
+		parts := chunks(data, b.resourceChunkSize)
+		if len(parts) < 2 {
+			continue
+		}
+		for _, part := range parts {
+			cID, err := database.Store(ctx, part)
+			if err != nil {
+				return log.Errf(ctx, err, "Storing a chunk of resource %v", rID)
+			}
+			idx, found := b.resourceIDToIdx[cID]
+			if !found {
+				idx = uint32(len(b.resources))
+				b.resourceIDToIdx[cID] = idx
+				b.resources = append(b.resources, &gapir.ResourceInfo{
+					Id:   cID[:],
+					Size: uint32(len(part)),
+				})
+				newBytes += uint64(len(part))
+			}
+			r.Chunks = append(r.Chunks, idx)
+		}
+		split++
+		splitBytes += uint64(r.Size)
+	}
+	log.D(ctx, "Split %d resources (%d bytes) into chunks, adding %d bytes of chunks", split, splitBytes, newBytes)
+	return nil
+}
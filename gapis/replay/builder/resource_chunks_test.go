@@ -0,0 +1,128 @@
+// Copyright (C) 2018 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package builder
+
+import (
+	"bytes"
+	"math/rand"
+	"testing"
+
+	"github.com/google/gapid/core/assert"
+	"github.com/google/gapid/core/data/id"
+	"github.com/google/gapid/core/log"
+	"github.com/google/gapid/core/os/device"
+	"github.com/google/gapid/gapis/database"
+	"github.com/google/gapid/gapis/memory"
+)
+
+const testChunkSize = 4096
+
+func randomBytes(seed int64, size int) []byte {
+	data := make([]byte, size)
+	rand.New(rand.NewSource(seed)).Read(data)
+	return data
+}
+
+func TestChunkSizeLimits(t *testing.T) {
+	assert := assert.To(t)
+	data := randomBytes(1, 1<<20)
+	parts := chunks(data, testChunkSize)
+	assert.For("data").ThatSlice(bytes.Join(parts, nil)).Equals(data)
+	for i, part := range parts[:len(parts)-1] {
+		assert.For("chunk %d size", i).ThatInteger(len(part)).IsBetween(testChunkSize/8, testChunkSize*4)
+	}
+	assert.For("chunk count").ThatInteger(len(parts)).IsBetween(len(data)/(testChunkSize*2), len(data)/(testChunkSize/2))
+
+	// Data without any boundary is split at the maximum chunk size.
+	zeros := make([]byte, testChunkSize*10)
+	for _, part := range chunks(zeros, testChunkSize)[:2] {
+		assert.For("zero chunk size").ThatInteger(len(part)).Equals(testChunkSize * 4)
+	}
+	assert.For("small chunk size").ThatInteger(chunkSize(data[:100], testChunkSize)).Equals(100)
+	assert.For("minimum chunk size").ThatInteger(chunkSize(data, MinResourceChunkSize)).IsAtLeast(MinResourceChunkSize / 8)
+}
+
+func TestChunksFollowContent(t *testing.T) {
+	assert := assert.To(t)
+	data := randomBytes(2, 1<<20)
+	edited := append(randomBytes(3, 1000), data...)
+	copy(edited[1<<19:], randomBytes(4, 64))
+
+	seen := map[id.ID]bool{}
+	for _, part := range chunks(data, testChunkSize) {
+		seen[id.OfBytes(part)] = true
+	}
+	changed := 0
+	for _, part := range chunks(edited, testChunkSize) {
+		if !seen[id.OfBytes(part)] {
+			changed += len(part)
+		}
+	}
+	// Only the chunks around the inserted and overwritten bytes change.
+	assert.For("changed bytes").ThatInteger(changed).IsAtMost(testChunkSize * 16)
+}
+
+func TestSetResourceChunkSize(t *testing.T) {
+	assert := assert.To(t)
+	b := New(device.Little64)
+	assert.For("disabled").ThatError(b.SetResourceChunkSize(0)).Succeeded()
+	assert.For("too small").ThatError(b.SetResourceChunkSize(MinResourceChunkSize - 1)).Failed()
+	assert.For("smallest").ThatError(b.SetResourceChunkSize(MinResourceChunkSize)).Succeeded()
+}
+
+func TestBuildChunkedResources(t *testing.T) {
+	ctx := log.Testing(t)
+	ctx = database.Put(ctx, database.NewInMemory(ctx))
+
+	first := randomBytes(5, 1<<18)
+	second := append([]byte{}, first...)
+	copy(second[1<<17:], randomBytes(6, 256))
+	small := randomBytes(7, testChunkSize)
+
+	b := New(device.Little64)
+	assert.For(ctx, "set").ThatError(b.SetResourceChunkSize(testChunkSize)).Succeeded()
+	for i, data := range [][]byte{first, second, small} {
+		rID, err := database.Store(ctx, data)
+		assert.For(ctx, "store").ThatError(err).Succeeded()
+		b.BeginCommand(uint64(i), 0)
+		b.Write(memory.Range{Base: 0x100000 * uint64(i+1), Size: uint64(len(data))}, rID)
+		b.CommitCommand()
+	}
+	payload, _, _, err := b.Build(ctx)
+	assert.For(ctx, "build").ThatError(err).Succeeded()
+
+	resources := payload.Resources
+	assert.For(ctx, "small chunks").ThatSlice(resources[2].Chunks).IsEmpty()
+	unique := map[uint32]bool{}
+	for i, data := range [][]byte{first, second} {
+		r := resources[i]
+		assert.For(ctx, "resource %d chunks", i).ThatSlice(r.Chunks).IsNotEmpty()
+		parts := [][]byte{}
+		for _, idx := range r.Chunks {
+			c := resources[idx]
+			assert.For(ctx, "chunk of chunk").ThatSlice(c.Chunks).IsEmpty()
+			cID := id.ID{}
+			copy(cID[:], c.Id)
+			obj, err := database.Resolve(ctx, cID)
+			assert.For(ctx, "resolve").ThatError(err).Succeeded()
+			assert.For(ctx, "chunk size").ThatInteger(len(obj.([]byte))).Equals(int(c.Size))
+			parts = append(parts, obj.([]byte))
+			unique[idx] = true
+		}
+		assert.For(ctx, "resource %d data", i).ThatSlice(bytes.Join(parts, nil)).Equals(data)
+	}
+	// The resources only differ in the chunks around the overwritten bytes.
+	assert.For(ctx, "unique chunks").ThatInteger(len(unique)).IsAtMost(len(resources[0].Chunks) + 4)
+}
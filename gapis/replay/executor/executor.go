@@ -96,6 +96,23 @@ func (e executor) HandleNotification(ctx context.Context, notification *gapir.No
 	return nil
 }
 
+// HandleReplayStats implements gapir.ReplayResponseHandler interface.
+func (e executor) HandleReplayStats(ctx context.Context, stats *gapir.ReplayStats, conn *gapir.Connection) error {
+	if stats == nil {
+		return nil
+	}
+	ms := func(ns uint64) float64 { return float64(ns) / 1e6 }
+	log.D(ctx, "Replay %v: payload %.1fms (%d bytes, %d resources), context %.1fms, renderer %.1fms, "+
+		"prefetch %.1fms, interpret %.1fms, resource fetch %.1fms (%d requests, %d resources, %d bytes, %d cache hits, %d lookahead hits), "+
+		"posts %d (%d bytes, %d on the wire), %d instructions skipped by checkpoint",
+		stats.ReplayId, ms(stats.PayloadNs), stats.PayloadBytes, stats.PayloadResources,
+		ms(stats.ContextNs), ms(stats.RendererNs), ms(stats.PrefetchNs), ms(stats.InterpretNs),
+		ms(stats.ResourceFetchNs), stats.ResourceRequests, stats.ResourcesRequested,
+		stats.ResourceBytesRequested, stats.ResourceCacheHits, stats.ResourceLookaheadHits,
+		stats.Posts, stats.PostBytes, stats.PostWireBytes, stats.CheckpointInstructions)
+	return nil
+}
+
 // HandleCrashDump implements gapir.ReplayResponseHandler interface.
 func (e executor) HandleCrashDump(ctx context.Context, dump *gapir.CrashDump, conn *gapir.Connection) error {
 	if dump == nil {
@@ -129,14 +146,15 @@ func (e executor) HandleResourceRequest(ctx context.Context, req *gapir.Resource
 	totalReturnedSize := uint64(0)
 	response := make([]byte, 0, totalExpectedSize)
 	db := database.Get(ctx)
-	for _, idStr := range ids {
-		rID, err := id.Parse(idStr)
-		if err != nil {
-			return log.Errf(ctx, err, "Failed to parse resource id: %v", idStr)
+	for _, idBytes := range ids {
+		if len(idBytes) != id.Size {
+			return log.Errf(ctx, nil, "Invalid resource id size: %v", len(idBytes))
 		}
+		rID := id.ID{}
+		copy(rID[:], idBytes)
 		obj, err := db.Resolve(ctx, rID)
 		if err != nil {
-			return log.Errf(ctx, err, "Failed to parse resource id: %v", idStr)
+			return log.Errf(ctx, err, "Failed to parse resource id: %v", rID)
 		}
 		objData := obj.([]byte)
 		response = append(response, objData...)
@@ -432,6 +432,14 @@ func optionsToTraceOptions(opts *service.TraceOptions) tracer.TraceOptions {
 		DeferStart:            opts.DeferStart,
 		NoBuffer:              opts.NoBuffer,
 		HideUnknownExtensions: opts.HideUnknownExtensions,
+		CompressStream:        opts.CompressStream,
+		PerThreadCapture:      opts.PerThreadCapture,
+		SharedMemoryStream:    opts.SharedMemoryStream,
+
+		FlightRecorderFrames:     opts.FlightRecorderFrames,
+		FlightRecorderBufferSize: opts.FlightRecorderBufferSize,
+
+		AsyncFramebufferObservations: opts.AsyncFramebufferObservations,
 	}
 }
 
@@ -442,6 +450,8 @@ type traceHandler struct {
 	initialized    bool               // Has the trace been initialized yet
 	started        bool               // Has the trace been started yet
 	done           bool               // Has the trace been finished
+	flightRecorder bool               // Is the trace using the flight recorder
+	flushed        bool               // Has the flight recorder been flushed
 	err            error              // Was there an error to report at next request
 	bytesWritten   int64              // How many bytes have been written so far
 	startSignal    task.Signal        // If we are in MEC this signal will start the trace
@@ -467,6 +477,7 @@ func (r *traceHandler) Initialize(opts *service.TraceOptions) (*service.StatusRe
 	if !opts.DeferStart {
 		r.started = true
 	}
+	r.flightRecorder = opts.FlightRecorderFrames != 0
 
 	resp := &service.StatusResponse{
 		BytesCaptured: 0,
@@ -497,6 +508,16 @@ func (r *traceHandler) Event(req service.TraceEvent) (*service.StatusResponse, e
 		}
 		r.stopFunc()
 		r.doneSignal.Wait(r.ctx)
+	case service.TraceEvent_Flush:
+		if !r.flightRecorder {
+			return nil, log.Errf(r.ctx, nil, "Cannot flush a trace that is not using the flight recorder")
+		}
+		if r.flushed {
+			return nil, log.Errf(r.ctx, nil, "Invalid to flush an already flushed trace")
+		}
+		// The flight recorder sends its frames when the start signal fires.
+		r.startFunc(r.ctx)
+		r.flushed = true
 	case service.TraceEvent_Status:
 		// intentionally empty
 	}
@@ -544,6 +565,8 @@ func (s *server) Trace(ctx context.Context) (service.TraceHandler, error) {
 		false,
 		false,
 		false,
+		false,
+		false,
 		nil,
 		0,
 		startSignal,
@@ -0,0 +1,87 @@
+// Copyright (C) 2018 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package shadertools
+
+import (
+	"fmt"
+	"io/ioutil"
+	"path/filepath"
+	"runtime"
+	"testing"
+
+	"github.com/google/gapid/core/assert"
+	"github.com/google/gapid/core/log"
+)
+
+// corpus returns the sources of the test shaders, and their conversion
+// options.
+func corpus(t testing.TB) ([]string, []*ConvertOptions) {
+	sources, opts := []string{}, []*ConvertOptions{}
+	for ext, ty := range map[string]ShaderType{".vert": TypeVertex, ".frag": TypeFragment} {
+		files, err := filepath.Glob(filepath.Join("cc", "tests", "shaders", "*"+ext))
+		if err != nil {
+			t.Fatal(err)
+		}
+		for _, file := range files {
+			source, err := ioutil.ReadFile(file)
+			if err != nil {
+				t.Fatal(err)
+			}
+			sources = append(sources, string(source))
+			opts = append(opts, &ConvertOptions{ShaderType: ty, CheckAfterChanges: true})
+		}
+	}
+	if len(sources) == 0 {
+		t.Fatal("No test shaders found")
+	}
+	return sources, opts
+}
+
+func TestConvertGlslBatch(t *testing.T) {
+	ctx := log.Testing(t)
+	sources, opts := corpus(t)
+	results := convertGlslBatch(sources, opts, 4)
+	assert.For(ctx, "count").That(len(results)).Equals(len(sources))
+	for i, source := range sources {
+		assert.For(ctx, "result %v", i).That(results[i]).DeepEquals(convertGlsl(source, opts[i]))
+	}
+}
+
+func TestCompileGlslBatch(t *testing.T) {
+	ctx := log.Testing(t)
+	sources, convertOpts := corpus(t)
+	opts := make([]CompileOptions, len(sources))
+	for i, o := range convertOpts {
+		opts[i] = CompileOptions{ShaderType: o.ShaderType, ClientType: OpenGLES}
+	}
+	results := compileGlslBatch(sources, opts, 4)
+	assert.For(ctx, "count").That(len(results)).Equals(len(sources))
+	for i, source := range sources {
+		assert.For(ctx, "result %v", i).That(results[i]).DeepEquals(compileGlsl(source, opts[i]))
+	}
+}
+
+// BenchmarkConvertGlslBatch measures the time taken to convert the test
+// shaders, without the cache, with an increasing number of threads.
+func BenchmarkConvertGlslBatch(b *testing.B) {
+	sources, opts := corpus(b)
+	for _, threads := range []int{1, 2, 4, 8, runtime.NumCPU()} {
+		b.Run(fmt.Sprintf("threads=%v", threads), func(b *testing.B) {
+			for i := 0; i < b.N; i++ {
+				convertGlslBatch(sources, opts, threads)
+			}
+		})
+	}
+}
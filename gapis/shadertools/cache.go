@@ -0,0 +1,276 @@
+// Copyright (C) 2018 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package shadertools
+
+import (
+	"container/list"
+	"encoding/json"
+	"fmt"
+	"io"
+	"io/ioutil"
+	"os"
+	"path/filepath"
+	"sync"
+
+	"github.com/google/gapid/core/data/id"
+	"github.com/google/gapid/core/fault"
+)
+
+// cacheVersion is part of every cache key. It must be incremented whenever a
+// change to the C library changes the results of conversion or compilation,
+// so that stale results on disk are not used.
+const cacheVersion = 1
+
+// defaultCacheSize is the default number of results held in memory.
+const defaultCacheSize = 1024
+
+// CacheStats holds the counters of the ConvertGlsl and CompileGlsl result
+// cache.
+type CacheStats struct {
+	Hits     uint64 // Results found in memory.
+	DiskHits uint64 // Results found in the cache directory.
+	Misses   uint64 // Results that had to be computed.
+}
+
+// HitRate returns the fraction of lookups that did not need computing.
+func (s CacheStats) HitRate() float64 {
+	total := s.Hits + s.DiskHits + s.Misses
+	if total == 0 {
+		return 0
+	}
+	return float64(s.Hits+s.DiskHits) / float64(total)
+}
+
+func (s CacheStats) String() string {
+	return fmt.Sprintf("hits: %v, disk hits: %v, misses: %v (%.1f%% hit rate)",
+		s.Hits, s.DiskHits, s.Misses, s.HitRate()*100)
+}
+
+// cachedResult is the result of a ConvertGlsl or CompileGlsl call.
+type cachedResult struct {
+	Code  CodeWithDebugInfo `json:",omitempty"`
+	Words []uint32          `json:",omitempty"`
+	Err   string            `json:",omitempty"`
+}
+
+// clone returns a deep copy of r, so that callers can modify the results
+// they are returned without modifying the cache.
+func (r cachedResult) clone() cachedResult {
+	out := r
+	if r.Words != nil {
+		out.Words = append([]uint32(nil), r.Words...)
+	}
+	if r.Code.Info != nil {
+		out.Code.Info = make([]Instruction, len(r.Code.Info))
+		for i, inst := range r.Code.Info {
+			inst.Words = append([]uint32(nil), inst.Words...)
+			out.Code.Info[i] = inst
+		}
+	}
+	return out
+}
+
+// err returns the error of the result, if any.
+func (r cachedResult) err() error {
+	if r.Err == "" {
+		return nil
+	}
+	return fault.Const(r.Err)
+}
+
+type cacheEntry struct {
+	key    id.ID
+	result cachedResult
+}
+
+// cache is an LRU cache of results in memory, backed by an optional
+// directory holding a file per result, which persists between runs.
+type cache struct {
+	mutex   sync.Mutex
+	size    int
+	dir     string
+	entries map[id.ID]*list.Element
+	lru     list.List // Of *cacheEntry, most recently used first.
+	stats   CacheStats
+}
+
+var results = newCache(defaultCacheSize)
+
+func newCache(size int) *cache {
+	return &cache{size: size, entries: map[id.ID]*list.Element{}}
+}
+
+// cacheKey returns the key of the result of the function with the given name
+// applied to source with the given options.
+func cacheKey(name, source string, options interface{}) id.ID {
+	key, _ := id.Hash(func(w io.Writer) error {
+		opts, err := json.Marshal(options)
+		if err != nil {
+			return err
+		}
+		fmt.Fprintf(w, "%v:%v:%v:%s:%v:", cacheVersion, name, len(opts), opts, len(source))
+		_, err = io.WriteString(w, source)
+		return err
+	})
+	return key
+}
+
+// get returns the result for key, calling compute to produce it if it is not
+// in the cache.
+func (c *cache) get(key id.ID, compute func() cachedResult) cachedResult {
+	return c.getAll([]id.ID{key}, func([]int) []cachedResult {
+		return []cachedResult{compute()}
+	})[0]
+}
+
+// getAll returns the results for keys, calling compute once with the indices
+// of the keys that are not in the cache to produce their results, in order.
+func (c *cache) getAll(keys []id.ID, compute func(missing []int) []cachedResult) []cachedResult {
+	out := make([]cachedResult, len(keys))
+	found := make([]bool, len(keys))
+	c.mutex.Lock()
+	for i, key := range keys {
+		if e, ok := c.entries[key]; ok {
+			c.lru.MoveToFront(e)
+			c.stats.Hits++
+			out[i], found[i] = e.Value.(*cacheEntry).result, true
+		}
+	}
+	dir := c.dir
+	c.mutex.Unlock()
+
+	diskHits, missing := uint64(0), []int{}
+	for i, key := range keys {
+		if !found[i] {
+			if r, ok := c.load(dir, key); ok {
+				out[i] = r
+				diskHits++
+			} else {
+				missing = append(missing, i)
+			}
+		}
+	}
+	if len(missing) > 0 {
+		for j, r := range compute(missing) {
+			out[missing[j]] = r
+			c.store(dir, keys[missing[j]], r)
+		}
+	}
+
+	c.mutex.Lock()
+	c.stats.DiskHits += diskHits
+	c.stats.Misses += uint64(len(missing))
+	for i, key := range keys {
+		if _, ok := c.entries[key]; !ok && !found[i] {
+			c.entries[key] = c.lru.PushFront(&cacheEntry{key, out[i]})
+		}
+	}
+	c.trim()
+	c.mutex.Unlock()
+
+	for i, r := range out {
+		out[i] = r.clone()
+	}
+	return out
+}
+
+// trim evicts the least recently used results until at most size remain.
+func (c *cache) trim() {
+	for c.lru.Len() > c.size {
+		e := c.lru.Back()
+		delete(c.entries, e.Value.(*cacheEntry).key)
+		c.lru.Remove(e)
+	}
+}
+
+func (c *cache) path(dir string, key id.ID) string {
+	return filepath.Join(dir, key.String()+".json")
+}
+
+// load reads the result for key from dir, if any.
+func (c *cache) load(dir string, key id.ID) (cachedResult, bool) {
+	r := cachedResult{}
+	if dir == "" {
+		return r, false
+	}
+	data, err := ioutil.ReadFile(c.path(dir, key))
+	if err != nil {
+		return r, false
+	}
+	if err := json.Unmarshal(data, &r); err != nil {
+		return cachedResult{}, false
+	}
+	return r, true
+}
+
+// store writes the result for key to dir. Failures are ignored, as the result
+// is just computed again in the next run.
+func (c *cache) store(dir string, key id.ID, r cachedResult) {
+	if dir == "" {
+		return
+	}
+	data, err := json.Marshal(r)
+	if err != nil {
+		return
+	}
+	// Write to a temporary file first, so that concurrent servers sharing the
+	// directory never read a partially written result.
+	f, err := ioutil.TempFile(dir, "tmp")
+	if err != nil {
+		return
+	}
+	_, err = f.Write(data)
+	if cerr := f.Close(); err == nil {
+		err = cerr
+	}
+	if err == nil {
+		err = os.Rename(f.Name(), c.path(dir, key))
+	}
+	if err != nil {
+		os.Remove(f.Name())
+	}
+}
+
+// SetCacheDir sets the directory in which the results of ConvertGlsl and
+// CompileGlsl are cached between runs, creating it if necessary. An empty
+// dir disables the on-disk cache.
+func SetCacheDir(dir string) error {
+	if dir != "" {
+		if err := os.MkdirAll(dir, 0755); err != nil {
+			return err
+		}
+	}
+	results.mutex.Lock()
+	defer results.mutex.Unlock()
+	results.dir = dir
+	return nil
+}
+
+// SetCacheSize sets the number of results of ConvertGlsl and CompileGlsl
+// that are cached in memory.
+func SetCacheSize(size int) {
+	results.mutex.Lock()
+	defer results.mutex.Unlock()
+	results.size = size
+	results.trim()
+}
+
+// GetCacheStats returns the counters of the ConvertGlsl and CompileGlsl result
+// cache.
+func GetCacheStats() CacheStats {
+	results.mutex.Lock()
+	defer results.mutex.Unlock()
+	return results.stats
+}
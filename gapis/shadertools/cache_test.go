@@ -0,0 +1,96 @@
+// Copyright (C) 2018 Google Inc.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//      http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+
+package shadertools
+
+import (
+	"io/ioutil"
+	"os"
+	"testing"
+
+	"github.com/google/gapid/core/assert"
+	"github.com/google/gapid/core/log"
+)
+
+func TestCacheKey(t *testing.T) {
+	ctx := log.Testing(t)
+	a := cacheKey("CompileGlsl", "void main() {}", CompileOptions{ShaderType: TypeVertex})
+	assert.For(ctx, "same").That(cacheKey("CompileGlsl", "void main() {}", CompileOptions{ShaderType: TypeVertex})).Equals(a)
+	assert.For(ctx, "source").That(cacheKey("CompileGlsl", "void main() { }", CompileOptions{ShaderType: TypeVertex})).NotEquals(a)
+	assert.For(ctx, "options").That(cacheKey("CompileGlsl", "void main() {}", CompileOptions{ShaderType: TypeFragment})).NotEquals(a)
+	assert.For(ctx, "preamble").That(cacheKey("CompileGlsl", "void main() {}", CompileOptions{ShaderType: TypeVertex, Preamble: "#define X"})).NotEquals(a)
+	assert.For(ctx, "function").That(cacheKey("ConvertGlsl", "void main() {}", CompileOptions{ShaderType: TypeVertex})).NotEquals(a)
+}
+
+func TestCacheLRU(t *testing.T) {
+	ctx := log.Testing(t)
+	c := newCache(2)
+	computed := 0
+	get := func(source string) cachedResult {
+		return c.get(cacheKey("test", source, nil), func() cachedResult {
+			computed++
+			return cachedResult{Words: []uint32{uint32(len(source))}, Err: source}
+		})
+	}
+
+	assert.For(ctx, "a").That(get("a").Err).Equals("a")
+	assert.For(ctx, "bb").That(get("bb").Words).DeepEquals([]uint32{2})
+	assert.For(ctx, "a again").That(get("a").Err).Equals("a")
+	assert.For(ctx, "computed").That(computed).Equals(2)
+
+	// Evicts bb, the least recently used.
+	get("ccc")
+	get("a")
+	assert.For(ctx, "computed").That(computed).Equals(3)
+	get("bb")
+	assert.For(ctx, "computed").That(computed).Equals(4)
+	assert.For(ctx, "stats").That(c.stats).Equals(CacheStats{Hits: 2, Misses: 4})
+
+	// Results are copied.
+	get("a").Words[0] = 10
+	assert.For(ctx, "copy").That(get("a").Words).DeepEquals([]uint32{1})
+}
+
+func TestCacheDir(t *testing.T) {
+	ctx := log.Testing(t)
+	dir, err := ioutil.TempDir("", "shadertools")
+	assert.For(ctx, "err").ThatError(err).Succeeded()
+	defer os.RemoveAll(dir)
+
+	result := cachedResult{
+		Code: CodeWithDebugInfo{
+			SourceCode: "void main() {}",
+			Info:       []Instruction{{ID: 1, Opcode: 2, Words: []uint32{3, 4}, Name: "x"}},
+		},
+	}
+	computed := 0
+	compute := func() cachedResult {
+		computed++
+		return result
+	}
+	key := cacheKey("test", "source", nil)
+
+	first := newCache(10)
+	first.dir = dir
+	first.get(key, compute)
+
+	// A new cache, as used by a new server, loads the result from disk.
+	second := newCache(10)
+	second.dir = dir
+	assert.For(ctx, "result").That(second.get(key, compute)).DeepEquals(result)
+	second.get(key, compute)
+	assert.For(ctx, "computed").That(computed).Equals(1)
+	assert.For(ctx, "stats").That(second.stats).Equals(CacheStats{Hits: 1, DiskHits: 1})
+	assert.For(ctx, "hit rate").That(second.stats.HitRate()).Equals(1.0)
+}
@@ -22,10 +22,14 @@
 #include "spirv2glsl.h"
 #include "spv_manager.h"
 
+#include <algorithm>
+#include <atomic>
 #include <cstring>
 #include <iostream>
+#include <mutex>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 
 const TBuiltInResource DefaultTBuiltInResource = {
@@ -125,6 +129,44 @@ const TBuiltInResource DefaultTBuiltInResource = {
         /* .generalConstantMatrixVectorIndexing = */ 1,
     }};
 
+/**
+ * Initializes glslang once for the process. The initialization is fairly
+ * expensive, so glslang is kept initialized indefinitely and
+ * glslang::FinalizeProcess() is never called. After this, glslang keeps the
+ * parser state of each thread in the pool allocator of the thread, so each
+ * batch worker parses with its own state.
+ **/
+static void initializeGlslang() {
+  static std::once_flag once;
+  std::call_once(once, [] { glslang::InitializeProcess(); });
+}
+
+/**
+ * Calls f for each index in [0, count) on up to threads threads, including
+ * the calling thread, or one thread per CPU if threads is 0.
+ **/
+template <typename F>
+static void parallelFor(size_t count, uint32_t threads, const F& f) {
+  if (threads == 0) {
+    threads = std::thread::hardware_concurrency();
+  }
+  size_t workers = std::max<size_t>(1, std::min<size_t>(threads, count));
+  std::atomic<size_t> next(0);
+  auto work = [&] {
+    for (size_t i = next++; i < count; i = next++) {
+      f(i);
+    }
+  };
+  std::vector<std::thread> pool;
+  for (size_t i = 1; i < workers; i++) {
+    pool.emplace_back(work);
+  }
+  work();
+  for (auto& thread : pool) {
+    thread.join();
+  }
+}
+
 void set_error_msg(code_with_debug_info_t* x, std::string msg) {
   x->ok = false;
   x->message = new char[msg.length() + 1];
@@ -209,7 +251,7 @@ std::vector<unsigned int> parseGlslang(const char* code, const char* preamble,
     }
   }
 
-  glslang::InitializeProcess();
+  initializeGlslang();
   glslang::TShader shader(lang);
   shader.setPreamble(preamble);
   shader.setStrings(&code, 1);
@@ -248,9 +290,6 @@ std::vector<unsigned int> parseGlslang(const char* code, const char* preamble,
     glslang::GlslangToSpv(*program.getIntermediate(lang), spirv);
   }
 
-  // The compiler initialization is fairly expensive, so keep it initialized
-  // indefinitely. glslang::FinalizeProcess();
-
   // Hack the SPIR-V to add a version to the header
   if (spirv.size() >= 2) {
     spirv[1] = glslang::EShTargetSpv_1_0;
@@ -343,6 +382,14 @@ code_with_debug_info_t* convertGlsl(const char* input, size_t length,
   return result;
 }
 
+void convertGlslBatch(const char* const* sources, const size_t* lengths,
+                      const convert_options_t* options, size_t count,
+                      uint32_t threads, code_with_debug_info_t** results) {
+  parallelFor(count, threads, [&](size_t i) {
+    results[i] = convertGlsl(sources[i], lengths[i], &options[i]);
+  });
+}
+
 /**
  * Releses memory allocated by SpvManager.
  * May needs update after changes.
@@ -448,6 +495,14 @@ glsl_compile_result_t* compileGlsl(const char* code,
   return result;
 }
 
+void compileGlslBatch(const char* const* sources,
+                      const compile_options_t* options, size_t count,
+                      uint32_t threads, glsl_compile_result_t** results) {
+  parallelFor(count, threads, [&](size_t i) {
+    results[i] = compileGlsl(sources[i], &options[i]);
+  });
+}
+
 void deleteCompileResult(glsl_compile_result_t* result) {
   if (result) {
     delete[] result->message;
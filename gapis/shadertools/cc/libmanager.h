@@ -96,9 +96,23 @@ typedef struct glsl_compile_result_t {
   spirv_binary_t binary;
 } glsl_compile_result_t;
 
+/**
+ * Calls to the functions below must not overlap. The batch functions process
+ * their shaders on worker threads of their own.
+ **/
+
 code_with_debug_info_t* convertGlsl(const char*, size_t,
                                     const convert_options_t*);
 
+/**
+ * Converts count shaders as convertGlsl does, on up to threads threads, or one
+ * thread per CPU if threads is 0. The source sources[i] of lengths[i] bytes is
+ * converted with options[i], and the result is stored to results[i].
+ **/
+void convertGlslBatch(const char* const* sources, const size_t* lengths,
+                      const convert_options_t* options, size_t count,
+                      uint32_t threads, code_with_debug_info_t** results);
+
 void deleteGlslCodeWithDebug(code_with_debug_info_t*);
 
 const char* getDisassembleText(uint32_t*, size_t);
@@ -113,6 +127,15 @@ const char* opcodeToString(uint32_t);
 
 glsl_compile_result_t* compileGlsl(const char* code, const compile_options_t*);
 
+/**
+ * Compiles count shaders as compileGlsl does, on up to threads threads, or one
+ * thread per CPU if threads is 0. The source sources[i] is compiled with
+ * options[i], and the result is stored to results[i].
+ **/
+void compileGlslBatch(const char* const* sources,
+                      const compile_options_t* options, size_t count,
+                      uint32_t threads, glsl_compile_result_t** results);
+
 void deleteCompileResult(glsl_compile_result_t*);
 
 #ifdef __cplusplus
@@ -29,10 +29,12 @@ import (
 	"sync"
 	"unsafe"
 
-	"github.com/google/gapid/core/fault"
+	"github.com/google/gapid/core/data/id"
 	"github.com/google/gapid/core/text"
 )
 
+// mutex serializes the calls to libmanager. The batch calls hold it while
+// libmanager runs their workers.
 var mutex sync.Mutex
 
 // Instruction represents a SPIR-V instruction.
@@ -148,7 +150,38 @@ type ConvertOptions struct {
 // o and returns the modification status and result. Possible modifications
 // includes creating output variables for input variables, prefixing all
 // non-builtin symbols with a given prefix, etc.
+// The results are cached by source and options.
 func ConvertGlsl(source string, o *ConvertOptions) (CodeWithDebugInfo, error) {
+	r := results.get(cacheKey("ConvertGlsl", source, o), func() cachedResult {
+		return convertGlsl(source, o)
+	})
+	return r.Code, r.err()
+}
+
+// ConvertGlslBatch converts each of sources with the options at the same index
+// of opts, as ConvertGlsl does. The sources that are not cached are converted
+// concurrently on up to threads threads, or one thread per CPU if threads is 0.
+// The results and errors are returned in the order of sources.
+func ConvertGlslBatch(sources []string, opts []*ConvertOptions, threads int) ([]CodeWithDebugInfo, []error) {
+	keys := make([]id.ID, len(sources))
+	for i, source := range sources {
+		keys[i] = cacheKey("ConvertGlsl", source, opts[i])
+	}
+	rs := results.getAll(keys, func(missing []int) []cachedResult {
+		s, o := make([]string, len(missing)), make([]*ConvertOptions, len(missing))
+		for i, j := range missing {
+			s[i], o[i] = sources[j], opts[j]
+		}
+		return convertGlslBatch(s, o, threads)
+	})
+	codes, errs := make([]CodeWithDebugInfo, len(rs)), make([]error, len(rs))
+	for i, r := range rs {
+		codes[i], errs[i] = r.Code, r.err()
+	}
+	return codes, errs
+}
+
+func convertGlsl(source string, o *ConvertOptions) cachedResult {
 	toFree := []unsafe.Pointer{}
 	defer func() {
 		for _, ptr := range toFree {
@@ -156,16 +189,65 @@ func ConvertGlsl(source string, o *ConvertOptions) (CodeWithDebugInfo, error) {
 		}
 	}()
 
+	cstr := func(s string) *C.char {
+		out := C.CString(s)
+		toFree = append(toFree, unsafe.Pointer(out))
+		return out
+	}
+
 	mutex.Lock()
 	defer mutex.Unlock()
 
+	opts := cConvertOptions(o, cstr)
+	result := C.convertGlsl(cstr(source), C.size_t(len(source)), &opts)
+	defer C.deleteGlslCodeWithDebug(result)
+	return convertResult(result, source, o)
+}
+
+func convertGlslBatch(sources []string, opts []*ConvertOptions, threads int) []cachedResult {
+	if len(sources) == 0 {
+		return nil
+	}
+	toFree := []unsafe.Pointer{}
+	defer func() {
+		for _, ptr := range toFree {
+			C.free(ptr)
+		}
+	}()
+
 	cstr := func(s string) *C.char {
 		out := C.CString(s)
 		toFree = append(toFree, unsafe.Pointer(out))
 		return out
 	}
 
-	opts := C.struct_convert_options_t{
+	count := len(sources)
+	cSources := make([]*C.char, count)
+	cLengths := make([]C.size_t, count)
+	cOpts := make([]C.struct_convert_options_t, count)
+	cResults := make([]*C.code_with_debug_info_t, count)
+	for i, source := range sources {
+		cSources[i] = cstr(source)
+		cLengths[i] = C.size_t(len(source))
+		cOpts[i] = cConvertOptions(opts[i], cstr)
+	}
+	mutex.Lock()
+	C.convertGlslBatch(&cSources[0], &cLengths[0], &cOpts[0], C.size_t(count),
+		C.uint32_t(threads), &cResults[0])
+	mutex.Unlock()
+
+	out := make([]cachedResult, count)
+	for i, result := range cResults {
+		out[i] = convertResult(result, sources[i], opts[i])
+		C.deleteGlslCodeWithDebug(result)
+	}
+	return out
+}
+
+// cConvertOptions returns the C options for o, allocating the strings with
+// cstr.
+func cConvertOptions(o *ConvertOptions, cstr func(string) *C.char) C.struct_convert_options_t {
+	return C.struct_convert_options_t{
 		shader_type:            C.shader_type(o.ShaderType),
 		preamble:               cstr(o.Preamble),
 		prefix_names:           C.bool(o.PrefixNames),
@@ -179,9 +261,11 @@ func ConvertGlsl(source string, o *ConvertOptions) (CodeWithDebugInfo, error) {
 		strip_optimizations:    C.bool(o.StripOptimizations),
 		target_glsl_version:    C.int(o.TargetGLSLVersion),
 	}
-	result := C.convertGlsl(cstr(source), C.size_t(len(source)), &opts)
-	defer C.deleteGlslCodeWithDebug(result)
+}
 
+// convertResult returns the result of converting source with the options o
+// from the C result.
+func convertResult(result *C.code_with_debug_info_t, source string, o *ConvertOptions) cachedResult {
 	ret := CodeWithDebugInfo{
 		SourceCode:        C.GoString(result.source_code),
 		DisassemblyString: C.GoString(result.disassembly_string),
@@ -214,10 +298,10 @@ func ConvertGlsl(source string, o *ConvertOptions) (CodeWithDebugInfo, error) {
 		}
 		msg = append(msg, "Translated source:", text.LineNumber(C.GoString(result.source_code)))
 		msg = append(msg, "Original source:", text.LineNumber(source))
-		return ret, fault.Const(strings.Join(msg, "\n"))
+		return cachedResult{Code: ret, Err: strings.Join(msg, "\n")}
 	}
 
-	return ret, nil
+	return cachedResult{Code: ret}
 }
 
 // DisassembleSpirvBinary disassembles the given SPIR-V binary words by calling
@@ -272,38 +356,118 @@ type CompileOptions struct {
 }
 
 // CompileGlsl compiles GLSL source code to SPIR-V binary words.
+// The results are cached by source and options.
 func CompileGlsl(source string, o CompileOptions) ([]uint32, error) {
+	r := results.get(cacheKey("CompileGlsl", source, o), func() cachedResult {
+		return compileGlsl(source, o)
+	})
+	return r.Words, r.err()
+}
+
+// CompileGlslBatch compiles each of sources with the options at the same index
+// of opts, as CompileGlsl does. The sources that are not cached are compiled
+// concurrently on up to threads threads, or one thread per CPU if threads is 0.
+// The results and errors are returned in the order of sources.
+func CompileGlslBatch(sources []string, opts []CompileOptions, threads int) ([][]uint32, []error) {
+	keys := make([]id.ID, len(sources))
+	for i, source := range sources {
+		keys[i] = cacheKey("CompileGlsl", source, opts[i])
+	}
+	rs := results.getAll(keys, func(missing []int) []cachedResult {
+		s, o := make([]string, len(missing)), make([]CompileOptions, len(missing))
+		for i, j := range missing {
+			s[i], o[i] = sources[j], opts[j]
+		}
+		return compileGlslBatch(s, o, threads)
+	})
+	words, errs := make([][]uint32, len(rs)), make([]error, len(rs))
+	for i, r := range rs {
+		words[i], errs[i] = r.Words, r.err()
+	}
+	return words, errs
+}
+
+func compileGlsl(source string, o CompileOptions) cachedResult {
 	toFree := []unsafe.Pointer{}
 	defer func() {
 		for _, ptr := range toFree {
 			C.free(ptr)
 		}
 	}()
+
+	cstr := func(s string) *C.char {
+		out := C.CString(s)
+		toFree = append(toFree, unsafe.Pointer(out))
+		return out
+	}
+
 	mutex.Lock()
 	defer mutex.Unlock()
 
+	opts := cCompileOptions(o, cstr)
+	result := C.compileGlsl(cstr(source), &opts)
+	defer C.deleteCompileResult(result)
+	return compileResult(result, source, o)
+}
+
+func compileGlslBatch(sources []string, opts []CompileOptions, threads int) []cachedResult {
+	if len(sources) == 0 {
+		return nil
+	}
+	toFree := []unsafe.Pointer{}
+	defer func() {
+		for _, ptr := range toFree {
+			C.free(ptr)
+		}
+	}()
+
 	cstr := func(s string) *C.char {
 		out := C.CString(s)
 		toFree = append(toFree, unsafe.Pointer(out))
 		return out
 	}
 
-	opts := C.struct_compile_options_t{
+	count := len(sources)
+	cSources := make([]*C.char, count)
+	cOpts := make([]C.struct_compile_options_t, count)
+	cResults := make([]*C.glsl_compile_result_t, count)
+	for i, source := range sources {
+		cSources[i] = cstr(source)
+		cOpts[i] = cCompileOptions(opts[i], cstr)
+	}
+	mutex.Lock()
+	C.compileGlslBatch(&cSources[0], &cOpts[0], C.size_t(count),
+		C.uint32_t(threads), &cResults[0])
+	mutex.Unlock()
+
+	out := make([]cachedResult, count)
+	for i, result := range cResults {
+		out[i] = compileResult(result, sources[i], opts[i])
+		C.deleteCompileResult(result)
+	}
+	return out
+}
+
+// cCompileOptions returns the C options for o, allocating the strings with
+// cstr.
+func cCompileOptions(o CompileOptions, cstr func(string) *C.char) C.struct_compile_options_t {
+	return C.struct_compile_options_t{
 		shader_type: C.shader_type(o.ShaderType),
 		client_type: C.client_type(o.ClientType),
 		preamble:    cstr(o.Preamble),
 	}
+}
 
-	result := C.compileGlsl(cstr(source), &opts)
-	defer C.deleteCompileResult(result)
-
+// compileResult returns the result of compiling source with the options o
+// from the C result.
+func compileResult(result *C.glsl_compile_result_t, source string, o CompileOptions) cachedResult {
 	count := uint64(result.binary.words_num)
 	words := make([]uint32, count)
 	if result.ok {
 		// TODO: Remove the following hack and encoding the data without using unsafe.
 		data := (*[1 << 30]uint32)(unsafe.Pointer(result.binary.words))[:count:count]
 		copy(words, data)
-		return words, nil
+		return cachedResult{Words: words}
 	}
 	msg := []string{
 		fmt.Sprintf("Failed to compile %v shader.", o.ShaderType),
@@ -315,5 +479,5 @@ func CompileGlsl(source string, o CompileOptions) ([]uint32, error) {
 	if len(o.Preamble) > 0 {
 		msg = append(msg, "Preamble:", text.LineNumber(o.Preamble))
 	}
-	return words, fault.Const(strings.Join(msg, "\n"))
+	return cachedResult{Words: words, Err: strings.Join(msg, "\n")}
 }
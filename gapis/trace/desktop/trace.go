@@ -231,7 +231,13 @@ func (t *DesktopTracer) SetupTrace(ctx context.Context, o *tracer.TraceOptions)
 		cleanup(ctx)
 		return nil, nil, err
 	}
-	process := &gapii.Process{Port: boundPort, Device: t.b, Options: o.GapiiOptions()}
+	options := o.GapiiOptions()
+	// The shared memory ring is mapped through /proc, so it is only offered
+	// to an application running on this host.
+	if o.SharedMemoryStream && t.b.Instance().ID.ID() == bind.Host(ctx).Instance().ID.ID() {
+		options.Flags |= gapii.SharedMemoryStream
+	}
+	process := &gapii.Process{Port: boundPort, Device: t.b, Options: options}
 	return process, func() { cleanup(ctx) }, nil
 }
 
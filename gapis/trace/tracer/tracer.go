@@ -67,6 +67,14 @@ type TraceOptions struct {
 	DeferStart            bool    // Should we record extra error state
 	NoBuffer              bool    // Disable buffering.
 	HideUnknownExtensions bool    // Hide unknown extensions from the application.
+	CompressStream        bool    // Compress the capture stream.
+	PerThreadCapture      bool    // Capture command buffer recording on different threads concurrently.
+	SharedMemoryStream    bool    // Stream the capture through shared memory, if the application runs on the host.
+
+	FlightRecorderFrames     uint32 // How many frames should the flight recorder retain
+	FlightRecorderBufferSize uint64 // How many bytes may the flight recorder retain
+
+	AsyncFramebufferObservations bool // Downsample framebuffer observations on a background thread
 }
 
 // Tracer is an option interface that a bind.Device can implement.
@@ -134,6 +142,15 @@ func (o TraceOptions) GapiiOptions() gapii.Options {
 	if o.HideUnknownExtensions {
 		flags |= gapii.HideUnknownExtensions
 	}
+	if o.CompressStream {
+		flags |= gapii.CompressStream
+	}
+	if o.PerThreadCapture {
+		flags |= gapii.PerThreadCapture
+	}
+	if o.AsyncFramebufferObservations {
+		flags |= gapii.AsyncFramebufferObservations
+	}
 
 	return gapii.Options{
 		o.ObserveFrameFrequency,
@@ -143,5 +160,7 @@ func (o TraceOptions) GapiiOptions() gapii.Options {
 		apis,
 		flags,
 		o.AdditionalFlags,
+		o.FlightRecorderFrames,
+		o.FlightRecorderBufferSize,
 	}
 }